@@ -1,36 +1,75 @@
 #include "activation_functions.h"
 
-ActivationResult relu(double value) {
-    ActivationResult result;
-    if (value < 0) {
-        result.activatedValue = 0;
-        result.derivative = 0;
-    } else {
-        result.activatedValue = value;
-        result.derivative = 1;
+static const char FAST_SUFFIX[] = "_fast";
+
+ActivationType activationFromName(const std::string& functionName){
+    size_t suffixLength = sizeof(FAST_SUFFIX) - 1;
+    if(functionName.size() > suffixLength
+       && functionName.compare(functionName.size() - suffixLength, suffixLength, FAST_SUFFIX) == 0){
+        return withPrecision(activationFromName(functionName.substr(0, functionName.size() - suffixLength)),
+                             ActivationPrecision::Fast);
+    }
+    if(functionName == "relu") {
+        return ActivationType::Relu;
+    } else if(functionName == "tanh") {
+        return ActivationType::Tanh;
+    } else if(functionName == "softmax") {
+        return ActivationType::Softmax;
+    } else if(functionName == "sigmoid") {
+        return ActivationType::Sigmoid;
+    } else if(functionName == "gelu") {
+        return ActivationType::Gelu;
+    } else if(functionName == "softplus") {
+        return ActivationType::Softplus;
     }
-    return result;
+    return ActivationType::LeakyRelu;
 }
-ActivationResult leakyRelu(double value){
-    ActivationResult result;
-    if (value < 0) {
-        
-        result.activatedValue = 0.01 * value;
-        result.derivative = 0.01;
-    } else {
-        result.activatedValue = value;
-        result.derivative = 1;
+const char* activationName(ActivationType type){
+    switch(type){
+        case ActivationType::Relu:
+            return "relu";
+        case ActivationType::Tanh:
+            return "tanh";
+        case ActivationType::Softmax:
+            return "softmax";
+        case ActivationType::Sigmoid:
+            return "sigmoid";
+        case ActivationType::Gelu:
+            return "gelu";
+        case ActivationType::Softplus:
+            return "softplus";
+        case ActivationType::TanhFast:
+            return "tanh_fast";
+        case ActivationType::SigmoidFast:
+            return "sigmoid_fast";
+        case ActivationType::GeluFast:
+            return "gelu_fast";
+        case ActivationType::SoftplusFast:
+            return "softplus_fast";
+        default:
+            return "leakyrelu";
     }
-    return result;
 }
-ActivationResult tanH(double value){
-    ActivationResult result;
-    result.activatedValue = tanh(value);
-    result.derivative = 1 - (result.activatedValue * result.activatedValue);
-
-    return result;
 
+ActivationType withPrecision(ActivationType type, ActivationPrecision precision){
+    bool fast = precision == ActivationPrecision::Fast;
+    switch(type){
+        case ActivationType::Tanh:
+        case ActivationType::TanhFast:
+            return fast ? ActivationType::TanhFast : ActivationType::Tanh;
+        case ActivationType::Sigmoid:
+        case ActivationType::SigmoidFast:
+            return fast ? ActivationType::SigmoidFast : ActivationType::Sigmoid;
+        case ActivationType::Gelu:
+        case ActivationType::GeluFast:
+            return fast ? ActivationType::GeluFast : ActivationType::Gelu;
+        case ActivationType::Softplus:
+        case ActivationType::SoftplusFast:
+            return fast ? ActivationType::SoftplusFast : ActivationType::Softplus;
+        default:
+            return type;
+    }
+}
+ActivationPrecision precisionOf(ActivationType type){
+    return withPrecision(type, ActivationPrecision::Exact) == type ? ActivationPrecision::Exact : ActivationPrecision::Fast;
 }
-
-
-
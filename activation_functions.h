@@ -1,16 +1,230 @@
 #ifndef ACTIVATION_FUNCS
 #define ACTIVATION_FUNCS
 #include <math.h>
+#include <cmath>
+#include <string>
+#include <algorithm>
 
-struct ActivationResult {
-    double activatedValue;
-    double derivative;
+template<typename Scalar>
+struct ActivationResultT {
+    Scalar activatedValue;
+    Scalar derivative;
 };
-ActivationResult relu(double value);
+typedef ActivationResultT<double> ActivationResult;
 
-ActivationResult leakyRelu(double value);
+//activations are chosen per layer. The enum is resolved once per layer and
+//indexes kernels that are specialized for it at compile time. The values are
+//stored in model files, new types go at the end
+enum class ActivationType {
+    LeakyRelu,
+    Relu,
+    Tanh,
+    //layer scope, output layers only. The per element kernels leave the logits
+    //as they are with a derivative of 1 and softmax() then normalizes the whole
+    //layer. The output is trained with cross-entropy, so its delta is p - y
+    Softmax,
+    //1 / (1 + e^-x), x * Phi(x) with the normal CDF Phi, and log(1 + e^x).
+    //These call libm once per element on every ISA
+    Sigmoid,
+    Gelu,
+    Softplus,
+    //vectorized approximations of the exact types, see ActivationPrecision.
+    //Largest absolute error of the double kernels against the exact function
+    //on [-20, 20], for the value and the derivative:
+    //rational x * P(x^2) / Q(x^2) clamped at |x| = 7.9, 2.7e-7 and 5.3e-7
+    TanhFast,
+    //0.5 + 0.5 * tanh(x / 2) with the fast tanh, 1.3e-7 and 1.3e-7
+    SigmoidFast,
+    //Abramowitz and Stegun 7.1.26 for erf with a short exp, 2.2e-7 and 8e-8
+    GeluFast,
+    //max(x, 0) + log1p(e^-|x|) with the same exp and a 6 term atanh series
+    //for log1p, 1.1e-7 and 4e-8
+    SoftplusFast
+};
+const int ACTIVATION_TYPE_COUNT = 11;
+
+//how setActivation picks between an exact activation and its approximation.
+//Exact tanh is within a few ulp and vectorized, exact sigmoid, GELU and
+//softplus call libm. Fast trades that for an absolute error of a few 1e-7,
+//well below what training notices, and runs an order of magnitude faster
+//than libm. Types without an approximation are the same in both
+enum class ActivationPrecision {
+    Exact,
+    Fast
+};
+
+//type with the given precision, e.g. Tanh and Fast give TanhFast
+ActivationType withPrecision(ActivationType type, ActivationPrecision precision);
+//Fast for the approximations
+ActivationPrecision precisionOf(ActivationType type);
+
+//the exact sigmoid, GELU and softplus, which have no vectorized kernel
+constexpr bool usesLibm(ActivationType type){
+    return type == ActivationType::Sigmoid || type == ActivationType::Gelu || type == ActivationType::Softplus;
+}
+
+//constants of the fast approximations, the double and float kernels evaluate
+//the same expressions in their own precision.
+//tanh(x) = x * P(x^2) / Q(x^2) on |x| <= FAST_TANH_CLAMP, where it rounds to 1
+//in float. P and Q are in Horner order, highest power first
+const double FAST_TANH_CLAMP = 7.90531110763549805;
+const int FAST_TANH_P_TERMS = 7;
+const double FAST_TANH_P[FAST_TANH_P_TERMS] = {
+    -2.76076847742355e-16, 2.00018790482477e-13, -8.60467152213735e-11, 5.12229709037114e-08,
+    1.48572235717979e-05, 6.37261928875436e-04, 4.89352455891786e-03
+};
+const int FAST_TANH_Q_TERMS = 4;
+const double FAST_TANH_Q[FAST_TANH_Q_TERMS] = {
+    1.19825839466702e-06, 1.18534705686654e-04, 2.26843463243900e-03, 4.89352518554385e-03
+};
+//e^x for -FAST_EXP_CLAMP <= x <= 0 as 2^n * e^r, |r| <= ln2/2, with the
+//degree 6 Taylor polynomial of e^r. 1.6e-7 relative error, e^-80 is still a
+//normal float
+const double FAST_EXP_CLAMP = 80.0;
+const int FAST_EXP_TERMS = 7;
+const double FAST_EXP_COEFFS[FAST_EXP_TERMS] = {
+    1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0
+};
+//erfc(z) = t * A(t) * e^-z^2 with t = 1 / (1 + FAST_ERF_P * z) for z >= 0,
+//Abramowitz and Stegun 7.1.26 (error 1.5e-7). Past FAST_GELU_CLAMP the tail
+//is below 1e-22 and the GELU is x or 0
+const double FAST_ERF_P = 0.3275911;
+const int FAST_ERF_TERMS = 5;
+const double FAST_ERF_A[FAST_ERF_TERMS] = {
+    1.061405429, -1.453152027, 1.421413741, -0.284496736, 0.254829592
+};
+const double FAST_GELU_CLAMP = 10.0;
+const double INV_SQRT2 = 0.70710678118654752440;
+const double INV_SQRT_2PI = 0.39894228040143267794;
+//log1p(u) = 2 atanh(s) = 2 * (s + s^3 / 3 + ... + s^11 / 11) with
+//s = u / (u + 2) <= 1/3 for u <= 1, error 1e-8
+const int FAST_LOG1P_TERMS = 6;
+const double FAST_LOG1P_COEFFS[FAST_LOG1P_TERMS] = {
+    1.0 / 11.0, 1.0 / 9.0, 1.0 / 7.0, 1.0 / 5.0, 1.0 / 3.0, 1.0
+};
+
+//activations that need the whole layer, see softmax()
+inline bool isLayerScope(ActivationType type){
+    return type == ActivationType::Softmax;
+}
+
+template<typename Scalar>
+ActivationResultT<Scalar> relu(Scalar value) {
+    ActivationResultT<Scalar> result;
+    if (value < 0) {
+        result.activatedValue = 0;
+        result.derivative = 0;
+    } else {
+        result.activatedValue = value;
+        result.derivative = 1;
+    }
+    return result;
+}
+template<typename Scalar>
+ActivationResultT<Scalar> leakyRelu(Scalar value){
+    ActivationResultT<Scalar> result;
+    if (value < 0) {
+        result.activatedValue = Scalar(0.01) * value;
+        result.derivative = Scalar(0.01);
+    } else {
+        result.activatedValue = value;
+        result.derivative = 1;
+    }
+    return result;
+}
+template<typename Scalar>
+ActivationResultT<Scalar> tanH(Scalar value){
+    ActivationResultT<Scalar> result;
+    result.activatedValue = std::tanh(value);
+    result.derivative = 1 - (result.activatedValue * result.activatedValue);
+    return result;
+}
+
+template<typename Scalar>
+ActivationResultT<Scalar> sigmoid(Scalar value){
+    ActivationResultT<Scalar> result;
+    result.activatedValue = 1 / (1 + std::exp(-value));
+    result.derivative = result.activatedValue * (1 - result.activatedValue);
+    return result;
+}
+//x * Phi(x), Phi(x) = erfc(-x / sqrt(2)) / 2. The derivative is Phi(x) + x * phi(x)
+template<typename Scalar>
+ActivationResultT<Scalar> gelu(Scalar value){
+    const Scalar invSqrt2 = Scalar(0.70710678118654752440L);
+    const Scalar invSqrt2Pi = Scalar(0.39894228040143267794L);
+    ActivationResultT<Scalar> result;
+    Scalar cdf = Scalar(0.5) * std::erfc(-value * invSqrt2);
+    result.activatedValue = value * cdf;
+    result.derivative = cdf + value * invSqrt2Pi * std::exp(Scalar(-0.5) * value * value);
+    return result;
+}
+//log(1 + e^x) written so that neither e^x overflows nor 1 + e^x loses e^x
+template<typename Scalar>
+ActivationResultT<Scalar> softPlus(Scalar value){
+    ActivationResultT<Scalar> result;
+    result.activatedValue = std::max(value, Scalar(0)) + std::log1p(std::exp(-std::abs(value)));
+    result.derivative = sigmoid(value).activatedValue;
+    return result;
+}
+
+//the per element part of softmax
+template<typename Scalar>
+ActivationResultT<Scalar> logit(Scalar value){
+    ActivationResultT<Scalar> result;
+    result.activatedValue = value;
+    result.derivative = 1;
+    return result;
+}
+
+//numerically stable softmax of n logits in place: one pass for the max and one
+//that exponentiates and sums, so every logit costs a single exp. Subtracting
+//the max keeps every exp in (0, 1] and the sum at least 1
+template<typename Scalar>
+void softmax(Scalar* values, size_t n){
+    Scalar maxValue = values[0];
+    for(size_t i = 1; i < n; i++){
+        maxValue = values[i] > maxValue ? values[i] : maxValue;
+    }
+    Scalar sum = 0;
+    for(size_t i = 0; i < n; i++){
+        values[i] = std::exp(values[i] - maxValue);
+        sum += values[i];
+    }
+    Scalar inverse = Scalar(1) / sum;
+    for(size_t i = 0; i < n; i++){
+        values[i] *= inverse;
+    }
+}
+
+//single value version of the layer kernels with libm, for debugging. The fast
+//types give the exact value they approximate, which is what their errors are
+//measured against
+template<typename Scalar>
+ActivationResultT<Scalar> applyActivation(ActivationType type, Scalar value){
+    switch(withPrecision(type, ActivationPrecision::Exact)){
+        case ActivationType::Relu:
+            return relu(value);
+        case ActivationType::Tanh:
+            return tanH(value);
+        case ActivationType::Softmax:
+            return logit(value);
+        case ActivationType::Sigmoid:
+            return sigmoid(value);
+        case ActivationType::Gelu:
+            return gelu(value);
+        case ActivationType::Softplus:
+            return softPlus(value);
+        default:
+            return leakyRelu(value);
+    }
+}
+
+//"relu", "tanh", "softmax", "sigmoid", "gelu", "softplus" or "leakyrelu", and
+//"tanh_fast", "sigmoid_fast", "gelu_fast" or "softplus_fast" for the
+//approximations. Unknown names fall back to leaky relu
+ActivationType activationFromName(const std::string& functionName);
 
-ActivationResult tanH(double value);
+const char* activationName(ActivationType type);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,327 @@
+#include "network.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+#include <type_traits>
+
+//throughput benchmarks for the training and inference passes and the data
+//loader. Results are printed as one JSON document so runs can be compared.
+//  --quick          small grid, for a fast check
+//  --min-time s     seconds each measurement runs for (default 0.25)
+//  --threads n      thread pool size for trainBatch and wide layers (default 1)
+//  --data-mb n      size of the generated CSV for processData (default 64)
+//  --scalar type    double, float or both (default both)
+//  --optimizer name sgd, momentum, rmsprop, adam or adamw for the training rows (default rmsprop)
+//  --output file    write the JSON to file instead of stdout
+
+//FLOPs are counted per weight, bias adds and activations are left out:
+//  forward           2 (multiply-add)
+//  propagating back  2, every layer except the first hidden one
+//  batch gradient    2 per sample
+//  optimizer update  Optimizer::flopsPerWeight
+//the int8 rows count their integer multiply-adds the same way
+
+struct BenchmarkResult {
+    std::string name;
+    //"double" or "float"
+    std::string scalar;
+    std::vector<int> structure;
+    int batchSize;
+    bool includesForward;
+    long long iterations;
+    double seconds;
+    double samplesPerSecond;
+    double gflops;
+};
+
+struct DataResult {
+    std::string name;
+    unsigned long long bytes;
+    size_t rows;
+    double seconds;
+    double megabytesPerSecond;
+};
+
+static double elapsedSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//one warmup call, then calls body until minTime has passed
+template<typename Body>
+static BenchmarkResult measure(const std::string& name, const char* scalar, const std::vector<int>& structure, int batchSize,
+                               bool includesForward, double flopsPerCall, double minTime, Body body){
+    body();
+    long long iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+    do {
+        body();
+        iterations++;
+        seconds = elapsedSince(start);
+    } while(seconds < minTime);
+
+    BenchmarkResult result;
+    result.name = name;
+    result.scalar = scalar;
+    result.structure = structure;
+    result.batchSize = batchSize;
+    result.includesForward = includesForward;
+    result.iterations = iterations;
+    result.seconds = seconds;
+    result.samplesPerSecond = iterations * batchSize / seconds;
+    result.gflops = iterations * flopsPerCall / seconds * 1e-9;
+    return result;
+}
+
+//weights of every layer, and of the layers that propagate deltas (not the first hidden layer)
+static void countWeights(const std::vector<int>& structure, double& weights, double& propagated){
+    weights = 0.0;
+    propagated = 0.0;
+    for(size_t i = 1; i < structure.size(); i++){
+        double count = (double)structure[i - 1] * structure[i];
+        weights += count;
+        if(i > 1){
+            propagated += count;
+        }
+    }
+}
+
+template<typename Scalar>
+static void benchmarkNetwork(const std::vector<int>& structure, int batchSize, int numThreads, const Optimizer& optimizer,
+                             double minTime, std::vector<BenchmarkResult>& results){
+    const char* scalar = sizeof(Scalar) == sizeof(float) ? "float" : "double";
+    NetworkT<Scalar> net;
+    net.setupNetwork(structure);
+    net.setOptimizer(optimizer);
+    //small steps on a fixed sample keep the weights finite for the whole run
+    net.learningRate = 1e-4;
+    net.setThreads(numThreads);
+    net.intraLayerParallel = numThreads > 1;
+
+    std::mt19937_64 generator(1234);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<Scalar> inputs((size_t)batchSize * structure.front());
+    std::vector<Scalar> expected((size_t)batchSize * structure.back());
+    for(Scalar& value: inputs){
+        value = (Scalar)dist(generator);
+    }
+    for(Scalar& value: expected){
+        value = (Scalar)dist(generator);
+    }
+
+    double weights, propagated;
+    countWeights(structure, weights, propagated);
+    double forwardFlops = 2.0 * weights;
+    //network::backPropagate and backPropagateRMS both apply the network's optimizer
+    double updateFlops = optimizer.flopsPerWeight() * weights;
+    double backwardFlops = 2.0 * propagated + updateFlops;
+
+    InferenceNetworkT<Scalar> frozen = net.freeze();
+    std::vector<Scalar> outputs(expected.size());
+    //the int8 rows are only run once, next to the double ones, calibrated on the inputs
+    bool runInt8 = std::is_same<Scalar, double>::value;
+    DataSet calibration;
+    calibration.numRows = batchSize;
+    calibration.numColumns = structure.front();
+    calibration.values.assign(inputs.begin(), inputs.end());
+    QuantizedNetwork quantized = runInt8 ? net.quantize(calibration) : QuantizedNetwork();
+    std::vector<double> inputsInt8(inputs.begin(), inputs.end());
+    std::vector<double> outputsInt8(expected.size());
+
+    if(batchSize == 1){
+        results.push_back(measure("forwardPass", scalar, structure, 1, false, forwardFlops, minTime, [&](){
+            net.forwardPass(inputs);
+        }));
+        results.push_back(measure("predict", scalar, structure, 1, false, forwardFlops, minTime, [&](){
+            frozen.predict(inputs.data(), outputs.data());
+        }));
+        if(runInt8){
+            results.push_back(measure("predictInt8", "int8", structure, 1, false, forwardFlops, minTime, [&](){
+                quantized.predict(inputsInt8.data(), outputsInt8.data());
+            }));
+        }
+        results.push_back(measure("backPropagate", scalar, structure, 1, true, forwardFlops + backwardFlops, minTime, [&](){
+            net.forwardPass(inputs);
+            net.backPropagate(expected);
+        }));
+        results.push_back(measure("backPropagateRMS", scalar, structure, 1, true, forwardFlops + backwardFlops, minTime, [&](){
+            net.forwardPass(inputs);
+            net.backPropagateRMS(expected);
+        }));
+        return;
+    }
+    //the batched passes compute the weight gradients as a GEMM and run the
+    //optimizer update once per batch on the averaged gradients
+    double gradientFlops = 2.0 * weights + 2.0 * propagated;
+    results.push_back(measure("forwardBatch", scalar, structure, batchSize, false, forwardFlops * batchSize, minTime, [&](){
+        net.forwardBatch(inputs, batchSize);
+    }));
+    results.push_back(measure("predictBatch", scalar, structure, batchSize, false, forwardFlops * batchSize, minTime, [&](){
+        frozen.predictBatch(inputs.data(), outputs.data(), batchSize);
+    }));
+    if(runInt8){
+        results.push_back(measure("predictBatchInt8", "int8", structure, batchSize, false, forwardFlops * batchSize, minTime, [&](){
+            quantized.predictBatch(inputsInt8.data(), outputsInt8.data(), batchSize);
+        }));
+    }
+    results.push_back(measure("trainBatch", scalar, structure, batchSize, true,
+                              (forwardFlops + gradientFlops) * batchSize + updateFlops, minTime, [&](){
+        net.trainBatch(inputs, expected, batchSize);
+    }));
+}
+
+//iris formatted rows until the file reaches the requested size
+static unsigned long long writeCsv(const std::string& path, unsigned long long targetBytes){
+    static const char* labels[] = {"Iris-setosa", "Iris-versicolor", "Iris-virginica"};
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::mt19937_64 generator(99);
+    std::uniform_real_distribution<double> dist(0.1, 8.0);
+    unsigned long long written = 0;
+    char line[128];
+    while(written < targetBytes){
+        int length = std::snprintf(line, sizeof(line), "%.1f,%.1f,%.1f,%.1f,%s\n", dist(generator), dist(generator),
+                                   dist(generator), dist(generator), labels[generator() % 3]);
+        out.write(line, length);
+        written += length;
+    }
+    return written;
+}
+
+static DataResult benchmarkProcessData(unsigned long long targetBytes){
+    std::string path = (std::filesystem::temp_directory_path() / "nn_benchmark_data.csv").string();
+    DataResult result;
+    result.name = "processData";
+    result.bytes = writeCsv(path, targetBytes);
+    result.rows = 0;
+    result.seconds = 0.0;
+    //best of three, the first run also warms the page cache
+    for(int run = 0; run < 3; run++){
+        auto start = std::chrono::steady_clock::now();
+        DataSet data = processData(path);
+        double seconds = elapsedSince(start);
+        if(run == 0 || seconds < result.seconds){
+            result.seconds = seconds;
+        }
+        result.rows = data.numRows;
+    }
+    result.megabytesPerSecond = result.bytes / result.seconds * 1e-6;
+    std::filesystem::remove(path);
+    return result;
+}
+
+static std::string toJson(const std::vector<BenchmarkResult>& results, const std::vector<DataResult>& dataResults,
+                          int numThreads, const Optimizer& optimizer, double minTime){
+    std::ostringstream json;
+    json << std::setprecision(6);
+    json << "{\n";
+    json << "  \"isa\": \"" << kernels().name << "\",\n";
+    json << "  \"integer_isa\": \"" << integerKernels().name << "\",\n";
+    json << "  \"threads\": " << numThreads << ",\n";
+    json << "  \"optimizer\": \"" << optimizerName(optimizer.type) << "\",\n";
+    json << "  \"min_time\": " << minTime << ",\n";
+    json << "  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++){
+        const BenchmarkResult& result = results[i];
+        json << "    {\"name\": \"" << result.name << "\", \"scalar\": \"" << result.scalar << "\", \"structure\": [";
+        for(size_t j = 0; j < result.structure.size(); j++){
+            json << (j ? ", " : "") << result.structure[j];
+        }
+        json << "], \"batch_size\": " << result.batchSize
+             << ", \"includes_forward\": " << (result.includesForward ? "true" : "false")
+             << ", \"iterations\": " << result.iterations
+             << ", \"seconds\": " << result.seconds
+             << ", \"samples_per_sec\": " << result.samplesPerSecond
+             << ", \"gflops\": " << result.gflops << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ],\n";
+    json << "  \"data\": [\n";
+    for(size_t i = 0; i < dataResults.size(); i++){
+        const DataResult& result = dataResults[i];
+        json << "    {\"name\": \"" << result.name << "\", \"bytes\": " << result.bytes
+             << ", \"rows\": " << result.rows
+             << ", \"seconds\": " << result.seconds
+             << ", \"mb_per_sec\": " << result.megabytesPerSecond << "}"
+             << (i + 1 < dataResults.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+    return json.str();
+}
+
+int main(int argc, char** argv){
+    Logger::setLevel(LogLevel::Off);
+    bool quick = false;
+    double minTime = 0.25;
+    int numThreads = 1;
+    unsigned long long dataMegabytes = 64;
+    std::string outputPath;
+    std::string scalarType = "both";
+    Optimizer optimizer;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--quick"){
+            quick = true;
+        }else if(arg == "--min-time" && hasValue){
+            minTime = std::atof(argv[++i]);
+        }else if(arg == "--threads" && hasValue){
+            numThreads = std::atoi(argv[++i]);
+        }else if(arg == "--data-mb" && hasValue){
+            dataMegabytes = std::strtoull(argv[++i], nullptr, 10);
+        }else if(arg == "--scalar" && hasValue && (std::string(argv[i + 1]) == "double"
+                                                   || std::string(argv[i + 1]) == "float"
+                                                   || std::string(argv[i + 1]) == "both")){
+            scalarType = argv[++i];
+        }else if(arg == "--optimizer" && hasValue && optimizerName(optimizerFromName(argv[i + 1]).type) == std::string(argv[i + 1])){
+            optimizer = optimizerFromName(argv[++i]);
+        }else if(arg == "--output" && hasValue){
+            outputPath = argv[++i];
+        }else{
+            std::cerr << "Usage: nn_benchmark [--quick] [--min-time seconds] [--threads n] [--data-mb n] [--scalar double|float|both]"
+                      << " [--optimizer sgd|momentum|rmsprop|adam|adamw] [--output file]\n";
+            return 1;
+        }
+    }
+    if(quick){
+        minTime = std::min(minTime, 0.05);
+        dataMegabytes = std::min(dataMegabytes, 4ULL);
+    }
+
+    std::vector<int> widths = quick ? std::vector<int>{32, 256} : std::vector<int>{32, 128, 512, 1024};
+    std::vector<int> depths = quick ? std::vector<int>{1} : std::vector<int>{1, 3};
+    std::vector<int> batchSizes = quick ? std::vector<int>{1, 32} : std::vector<int>{1, 16, 128};
+
+    std::vector<BenchmarkResult> results;
+    for(int width: widths){
+        for(int depth: depths){
+            //input, depth hidden layers and output, all the same width
+            std::vector<int> structure(depth + 2, width);
+            for(int batchSize: batchSizes){
+                if(scalarType != "float"){
+                    benchmarkNetwork<double>(structure, batchSize, numThreads, optimizer, minTime, results);
+                }
+                if(scalarType != "double"){
+                    benchmarkNetwork<float>(structure, batchSize, numThreads, optimizer, minTime, results);
+                }
+            }
+        }
+    }
+    std::vector<DataResult> dataResults;
+    dataResults.push_back(benchmarkProcessData(dataMegabytes << 20));
+
+    std::string json = toJson(results, dataResults, numThreads, optimizer, minTime);
+    if(outputPath.empty()){
+        std::cout << json;
+        return 0;
+    }
+    std::ofstream out(outputPath);
+    if(!out){
+        std::cerr << "Error: could not open " << outputPath << " for writing\n";
+        return 1;
+    }
+    out << json;
+    return 0;
+}
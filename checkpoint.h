@@ -0,0 +1,223 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+
+#include "layer.h"
+#include "optimizer.h"
+#include "model_file.h"
+
+//when and where NetworkT::enableCheckpoints saves
+struct CheckpointOptions {
+    //replaced by every save, resume with loadModel(path)
+    std::string path = "checkpoint.nnm";
+    //save every this many training steps, 0 never
+    int everySteps = 0;
+    //save once this many seconds have passed since the last capture, 0 never
+    double everySeconds = 0.0;
+    //fsync the file and its directory so a checkpoint survives a crash
+    bool sync = true;
+};
+
+//everything a training run needs to continue exactly where it was: the layers
+//with all of their optimizer state, the step, the learning rate, the optimizer,
+//the schedule and what validation has found so far
+template<typename Scalar>
+struct TrainingSnapshotT {
+    std::vector<LayerT<Scalar>> layers;
+    int step = 0;
+    double learningRate = 0.0;
+    Optimizer optimizer;
+    LearningRateSchedule schedule;
+    ValidationProgressT<Scalar> validation;
+
+    //copies the parameters into the buffers of an earlier capture, so once
+    //both of the writer's buffers have been filled capturing does not allocate
+    //a null sourceValidation captures no validation progress
+    void capture(const std::vector<LayerT<Scalar>>& source, int sourceStep, double sourceRate,
+                 const Optimizer& sourceOptimizer, const LearningRateSchedule& sourceSchedule,
+                 const ValidationProgressT<Scalar>* sourceValidation){
+        bool sameShape = layers.size() == source.size();
+        for(size_t i = 0; sameShape && i < source.size(); i++){
+            sameShape = layers[i].size == source[i].size && layers[i].inputSize == source[i].inputSize;
+        }
+        if(!sameShape){
+            layers = source;
+        }else{
+            for(size_t i = 0; i < source.size(); i++){
+                LayerT<Scalar>& layer = layers[i];
+                const LayerT<Scalar>& from = source[i];
+                layer.weights.assign(from.weights.begin(), from.weights.end());
+                layer.historicGradients.assign(from.historicGradients.begin(), from.historicGradients.end());
+                layer.biases.assign(from.biases.begin(), from.biases.end());
+                layer.firstMoments.assign(from.firstMoments.begin(), from.firstMoments.end());
+                layer.biasFirstMoments.assign(from.biasFirstMoments.begin(), from.biasFirstMoments.end());
+                layer.biasHistoricGradients.assign(from.biasHistoricGradients.begin(), from.biasHistoricGradients.end());
+                layer.activation = from.activation;
+                layer.isOutput = from.isOutput;
+            }
+        }
+        step = sourceStep;
+        learningRate = sourceRate;
+        optimizer = sourceOptimizer;
+        schedule = sourceSchedule;
+        ValidationProgressT<Scalar> none;
+        const ValidationProgressT<Scalar>& progress = sourceValidation ? *sourceValidation : none;
+        validation.bestScore = progress.bestScore;
+        validation.bestStep = progress.bestStep;
+        validation.sinceBest = progress.sinceBest;
+        validation.stopped = progress.stopped;
+        validation.bestWeights.resize(progress.bestWeights.size());
+        validation.bestBiases.resize(progress.bestBiases.size());
+        for(size_t i = 0; i < progress.bestWeights.size(); i++){
+            validation.bestWeights[i].assign(progress.bestWeights[i].begin(), progress.bestWeights[i].end());
+        }
+        for(size_t i = 0; i < progress.bestBiases.size(); i++){
+            validation.bestBiases[i].assign(progress.bestBiases[i].begin(), progress.bestBiases[i].end());
+        }
+    }
+};
+
+//saves snapshots of a training run from a background thread. capture() copies
+//the state into a spare buffer, which is the only pause the training thread
+//sees, and the writer thread serializes and syncs it while training goes on.
+//There are two buffers, the one being written and the one waiting. A capture
+//made while the writer is busy replaces the waiting one, so the newest state
+//is always saved next and training never waits for the disk
+template<typename Scalar>
+class CheckpointWriterT {
+public:
+    explicit CheckpointWriterT(const CheckpointOptions& options)
+        : options(options), lastCapture(std::chrono::steady_clock::now()){
+        writer = std::thread([this](){ writerLoop(); });
+    }
+    //saves the waiting snapshot before stopping
+    ~CheckpointWriterT(){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+    }
+    CheckpointWriterT(const CheckpointWriterT&) = delete;
+    CheckpointWriterT& operator=(const CheckpointWriterT&) = delete;
+
+    //whether the schedule asks for a checkpoint after step
+    bool due(int step) const {
+        if(options.everySteps > 0 && step % options.everySteps == 0){
+            return true;
+        }
+        return options.everySeconds > 0.0
+               && std::chrono::duration<double>(std::chrono::steady_clock::now() - lastCapture).count() >= options.everySeconds;
+    }
+
+    //called from the training thread between steps
+    void capture(const std::vector<LayerT<Scalar>>& layers, int step, double learningRate, const Optimizer& optimizer,
+                 const LearningRateSchedule& schedule, const ValidationProgressT<Scalar>* validation){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if(hasPending){
+                replacedCount++;
+            }
+            pending.capture(layers, step, learningRate, optimizer, schedule, validation);
+            hasPending = true;
+        }
+        wake.notify_one();
+        lastCapture = std::chrono::steady_clock::now();
+        lastPause = std::chrono::duration<double>(lastCapture - start).count();
+        longestPause = std::max(longestPause, lastPause);
+    }
+
+    //blocks until every captured snapshot is on disk, or failed
+    void flush(){
+        std::unique_lock<std::mutex> lock(mtx);
+        idle.wait(lock, [this](){ return !hasPending && !writing; });
+    }
+
+    //step of the newest checkpoint on disk, -1 before the first one
+    int savedStep() const {
+        return lastSavedStep.load();
+    }
+    size_t saved() const {
+        return savedCount.load();
+    }
+    size_t failed() const {
+        return failedCount.load();
+    }
+    //snapshots replaced by a newer one before the writer got to them
+    size_t replaced() const {
+        return replacedCount.load();
+    }
+    //seconds the training thread spent in capture()
+    double lastPauseSeconds() const {
+        return lastPause;
+    }
+    double longestPauseSeconds() const {
+        return longestPause;
+    }
+    const CheckpointOptions& settings() const {
+        return options;
+    }
+
+private:
+    CheckpointOptions options;
+    std::thread writer;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool stopping = false;
+    bool hasPending = false;
+    bool writing = false;
+    //pending is filled by capture(), current is owned by the writer while it saves
+    TrainingSnapshotT<Scalar> pending;
+    TrainingSnapshotT<Scalar> current;
+
+    std::atomic<int> lastSavedStep{-1};
+    std::atomic<size_t> savedCount{0};
+    std::atomic<size_t> failedCount{0};
+    std::atomic<size_t> replacedCount{0};
+    //only touched by the training thread
+    std::chrono::steady_clock::time_point lastCapture;
+    double lastPause = 0.0;
+    double longestPause = 0.0;
+
+    void writerLoop(){
+        std::unique_lock<std::mutex> lock(mtx);
+        while(true){
+            wake.wait(lock, [this](){ return stopping || hasPending; });
+            if(!hasPending){
+                return;
+            }
+            //the buffers trade places, so the next capture reuses the old one
+            std::swap(pending, current);
+            hasPending = false;
+            writing = true;
+            lock.unlock();
+            bool ok = writeModelFile(options.path, current.layers, current.step, current.learningRate,
+                                     true, &current.optimizer, options.sync, &current.schedule, &current.validation);
+            lock.lock();
+            writing = false;
+            if(ok){
+                lastSavedStep = current.step;
+                savedCount++;
+            }else{
+                std::cerr << "Error: checkpoint of step " << current.step << " was not saved\n";
+                failedCount++;
+            }
+            idle.notify_all();
+        }
+    }
+};
+
+#endif // CHECKPOINT_H
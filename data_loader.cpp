@@ -0,0 +1,305 @@
+#include "data_loader.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+
+double DataSet::normalize(int column, double value) const {
+    const ColumnStats& columnStats = stats[column];
+    switch(schema.columns[column].normalization){
+        case Normalization::MinMax: {
+            double denom = columnStats.max - columnStats.min;
+            return denom != 0.0 ? (value - columnStats.min) / denom : 0.0;
+        }
+        case Normalization::Standard: {
+            double deviation = std::sqrt(columnStats.variance());
+            return deviation != 0.0 ? (value - columnStats.mean()) / deviation : 0.0;
+        }
+        default:
+            return value;
+    }
+}
+
+static bool isSpace(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static std::string_view trim(const char* begin, const char* end){
+    while(begin < end && isSpace(*begin)){
+        begin++;
+    }
+    while(end > begin && isSpace(end[-1])){
+        end--;
+    }
+    return std::string_view(begin, end - begin);
+}
+
+//Clinger's fast path. Up to 15 significant digits and a power of ten up to 22
+//are both exact doubles, so a single multiply or divide rounds the same way a
+//full parser does. Anything else is left to std::from_chars
+static const double POWERS_OF_TEN[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static bool parseSimpleNumber(const char* p, const char* end, double& value){
+    bool negative = p < end && *p == '-';
+    if(negative){
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    while(p < end && *p >= '0' && *p <= '9'){
+        mantissa = mantissa * 10 + (*p - '0');
+        digits++;
+        p++;
+    }
+    if(p < end && *p == '.'){
+        p++;
+        while(p < end && *p >= '0' && *p <= '9'){
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+            exponent--;
+            p++;
+        }
+    }
+    if(digits == 0 || digits > 15){
+        return false;
+    }
+    if(p < end && (*p == 'e' || *p == 'E')){
+        p++;
+        bool negativeExponent = p < end && *p == '-';
+        if(p < end && (*p == '-' || *p == '+')){
+            p++;
+        }
+        int written = 0;
+        int exponentDigits = 0;
+        while(p < end && *p >= '0' && *p <= '9' && exponentDigits < 4){
+            written = written * 10 + (*p - '0');
+            exponentDigits++;
+            p++;
+        }
+        if(exponentDigits == 0){
+            return false;
+        }
+        exponent += negativeExponent ? -written : written;
+    }
+    if(p != end || exponent < -22 || exponent > 22){
+        return false;
+    }
+    double result = (double)mantissa;
+    result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+    value = negative ? -result : result;
+    return true;
+}
+
+static bool parseNumber(std::string_view field, double& value){
+    if(field.empty()){
+        return false;
+    }
+    if(parseSimpleNumber(field.data(), field.data() + field.size(), value)){
+        return true;
+    }
+    std::from_chars_result result = std::from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == std::errc() && result.ptr == field.data() + field.size();
+}
+
+//turns lines into rows of the DataSet. Lines are parsed straight out of the
+//read buffer, nothing is copied on the way
+class CsvParser {
+public:
+    CsvParser(DataSet& data) : data(data) {}
+
+    //[begin, end) is one line without its '\n'
+    void parseLine(const char* begin, const char* end){
+        lineNumber++;
+        if(trim(begin, end).empty()){
+            return;
+        }
+        if(data.schema.hasHeader && !headerSeen){
+            headerSeen = true;
+            if(data.schema.columns.empty()){
+                headerLine.assign(begin, end);
+            }
+            return;
+        }
+        if(data.numColumns == 0 && !inferSchema(begin, end)){
+            return;
+        }
+
+        size_t start = data.values.size();
+        data.values.resize(start + data.numColumns);
+        double* out = &data.values[start];
+        const char delimiter = data.schema.delimiter;
+        const char* field = begin;
+        int column = 0;
+        while(true){
+            const char* fieldEnd = (const char*)std::memchr(field, delimiter, end - field);
+            if(fieldEnd == nullptr){
+                fieldEnd = end;
+            }
+            if(column >= data.numColumns){
+                column++;
+                break;
+            }
+            std::string_view text = trim(field, fieldEnd);
+            if(data.schema.columns[column].type == ColumnType::Numeric){
+                if(!parseNumber(text, out[column])){
+                    std::cerr << "Error: line " << lineNumber << " column " << column
+                    << " is not a number (" << text << "), skipping the row.\n";
+                    data.values.resize(start);
+                    data.skippedRows++;
+                    return;
+                }
+            }else{
+                out[column] = data.categories[column].intern(text);
+            }
+            column++;
+            if(fieldEnd == end){
+                break;
+            }
+            field = fieldEnd + 1;
+        }
+        if(column != data.numColumns){
+            std::cerr << "Error: line " << lineNumber << " does not have " << data.numColumns
+            << " fields, skipping the row.\n";
+            data.values.resize(start);
+            data.skippedRows++;
+            return;
+        }
+        for(int i = 0; i < data.numColumns; i++){
+            data.stats[i].add(out[i]);
+        }
+        data.numRows++;
+    }
+
+private:
+    DataSet& data;
+    size_t lineNumber = 0;
+    bool headerSeen = false;
+    std::string headerLine;
+
+    //sets up the columns from the schema, or from this line if the schema has none
+    bool inferSchema(const char* begin, const char* end){
+        std::vector<ColumnSchema>& columns = data.schema.columns;
+        if(columns.empty()){
+            std::vector<std::string_view> names = split(headerLine.data(), headerLine.data() + headerLine.size());
+            std::vector<std::string_view> fields = split(begin, end);
+            double unused;
+            for(size_t i = 0; i < fields.size(); i++){
+                ColumnSchema column;
+                if(i < names.size()){
+                    column.name = std::string(names[i]);
+                }
+                column.type = parseNumber(fields[i], unused) ? ColumnType::Numeric : ColumnType::Categorical;
+                columns.push_back(column);
+            }
+        }
+        data.numColumns = (int)columns.size();
+        data.stats.assign(columns.size(), ColumnStats());
+        data.categories.assign(columns.size(), CategoryDictionary());
+        for(size_t i = 0; i < columns.size(); i++){
+            for(const std::string& category: columns[i].categories){
+                data.categories[i].intern(category);
+            }
+        }
+        return data.numColumns > 0;
+    }
+
+    std::vector<std::string_view> split(const char* begin, const char* end){
+        std::vector<std::string_view> fields;
+        if(begin == end){
+            return fields;
+        }
+        while(true){
+            const char* fieldEnd = (const char*)std::memchr(begin, data.schema.delimiter, end - begin);
+            if(fieldEnd == nullptr){
+                fields.push_back(trim(begin, end));
+                return fields;
+            }
+            fields.push_back(trim(begin, fieldEnd));
+            begin = fieldEnd + 1;
+        }
+    }
+};
+
+DataSet loadCsv(const std::string& filepath, const DataSchema& schema){
+    DataSet data;
+    data.schema = schema;
+    std::FILE* file = std::fopen(filepath.c_str(), "rb");
+    if(file == nullptr){
+        std::cerr << "Error: Could not open file " << filepath << ".\n";
+        return data;
+    }
+    std::error_code error;
+    uintmax_t fileSize = std::filesystem::file_size(filepath, error);
+    //without a file size the row buffer just grows
+    bool reserved = (bool)error;
+
+    CsvParser parser(data);
+    std::vector<char> buffer(CSV_CHUNK_SIZE);
+    size_t filled = 0;
+    while(true){
+        size_t got = std::fread(buffer.data() + filled, 1, buffer.size() - filled, file);
+        filled += got;
+        const char* begin = buffer.data();
+        const char* end = begin + filled;
+        //every complete line in the chunk, the partial last line waits for the next read
+        while(const char* newline = (const char*)std::memchr(begin, '\n', end - begin)){
+            parser.parseLine(begin, newline);
+            begin = newline + 1;
+        }
+        if(!reserved && data.numRows > 0){
+            //size the row buffer once from the bytes per row seen so far
+            size_t bytesPerRow = std::max<size_t>(1, (size_t)(begin - buffer.data()) / data.numRows);
+            data.values.reserve((size_t)(fileSize / bytesPerRow + 1) * data.numColumns);
+            reserved = true;
+        }
+        size_t rest = end - begin;
+        if(got == 0){
+            if(std::ferror(file)){
+                std::cerr << "Error: failed reading " << filepath << ".\n";
+                std::fclose(file);
+                return DataSet();
+            }
+            if(rest > 0){
+                parser.parseLine(begin, end);
+            }
+            break;
+        }
+        if(rest == buffer.size()){
+            //a single line fills the whole buffer
+            buffer.resize(buffer.size() * 2);
+        }else if(rest > 0){
+            std::memmove(buffer.data(), begin, rest);
+        }
+        filled = rest;
+    }
+    std::fclose(file);
+
+    //every statistic is known now, normalize the buffer in place. Each column is
+    //(value - offset) / scale, the same arithmetic DataSet::normalize does
+    std::vector<double> offsets(data.numColumns, 0.0);
+    std::vector<double> scales(data.numColumns, 1.0);
+    for(int j = 0; j < data.numColumns; j++){
+        const ColumnStats& columnStats = data.stats[j];
+        if(data.schema.columns[j].normalization == Normalization::MinMax){
+            offsets[j] = columnStats.min;
+            scales[j] = columnStats.max - columnStats.min;
+        }else if(data.schema.columns[j].normalization == Normalization::Standard){
+            offsets[j] = columnStats.mean();
+            scales[j] = std::sqrt(columnStats.variance());
+        }
+    }
+    for(size_t i = 0; i < data.numRows; i++){
+        double* row = data.row(i);
+        for(int j = 0; j < data.numColumns; j++){
+            row[j] = scales[j] != 0.0 ? (row[j] - offsets[j]) / scales[j] : 0.0;
+        }
+    }
+    return data;
+}
@@ -0,0 +1,159 @@
+#ifndef DATA_LOADER_H
+#define DATA_LOADER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstddef>
+
+enum class ColumnType {
+    Numeric,
+    //text values are replaced by their id in the column's CategoryDictionary
+    Categorical
+};
+
+enum class Normalization {
+    None,
+    //(value - min) / (max - min), 0 when the column is constant
+    MinMax,
+    //(value - mean) / standard deviation, 0 when the column is constant
+    Standard
+};
+
+struct ColumnSchema {
+    std::string name;
+    ColumnType type = ColumnType::Numeric;
+    Normalization normalization = Normalization::MinMax;
+    //categorical columns give these values ids 0, 1, 2... in order, values
+    //that are not listed get the next free id when they are first seen
+    std::vector<std::string> categories;
+};
+
+//describes the columns of a file. An empty column list is inferred from the
+//first data row: fields that parse as numbers are numeric, the rest categorical
+struct DataSchema {
+    std::vector<ColumnSchema> columns;
+    bool hasHeader = false;
+    char delimiter = ',';
+};
+
+//interned category values to dense ids. Lookups take a view into the read
+//buffer, so only the first occurrence of a value allocates
+class CategoryDictionary {
+public:
+    CategoryDictionary() = default;
+    CategoryDictionary(CategoryDictionary&&) = default;
+    //the map keys point into names, a copy has to rebuild them
+    CategoryDictionary(const CategoryDictionary& other){
+        for(const std::string& name: other.names){
+            intern(name);
+        }
+    }
+    CategoryDictionary& operator=(CategoryDictionary other){
+        names.swap(other.names);
+        ids.swap(other.ids);
+        return *this;
+    }
+
+    //id of value, added to the dictionary if it is new
+    int intern(std::string_view value){
+        auto found = ids.find(value);
+        if(found != ids.end()){
+            return found->second;
+        }
+        //deque elements never move, so the key stays valid
+        names.emplace_back(value);
+        int id = (int)names.size() - 1;
+        ids.emplace(std::string_view(names.back()), id);
+        return id;
+    }
+    //-1 if value has not been seen
+    int find(std::string_view value) const {
+        auto found = ids.find(value);
+        return found == ids.end() ? -1 : found->second;
+    }
+    const std::string& name(int id) const {
+        return names[id];
+    }
+    int size() const {
+        return (int)names.size();
+    }
+
+private:
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, int> ids;
+};
+
+//statistics of the raw (not normalized) values of one column, kept so new
+//samples can be normalized the same way. Sums are taken around the first value
+//(shifted data) so the variance stays accurate without a division per value
+struct ColumnStats {
+    double min = 0.0;
+    double max = 0.0;
+    double shift = 0.0;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    size_t count = 0;
+
+    void add(double value){
+        if(count == 0){
+            min = value;
+            max = value;
+            shift = value;
+        }else{
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+        }
+        count++;
+        double shifted = value - shift;
+        sum += shifted;
+        sumSquares += shifted * shifted;
+    }
+    double mean() const {
+        return count > 0 ? shift + sum / count : 0.0;
+    }
+    double variance() const {
+        if(count < 2){
+            return 0.0;
+        }
+        double variance = (sumSquares - sum * sum / count) / count;
+        return variance > 0.0 ? variance : 0.0;
+    }
+};
+
+//a whole file as one row-major numRows x numColumns buffer
+struct DataSet {
+    std::vector<double> values;
+    size_t numRows = 0;
+    int numColumns = 0;
+    //the schema that was used, inferred columns filled in
+    DataSchema schema;
+    std::vector<ColumnStats> stats;
+    //one per column, empty for numeric columns
+    std::vector<CategoryDictionary> categories;
+    //data lines that were reported and skipped
+    size_t skippedRows = 0;
+
+    const double* row(size_t index) const {
+        return values.data() + index * numColumns;
+    }
+    double* row(size_t index){
+        return values.data() + index * numColumns;
+    }
+    //applies the column's normalization to a raw value
+    double normalize(int column, double value) const;
+};
+
+//size of each read from the file. Lines longer than this grow the buffer
+const size_t CSV_CHUNK_SIZE = 1 << 20;
+
+//streams filepath in fixed-size chunks and parses every field in place with
+//std::from_chars, collecting the column statistics as it goes. Rows are written
+//straight into the DataSet buffer and normalized in place once the file is read.
+//Rows with the wrong field count or a bad number are reported and skipped.
+//Prints an error and returns an empty DataSet if the file can not be read
+DataSet loadCsv(const std::string& filepath, const DataSchema& schema = DataSchema());
+
+#endif // DATA_LOADER_H
@@ -0,0 +1,297 @@
+#include "ensemble.h"
+#include <algorithm>
+
+//partial sums of KernelTable::dot, 16 for double and 32 for float
+template<typename Scalar>
+static constexpr size_t dotPartials(){
+    return 128 / sizeof(Scalar);
+}
+
+//member m's array of count values goes to lanes[i * members + m]. Empty
+//arrays (optimizer state the rule does not use) stay empty
+template<typename Scalar>
+static void interleave(const std::vector<const std::vector<Scalar>*>& sources, std::vector<Scalar>& lanes){
+    size_t members = sources.size();
+    size_t count = sources.front()->size();
+    lanes.assign(count * members, Scalar(0));
+    for(size_t m = 0; m < members; m++){
+        for(size_t i = 0; i < count; i++){
+            lanes[i * members + m] = (*sources[m])[i];
+        }
+    }
+}
+
+template<typename Scalar>
+static void deinterleave(const std::vector<Scalar>& lanes, int members, int member, std::vector<Scalar>& values){
+    values.resize(lanes.size() / members);
+    for(size_t i = 0; i < values.size(); i++){
+        values[i] = lanes[i * members + member];
+    }
+}
+
+template<typename Scalar>
+EnsembleT<Scalar>::EnsembleT(const std::vector<NetworkT<Scalar>>& networks){
+    build(networks);
+}
+
+template<typename Scalar>
+EnsembleT<Scalar>::EnsembleT(const std::vector<int>& structure, int memberCount, uint64_t seed){
+    std::vector<NetworkT<Scalar>> networks(std::max(memberCount, 1));
+    for(size_t m = 0; m < networks.size(); m++){
+        networks[m].setupNetwork(structure, seed ? seed + m : 0);
+    }
+    build(networks);
+}
+
+template<typename Scalar>
+void EnsembleT<Scalar>::build(const std::vector<NetworkT<Scalar>>& networks){
+    if(networks.empty() || networks.front().layers.size() < 2){
+        std::cerr << "Error: an ensemble needs at least one network with weights.\n";
+        return;
+    }
+    //the optimizer state is filled in for every member before it is interleaved
+    std::vector<NetworkT<Scalar>> sources(networks);
+    const NetworkT<Scalar>& first = sources.front();
+    for(NetworkT<Scalar>& source: sources){
+        bool sameShape = source.layers.size() == first.layers.size() && !source.isReadOnly();
+        for(size_t i = 0; sameShape && i < source.layers.size(); i++){
+            sameShape = source.layers[i].size == first.layers[i].size && source.layers[i].inputSize == first.layers[i].inputSize
+                        && source.layers[i].activation == first.layers[i].activation;
+        }
+        if(!sameShape){
+            std::cerr << "Error: ensemble members need the same structure and activations and writable weights.\n";
+            return;
+        }
+        for(size_t i = 1; i < source.layers.size(); i++){
+            source.layers[i].prepareOptimizer(first.optimizer);
+        }
+    }
+    members = (int)sources.size();
+    learningRate = first.learningRate;
+    schedule = first.schedule;
+    step = first.step;
+    optimizer = first.optimizer;
+    prototype = first;
+
+    layers.clear();
+    layers.resize(first.layers.size());
+    size_t widest = 0;
+    for(size_t i = 0; i < layers.size(); i++){
+        LockstepLayer& layer = layers[i];
+        const LayerT<Scalar>& shape = first.layers[i];
+        layer.size = shape.size;
+        layer.inputSize = shape.inputSize;
+        layer.activation = shape.activation;
+        layer.isOutput = shape.isOutput;
+        layer.activations.assign((size_t)layer.size * members, Scalar(0));
+        layer.derivatives.assign((size_t)layer.size * members, Scalar(0));
+        layer.deltas.assign((size_t)layer.size * members, Scalar(0));
+        widest = std::max(widest, (size_t)layer.size);
+        if(i == 0){
+            continue;
+        }
+        std::vector<const std::vector<Scalar>*> parts(members);
+        auto gather = [&](std::vector<Scalar> LayerT<Scalar>::* array, std::vector<Scalar>& lanes){
+            for(int m = 0; m < members; m++){
+                parts[m] = &(sources[m].layers[i].*array);
+            }
+            if(parts.front()->empty()){
+                lanes.clear();
+                return;
+            }
+            interleave(parts, lanes);
+        };
+        gather(&LayerT<Scalar>::weights, layer.weights);
+        gather(&LayerT<Scalar>::historicGradients, layer.historicGradients);
+        gather(&LayerT<Scalar>::firstMoments, layer.firstMoments);
+        gather(&LayerT<Scalar>::biases, layer.biases);
+        gather(&LayerT<Scalar>::biasFirstMoments, layer.biasFirstMoments);
+        gather(&LayerT<Scalar>::biasHistoricGradients, layer.biasHistoricGradients);
+        layer.gradients.assign(layer.weights.size(), Scalar(0));
+    }
+    partials.assign(dotPartials<Scalar>() * members, Scalar(0));
+    memberScratch.assign(widest, Scalar(0));
+}
+
+//z = bias + dot(row, x) for every neuron and member, with the partial sums of
+//dot kept per member: the full blocks of the row land on the partial sums in
+//order, the sums are reduced in dot's tree and the tail is added last
+template<typename Scalar>
+void EnsembleT<Scalar>::activateLayer(LockstepLayer& layer, const LockstepLayer& prevLayer){
+    const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+    const size_t lanes = members;
+    const size_t blockInputs = dotPartials<Scalar>();
+    const size_t block = blockInputs * lanes;
+    const size_t rowLength = (size_t)layer.inputSize * lanes;
+    const size_t fullInputs = layer.inputSize / blockInputs * blockInputs;
+    const Scalar* x = prevLayer.activations.data();
+    Scalar* p = partials.data();
+    for(int j = 0; j < layer.size; j++){
+        const Scalar* row = &layer.weights[(size_t)j * rowLength];
+        Scalar* sum = &layer.activations[(size_t)j * lanes];
+        //rows shorter than a block only have the tail, the tree of zeros is 0
+        std::fill(sum, sum + lanes, Scalar(0));
+        if(fullInputs > 0){
+            std::fill(p, p + block, Scalar(0));
+            for(size_t b = 0; b < fullInputs; b += blockInputs){
+                k.multiplyAdd(row + b * lanes, x + b * lanes, p, block, block);
+            }
+            for(size_t half = blockInputs / 2; half >= 4; half /= 2){
+                k.axpy(Scalar(1), p + half * lanes, p, half * lanes);
+            }
+            //(t0 + t2) + (t1 + t3)
+            k.axpy(Scalar(1), p + 2 * lanes, p, lanes);
+            k.axpy(Scalar(1), p + 3 * lanes, p + lanes, lanes);
+            k.axpy(Scalar(1), p + lanes, p, lanes);
+            std::copy(p, p + lanes, sum);
+        }
+        for(size_t i = fullInputs; i < (size_t)layer.inputSize; i++){
+            k.multiplyAdd(row + i * lanes, x + i * lanes, sum, lanes, lanes);
+        }
+        k.axpy(Scalar(1), &layer.biases[(size_t)j * lanes], sum, lanes);
+    }
+    size_t count = (size_t)layer.size * lanes;
+    k.activation[(int)layer.activation](layer.activations.data(), layer.activations.data(), layer.derivatives.data(), count);
+    if(isLayerScope(layer.activation)){
+        for(int m = 0; m < members; m++){
+            for(int j = 0; j < layer.size; j++){
+                memberScratch[j] = layer.activations[(size_t)j * lanes + m];
+            }
+            softmax(memberScratch.data(), layer.size);
+            for(int j = 0; j < layer.size; j++){
+                layer.activations[(size_t)j * lanes + m] = memberScratch[j];
+            }
+        }
+    }
+}
+
+template<typename Scalar>
+void EnsembleT<Scalar>::forward(const Scalar* inputs){
+    if(layers.empty()){
+        return;
+    }
+    LockstepLayer& inputLayer = layers.front();
+    for(int m = 0; m < members; m++){
+        for(int i = 0; i < inputLayer.size; i++){
+            inputLayer.activations[(size_t)i * members + m] = inputs[(size_t)m * inputLayer.size + i];
+        }
+    }
+    for(size_t i = 1; i < layers.size(); i++){
+        activateLayer(layers[i], layers[i - 1]);
+    }
+}
+
+template<typename Scalar>
+void EnsembleT<Scalar>::forwardShared(const Scalar* input){
+    if(layers.empty()){
+        return;
+    }
+    LockstepLayer& inputLayer = layers.front();
+    for(int i = 0; i < inputLayer.size; i++){
+        std::fill_n(&inputLayer.activations[(size_t)i * members], members, input[i]);
+    }
+    for(size_t i = 1; i < layers.size(); i++){
+        activateLayer(layers[i], layers[i - 1]);
+    }
+}
+
+//deltas are passed to the previous layer before a layer's weights are updated,
+//as Network::backPropagate does. The optimizer then runs once over the whole
+//interleaved layer, every lane is one weight of one member
+template<typename Scalar>
+void EnsembleT<Scalar>::backward(const Scalar* expectedValues){
+    if(layers.empty()){
+        return;
+    }
+    const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+    const size_t lanes = members;
+    OptimizerStep update = optimizer.nextStep(learningRate);
+    OptimizerKernelT<Scalar> weightUpdate = k.optimizer[(int)optimizer.type];
+    OptimizerKernelT<Scalar> biasUpdate = k.optimizer[(int)optimizer.biasType()];
+    auto stateAt = [](std::vector<Scalar>& state){
+        return state.empty() ? nullptr : state.data();
+    };
+    for(size_t l = layers.size() - 1; l > 0; l--){
+        LockstepLayer& layer = layers[l];
+        LockstepLayer& prevLayer = layers[l - 1];
+        size_t count = (size_t)layer.size * lanes;
+        if(layer.isOutput){
+            //softmax outputs are trained with cross-entropy, see Layer::computeDeltas
+            bool crossEntropy = layer.activation == ActivationType::Softmax;
+            for(int j = 0; j < layer.size; j++){
+                for(size_t m = 0; m < lanes; m++){
+                    size_t index = (size_t)j * lanes + m;
+                    Scalar error = layer.activations[index] - expectedValues[m * layer.size + j];
+                    layer.deltas[index] = crossEntropy ? error : error * layer.derivatives[index];
+                }
+            }
+        }else{
+            for(size_t index = 0; index < count; index++){
+                layer.deltas[index] *= layer.derivatives[index];
+            }
+        }
+        size_t rowLength = (size_t)layer.inputSize * lanes;
+        if(l > 1){
+            std::fill(prevLayer.deltas.begin(), prevLayer.deltas.end(), Scalar(0));
+            for(int j = 0; j < layer.size; j++){
+                k.multiplyAdd(&layer.weights[(size_t)j * rowLength], &layer.deltas[(size_t)j * lanes], prevLayer.deltas.data(),
+                              rowLength, lanes);
+            }
+        }
+        std::fill(layer.gradients.begin(), layer.gradients.end(), Scalar(0));
+        for(int j = 0; j < layer.size; j++){
+            k.multiplyAdd(prevLayer.activations.data(), &layer.deltas[(size_t)j * lanes], &layer.gradients[(size_t)j * rowLength],
+                          rowLength, lanes);
+        }
+        weightUpdate(layer.weights.data(), stateAt(layer.firstMoments), stateAt(layer.historicGradients),
+                     layer.gradients.data(), Scalar(1), update, layer.weights.size());
+        biasUpdate(layer.biases.data(), stateAt(layer.biasFirstMoments), stateAt(layer.biasHistoricGradients),
+                   layer.deltas.data(), Scalar(1), update, count);
+    }
+    step++;
+    if(schedule.adjusts()){
+        learningRate = schedule.rateAt(step);
+    }
+}
+
+template<typename Scalar>
+void EnsembleT<Scalar>::predict(const Scalar* input, Scalar* output){
+    forwardShared(input);
+    const LockstepLayer& last = layers.back();
+    for(int j = 0; j < last.size; j++){
+        Scalar sum = 0;
+        for(int m = 0; m < members; m++){
+            sum += last.activations[(size_t)j * members + m];
+        }
+        output[j] = sum / members;
+    }
+}
+
+template<typename Scalar>
+NetworkT<Scalar> EnsembleT<Scalar>::member(int m) const {
+    NetworkT<Scalar> net = prototype;
+    net.learningRate = learningRate;
+    net.schedule = schedule;
+    net.step = step;
+    net.optimizer = optimizer;
+    for(size_t i = 0; i < layers.size(); i++){
+        const LockstepLayer& layer = layers[i];
+        LayerT<Scalar>& target = net.layers[i];
+        deinterleave(layer.activations, members, m, target.activations);
+        deinterleave(layer.derivatives, members, m, target.derivatives);
+        deinterleave(layer.deltas, members, m, target.deltas);
+        if(i == 0){
+            continue;
+        }
+        deinterleave(layer.weights, members, m, target.weights);
+        deinterleave(layer.historicGradients, members, m, target.historicGradients);
+        deinterleave(layer.firstMoments, members, m, target.firstMoments);
+        deinterleave(layer.biases, members, m, target.biases);
+        deinterleave(layer.biasFirstMoments, members, m, target.biasFirstMoments);
+        deinterleave(layer.biasHistoricGradients, members, m, target.biasHistoricGradients);
+    }
+    return net;
+}
+
+template class EnsembleT<double>;
+template class EnsembleT<float>;
@@ -0,0 +1,104 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>
+#include <cstdint>
+#include "network.h"
+
+//K networks of the same shape trained and run in lockstep. Every parameter and
+//per sample value is stored interleaved, weight (j, i) of all K members side
+//by side, so each step of the single sample passes is one elementwise kernel
+//call over K lanes instead of K calls over one. A 5 neuron layer that cannot
+//fill a SIMD register on its own fills it with K members. Members see their
+//own inputs and targets, for bagging, or the same ones, for seed sweeps.
+//Each member follows the exact summation order of Network::forwardPass and
+//backPropagate, so member(m) is bit for bit the network that would have
+//trained on the same samples alone. Members share the learning rate and
+//optimizer. EnsembleF runs in float
+template<typename Scalar>
+class EnsembleT {
+public:
+    double learningRate = 1.0;
+    int step = 0;
+    Optimizer optimizer;
+    //sets learningRate after every step like NetworkT::schedule
+    LearningRateSchedule schedule;
+
+    EnsembleT() = default;
+    //interleaves networks that all have the same structure and activations.
+    //The learning rate, schedule, optimizer and step of the first one are used for all of them
+    explicit EnsembleT(const std::vector<NetworkT<Scalar>>& networks);
+    //members networks of structure, member m starting from the weights of
+    //setupNetwork(structure, seed + m), random ones for seed 0
+    EnsembleT(const std::vector<int>& structure, int members, uint64_t seed = 0);
+
+    int size() const {
+        return members;
+    }
+    int inputSize() const {
+        return layers.empty() ? 0 : layers.front().size;
+    }
+    int outputSize() const {
+        return layers.empty() ? 0 : layers.back().size;
+    }
+
+    //inputs is size() x inputSize(), one row per member
+    void forward(const Scalar* inputs);
+    //the same input for every member
+    void forwardShared(const Scalar* input);
+    //one optimizer step of every member after forward, expectedValues is
+    //size() x outputSize(). Same pass as Network::backPropagate
+    void backward(const Scalar* expectedValues);
+    void train(const Scalar* inputs, const Scalar* expectedValues){
+        forward(inputs);
+        backward(expectedValues);
+    }
+
+    //output j of member m after the last forward pass
+    Scalar output(int member, int j) const {
+        return layers.back().activations[(size_t)j * members + member];
+    }
+    //averaged prediction of all members for one input, output has outputSize() values
+    void predict(const Scalar* input, Scalar* output);
+
+    //copy of member m as an ordinary network, with its optimizer state
+    NetworkT<Scalar> member(int m) const;
+
+private:
+    //a Layer with every array widened by members, element (j, i) of member m
+    //at (j * inputSize + i) * members + m
+    struct LockstepLayer {
+        int size = 0;
+        int inputSize = 0;
+        ActivationType activation = ActivationType::LeakyRelu;
+        bool isOutput = false;
+        std::vector<Scalar> weights;
+        std::vector<Scalar> historicGradients;
+        std::vector<Scalar> firstMoments;
+        std::vector<Scalar> biases;
+        std::vector<Scalar> biasFirstMoments;
+        std::vector<Scalar> biasHistoricGradients;
+        std::vector<Scalar> activations;
+        std::vector<Scalar> derivatives;
+        std::vector<Scalar> deltas;
+        //delta * input of every weight, formed before the optimizer runs over the whole layer
+        std::vector<Scalar> gradients;
+    };
+
+    int members = 0;
+    std::vector<LockstepLayer> layers;
+    //the partial sums of KernelTable::dot for every member
+    std::vector<Scalar> partials;
+    //one member's outputs, for softmax
+    std::vector<Scalar> memberScratch;
+    //shape, activations and settings member() starts from
+    NetworkT<Scalar> prototype;
+
+    void build(const std::vector<NetworkT<Scalar>>& networks);
+    void activateLayer(LockstepLayer& layer, const LockstepLayer& prevLayer);
+};
+
+typedef EnsembleT<double> Ensemble;
+typedef EnsembleT<float> EnsembleF;
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,165 @@
+#include "inference.h"
+#include <algorithm>
+
+//rounds offsets up to a cache line so every layer starts on its own line
+template<typename Scalar>
+static size_t alignToLine(size_t count){
+    const size_t perLine = 64 / sizeof(Scalar);
+    return (count + perLine - 1) / perLine * perLine;
+}
+
+template<typename Scalar>
+InferenceNetworkT<Scalar>::InferenceNetworkT(const std::vector<LayerT<Scalar>>& layers,
+                                             std::shared_ptr<const MappedFile> mapping)
+    : mapping(std::move(mapping)){
+    if(layers.size() < 2){
+        return;
+    }
+    //a layer stays in the mapping when all of its weights are there, a mapped
+    //dense layer or one whose CSR form the file kept
+    auto inMapping = [&](const LayerT<Scalar>& layer){
+        return this->mapping && layer.mappedWeights && (!layer.isSparse() || layer.mappedRowStarts);
+    };
+    size_t total = 0;
+    size_t indexCount = 0;
+    for(size_t i = 1; i < layers.size(); i++){
+        const LayerT<Scalar>& layer = layers[i];
+        size_t weightCount = layer.isSparse() ? layer.nonzeroCount() : (size_t)layer.size * layer.inputSize;
+        total += (inMapping(layer) ? 0 : alignToLine<Scalar>(weightCount)) + alignToLine<Scalar>(layer.size);
+        if(layer.isSparse() && !inMapping(layer)){
+            indexCount += layer.size + 1 + layer.nonzeroCount();
+        }
+    }
+    parameters.assign(total, Scalar(0));
+    indices.reserve(indexCount);
+
+    size_t offset = 0;
+    for(size_t i = 1; i < layers.size(); i++){
+        const LayerT<Scalar>& layer = layers[i];
+        LayerPlan step = {layer.size, layer.inputSize, layer.activation, offset, 0, layer.isSparse(), 0, 0,
+                          nullptr, nullptr, nullptr};
+        size_t weightCount;
+        if(inMapping(layer)){
+            weightCount = 0;
+            step.mappedWeights = step.sparse ? layer.sparseValueData() : layer.weightData();
+            step.mappedRowStarts = step.sparse ? layer.rowStartData() : nullptr;
+            step.mappedColumns = step.sparse ? layer.columnData() : nullptr;
+        }else if(step.sparse){
+            weightCount = layer.nonzeroCount();
+            std::copy(layer.sparseValueData(), layer.sparseValueData() + weightCount, parameters.begin() + offset);
+            step.rowStartsOffset = indices.size();
+            indices.insert(indices.end(), layer.rowStartData(), layer.rowStartData() + layer.size + 1);
+            step.columnsOffset = indices.size();
+            indices.insert(indices.end(), layer.columnData(), layer.columnData() + weightCount);
+        }else{
+            weightCount = (size_t)layer.size * layer.inputSize;
+            std::copy(layer.weightData(), layer.weightData() + weightCount, parameters.begin() + offset);
+        }
+        offset += alignToLine<Scalar>(weightCount);
+        step.biasesOffset = offset;
+        std::copy(layer.biases.begin(), layer.biases.end(), parameters.begin() + offset);
+        offset += alignToLine<Scalar>(layer.size);
+        plan.push_back(step);
+        maxWidth = std::max(maxWidth, layer.size);
+    }
+    numInputs = layers.front().size;
+    numOutputs = layers.back().size;
+}
+
+template<typename Scalar>
+typename InferenceNetworkT<Scalar>::Workspace& InferenceNetworkT<Scalar>::threadWorkspace(){
+    thread_local Workspace workspace;
+    return workspace;
+}
+
+template<typename Scalar>
+void InferenceNetworkT<Scalar>::multiply(const LayerPlan& step, const Scalar* in, Scalar* out) const {
+    const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+    const Scalar* values = weightsOf(step);
+    if(step.sparse){
+        const int32_t* rowStarts = step.mappedRowStarts ? step.mappedRowStarts : &indices[step.rowStartsOffset];
+        const int32_t* columns = step.mappedRowStarts ? step.mappedColumns : &indices[step.columnsOffset];
+        for(int j = 0; j < step.size; j++){
+            out[j] = k.sparseDot(values + rowStarts[j], columns + rowStarts[j], in, rowStarts[j + 1] - rowStarts[j]);
+        }
+        return;
+    }
+    for(int j = 0; j < step.size; j++){
+        out[j] = k.dot(values + (size_t)j * step.inputSize, in, step.inputSize);
+    }
+}
+
+template<typename Scalar>
+void InferenceNetworkT<Scalar>::predict(const Scalar* input, Scalar* output) const {
+    predict(input, output, threadWorkspace());
+}
+
+template<typename Scalar>
+void InferenceNetworkT<Scalar>::predict(const Scalar* input, Scalar* output, Workspace& workspace) const {
+    if(plan.empty()){
+        return;
+    }
+    if(workspace.front.size() < (size_t)maxWidth){
+        workspace.front.resize(maxWidth);
+        workspace.back.resize(maxWidth);
+    }
+    const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+    const Scalar* in = input;
+    for(size_t i = 0; i < plan.size(); i++){
+        const LayerPlan& step = plan[i];
+        Scalar* out = i + 1 == plan.size() ? output : (i % 2 == 0 ? workspace.front.data() : workspace.back.data());
+        multiply(step, in, out);
+        k.biasActivation[(int)step.activation](&parameters[step.biasesOffset], out, step.size);
+        if(isLayerScope(step.activation)){
+            softmax(out, step.size);
+        }
+        in = out;
+    }
+}
+
+template<typename Scalar>
+void InferenceNetworkT<Scalar>::predictBatch(const Scalar* inputs, Scalar* outputs, int batchSize) const {
+    predictBatch(inputs, outputs, batchSize, threadWorkspace());
+}
+
+template<typename Scalar>
+void InferenceNetworkT<Scalar>::predictBatch(const Scalar* inputValues, Scalar* outputValues, int batchSize,
+                                             Workspace& workspace) const {
+    if(plan.empty() || batchSize <= 0){
+        return;
+    }
+    size_t needed = (size_t)maxWidth * std::min(batchSize, INFERENCE_BATCH_CHUNK);
+    if(workspace.front.size() < needed){
+        workspace.front.resize(needed);
+        workspace.back.resize(needed);
+    }
+    const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+    for(int first = 0; first < batchSize; first += INFERENCE_BATCH_CHUNK){
+        int rows = std::min(INFERENCE_BATCH_CHUNK, batchSize - first);
+        const Scalar* in = inputValues + (size_t)first * numInputs;
+        for(size_t i = 0; i < plan.size(); i++){
+            const LayerPlan& step = plan[i];
+            Scalar* out = i + 1 == plan.size() ? outputValues + (size_t)first * numOutputs
+                          : (i % 2 == 0 ? workspace.front.data() : workspace.back.data());
+            if(step.sparse){
+                //one sparse product per sample, results match predict instead of forwardBatch
+                for(int r = 0; r < rows; r++){
+                    multiply(step, in + (size_t)r * step.inputSize, out + (size_t)r * step.size);
+                }
+            }else{
+                //same GEMM as Layer::activateBatch, so results match forwardBatch
+                matMulNT(rows, step.size, step.inputSize, Scalar(1), in, weightsOf(step), out);
+            }
+            for(int r = 0; r < rows; r++){
+                k.biasActivation[(int)step.activation](&parameters[step.biasesOffset], out + (size_t)r * step.size, step.size);
+                if(isLayerScope(step.activation)){
+                    softmax(out + (size_t)r * step.size, step.size);
+                }
+            }
+            in = out;
+        }
+    }
+}
+
+template class InferenceNetworkT<double>;
+template class InferenceNetworkT<float>;
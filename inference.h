@@ -0,0 +1,102 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include <vector>
+#include <cstddef>
+#include <memory>
+#include "layer.h"
+
+class MappedFile;
+
+//rows per GEMM in predictBatch, bounds the workspace for large batches
+const int INFERENCE_BATCH_CHUNK = 64;
+
+//read-only forward pass compiled from a trained network (network::freeze).
+//Only weights and biases are kept, packed into one buffer, and each layer is
+//a matrix-vector product followed by one fused bias + activation pass with no
+//derivatives. Nothing is written to the plan after construction, so any number
+//of threads can call predict at once, each with its own Workspace.
+//Pruned layers (Layer::prune) are stored in CSR form, only their kept weights
+//and a 32-bit column per weight, and run on the sparse kernels.
+//Given the mapping of a network loaded with mapWeights, the plan keeps it and
+//refers to the weights inside it instead of copying them, so every process
+//serving the same file shares one physical copy.
+//InferenceNetwork serves in double and InferenceNetworkF in float
+template<typename Scalar>
+class InferenceNetworkT {
+public:
+    //activations of one call. Layers alternate between the two buffers and
+    //the last layer writes straight into the caller's output
+    struct Workspace {
+        std::vector<Scalar> front;
+        std::vector<Scalar> back;
+    };
+
+    InferenceNetworkT() = default;
+    //mapping is the file layers with mappedWeights read from, see
+    //NetworkT::loadModel. Without it their weights are copied too
+    explicit InferenceNetworkT(const std::vector<LayerT<Scalar>>& layers,
+                               std::shared_ptr<const MappedFile> mapping = nullptr);
+
+    int inputSize() const {
+        return numInputs;
+    }
+    int outputSize() const {
+        return numOutputs;
+    }
+    bool empty() const {
+        return plan.empty();
+    }
+    //memory held by the weights, biases and sparse indices, not counting the
+    //weights left in the mapping
+    size_t parameterBytes() const {
+        return parameters.size() * sizeof(Scalar) + indices.size() * sizeof(int32_t);
+    }
+
+    //output has outputSize() values. The overloads without a workspace use one
+    //per calling thread, allocated on its first call
+    void predict(const Scalar* input, Scalar* output) const;
+    void predict(const Scalar* input, Scalar* output, Workspace& workspace) const;
+    //inputs is batchSize x inputSize() and outputs batchSize x outputSize(), row-major
+    void predictBatch(const Scalar* inputs, Scalar* outputs, int batchSize) const;
+    void predictBatch(const Scalar* inputs, Scalar* outputs, int batchSize, Workspace& workspace) const;
+
+private:
+    struct LayerPlan {
+        int size;
+        int inputSize;
+        ActivationType activation;
+        size_t weightsOffset;
+        size_t biasesOffset;
+        //CSR layers only, positions of the row starts and columns in indices
+        bool sparse;
+        size_t rowStartsOffset;
+        size_t columnsOffset;
+        //set for a layer whose weights (or CSR arrays) stay in the mapping,
+        //the offsets above are not used for them then
+        const Scalar* mappedWeights;
+        const int32_t* mappedRowStarts;
+        const int32_t* mappedColumns;
+    };
+
+    std::vector<LayerPlan> plan;
+    std::vector<Scalar> parameters;
+    std::vector<int32_t> indices;
+    int numInputs = 0;
+    int numOutputs = 0;
+    int maxWidth = 0;
+    //keeps the file of the mapped weights open
+    std::shared_ptr<const MappedFile> mapping;
+
+    const Scalar* weightsOf(const LayerPlan& step) const {
+        return step.mappedWeights ? step.mappedWeights : &parameters[step.weightsOffset];
+    }
+    static Workspace& threadWorkspace();
+    //one sample through one layer, before the bias and activation
+    void multiply(const LayerPlan& step, const Scalar* in, Scalar* out) const;
+};
+
+typedef InferenceNetworkT<double> InferenceNetwork;
+typedef InferenceNetworkT<float> InferenceNetworkF;
+
+#endif // INFERENCE_H
@@ -0,0 +1,1391 @@
+#include "kernels.h"
+#include "simd_target.h"
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+//dot products accumulate into 16 independent partial sums (element i goes to
+//sum i % 16) and reduce them in a fixed tree, so every ISA rounds the same way
+static const double LEAKY_SLOPE = 0.01;
+
+//tanh(x) = expm1(2|x|) / (expm1(2|x|) + 2) with the sign of x restored.
+//expm1 is 2^n * expm1(r) + (2^n - 1) with |r| <= ln2/2, which keeps full
+//relative precision near zero. Max error against libm tanh is 3 ulp on [-20, 20]
+static const double TANH_CLAMP = 20.0;
+static const double LOG2E = 1.4426950408889634;
+static const double LN2_HI = 6.93147180369123816490e-01;
+static const double LN2_LO = 1.90821492927058770002e-10;
+static const double ROUND_MAGIC = 6755399441055744.0;
+static const int EXPM1_TERMS = 13;
+//1/k! for k = 13 down to 2, used in Horner order
+static const double EXPM1_COEFFS[EXPM1_TERMS - 1] = {
+    1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+    1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0,
+    1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0
+};
+static const uint64_t SIGN_MASK = 0x8000000000000000ULL;
+static const uint64_t ABS_MASK = 0x7fffffffffffffffULL;
+
+static inline uint64_t toBits(double value){
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+static inline double fromBits(uint64_t bits){
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//---------------------------------------------------------------- scalar
+
+static double dotScalar(const double* a, const double* b, size_t n){
+    double acc[16] = {0.0};
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        for(int k = 0; k < 16; k++){
+            acc[k] += a[i + k] * b[i + k];
+        }
+    }
+    double v[8], t[4];
+    for(int k = 0; k < 8; k++){
+        v[k] = acc[k] + acc[k + 8];
+    }
+    for(int k = 0; k < 4; k++){
+        t[k] = v[k] + v[k + 4];
+    }
+    double sum = (t[0] + t[2]) + (t[1] + t[3]);
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void axpyScalar(double alpha, const double* x, double* y, size_t n){
+    for(size_t i = 0; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+//dot of one CSR row with a dense vector, in the same order as dotScalar so
+//the gathered versions round the same way
+static double sparseDotScalar(const double* values, const int32_t* columns, const double* x, size_t n){
+    double acc[16] = {0.0};
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        for(int k = 0; k < 16; k++){
+            acc[k] += values[i + k] * x[columns[i + k]];
+        }
+    }
+    double v[8], t[4];
+    for(int k = 0; k < 8; k++){
+        v[k] = acc[k] + acc[k + 8];
+    }
+    for(int k = 0; k < 4; k++){
+        t[k] = v[k] + v[k + 4];
+    }
+    double sum = (t[0] + t[2]) + (t[1] + t[3]);
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+//columns of a row are distinct, so every y element gets one update
+static void sparseAxpyScalar(double alpha, const double* values, const int32_t* columns, double* y, size_t n){
+    for(size_t i = 0; i < n; i++){
+        y[columns[i]] += alpha * values[i];
+    }
+}
+
+//b repeats every period elements, so a vector of per lane values scales every
+//group of lanes without being copied out to the full length
+static void multiplyAddScalar(const double* a, const double* b, double* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        for(size_t m = 0; m < count; m++){
+            y[start + m] += a[start + m] * b[m];
+        }
+    }
+}
+
+//an OptimizerStep converted once per call
+struct UpdateConstants {
+    double learningRate;
+    double beta1;
+    double oneMinusBeta1;
+    double beta2;
+    double oneMinusBeta2;
+    double epsilon;
+    double weightDecay;
+    double maxRate;
+    double correction1;
+    double correction2;
+    //AdamW's decoupled decay, weight *= 1 - learningRate * weightDecay
+    double shrink;
+};
+
+static inline UpdateConstants updateConstants(const OptimizerStep& step){
+    UpdateConstants c;
+    c.learningRate = (double)step.learningRate;
+    c.beta1 = (double)step.beta1;
+    c.oneMinusBeta1 = 1 - c.beta1;
+    c.beta2 = (double)step.beta2;
+    c.oneMinusBeta2 = 1 - c.beta2;
+    c.epsilon = (double)step.epsilon;
+    c.weightDecay = (double)step.weightDecay;
+    c.maxRate = (double)step.maxRate;
+    c.correction1 = (double)step.correction1;
+    c.correction2 = (double)step.correction2;
+    c.shrink = (double)(1.0 - step.learningRate * step.weightDecay);
+    return c;
+}
+
+//element i of update rule T with gradient g, returns the rate it used. The
+//vector kernels below do exactly the same operations in the same order
+template<OptimizerType T>
+static inline double optimizerElement(double* params, double* first, double* second, size_t i, double g, const UpdateConstants& c){
+    double p = params[i];
+    double rate = c.learningRate;
+    if constexpr(T != OptimizerType::AdamW){
+        g = g + c.weightDecay * p;
+    }
+    if constexpr(T == OptimizerType::SGD){
+        p = p - rate * g;
+    }else if constexpr(T == OptimizerType::Momentum){
+        double m = c.beta1 * first[i] + g;
+        first[i] = m;
+        p = p - rate * m;
+    }else if constexpr(T == OptimizerType::RMSProp){
+        double v = second[i];
+        rate = std::min(c.learningRate / (std::sqrt(v) + c.epsilon), c.maxRate);
+        p = p - rate * g;
+        second[i] = (c.beta2 * v) + (c.oneMinusBeta2 * (g * g));
+    }else{
+        double m = (c.beta1 * first[i]) + (c.oneMinusBeta1 * g);
+        double v = (c.beta2 * second[i]) + (c.oneMinusBeta2 * (g * g));
+        first[i] = m;
+        second[i] = v;
+        rate = std::min(c.learningRate / (std::sqrt(v * c.correction2) + c.epsilon), c.maxRate);
+        if constexpr(T == OptimizerType::AdamW){
+            p = p * c.shrink;
+        }
+        p = p - rate * (m * c.correction1);
+    }
+    params[i] = p;
+    return rate;
+}
+
+template<OptimizerType T>
+static double optimizerScalar(double* params, double* first, double* second, const double* x, double scale,
+                             const OptimizerStep& step, size_t n){
+    UpdateConstants c = updateConstants(step);
+    double rate = 0.0;
+    for(size_t i = 0; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+static inline double reluScalar(double value, double& der){
+    bool negative = value < 0;
+    der = negative ? 0.0 : 1.0;
+    return negative ? 0.0 : value;
+}
+static inline double leakyReluScalar(double value, double& der){
+    bool negative = value < 0;
+    der = negative ? LEAKY_SLOPE : 1.0;
+    return negative ? LEAKY_SLOPE * value : value;
+}
+static inline double tanhScalar(double value, double& der){
+    double a = fromBits(toBits(value) & ABS_MASK);
+    a = std::min(a, TANH_CLAMP);
+    double a2 = a + a;
+    double t = a2 * LOG2E + ROUND_MAGIC;
+    double n = t - ROUND_MAGIC;
+    double r = (a2 - n * LN2_HI) - n * LN2_LO;
+    double q = EXPM1_COEFFS[0];
+    for(int k = 1; k < EXPM1_TERMS - 1; k++){
+        q = q * r + EXPM1_COEFFS[k];
+    }
+    q = q * r + 1.0;
+    double p = q * r;
+    double scale = fromBits((toBits(t) + 1023) << 52);
+    double em1 = scale * p + (scale - 1.0);
+    double th = em1 / (em1 + 2.0);
+    th = fromBits(toBits(th) | (toBits(value) & SIGN_MASK));
+    der = 1.0 - th * th;
+    return th;
+}
+
+//the fast approximations (see activation_functions.h). Every ISA evaluates
+//the same operations in the same order, so they match the scalar ones bit for bit
+static inline double expFastScalar(double x){
+    double t = x * LOG2E + ROUND_MAGIC;
+    double n = t - ROUND_MAGIC;
+    double r = (x - n * LN2_HI) - n * LN2_LO;
+    double q = FAST_EXP_COEFFS[0];
+    for(int k = 1; k < FAST_EXP_TERMS; k++){
+        q = q * r + FAST_EXP_COEFFS[k];
+    }
+    return q * fromBits((toBits(t) + 1023) << 52);
+}
+static inline double tanhFastScalar(double value, double& der){
+    double x = std::min(std::max(value, -FAST_TANH_CLAMP), FAST_TANH_CLAMP);
+    double x2 = x * x;
+    double p = FAST_TANH_P[0];
+    for(int k = 1; k < FAST_TANH_P_TERMS; k++){
+        p = p * x2 + FAST_TANH_P[k];
+    }
+    double q = FAST_TANH_Q[0];
+    for(int k = 1; k < FAST_TANH_Q_TERMS; k++){
+        q = q * x2 + FAST_TANH_Q[k];
+    }
+    double th = (p * x) / q;
+    der = 1.0 - th * th;
+    return th;
+}
+static inline double sigmoidFastScalar(double value, double& der){
+    double th = tanhFastScalar(0.5 * value, der);
+    double s = 0.5 + 0.5 * th;
+    der = s * (1.0 - s);
+    return s;
+}
+static inline double geluFastScalar(double value, double& der){
+    double a = std::min(fromBits(toBits(value) & ABS_MASK), FAST_GELU_CLAMP);
+    double t = 1.0 / (1.0 + FAST_ERF_P * (a * INV_SQRT2));
+    double poly = FAST_ERF_A[0];
+    for(int k = 1; k < FAST_ERF_TERMS; k++){
+        poly = poly * t + FAST_ERF_A[k];
+    }
+    poly = poly * t;
+    double e = expFastScalar((a * a) * -0.5);
+    //erfc(|x| / sqrt(2)) / 2, the normal CDF of -|x|
+    double tail = 0.5 * (poly * e);
+    double cdf = value < 0 ? tail : 1.0 - tail;
+    der = cdf + value * (INV_SQRT_2PI * e);
+    return value * cdf;
+}
+static inline double softplusFastScalar(double value, double& der){
+    double u = expFastScalar(-std::min(fromBits(toBits(value) & ABS_MASK), FAST_EXP_CLAMP));
+    double s = u / (u + 2.0);
+    double s2 = s * s;
+    double q = FAST_LOG1P_COEFFS[0];
+    for(int k = 1; k < FAST_LOG1P_TERMS; k++){
+        q = q * s2 + FAST_LOG1P_COEFFS[k];
+    }
+    der = (value < 0 ? u : 1.0) / (1.0 + u);
+    return std::max(value, 0.0) + (s + s) * q;
+}
+
+//one specialization per activation, the branch is resolved at compile time
+template<ActivationType T>
+static inline double activationScalar(double value, double& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluScalar(value, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhScalar(value, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastScalar(value, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastScalar(value, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastScalar(value, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastScalar(value, der);
+    }else if constexpr(usesLibm(T)){
+        ActivationResultT<double> result = applyActivation(T, value);
+        der = result.derivative;
+        return result.activatedValue;
+    }else if constexpr(T == ActivationType::Softmax){
+        //logits pass through, softmax runs over the whole layer afterwards
+        der = 1.0;
+        return value;
+    }else{
+        return leakyReluScalar(value, der);
+    }
+}
+
+template<ActivationType T>
+static void activationVecScalar(const double* z, double* act, double* der, size_t n){
+    for(size_t i = 0; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+//z = activation(z + bias) with no derivatives, for the frozen inference plan.
+//z + bias rounds the same as bias + dot in the training pass
+template<ActivationType T>
+static void biasActivationScalar(const double* bias, double* z, size_t n){
+    double der;
+    for(size_t i = 0; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+#ifdef NN_X86
+//---------------------------------------------------------------- SSE2
+
+NN_TARGET("sse2")
+static double dotSSE2(const double* a, const double* b, size_t n){
+    __m128d s[8];
+    for(int k = 0; k < 8; k++){
+        s[k] = _mm_setzero_pd();
+    }
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        for(int k = 0; k < 8; k++){
+            s[k] = _mm_add_pd(s[k], _mm_mul_pd(_mm_loadu_pd(a + i + 2 * k), _mm_loadu_pd(b + i + 2 * k)));
+        }
+    }
+    __m128d v0 = _mm_add_pd(s[0], s[4]);
+    __m128d v1 = _mm_add_pd(s[1], s[5]);
+    __m128d v2 = _mm_add_pd(s[2], s[6]);
+    __m128d v3 = _mm_add_pd(s[3], s[7]);
+    __m128d t01 = _mm_add_pd(v0, v2);
+    __m128d t23 = _mm_add_pd(v1, v3);
+    __m128d u = _mm_add_pd(t01, t23);
+    double sum = _mm_cvtsd_f64(u) + _mm_cvtsd_f64(_mm_unpackhi_pd(u, u));
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+NN_TARGET("sse2")
+static void axpySSE2(double alpha, const double* x, double* y, size_t n){
+    __m128d va = _mm_set1_pd(alpha);
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+    }
+    for(; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+//SSE2 has no gathers, the pairs are loaded one element at a time
+NN_TARGET("sse2")
+static double sparseDotSSE2(const double* values, const int32_t* columns, const double* x, size_t n){
+    __m128d s[8];
+    for(int k = 0; k < 8; k++){
+        s[k] = _mm_setzero_pd();
+    }
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        for(int k = 0; k < 8; k++){
+            __m128d gathered = _mm_set_pd(x[columns[i + 2 * k + 1]], x[columns[i + 2 * k]]);
+            s[k] = _mm_add_pd(s[k], _mm_mul_pd(_mm_loadu_pd(values + i + 2 * k), gathered));
+        }
+    }
+    __m128d v0 = _mm_add_pd(s[0], s[4]);
+    __m128d v1 = _mm_add_pd(s[1], s[5]);
+    __m128d v2 = _mm_add_pd(s[2], s[6]);
+    __m128d v3 = _mm_add_pd(s[3], s[7]);
+    __m128d t01 = _mm_add_pd(v0, v2);
+    __m128d t23 = _mm_add_pd(v1, v3);
+    __m128d u = _mm_add_pd(t01, t23);
+    double sum = _mm_cvtsd_f64(u) + _mm_cvtsd_f64(_mm_unpackhi_pd(u, u));
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+NN_TARGET("sse2")
+static void multiplyAddSSE2(const double* a, const double* b, double* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        const double* as = a + start;
+        double* ys = y + start;
+        size_t m = 0;
+        for(; m + 2 <= count; m += 2){
+            _mm_storeu_pd(ys + m, _mm_add_pd(_mm_loadu_pd(ys + m), _mm_mul_pd(_mm_loadu_pd(as + m), _mm_loadu_pd(b + m))));
+        }
+        for(; m < count; m++){
+            ys[m] += as[m] * b[m];
+        }
+    }
+}
+
+template<OptimizerType T>
+NN_TARGET("sse2")
+static double optimizerSSE2(double* params, double* first, double* second, const double* x, double scale,
+                            const OptimizerStep& step, size_t n){
+    UpdateConstants c = updateConstants(step);
+    __m128d vScale = _mm_set1_pd(scale);
+    __m128d vRate = _mm_set1_pd(c.learningRate);
+    __m128d vBeta1 = _mm_set1_pd(c.beta1);
+    __m128d vOneMinusBeta1 = _mm_set1_pd(c.oneMinusBeta1);
+    __m128d vBeta2 = _mm_set1_pd(c.beta2);
+    __m128d vOneMinusBeta2 = _mm_set1_pd(c.oneMinusBeta2);
+    __m128d vEps = _mm_set1_pd(c.epsilon);
+    __m128d vDecay = _mm_set1_pd(c.weightDecay);
+    __m128d vMax = _mm_set1_pd(c.maxRate);
+    __m128d vCorrection1 = _mm_set1_pd(c.correction1);
+    __m128d vCorrection2 = _mm_set1_pd(c.correction2);
+    __m128d vShrink = _mm_set1_pd(c.shrink);
+    size_t i = 0;
+    //the last element always goes through optimizerElement, which reports its rate
+    for(; i + 2 < n; i += 2){
+        __m128d p = _mm_loadu_pd(params + i);
+        __m128d g = _mm_mul_pd(vScale, _mm_loadu_pd(x + i));
+        if constexpr(T != OptimizerType::AdamW){
+            g = _mm_add_pd(g, _mm_mul_pd(vDecay, p));
+        }
+        if constexpr(T == OptimizerType::SGD){
+            p = _mm_sub_pd(p, _mm_mul_pd(vRate, g));
+        }else if constexpr(T == OptimizerType::Momentum){
+            __m128d m = _mm_add_pd(_mm_mul_pd(vBeta1, _mm_loadu_pd(first + i)), g);
+            _mm_storeu_pd(first + i, m);
+            p = _mm_sub_pd(p, _mm_mul_pd(vRate, m));
+        }else if constexpr(T == OptimizerType::RMSProp){
+            __m128d v = _mm_loadu_pd(second + i);
+            __m128d rate = _mm_min_pd(vMax, _mm_div_pd(vRate, _mm_add_pd(_mm_sqrt_pd(v), vEps)));
+            p = _mm_sub_pd(p, _mm_mul_pd(rate, g));
+            _mm_storeu_pd(second + i, _mm_add_pd(_mm_mul_pd(vBeta2, v), _mm_mul_pd(vOneMinusBeta2, _mm_mul_pd(g, g))));
+        }else{
+            __m128d m = _mm_add_pd(_mm_mul_pd(vBeta1, _mm_loadu_pd(first + i)), _mm_mul_pd(vOneMinusBeta1, g));
+            __m128d v = _mm_add_pd(_mm_mul_pd(vBeta2, _mm_loadu_pd(second + i)), _mm_mul_pd(vOneMinusBeta2, _mm_mul_pd(g, g)));
+            _mm_storeu_pd(first + i, m);
+            _mm_storeu_pd(second + i, v);
+            __m128d rate = _mm_min_pd(vMax, _mm_div_pd(vRate, _mm_add_pd(_mm_sqrt_pd(_mm_mul_pd(v, vCorrection2)), vEps)));
+            if constexpr(T == OptimizerType::AdamW){
+                p = _mm_mul_pd(p, vShrink);
+            }
+            p = _mm_sub_pd(p, _mm_mul_pd(rate, _mm_mul_pd(m, vCorrection1)));
+        }
+        _mm_storeu_pd(params + i, p);
+    }
+    double rate = 0.0;
+    for(; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+NN_TARGET("sse2")
+static inline __m128d reluSSE2(__m128d v, __m128d& der){
+    __m128d negative = _mm_cmplt_pd(v, _mm_setzero_pd());
+    der = _mm_andnot_pd(negative, _mm_set1_pd(1.0));
+    return _mm_andnot_pd(negative, v);
+}
+
+NN_TARGET("sse2")
+static inline __m128d leakyReluSSE2(__m128d v, __m128d& der){
+    __m128d slope = _mm_set1_pd(LEAKY_SLOPE);
+    __m128d negative = _mm_cmplt_pd(v, _mm_setzero_pd());
+    __m128d leaked = _mm_mul_pd(slope, v);
+    der = _mm_or_pd(_mm_and_pd(negative, slope), _mm_andnot_pd(negative, _mm_set1_pd(1.0)));
+    return _mm_or_pd(_mm_and_pd(negative, leaked), _mm_andnot_pd(negative, v));
+}
+
+NN_TARGET("sse2")
+static inline __m128d tanhSSE2(__m128d v, __m128d& der){
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x((long long)ABS_MASK));
+    __m128d signMask = _mm_castsi128_pd(_mm_set1_epi64x((long long)SIGN_MASK));
+    __m128d a = _mm_min_pd(_mm_and_pd(v, absMask), _mm_set1_pd(TANH_CLAMP));
+    __m128d a2 = _mm_add_pd(a, a);
+    __m128d t = _mm_add_pd(_mm_mul_pd(a2, _mm_set1_pd(LOG2E)), magic);
+    __m128d k = _mm_sub_pd(t, magic);
+    __m128d r = _mm_sub_pd(_mm_sub_pd(a2, _mm_mul_pd(k, _mm_set1_pd(LN2_HI))), _mm_mul_pd(k, _mm_set1_pd(LN2_LO)));
+    __m128d q = _mm_set1_pd(EXPM1_COEFFS[0]);
+    for(int c = 1; c < EXPM1_TERMS - 1; c++){
+        q = _mm_add_pd(_mm_mul_pd(q, r), _mm_set1_pd(EXPM1_COEFFS[c]));
+    }
+    q = _mm_add_pd(_mm_mul_pd(q, r), one);
+    __m128d p = _mm_mul_pd(q, r);
+    __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(_mm_castpd_si128(t), _mm_set1_epi64x(1023)), 52));
+    __m128d em1 = _mm_add_pd(_mm_mul_pd(scale, p), _mm_sub_pd(scale, one));
+    __m128d th = _mm_div_pd(em1, _mm_add_pd(em1, _mm_set1_pd(2.0)));
+    th = _mm_or_pd(th, _mm_and_pd(v, signMask));
+    der = _mm_sub_pd(one, _mm_mul_pd(th, th));
+    return th;
+}
+
+NN_TARGET("sse2")
+static inline __m128d expFastSSE2(__m128d x){
+    __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    __m128d t = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(LOG2E)), magic);
+    __m128d k = _mm_sub_pd(t, magic);
+    __m128d r = _mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(k, _mm_set1_pd(LN2_HI))), _mm_mul_pd(k, _mm_set1_pd(LN2_LO)));
+    __m128d q = _mm_set1_pd(FAST_EXP_COEFFS[0]);
+    for(int c = 1; c < FAST_EXP_TERMS; c++){
+        q = _mm_add_pd(_mm_mul_pd(q, r), _mm_set1_pd(FAST_EXP_COEFFS[c]));
+    }
+    __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(_mm_castpd_si128(t), _mm_set1_epi64x(1023)), 52));
+    return _mm_mul_pd(q, scale);
+}
+
+NN_TARGET("sse2")
+static inline __m128d tanhFastSSE2(__m128d v, __m128d& der){
+    __m128d x = _mm_min_pd(_mm_max_pd(v, _mm_set1_pd(-FAST_TANH_CLAMP)), _mm_set1_pd(FAST_TANH_CLAMP));
+    __m128d x2 = _mm_mul_pd(x, x);
+    __m128d p = _mm_set1_pd(FAST_TANH_P[0]);
+    for(int c = 1; c < FAST_TANH_P_TERMS; c++){
+        p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(FAST_TANH_P[c]));
+    }
+    __m128d q = _mm_set1_pd(FAST_TANH_Q[0]);
+    for(int c = 1; c < FAST_TANH_Q_TERMS; c++){
+        q = _mm_add_pd(_mm_mul_pd(q, x2), _mm_set1_pd(FAST_TANH_Q[c]));
+    }
+    __m128d th = _mm_div_pd(_mm_mul_pd(p, x), q);
+    der = _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(th, th));
+    return th;
+}
+
+NN_TARGET("sse2")
+static inline __m128d sigmoidFastSSE2(__m128d v, __m128d& der){
+    __m128d half = _mm_set1_pd(0.5);
+    __m128d th = tanhFastSSE2(_mm_mul_pd(half, v), der);
+    __m128d s = _mm_add_pd(half, _mm_mul_pd(half, th));
+    der = _mm_mul_pd(s, _mm_sub_pd(_mm_set1_pd(1.0), s));
+    return s;
+}
+
+NN_TARGET("sse2")
+static inline __m128d geluFastSSE2(__m128d v, __m128d& der){
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x((long long)ABS_MASK));
+    __m128d a = _mm_min_pd(_mm_and_pd(v, absMask), _mm_set1_pd(FAST_GELU_CLAMP));
+    __m128d t = _mm_div_pd(one, _mm_add_pd(one, _mm_mul_pd(_mm_set1_pd(FAST_ERF_P), _mm_mul_pd(a, _mm_set1_pd(INV_SQRT2)))));
+    __m128d poly = _mm_set1_pd(FAST_ERF_A[0]);
+    for(int c = 1; c < FAST_ERF_TERMS; c++){
+        poly = _mm_add_pd(_mm_mul_pd(poly, t), _mm_set1_pd(FAST_ERF_A[c]));
+    }
+    poly = _mm_mul_pd(poly, t);
+    __m128d e = expFastSSE2(_mm_mul_pd(_mm_mul_pd(a, a), _mm_set1_pd(-0.5)));
+    __m128d tail = _mm_mul_pd(_mm_set1_pd(0.5), _mm_mul_pd(poly, e));
+    __m128d negative = _mm_cmplt_pd(v, _mm_setzero_pd());
+    __m128d cdf = _mm_or_pd(_mm_and_pd(negative, tail), _mm_andnot_pd(negative, _mm_sub_pd(one, tail)));
+    der = _mm_add_pd(cdf, _mm_mul_pd(v, _mm_mul_pd(_mm_set1_pd(INV_SQRT_2PI), e)));
+    return _mm_mul_pd(v, cdf);
+}
+
+NN_TARGET("sse2")
+static inline __m128d softplusFastSSE2(__m128d v, __m128d& der){
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x((long long)ABS_MASK));
+    __m128d signMask = _mm_castsi128_pd(_mm_set1_epi64x((long long)SIGN_MASK));
+    __m128d a = _mm_min_pd(_mm_and_pd(v, absMask), _mm_set1_pd(FAST_EXP_CLAMP));
+    __m128d u = expFastSSE2(_mm_xor_pd(a, signMask));
+    __m128d s = _mm_div_pd(u, _mm_add_pd(u, _mm_set1_pd(2.0)));
+    __m128d s2 = _mm_mul_pd(s, s);
+    __m128d q = _mm_set1_pd(FAST_LOG1P_COEFFS[0]);
+    for(int c = 1; c < FAST_LOG1P_TERMS; c++){
+        q = _mm_add_pd(_mm_mul_pd(q, s2), _mm_set1_pd(FAST_LOG1P_COEFFS[c]));
+    }
+    __m128d negative = _mm_cmplt_pd(v, _mm_setzero_pd());
+    der = _mm_div_pd(_mm_or_pd(_mm_and_pd(negative, u), _mm_andnot_pd(negative, one)), _mm_add_pd(one, u));
+    return _mm_add_pd(_mm_max_pd(v, _mm_setzero_pd()), _mm_mul_pd(_mm_add_pd(s, s), q));
+}
+
+template<ActivationType T>
+NN_TARGET("sse2")
+static inline __m128d activationSSE2(__m128d v, __m128d& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluSSE2(v, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhSSE2(v, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::Softmax){
+        der = _mm_set1_pd(1.0);
+        return v;
+    }else{
+        return leakyReluSSE2(v, der);
+    }
+}
+
+//the libm activations run the scalar loop on every ISA
+template<ActivationType T>
+NN_TARGET("sse2")
+static void activationVecSSE2(const double* z, double* act, double* der, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 2 <= n; i += 2){
+            __m128d d;
+            __m128d a = activationSSE2<T>(_mm_loadu_pd(z + i), d);
+            _mm_storeu_pd(act + i, a);
+            _mm_storeu_pd(der + i, d);
+        }
+    }
+    for(; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("sse2")
+static void biasActivationSSE2(const double* bias, double* z, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 2 <= n; i += 2){
+            __m128d d;
+            _mm_storeu_pd(z + i, activationSSE2<T>(_mm_add_pd(_mm_loadu_pd(z + i), _mm_loadu_pd(bias + i)), d));
+        }
+    }
+    double der;
+    for(; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+//---------------------------------------------------------------- AVX2
+
+NN_TARGET("avx2")
+static double dotAVX2(const double* a, const double* b, size_t n){
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+        s2 = _mm256_add_pd(s2, _mm256_mul_pd(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8)));
+        s3 = _mm256_add_pd(s3, _mm256_mul_pd(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12)));
+    }
+    __m256d t = _mm256_add_pd(_mm256_add_pd(s0, s2), _mm256_add_pd(s1, s3));
+    __m128d u = _mm_add_pd(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+    double sum = _mm_cvtsd_f64(u) + _mm_cvtsd_f64(_mm_unpackhi_pd(u, u));
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+NN_TARGET("avx2")
+static void axpyAVX2(double alpha, const double* x, double* y, size_t n){
+    __m256d va = _mm256_set1_pd(alpha);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(va, _mm256_loadu_pd(x + i))));
+    }
+    for(; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+NN_TARGET("avx2")
+static inline __m256d gatherAVX2(const double* x, const int32_t* columns){
+    return _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)columns), 8);
+}
+
+NN_TARGET("avx2")
+static double sparseDotAVX2(const double* values, const int32_t* columns, const double* x, size_t n){
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(values + i), gatherAVX2(x, columns + i)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(values + i + 4), gatherAVX2(x, columns + i + 4)));
+        s2 = _mm256_add_pd(s2, _mm256_mul_pd(_mm256_loadu_pd(values + i + 8), gatherAVX2(x, columns + i + 8)));
+        s3 = _mm256_add_pd(s3, _mm256_mul_pd(_mm256_loadu_pd(values + i + 12), gatherAVX2(x, columns + i + 12)));
+    }
+    __m256d t = _mm256_add_pd(_mm256_add_pd(s0, s2), _mm256_add_pd(s1, s3));
+    __m128d u = _mm_add_pd(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+    double sum = _mm_cvtsd_f64(u) + _mm_cvtsd_f64(_mm_unpackhi_pd(u, u));
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+NN_TARGET("avx2")
+static void multiplyAddAVX2(const double* a, const double* b, double* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        const double* as = a + start;
+        double* ys = y + start;
+        size_t m = 0;
+        for(; m + 4 <= count; m += 4){
+            _mm256_storeu_pd(ys + m, _mm256_add_pd(_mm256_loadu_pd(ys + m), _mm256_mul_pd(_mm256_loadu_pd(as + m), _mm256_loadu_pd(b + m))));
+        }
+        for(; m < count; m++){
+            ys[m] += as[m] * b[m];
+        }
+    }
+}
+
+template<OptimizerType T>
+NN_TARGET("avx2")
+static double optimizerAVX2(double* params, double* first, double* second, const double* x, double scale,
+                            const OptimizerStep& step, size_t n){
+    UpdateConstants c = updateConstants(step);
+    __m256d vScale = _mm256_set1_pd(scale);
+    __m256d vRate = _mm256_set1_pd(c.learningRate);
+    __m256d vBeta1 = _mm256_set1_pd(c.beta1);
+    __m256d vOneMinusBeta1 = _mm256_set1_pd(c.oneMinusBeta1);
+    __m256d vBeta2 = _mm256_set1_pd(c.beta2);
+    __m256d vOneMinusBeta2 = _mm256_set1_pd(c.oneMinusBeta2);
+    __m256d vEps = _mm256_set1_pd(c.epsilon);
+    __m256d vDecay = _mm256_set1_pd(c.weightDecay);
+    __m256d vMax = _mm256_set1_pd(c.maxRate);
+    __m256d vCorrection1 = _mm256_set1_pd(c.correction1);
+    __m256d vCorrection2 = _mm256_set1_pd(c.correction2);
+    __m256d vShrink = _mm256_set1_pd(c.shrink);
+    size_t i = 0;
+    //the last element always goes through optimizerElement, which reports its rate
+    for(; i + 4 < n; i += 4){
+        __m256d p = _mm256_loadu_pd(params + i);
+        __m256d g = _mm256_mul_pd(vScale, _mm256_loadu_pd(x + i));
+        if constexpr(T != OptimizerType::AdamW){
+            g = _mm256_add_pd(g, _mm256_mul_pd(vDecay, p));
+        }
+        if constexpr(T == OptimizerType::SGD){
+            p = _mm256_sub_pd(p, _mm256_mul_pd(vRate, g));
+        }else if constexpr(T == OptimizerType::Momentum){
+            __m256d m = _mm256_add_pd(_mm256_mul_pd(vBeta1, _mm256_loadu_pd(first + i)), g);
+            _mm256_storeu_pd(first + i, m);
+            p = _mm256_sub_pd(p, _mm256_mul_pd(vRate, m));
+        }else if constexpr(T == OptimizerType::RMSProp){
+            __m256d v = _mm256_loadu_pd(second + i);
+            __m256d rate = _mm256_min_pd(vMax, _mm256_div_pd(vRate, _mm256_add_pd(_mm256_sqrt_pd(v), vEps)));
+            p = _mm256_sub_pd(p, _mm256_mul_pd(rate, g));
+            _mm256_storeu_pd(second + i, _mm256_add_pd(_mm256_mul_pd(vBeta2, v), _mm256_mul_pd(vOneMinusBeta2, _mm256_mul_pd(g, g))));
+        }else{
+            __m256d m = _mm256_add_pd(_mm256_mul_pd(vBeta1, _mm256_loadu_pd(first + i)), _mm256_mul_pd(vOneMinusBeta1, g));
+            __m256d v = _mm256_add_pd(_mm256_mul_pd(vBeta2, _mm256_loadu_pd(second + i)), _mm256_mul_pd(vOneMinusBeta2, _mm256_mul_pd(g, g)));
+            _mm256_storeu_pd(first + i, m);
+            _mm256_storeu_pd(second + i, v);
+            __m256d rate = _mm256_min_pd(vMax, _mm256_div_pd(vRate, _mm256_add_pd(_mm256_sqrt_pd(_mm256_mul_pd(v, vCorrection2)), vEps)));
+            if constexpr(T == OptimizerType::AdamW){
+                p = _mm256_mul_pd(p, vShrink);
+            }
+            p = _mm256_sub_pd(p, _mm256_mul_pd(rate, _mm256_mul_pd(m, vCorrection1)));
+        }
+        _mm256_storeu_pd(params + i, p);
+    }
+    double rate = 0.0;
+    for(; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+NN_TARGET("avx2")
+static inline __m256d reluAVX2(__m256d v, __m256d& der){
+    __m256d negative = _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_LT_OQ);
+    der = _mm256_andnot_pd(negative, _mm256_set1_pd(1.0));
+    return _mm256_andnot_pd(negative, v);
+}
+
+NN_TARGET("avx2")
+static inline __m256d leakyReluAVX2(__m256d v, __m256d& der){
+    __m256d slope = _mm256_set1_pd(LEAKY_SLOPE);
+    __m256d negative = _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_LT_OQ);
+    der = _mm256_blendv_pd(_mm256_set1_pd(1.0), slope, negative);
+    return _mm256_blendv_pd(v, _mm256_mul_pd(slope, v), negative);
+}
+
+NN_TARGET("avx2")
+static inline __m256d tanhAVX2(__m256d v, __m256d& der){
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x((long long)ABS_MASK));
+    __m256d signMask = _mm256_castsi256_pd(_mm256_set1_epi64x((long long)SIGN_MASK));
+    __m256d a = _mm256_min_pd(_mm256_and_pd(v, absMask), _mm256_set1_pd(TANH_CLAMP));
+    __m256d a2 = _mm256_add_pd(a, a);
+    __m256d t = _mm256_add_pd(_mm256_mul_pd(a2, _mm256_set1_pd(LOG2E)), magic);
+    __m256d k = _mm256_sub_pd(t, magic);
+    __m256d r = _mm256_sub_pd(_mm256_sub_pd(a2, _mm256_mul_pd(k, _mm256_set1_pd(LN2_HI))), _mm256_mul_pd(k, _mm256_set1_pd(LN2_LO)));
+    __m256d q = _mm256_set1_pd(EXPM1_COEFFS[0]);
+    for(int c = 1; c < EXPM1_TERMS - 1; c++){
+        q = _mm256_add_pd(_mm256_mul_pd(q, r), _mm256_set1_pd(EXPM1_COEFFS[c]));
+    }
+    q = _mm256_add_pd(_mm256_mul_pd(q, r), one);
+    __m256d p = _mm256_mul_pd(q, r);
+    __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023)), 52));
+    __m256d em1 = _mm256_add_pd(_mm256_mul_pd(scale, p), _mm256_sub_pd(scale, one));
+    __m256d th = _mm256_div_pd(em1, _mm256_add_pd(em1, _mm256_set1_pd(2.0)));
+    th = _mm256_or_pd(th, _mm256_and_pd(v, signMask));
+    der = _mm256_sub_pd(one, _mm256_mul_pd(th, th));
+    return th;
+}
+
+NN_TARGET("avx2")
+static inline __m256d expFastAVX2(__m256d x){
+    __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    __m256d t = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)), magic);
+    __m256d k = _mm256_sub_pd(t, magic);
+    __m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(LN2_HI))), _mm256_mul_pd(k, _mm256_set1_pd(LN2_LO)));
+    __m256d q = _mm256_set1_pd(FAST_EXP_COEFFS[0]);
+    for(int c = 1; c < FAST_EXP_TERMS; c++){
+        q = _mm256_add_pd(_mm256_mul_pd(q, r), _mm256_set1_pd(FAST_EXP_COEFFS[c]));
+    }
+    __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023)), 52));
+    return _mm256_mul_pd(q, scale);
+}
+
+NN_TARGET("avx2")
+static inline __m256d tanhFastAVX2(__m256d v, __m256d& der){
+    __m256d x = _mm256_min_pd(_mm256_max_pd(v, _mm256_set1_pd(-FAST_TANH_CLAMP)), _mm256_set1_pd(FAST_TANH_CLAMP));
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d p = _mm256_set1_pd(FAST_TANH_P[0]);
+    for(int c = 1; c < FAST_TANH_P_TERMS; c++){
+        p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(FAST_TANH_P[c]));
+    }
+    __m256d q = _mm256_set1_pd(FAST_TANH_Q[0]);
+    for(int c = 1; c < FAST_TANH_Q_TERMS; c++){
+        q = _mm256_add_pd(_mm256_mul_pd(q, x2), _mm256_set1_pd(FAST_TANH_Q[c]));
+    }
+    __m256d th = _mm256_div_pd(_mm256_mul_pd(p, x), q);
+    der = _mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(th, th));
+    return th;
+}
+
+NN_TARGET("avx2")
+static inline __m256d sigmoidFastAVX2(__m256d v, __m256d& der){
+    __m256d half = _mm256_set1_pd(0.5);
+    __m256d th = tanhFastAVX2(_mm256_mul_pd(half, v), der);
+    __m256d s = _mm256_add_pd(half, _mm256_mul_pd(half, th));
+    der = _mm256_mul_pd(s, _mm256_sub_pd(_mm256_set1_pd(1.0), s));
+    return s;
+}
+
+NN_TARGET("avx2")
+static inline __m256d geluFastAVX2(__m256d v, __m256d& der){
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x((long long)ABS_MASK));
+    __m256d a = _mm256_min_pd(_mm256_and_pd(v, absMask), _mm256_set1_pd(FAST_GELU_CLAMP));
+    __m256d t = _mm256_div_pd(one, _mm256_add_pd(one, _mm256_mul_pd(_mm256_set1_pd(FAST_ERF_P), _mm256_mul_pd(a, _mm256_set1_pd(INV_SQRT2)))));
+    __m256d poly = _mm256_set1_pd(FAST_ERF_A[0]);
+    for(int c = 1; c < FAST_ERF_TERMS; c++){
+        poly = _mm256_add_pd(_mm256_mul_pd(poly, t), _mm256_set1_pd(FAST_ERF_A[c]));
+    }
+    poly = _mm256_mul_pd(poly, t);
+    __m256d e = expFastAVX2(_mm256_mul_pd(_mm256_mul_pd(a, a), _mm256_set1_pd(-0.5)));
+    __m256d tail = _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(poly, e));
+    __m256d negative = _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_LT_OQ);
+    __m256d cdf = _mm256_blendv_pd(_mm256_sub_pd(one, tail), tail, negative);
+    der = _mm256_add_pd(cdf, _mm256_mul_pd(v, _mm256_mul_pd(_mm256_set1_pd(INV_SQRT_2PI), e)));
+    return _mm256_mul_pd(v, cdf);
+}
+
+NN_TARGET("avx2")
+static inline __m256d softplusFastAVX2(__m256d v, __m256d& der){
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x((long long)ABS_MASK));
+    __m256d signMask = _mm256_castsi256_pd(_mm256_set1_epi64x((long long)SIGN_MASK));
+    __m256d a = _mm256_min_pd(_mm256_and_pd(v, absMask), _mm256_set1_pd(FAST_EXP_CLAMP));
+    __m256d u = expFastAVX2(_mm256_xor_pd(a, signMask));
+    __m256d s = _mm256_div_pd(u, _mm256_add_pd(u, _mm256_set1_pd(2.0)));
+    __m256d s2 = _mm256_mul_pd(s, s);
+    __m256d q = _mm256_set1_pd(FAST_LOG1P_COEFFS[0]);
+    for(int c = 1; c < FAST_LOG1P_TERMS; c++){
+        q = _mm256_add_pd(_mm256_mul_pd(q, s2), _mm256_set1_pd(FAST_LOG1P_COEFFS[c]));
+    }
+    __m256d negative = _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_LT_OQ);
+    der = _mm256_div_pd(_mm256_blendv_pd(one, u, negative), _mm256_add_pd(one, u));
+    return _mm256_add_pd(_mm256_max_pd(v, _mm256_setzero_pd()), _mm256_mul_pd(_mm256_add_pd(s, s), q));
+}
+
+template<ActivationType T>
+NN_TARGET("avx2")
+static inline __m256d activationAVX2(__m256d v, __m256d& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluAVX2(v, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhAVX2(v, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::Softmax){
+        der = _mm256_set1_pd(1.0);
+        return v;
+    }else{
+        return leakyReluAVX2(v, der);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx2")
+static void activationVecAVX2(const double* z, double* act, double* der, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 4 <= n; i += 4){
+            __m256d d;
+            __m256d a = activationAVX2<T>(_mm256_loadu_pd(z + i), d);
+            _mm256_storeu_pd(act + i, a);
+            _mm256_storeu_pd(der + i, d);
+        }
+    }
+    for(; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx2")
+static void biasActivationAVX2(const double* bias, double* z, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 4 <= n; i += 4){
+            __m256d d;
+            _mm256_storeu_pd(z + i, activationAVX2<T>(_mm256_add_pd(_mm256_loadu_pd(z + i), _mm256_loadu_pd(bias + i)), d));
+        }
+    }
+    double der;
+    for(; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+//---------------------------------------------------------------- AVX-512
+
+NN_TARGET("avx512f")
+static double dotAVX512(const double* a, const double* b, size_t n){
+    __m512d s0 = _mm512_setzero_pd();
+    __m512d s1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        s0 = _mm512_add_pd(s0, _mm512_mul_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+        s1 = _mm512_add_pd(s1, _mm512_mul_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8)));
+    }
+    __m512d v = _mm512_add_pd(s0, s1);
+    __m256d t = _mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1));
+    __m128d u = _mm_add_pd(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+    double sum = _mm_cvtsd_f64(u) + _mm_cvtsd_f64(_mm_unpackhi_pd(u, u));
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+NN_TARGET("avx512f")
+static void axpyAVX512(double alpha, const double* x, double* y, size_t n){
+    __m512d va = _mm512_set1_pd(alpha);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8){
+        _mm512_storeu_pd(y + i, _mm512_add_pd(_mm512_loadu_pd(y + i), _mm512_mul_pd(va, _mm512_loadu_pd(x + i))));
+    }
+    for(; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+NN_TARGET("avx512f")
+static double sparseDotAVX512(const double* values, const int32_t* columns, const double* x, size_t n){
+    __m512d s0 = _mm512_setzero_pd();
+    __m512d s1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m512d x0 = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(columns + i)), x, 8);
+        __m512d x1 = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(columns + i + 8)), x, 8);
+        s0 = _mm512_add_pd(s0, _mm512_mul_pd(_mm512_loadu_pd(values + i), x0));
+        s1 = _mm512_add_pd(s1, _mm512_mul_pd(_mm512_loadu_pd(values + i + 8), x1));
+    }
+    __m512d v = _mm512_add_pd(s0, s1);
+    __m256d t = _mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1));
+    __m128d u = _mm_add_pd(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+    double sum = _mm_cvtsd_f64(u) + _mm_cvtsd_f64(_mm_unpackhi_pd(u, u));
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+NN_TARGET("avx512f")
+static void multiplyAddAVX512(const double* a, const double* b, double* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        const double* as = a + start;
+        double* ys = y + start;
+        size_t m = 0;
+        for(; m + 8 <= count; m += 8){
+            _mm512_storeu_pd(ys + m, _mm512_add_pd(_mm512_loadu_pd(ys + m), _mm512_mul_pd(_mm512_loadu_pd(as + m), _mm512_loadu_pd(b + m))));
+        }
+        for(; m < count; m++){
+            ys[m] += as[m] * b[m];
+        }
+    }
+}
+
+//gather, add and scatter back, safe because the columns of a row are distinct
+NN_TARGET("avx512f")
+static void sparseAxpyAVX512(double alpha, const double* values, const int32_t* columns, double* y, size_t n){
+    __m512d va = _mm512_set1_pd(alpha);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256i index = _mm256_loadu_si256((const __m256i*)(columns + i));
+        __m512d sum = _mm512_add_pd(_mm512_i32gather_pd(index, y, 8), _mm512_mul_pd(va, _mm512_loadu_pd(values + i)));
+        _mm512_i32scatter_pd(y, index, sum, 8);
+    }
+    for(; i < n; i++){
+        y[columns[i]] += alpha * values[i];
+    }
+}
+
+template<OptimizerType T>
+NN_TARGET("avx512f")
+static double optimizerAVX512(double* params, double* first, double* second, const double* x, double scale,
+                              const OptimizerStep& step, size_t n){
+    UpdateConstants c = updateConstants(step);
+    __m512d vScale = _mm512_set1_pd(scale);
+    __m512d vRate = _mm512_set1_pd(c.learningRate);
+    __m512d vBeta1 = _mm512_set1_pd(c.beta1);
+    __m512d vOneMinusBeta1 = _mm512_set1_pd(c.oneMinusBeta1);
+    __m512d vBeta2 = _mm512_set1_pd(c.beta2);
+    __m512d vOneMinusBeta2 = _mm512_set1_pd(c.oneMinusBeta2);
+    __m512d vEps = _mm512_set1_pd(c.epsilon);
+    __m512d vDecay = _mm512_set1_pd(c.weightDecay);
+    __m512d vMax = _mm512_set1_pd(c.maxRate);
+    __m512d vCorrection1 = _mm512_set1_pd(c.correction1);
+    __m512d vCorrection2 = _mm512_set1_pd(c.correction2);
+    __m512d vShrink = _mm512_set1_pd(c.shrink);
+    size_t i = 0;
+    //the last element always goes through optimizerElement, which reports its rate
+    for(; i + 8 < n; i += 8){
+        __m512d p = _mm512_loadu_pd(params + i);
+        __m512d g = _mm512_mul_pd(vScale, _mm512_loadu_pd(x + i));
+        if constexpr(T != OptimizerType::AdamW){
+            g = _mm512_add_pd(g, _mm512_mul_pd(vDecay, p));
+        }
+        if constexpr(T == OptimizerType::SGD){
+            p = _mm512_sub_pd(p, _mm512_mul_pd(vRate, g));
+        }else if constexpr(T == OptimizerType::Momentum){
+            __m512d m = _mm512_add_pd(_mm512_mul_pd(vBeta1, _mm512_loadu_pd(first + i)), g);
+            _mm512_storeu_pd(first + i, m);
+            p = _mm512_sub_pd(p, _mm512_mul_pd(vRate, m));
+        }else if constexpr(T == OptimizerType::RMSProp){
+            __m512d v = _mm512_loadu_pd(second + i);
+            __m512d rate = _mm512_min_pd(vMax, _mm512_div_pd(vRate, _mm512_add_pd(_mm512_sqrt_pd(v), vEps)));
+            p = _mm512_sub_pd(p, _mm512_mul_pd(rate, g));
+            _mm512_storeu_pd(second + i, _mm512_add_pd(_mm512_mul_pd(vBeta2, v), _mm512_mul_pd(vOneMinusBeta2, _mm512_mul_pd(g, g))));
+        }else{
+            __m512d m = _mm512_add_pd(_mm512_mul_pd(vBeta1, _mm512_loadu_pd(first + i)), _mm512_mul_pd(vOneMinusBeta1, g));
+            __m512d v = _mm512_add_pd(_mm512_mul_pd(vBeta2, _mm512_loadu_pd(second + i)), _mm512_mul_pd(vOneMinusBeta2, _mm512_mul_pd(g, g)));
+            _mm512_storeu_pd(first + i, m);
+            _mm512_storeu_pd(second + i, v);
+            __m512d rate = _mm512_min_pd(vMax, _mm512_div_pd(vRate, _mm512_add_pd(_mm512_sqrt_pd(_mm512_mul_pd(v, vCorrection2)), vEps)));
+            if constexpr(T == OptimizerType::AdamW){
+                p = _mm512_mul_pd(p, vShrink);
+            }
+            p = _mm512_sub_pd(p, _mm512_mul_pd(rate, _mm512_mul_pd(m, vCorrection1)));
+        }
+        _mm512_storeu_pd(params + i, p);
+    }
+    double rate = 0.0;
+    for(; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+NN_TARGET("avx512f")
+static inline __m512d reluAVX512(__m512d v, __m512d& der){
+    __m512d zero = _mm512_setzero_pd();
+    __mmask8 negative = _mm512_cmp_pd_mask(v, zero, _CMP_LT_OQ);
+    der = _mm512_mask_blend_pd(negative, _mm512_set1_pd(1.0), zero);
+    return _mm512_mask_blend_pd(negative, v, zero);
+}
+
+NN_TARGET("avx512f")
+static inline __m512d leakyReluAVX512(__m512d v, __m512d& der){
+    __m512d slope = _mm512_set1_pd(LEAKY_SLOPE);
+    __mmask8 negative = _mm512_cmp_pd_mask(v, _mm512_setzero_pd(), _CMP_LT_OQ);
+    der = _mm512_mask_blend_pd(negative, _mm512_set1_pd(1.0), slope);
+    return _mm512_mask_blend_pd(negative, v, _mm512_mul_pd(slope, v));
+}
+
+NN_TARGET("avx512f")
+static inline __m512d tanhAVX512(__m512d v, __m512d& der){
+    __m512d one = _mm512_set1_pd(1.0);
+    __m512d magic = _mm512_set1_pd(ROUND_MAGIC);
+    __m512i vBits = _mm512_castpd_si512(v);
+    __m512d a = _mm512_castsi512_pd(_mm512_and_epi64(vBits, _mm512_set1_epi64((long long)ABS_MASK)));
+    a = _mm512_min_pd(a, _mm512_set1_pd(TANH_CLAMP));
+    __m512d a2 = _mm512_add_pd(a, a);
+    __m512d t = _mm512_add_pd(_mm512_mul_pd(a2, _mm512_set1_pd(LOG2E)), magic);
+    __m512d k = _mm512_sub_pd(t, magic);
+    __m512d r = _mm512_sub_pd(_mm512_sub_pd(a2, _mm512_mul_pd(k, _mm512_set1_pd(LN2_HI))), _mm512_mul_pd(k, _mm512_set1_pd(LN2_LO)));
+    __m512d q = _mm512_set1_pd(EXPM1_COEFFS[0]);
+    for(int c = 1; c < EXPM1_TERMS - 1; c++){
+        q = _mm512_add_pd(_mm512_mul_pd(q, r), _mm512_set1_pd(EXPM1_COEFFS[c]));
+    }
+    q = _mm512_add_pd(_mm512_mul_pd(q, r), one);
+    __m512d p = _mm512_mul_pd(q, r);
+    __m512d scale = _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64(_mm512_castpd_si512(t), _mm512_set1_epi64(1023)), 52));
+    __m512d em1 = _mm512_add_pd(_mm512_mul_pd(scale, p), _mm512_sub_pd(scale, one));
+    __m512d th = _mm512_div_pd(em1, _mm512_add_pd(em1, _mm512_set1_pd(2.0)));
+    __m512i sign = _mm512_and_epi64(vBits, _mm512_set1_epi64((long long)SIGN_MASK));
+    th = _mm512_castsi512_pd(_mm512_or_epi64(_mm512_castpd_si512(th), sign));
+    der = _mm512_sub_pd(one, _mm512_mul_pd(th, th));
+    return th;
+}
+
+NN_TARGET("avx512f")
+static inline __m512d expFastAVX512(__m512d x){
+    __m512d magic = _mm512_set1_pd(ROUND_MAGIC);
+    __m512d t = _mm512_add_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2E)), magic);
+    __m512d k = _mm512_sub_pd(t, magic);
+    __m512d r = _mm512_sub_pd(_mm512_sub_pd(x, _mm512_mul_pd(k, _mm512_set1_pd(LN2_HI))), _mm512_mul_pd(k, _mm512_set1_pd(LN2_LO)));
+    __m512d q = _mm512_set1_pd(FAST_EXP_COEFFS[0]);
+    for(int c = 1; c < FAST_EXP_TERMS; c++){
+        q = _mm512_add_pd(_mm512_mul_pd(q, r), _mm512_set1_pd(FAST_EXP_COEFFS[c]));
+    }
+    __m512d scale = _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64(_mm512_castpd_si512(t), _mm512_set1_epi64(1023)), 52));
+    return _mm512_mul_pd(q, scale);
+}
+
+NN_TARGET("avx512f")
+static inline __m512d tanhFastAVX512(__m512d v, __m512d& der){
+    __m512d x = _mm512_min_pd(_mm512_max_pd(v, _mm512_set1_pd(-FAST_TANH_CLAMP)), _mm512_set1_pd(FAST_TANH_CLAMP));
+    __m512d x2 = _mm512_mul_pd(x, x);
+    __m512d p = _mm512_set1_pd(FAST_TANH_P[0]);
+    for(int c = 1; c < FAST_TANH_P_TERMS; c++){
+        p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(FAST_TANH_P[c]));
+    }
+    __m512d q = _mm512_set1_pd(FAST_TANH_Q[0]);
+    for(int c = 1; c < FAST_TANH_Q_TERMS; c++){
+        q = _mm512_add_pd(_mm512_mul_pd(q, x2), _mm512_set1_pd(FAST_TANH_Q[c]));
+    }
+    __m512d th = _mm512_div_pd(_mm512_mul_pd(p, x), q);
+    der = _mm512_sub_pd(_mm512_set1_pd(1.0), _mm512_mul_pd(th, th));
+    return th;
+}
+
+NN_TARGET("avx512f")
+static inline __m512d sigmoidFastAVX512(__m512d v, __m512d& der){
+    __m512d half = _mm512_set1_pd(0.5);
+    __m512d th = tanhFastAVX512(_mm512_mul_pd(half, v), der);
+    __m512d s = _mm512_add_pd(half, _mm512_mul_pd(half, th));
+    der = _mm512_mul_pd(s, _mm512_sub_pd(_mm512_set1_pd(1.0), s));
+    return s;
+}
+
+NN_TARGET("avx512f")
+static inline __m512d geluFastAVX512(__m512d v, __m512d& der){
+    __m512d one = _mm512_set1_pd(1.0);
+    __m512d a = _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(v), _mm512_set1_epi64((long long)ABS_MASK)));
+    a = _mm512_min_pd(a, _mm512_set1_pd(FAST_GELU_CLAMP));
+    __m512d t = _mm512_div_pd(one, _mm512_add_pd(one, _mm512_mul_pd(_mm512_set1_pd(FAST_ERF_P), _mm512_mul_pd(a, _mm512_set1_pd(INV_SQRT2)))));
+    __m512d poly = _mm512_set1_pd(FAST_ERF_A[0]);
+    for(int c = 1; c < FAST_ERF_TERMS; c++){
+        poly = _mm512_add_pd(_mm512_mul_pd(poly, t), _mm512_set1_pd(FAST_ERF_A[c]));
+    }
+    poly = _mm512_mul_pd(poly, t);
+    __m512d e = expFastAVX512(_mm512_mul_pd(_mm512_mul_pd(a, a), _mm512_set1_pd(-0.5)));
+    __m512d tail = _mm512_mul_pd(_mm512_set1_pd(0.5), _mm512_mul_pd(poly, e));
+    __mmask8 negative = _mm512_cmp_pd_mask(v, _mm512_setzero_pd(), _CMP_LT_OQ);
+    __m512d cdf = _mm512_mask_blend_pd(negative, _mm512_sub_pd(one, tail), tail);
+    der = _mm512_add_pd(cdf, _mm512_mul_pd(v, _mm512_mul_pd(_mm512_set1_pd(INV_SQRT_2PI), e)));
+    return _mm512_mul_pd(v, cdf);
+}
+
+NN_TARGET("avx512f")
+static inline __m512d softplusFastAVX512(__m512d v, __m512d& der){
+    __m512d one = _mm512_set1_pd(1.0);
+    __m512d a = _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(v), _mm512_set1_epi64((long long)ABS_MASK)));
+    a = _mm512_min_pd(a, _mm512_set1_pd(FAST_EXP_CLAMP));
+    __m512d u = expFastAVX512(_mm512_castsi512_pd(_mm512_xor_epi64(_mm512_castpd_si512(a), _mm512_set1_epi64((long long)SIGN_MASK))));
+    __m512d s = _mm512_div_pd(u, _mm512_add_pd(u, _mm512_set1_pd(2.0)));
+    __m512d s2 = _mm512_mul_pd(s, s);
+    __m512d q = _mm512_set1_pd(FAST_LOG1P_COEFFS[0]);
+    for(int c = 1; c < FAST_LOG1P_TERMS; c++){
+        q = _mm512_add_pd(_mm512_mul_pd(q, s2), _mm512_set1_pd(FAST_LOG1P_COEFFS[c]));
+    }
+    __mmask8 negative = _mm512_cmp_pd_mask(v, _mm512_setzero_pd(), _CMP_LT_OQ);
+    der = _mm512_div_pd(_mm512_mask_blend_pd(negative, one, u), _mm512_add_pd(one, u));
+    return _mm512_add_pd(_mm512_max_pd(v, _mm512_setzero_pd()), _mm512_mul_pd(_mm512_add_pd(s, s), q));
+}
+
+template<ActivationType T>
+NN_TARGET("avx512f")
+static inline __m512d activationAVX512(__m512d v, __m512d& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluAVX512(v, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhAVX512(v, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::Softmax){
+        der = _mm512_set1_pd(1.0);
+        return v;
+    }else{
+        return leakyReluAVX512(v, der);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx512f")
+static void activationVecAVX512(const double* z, double* act, double* der, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 8 <= n; i += 8){
+            __m512d d;
+            __m512d a = activationAVX512<T>(_mm512_loadu_pd(z + i), d);
+            _mm512_storeu_pd(act + i, a);
+            _mm512_storeu_pd(der + i, d);
+        }
+    }
+    for(; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx512f")
+static void biasActivationAVX512(const double* bias, double* z, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 8 <= n; i += 8){
+            __m512d d;
+            _mm512_storeu_pd(z + i, activationAVX512<T>(_mm512_add_pd(_mm512_loadu_pd(z + i), _mm512_loadu_pd(bias + i)), d));
+        }
+    }
+    double der;
+    for(; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+#endif // NN_X86
+
+//---------------------------------------------------------------- dispatch
+
+//instantiates one activation kernel per ActivationType for the given ISA
+#define ACTIVATION_KERNELS(fn) {fn<ActivationType::LeakyRelu>, fn<ActivationType::Relu>, fn<ActivationType::Tanh>, \
+                                fn<ActivationType::Softmax>, fn<ActivationType::Sigmoid>, fn<ActivationType::Gelu>, \
+                                fn<ActivationType::Softplus>, fn<ActivationType::TanhFast>, \
+                                fn<ActivationType::SigmoidFast>, fn<ActivationType::GeluFast>, \
+                                fn<ActivationType::SoftplusFast>}
+//and one optimizer kernel per OptimizerType
+#define OPTIMIZER_KERNELS(fn) {fn<OptimizerType::SGD>, fn<OptimizerType::Momentum>, fn<OptimizerType::RMSProp>, \
+                               fn<OptimizerType::Adam>, fn<OptimizerType::AdamW>}
+
+static KernelTable makeKernelTable(KernelISA isa){
+    KernelTable table = {KernelISA::Scalar, "scalar", dotScalar, axpyScalar, sparseDotScalar, sparseAxpyScalar, multiplyAddScalar,
+                         OPTIMIZER_KERNELS(optimizerScalar), ACTIVATION_KERNELS(activationVecScalar),
+                         ACTIVATION_KERNELS(biasActivationScalar)};
+#ifdef NN_X86
+    if(isa == KernelISA::SSE2){
+        table = {isa, "sse2", dotSSE2, axpySSE2, sparseDotSSE2, sparseAxpyScalar, multiplyAddSSE2,
+                 OPTIMIZER_KERNELS(optimizerSSE2), ACTIVATION_KERNELS(activationVecSSE2), ACTIVATION_KERNELS(biasActivationSSE2)};
+    }else if(isa == KernelISA::AVX2){
+        table = {isa, "avx2", dotAVX2, axpyAVX2, sparseDotAVX2, sparseAxpyScalar, multiplyAddAVX2,
+                 OPTIMIZER_KERNELS(optimizerAVX2), ACTIVATION_KERNELS(activationVecAVX2), ACTIVATION_KERNELS(biasActivationAVX2)};
+    }else if(isa == KernelISA::AVX512){
+        table = {isa, "avx512", dotAVX512, axpyAVX512, sparseDotAVX512, sparseAxpyAVX512, multiplyAddAVX512,
+                 OPTIMIZER_KERNELS(optimizerAVX512), ACTIVATION_KERNELS(activationVecAVX512),
+                 ACTIVATION_KERNELS(biasActivationAVX512)};
+    }
+#endif
+    return table;
+}
+
+#ifdef NN_X86
+static bool cpuSupports(KernelISA isa){
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex(info, 7, 0);
+    switch(isa){
+        case KernelISA::SSE2: return true;
+        case KernelISA::AVX2: return avx && (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+        case KernelISA::AVX512: return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0;
+        default: return true;
+    }
+#else
+    __builtin_cpu_init();
+    switch(isa){
+        case KernelISA::SSE2: return __builtin_cpu_supports("sse2");
+        case KernelISA::AVX2: return __builtin_cpu_supports("avx2");
+        case KernelISA::AVX512: return __builtin_cpu_supports("avx512f");
+        default: return true;
+    }
+#endif
+}
+
+//AVX-512 VNNI (vpdpbusd), only used on top of the AVX-512 kernels
+static bool cpuSupportsVNNI(){
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuidex(info, 7, 0);
+    return cpuSupports(KernelISA::AVX512) && (info[2] & (1 << 11)) != 0;
+#else
+    __builtin_cpu_init();
+    return cpuSupports(KernelISA::AVX512) && __builtin_cpu_supports("avx512vnni");
+#endif
+}
+#else
+static bool cpuSupports(KernelISA isa){
+    return isa == KernelISA::Scalar;
+}
+static bool cpuSupportsVNNI(){
+    return false;
+}
+#endif
+
+KernelISA detectKernelISA(){
+    if(cpuSupports(KernelISA::AVX512)){
+        return KernelISA::AVX512;
+    }
+    if(cpuSupports(KernelISA::AVX2)){
+        return KernelISA::AVX2;
+    }
+    if(cpuSupports(KernelISA::SSE2)){
+        return KernelISA::SSE2;
+    }
+    return KernelISA::Scalar;
+}
+
+static KernelTable& activeKernels(){
+    static KernelTable table = makeKernelTable(detectKernelISA());
+    return table;
+}
+static KernelTableF& activeKernelsF(){
+    static KernelTableF table = makeKernelTableF(detectKernelISA());
+    return table;
+}
+
+static IntegerKernelTable& activeIntegerKernels(){
+    static IntegerKernelTable table = makeIntegerKernelTable(detectKernelISA(), cpuSupportsVNNI());
+    return table;
+}
+
+const KernelTable& kernels(){
+    return activeKernels();
+}
+const KernelTableF& kernelsF(){
+    return activeKernelsF();
+}
+const IntegerKernelTable& integerKernels(){
+    return activeIntegerKernels();
+}
+
+bool setKernelISA(KernelISA isa){
+    if(!cpuSupports(isa)){
+        return false;
+    }
+    activeKernels() = makeKernelTable(isa);
+    activeKernelsF() = makeKernelTableF(isa);
+    activeIntegerKernels() = makeIntegerKernelTable(isa, isa == KernelISA::AVX512 && cpuSupportsVNNI());
+    return true;
+}
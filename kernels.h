@@ -0,0 +1,111 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "activation_functions.h"
+#include "optimizer.h"
+
+//instruction sets the hot loops can run on. The best supported one is picked
+//once at startup from CPUID, every ISA produces bitwise identical results to
+//the scalar path (same summation order, no fused multiply-add)
+enum class KernelISA {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+//writes activation values and derivatives for n pre-activations.
+//z may alias act, each element is read before it is written
+template<typename Scalar>
+using ActivationKernelT = void (*)(const Scalar* z, Scalar* act, Scalar* der, size_t n);
+//z = activation(z + bias) in place, without derivatives
+template<typename Scalar>
+using BiasActivationKernelT = void (*)(const Scalar* bias, Scalar* z, size_t n);
+
+//one fused update of n parameters with gradient[i] = scale * x[i], reading and
+//writing the optimizer state in the same pass. first and second are the
+//moment arrays (see optimizer.h) and may be null for rules that do not use
+//them. Returns the rate used for the last element for printing
+template<typename Scalar>
+using OptimizerKernelT = Scalar (*)(Scalar* params, Scalar* first, Scalar* second, const Scalar* x, Scalar scale,
+                                    const OptimizerStep& step, size_t n);
+
+typedef ActivationKernelT<double> ActivationKernel;
+typedef BiasActivationKernelT<double> BiasActivationKernel;
+typedef OptimizerKernelT<double> OptimizerKernel;
+
+//one table per scalar type. The float kernels follow the same rules as the
+//double ones, so float results are also identical on every ISA
+template<typename Scalar>
+struct KernelTableT {
+    KernelISA isa;
+    const char* name;
+
+    //sum of a[i] * b[i]
+    Scalar (*dot)(const Scalar* a, const Scalar* b, size_t n);
+    //y[i] += alpha * x[i]
+    void (*axpy)(Scalar alpha, const Scalar* x, Scalar* y, size_t n);
+    //the same two for one row of a CSR matrix (n kept values and their
+    //columns) against a dense vector: sum of values[i] * x[columns[i]], and
+    //y[columns[i]] += alpha * values[i]. The columns must be distinct
+    Scalar (*sparseDot)(const Scalar* values, const int32_t* columns, const Scalar* x, size_t n);
+    void (*sparseAxpy)(Scalar alpha, const Scalar* values, const int32_t* columns, Scalar* y, size_t n);
+    //y[i] += a[i] * b[i % period], elementwise so every ISA rounds the same.
+    //period n multiplies two full vectors, a smaller one repeats b (see ensemble.h)
+    void (*multiplyAdd)(const Scalar* a, const Scalar* b, Scalar* y, size_t n, size_t period);
+    //one kernel per OptimizerType
+    OptimizerKernelT<Scalar> optimizer[OPTIMIZER_TYPE_COUNT];
+
+    //one kernel per ActivationType, each specialized at compile time
+    ActivationKernelT<Scalar> activation[ACTIVATION_TYPE_COUNT];
+    //fused versions for inference
+    BiasActivationKernelT<Scalar> biasActivation[ACTIVATION_TYPE_COUNT];
+};
+
+typedef KernelTableT<double> KernelTable;
+typedef KernelTableT<float> KernelTableF;
+
+//best ISA supported by this CPU and operating system
+KernelISA detectKernelISA();
+
+//currently selected kernels
+const KernelTable& kernels();
+const KernelTableF& kernelsF();
+
+//kernels() or kernelsF(), for code templated on the scalar type
+template<typename Scalar>
+const KernelTableT<Scalar>& kernelsFor();
+template<>
+inline const KernelTable& kernelsFor<double>(){
+    return kernels();
+}
+template<>
+inline const KernelTableF& kernelsFor<float>(){
+    return kernelsF();
+}
+
+//float kernels for one ISA, defined in kernels_float.cpp
+KernelTableF makeKernelTableF(KernelISA isa);
+
+//integer kernels of the int8 inference path (quantized.h). Integer sums are
+//exact, so every variant gives the same result without any ordering rules
+struct IntegerKernelTable {
+    const char* name;
+    //sum of a[i] * b[i] in int32, a unsigned and b signed. Exact for n up to
+    //66000, beyond that the sum can overflow
+    int32_t (*dotU8S8)(const uint8_t* a, const int8_t* b, size_t n);
+};
+
+//integer kernels for the selected ISA, using AVX-512 VNNI when the CPU has it
+const IntegerKernelTable& integerKernels();
+
+//defined in kernels_int8.cpp
+IntegerKernelTable makeIntegerKernelTable(KernelISA isa, bool vnni);
+
+//forces a specific ISA for both scalar types, mainly for comparing against the
+//scalar path. returns false and leaves the selection unchanged if the CPU lacks it
+bool setKernelISA(KernelISA isa);
+
+#endif // KERNELS_H
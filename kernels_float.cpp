@@ -0,0 +1,1306 @@
+#include "kernels.h"
+#include "simd_target.h"
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+//single precision versions of the kernels in kernels.cpp, built the same way:
+//a fixed number of partial sums reduced in a fixed tree and no fused
+//multiply-add, so every ISA gives bitwise identical float results.
+//dot products use 32 partial sums (element i goes to sum i % 32), twice as many
+//as the double kernels so one AVX-512 register still holds half of them
+static const float LEAKY_SLOPE = 0.01f;
+
+//same tanh as the double kernels with constants for float precision. tanh(10)
+//rounds to 1 in float, and 1/8! is the last term that still changes expm1 on
+//|r| <= ln2/2. Max error against std::tanh in float is 3 ulp on [-20, 20]
+static const float TANH_CLAMP = 10.0f;
+static const float LOG2E = 1.44269504f;
+//LN2_HI has its low 9 bits clear so k * LN2_HI is exact
+static const float LN2_HI = 0.693145751953125f;
+static const float LN2_LO = 1.42860682e-06f;
+static const float ROUND_MAGIC = 12582912.0f;
+static const int EXPM1_TERMS = 8;
+//1/k! for k = 8 down to 2, used in Horner order
+static const float EXPM1_COEFFS[EXPM1_TERMS - 1] = {
+    1.0f / 40320.0f, 1.0f / 5040.0f, 1.0f / 720.0f, 1.0f / 120.0f,
+    1.0f / 24.0f, 1.0f / 6.0f, 1.0f / 2.0f
+};
+static const uint32_t SIGN_MASK = 0x80000000u;
+static const uint32_t ABS_MASK = 0x7fffffffu;
+
+static inline uint32_t toBits(float value){
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+static inline float fromBits(uint32_t bits){
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//---------------------------------------------------------------- scalar
+
+static float dotScalar(const float* a, const float* b, size_t n){
+    float acc[32] = {0.0f};
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        for(int k = 0; k < 32; k++){
+            acc[k] += a[i + k] * b[i + k];
+        }
+    }
+    float v[16], w[8], t[4];
+    for(int k = 0; k < 16; k++){
+        v[k] = acc[k] + acc[k + 16];
+    }
+    for(int k = 0; k < 8; k++){
+        w[k] = v[k] + v[k + 8];
+    }
+    for(int k = 0; k < 4; k++){
+        t[k] = w[k] + w[k + 4];
+    }
+    float sum = (t[0] + t[2]) + (t[1] + t[3]);
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void axpyScalar(float alpha, const float* x, float* y, size_t n){
+    for(size_t i = 0; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+//dot of one CSR row with a dense vector, in the same order as dotScalar
+static float sparseDotScalar(const float* values, const int32_t* columns, const float* x, size_t n){
+    float acc[32] = {0.0f};
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        for(int k = 0; k < 32; k++){
+            acc[k] += values[i + k] * x[columns[i + k]];
+        }
+    }
+    float v[16], w[8], t[4];
+    for(int k = 0; k < 16; k++){
+        v[k] = acc[k] + acc[k + 16];
+    }
+    for(int k = 0; k < 8; k++){
+        w[k] = v[k] + v[k + 8];
+    }
+    for(int k = 0; k < 4; k++){
+        t[k] = w[k] + w[k + 4];
+    }
+    float sum = (t[0] + t[2]) + (t[1] + t[3]);
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+static void sparseAxpyScalar(float alpha, const float* values, const int32_t* columns, float* y, size_t n){
+    for(size_t i = 0; i < n; i++){
+        y[columns[i]] += alpha * values[i];
+    }
+}
+
+//b repeats every period elements, so a vector of per lane values scales every
+//group of lanes without being copied out to the full length
+static void multiplyAddScalar(const float* a, const float* b, float* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        for(size_t m = 0; m < count; m++){
+            y[start + m] += a[start + m] * b[m];
+        }
+    }
+}
+
+//an OptimizerStep converted once per call
+struct UpdateConstantsF {
+    float learningRate;
+    float beta1;
+    float oneMinusBeta1;
+    float beta2;
+    float oneMinusBeta2;
+    float epsilon;
+    float weightDecay;
+    float maxRate;
+    float correction1;
+    float correction2;
+    //AdamW's decoupled decay, weight *= 1 - learningRate * weightDecay
+    float shrink;
+};
+
+static inline UpdateConstantsF updateConstants(const OptimizerStep& step){
+    UpdateConstantsF c;
+    c.learningRate = (float)step.learningRate;
+    c.beta1 = (float)step.beta1;
+    c.oneMinusBeta1 = 1 - c.beta1;
+    c.beta2 = (float)step.beta2;
+    c.oneMinusBeta2 = 1 - c.beta2;
+    c.epsilon = (float)step.epsilon;
+    c.weightDecay = (float)step.weightDecay;
+    c.maxRate = (float)step.maxRate;
+    c.correction1 = (float)step.correction1;
+    c.correction2 = (float)step.correction2;
+    c.shrink = (float)(1.0 - step.learningRate * step.weightDecay);
+    return c;
+}
+
+//element i of update rule T with gradient g, returns the rate it used. The
+//vector kernels below do exactly the same operations in the same order
+template<OptimizerType T>
+static inline float optimizerElement(float* params, float* first, float* second, size_t i, float g, const UpdateConstantsF& c){
+    float p = params[i];
+    float rate = c.learningRate;
+    if constexpr(T != OptimizerType::AdamW){
+        g = g + c.weightDecay * p;
+    }
+    if constexpr(T == OptimizerType::SGD){
+        p = p - rate * g;
+    }else if constexpr(T == OptimizerType::Momentum){
+        float m = c.beta1 * first[i] + g;
+        first[i] = m;
+        p = p - rate * m;
+    }else if constexpr(T == OptimizerType::RMSProp){
+        float v = second[i];
+        rate = std::min(c.learningRate / (std::sqrt(v) + c.epsilon), c.maxRate);
+        p = p - rate * g;
+        second[i] = (c.beta2 * v) + (c.oneMinusBeta2 * (g * g));
+    }else{
+        float m = (c.beta1 * first[i]) + (c.oneMinusBeta1 * g);
+        float v = (c.beta2 * second[i]) + (c.oneMinusBeta2 * (g * g));
+        first[i] = m;
+        second[i] = v;
+        rate = std::min(c.learningRate / (std::sqrt(v * c.correction2) + c.epsilon), c.maxRate);
+        if constexpr(T == OptimizerType::AdamW){
+            p = p * c.shrink;
+        }
+        p = p - rate * (m * c.correction1);
+    }
+    params[i] = p;
+    return rate;
+}
+
+template<OptimizerType T>
+static float optimizerScalar(float* params, float* first, float* second, const float* x, float scale,
+                             const OptimizerStep& step, size_t n){
+    UpdateConstantsF c = updateConstants(step);
+    float rate = 0.0f;
+    for(size_t i = 0; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+static inline float reluScalar(float value, float& der){
+    bool negative = value < 0;
+    der = negative ? 0.0f : 1.0f;
+    return negative ? 0.0f : value;
+}
+static inline float leakyReluScalar(float value, float& der){
+    bool negative = value < 0;
+    der = negative ? LEAKY_SLOPE : 1.0f;
+    return negative ? LEAKY_SLOPE * value : value;
+}
+static inline float tanhScalar(float value, float& der){
+    float a = fromBits(toBits(value) & ABS_MASK);
+    a = std::min(a, TANH_CLAMP);
+    float a2 = a + a;
+    float t = a2 * LOG2E + ROUND_MAGIC;
+    float n = t - ROUND_MAGIC;
+    float r = (a2 - n * LN2_HI) - n * LN2_LO;
+    float q = EXPM1_COEFFS[0];
+    for(int k = 1; k < EXPM1_TERMS - 1; k++){
+        q = q * r + EXPM1_COEFFS[k];
+    }
+    q = q * r + 1.0f;
+    float p = q * r;
+    float scale = fromBits((toBits(t) + 127) << 23);
+    float em1 = scale * p + (scale - 1.0f);
+    float th = em1 / (em1 + 2.0f);
+    th = fromBits(toBits(th) | (toBits(value) & SIGN_MASK));
+    der = 1.0f - th * th;
+    return th;
+}
+
+//the fast approximations with the double constants rounded to float once, so
+//no expression is promoted to double
+static inline float expFastScalar(float x){
+    float t = x * LOG2E + ROUND_MAGIC;
+    float n = t - ROUND_MAGIC;
+    float r = (x - n * LN2_HI) - n * LN2_LO;
+    float q = (float)FAST_EXP_COEFFS[0];
+    for(int k = 1; k < FAST_EXP_TERMS; k++){
+        q = q * r + (float)FAST_EXP_COEFFS[k];
+    }
+    return q * fromBits((toBits(t) + 127) << 23);
+}
+static inline float tanhFastScalar(float value, float& der){
+    float x = std::min(std::max(value, (float)-FAST_TANH_CLAMP), (float)FAST_TANH_CLAMP);
+    float x2 = x * x;
+    float p = (float)FAST_TANH_P[0];
+    for(int k = 1; k < FAST_TANH_P_TERMS; k++){
+        p = p * x2 + (float)FAST_TANH_P[k];
+    }
+    float q = (float)FAST_TANH_Q[0];
+    for(int k = 1; k < FAST_TANH_Q_TERMS; k++){
+        q = q * x2 + (float)FAST_TANH_Q[k];
+    }
+    float th = (p * x) / q;
+    der = 1.0f - th * th;
+    return th;
+}
+static inline float sigmoidFastScalar(float value, float& der){
+    float th = tanhFastScalar(0.5f * value, der);
+    float s = 0.5f + 0.5f * th;
+    der = s * (1.0f - s);
+    return s;
+}
+static inline float geluFastScalar(float value, float& der){
+    float a = std::min(fromBits(toBits(value) & ABS_MASK), (float)FAST_GELU_CLAMP);
+    float t = 1.0f / (1.0f + (float)FAST_ERF_P * (a * (float)INV_SQRT2));
+    float poly = (float)FAST_ERF_A[0];
+    for(int k = 1; k < FAST_ERF_TERMS; k++){
+        poly = poly * t + (float)FAST_ERF_A[k];
+    }
+    poly = poly * t;
+    float e = expFastScalar((a * a) * -0.5f);
+    float tail = 0.5f * (poly * e);
+    float cdf = value < 0 ? tail : 1.0f - tail;
+    der = cdf + value * ((float)INV_SQRT_2PI * e);
+    return value * cdf;
+}
+static inline float softplusFastScalar(float value, float& der){
+    float u = expFastScalar(-std::min(fromBits(toBits(value) & ABS_MASK), (float)FAST_EXP_CLAMP));
+    float s = u / (u + 2.0f);
+    float s2 = s * s;
+    float q = (float)FAST_LOG1P_COEFFS[0];
+    for(int k = 1; k < FAST_LOG1P_TERMS; k++){
+        q = q * s2 + (float)FAST_LOG1P_COEFFS[k];
+    }
+    der = (value < 0 ? u : 1.0f) / (1.0f + u);
+    return std::max(value, 0.0f) + (s + s) * q;
+}
+
+template<ActivationType T>
+static inline float activationScalar(float value, float& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluScalar(value, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhScalar(value, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastScalar(value, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastScalar(value, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastScalar(value, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastScalar(value, der);
+    }else if constexpr(usesLibm(T)){
+        ActivationResultT<float> result = applyActivation(T, value);
+        der = result.derivative;
+        return result.activatedValue;
+    }else if constexpr(T == ActivationType::Softmax){
+        //logits pass through, softmax runs over the whole layer afterwards
+        der = 1.0f;
+        return value;
+    }else{
+        return leakyReluScalar(value, der);
+    }
+}
+
+template<ActivationType T>
+static void activationVecScalar(const float* z, float* act, float* der, size_t n){
+    for(size_t i = 0; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+template<ActivationType T>
+static void biasActivationScalar(const float* bias, float* z, size_t n){
+    float der;
+    for(size_t i = 0; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+#ifdef NN_X86
+//---------------------------------------------------------------- SSE2
+
+//last two steps of the reduction tree, t holds the four partial sums t[0..3]
+NN_TARGET("sse2")
+static inline float reduceSSE2(__m128 t){
+    __m128 m = _mm_add_ps(t, _mm_movehl_ps(t, t));
+    return _mm_cvtss_f32(m) + _mm_cvtss_f32(_mm_shuffle_ps(m, m, 1));
+}
+
+NN_TARGET("sse2")
+static float dotSSE2(const float* a, const float* b, size_t n){
+    __m128 s[8];
+    for(int k = 0; k < 8; k++){
+        s[k] = _mm_setzero_ps();
+    }
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        for(int k = 0; k < 8; k++){
+            s[k] = _mm_add_ps(s[k], _mm_mul_ps(_mm_loadu_ps(a + i + 4 * k), _mm_loadu_ps(b + i + 4 * k)));
+        }
+    }
+    __m128 v0 = _mm_add_ps(s[0], s[4]);
+    __m128 v1 = _mm_add_ps(s[1], s[5]);
+    __m128 v2 = _mm_add_ps(s[2], s[6]);
+    __m128 v3 = _mm_add_ps(s[3], s[7]);
+    __m128 w0 = _mm_add_ps(v0, v2);
+    __m128 w1 = _mm_add_ps(v1, v3);
+    float sum = reduceSSE2(_mm_add_ps(w0, w1));
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+NN_TARGET("sse2")
+static void axpySSE2(float alpha, const float* x, float* y, size_t n){
+    __m128 va = _mm_set1_ps(alpha);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    }
+    for(; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+NN_TARGET("sse2")
+static float sparseDotSSE2(const float* values, const int32_t* columns, const float* x, size_t n){
+    __m128 s[8];
+    for(int k = 0; k < 8; k++){
+        s[k] = _mm_setzero_ps();
+    }
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        for(int k = 0; k < 8; k++){
+            const int32_t* c = columns + i + 4 * k;
+            __m128 gathered = _mm_set_ps(x[c[3]], x[c[2]], x[c[1]], x[c[0]]);
+            s[k] = _mm_add_ps(s[k], _mm_mul_ps(_mm_loadu_ps(values + i + 4 * k), gathered));
+        }
+    }
+    __m128 v0 = _mm_add_ps(s[0], s[4]);
+    __m128 v1 = _mm_add_ps(s[1], s[5]);
+    __m128 v2 = _mm_add_ps(s[2], s[6]);
+    __m128 v3 = _mm_add_ps(s[3], s[7]);
+    __m128 w0 = _mm_add_ps(v0, v2);
+    __m128 w1 = _mm_add_ps(v1, v3);
+    float sum = reduceSSE2(_mm_add_ps(w0, w1));
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+NN_TARGET("sse2")
+static void multiplyAddSSE2(const float* a, const float* b, float* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        const float* as = a + start;
+        float* ys = y + start;
+        size_t m = 0;
+        for(; m + 4 <= count; m += 4){
+            _mm_storeu_ps(ys + m, _mm_add_ps(_mm_loadu_ps(ys + m), _mm_mul_ps(_mm_loadu_ps(as + m), _mm_loadu_ps(b + m))));
+        }
+        for(; m < count; m++){
+            ys[m] += as[m] * b[m];
+        }
+    }
+}
+
+template<OptimizerType T>
+NN_TARGET("sse2")
+static float optimizerSSE2(float* params, float* first, float* second, const float* x, float scale,
+                           const OptimizerStep& step, size_t n){
+    UpdateConstantsF c = updateConstants(step);
+    __m128 vScale = _mm_set1_ps(scale);
+    __m128 vRate = _mm_set1_ps(c.learningRate);
+    __m128 vBeta1 = _mm_set1_ps(c.beta1);
+    __m128 vOneMinusBeta1 = _mm_set1_ps(c.oneMinusBeta1);
+    __m128 vBeta2 = _mm_set1_ps(c.beta2);
+    __m128 vOneMinusBeta2 = _mm_set1_ps(c.oneMinusBeta2);
+    __m128 vEps = _mm_set1_ps(c.epsilon);
+    __m128 vDecay = _mm_set1_ps(c.weightDecay);
+    __m128 vMax = _mm_set1_ps(c.maxRate);
+    __m128 vCorrection1 = _mm_set1_ps(c.correction1);
+    __m128 vCorrection2 = _mm_set1_ps(c.correction2);
+    __m128 vShrink = _mm_set1_ps(c.shrink);
+    size_t i = 0;
+    //the last element always goes through optimizerElement, which reports its rate
+    for(; i + 4 < n; i += 4){
+        __m128 p = _mm_loadu_ps(params + i);
+        __m128 g = _mm_mul_ps(vScale, _mm_loadu_ps(x + i));
+        if constexpr(T != OptimizerType::AdamW){
+            g = _mm_add_ps(g, _mm_mul_ps(vDecay, p));
+        }
+        if constexpr(T == OptimizerType::SGD){
+            p = _mm_sub_ps(p, _mm_mul_ps(vRate, g));
+        }else if constexpr(T == OptimizerType::Momentum){
+            __m128 m = _mm_add_ps(_mm_mul_ps(vBeta1, _mm_loadu_ps(first + i)), g);
+            _mm_storeu_ps(first + i, m);
+            p = _mm_sub_ps(p, _mm_mul_ps(vRate, m));
+        }else if constexpr(T == OptimizerType::RMSProp){
+            __m128 v = _mm_loadu_ps(second + i);
+            __m128 rate = _mm_min_ps(vMax, _mm_div_ps(vRate, _mm_add_ps(_mm_sqrt_ps(v), vEps)));
+            p = _mm_sub_ps(p, _mm_mul_ps(rate, g));
+            _mm_storeu_ps(second + i, _mm_add_ps(_mm_mul_ps(vBeta2, v), _mm_mul_ps(vOneMinusBeta2, _mm_mul_ps(g, g))));
+        }else{
+            __m128 m = _mm_add_ps(_mm_mul_ps(vBeta1, _mm_loadu_ps(first + i)), _mm_mul_ps(vOneMinusBeta1, g));
+            __m128 v = _mm_add_ps(_mm_mul_ps(vBeta2, _mm_loadu_ps(second + i)), _mm_mul_ps(vOneMinusBeta2, _mm_mul_ps(g, g)));
+            _mm_storeu_ps(first + i, m);
+            _mm_storeu_ps(second + i, v);
+            __m128 rate = _mm_min_ps(vMax, _mm_div_ps(vRate, _mm_add_ps(_mm_sqrt_ps(_mm_mul_ps(v, vCorrection2)), vEps)));
+            if constexpr(T == OptimizerType::AdamW){
+                p = _mm_mul_ps(p, vShrink);
+            }
+            p = _mm_sub_ps(p, _mm_mul_ps(rate, _mm_mul_ps(m, vCorrection1)));
+        }
+        _mm_storeu_ps(params + i, p);
+    }
+    float rate = 0.0f;
+    for(; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+NN_TARGET("sse2")
+static inline __m128 reluSSE2(__m128 v, __m128& der){
+    __m128 negative = _mm_cmplt_ps(v, _mm_setzero_ps());
+    der = _mm_andnot_ps(negative, _mm_set1_ps(1.0f));
+    return _mm_andnot_ps(negative, v);
+}
+
+NN_TARGET("sse2")
+static inline __m128 leakyReluSSE2(__m128 v, __m128& der){
+    __m128 slope = _mm_set1_ps(LEAKY_SLOPE);
+    __m128 negative = _mm_cmplt_ps(v, _mm_setzero_ps());
+    __m128 leaked = _mm_mul_ps(slope, v);
+    der = _mm_or_ps(_mm_and_ps(negative, slope), _mm_andnot_ps(negative, _mm_set1_ps(1.0f)));
+    return _mm_or_ps(_mm_and_ps(negative, leaked), _mm_andnot_ps(negative, v));
+}
+
+NN_TARGET("sse2")
+static inline __m128 tanhSSE2(__m128 v, __m128& der){
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 magic = _mm_set1_ps(ROUND_MAGIC);
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32((int)ABS_MASK));
+    __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)SIGN_MASK));
+    __m128 a = _mm_min_ps(_mm_and_ps(v, absMask), _mm_set1_ps(TANH_CLAMP));
+    __m128 a2 = _mm_add_ps(a, a);
+    __m128 t = _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(LOG2E)), magic);
+    __m128 k = _mm_sub_ps(t, magic);
+    __m128 r = _mm_sub_ps(_mm_sub_ps(a2, _mm_mul_ps(k, _mm_set1_ps(LN2_HI))), _mm_mul_ps(k, _mm_set1_ps(LN2_LO)));
+    __m128 q = _mm_set1_ps(EXPM1_COEFFS[0]);
+    for(int c = 1; c < EXPM1_TERMS - 1; c++){
+        q = _mm_add_ps(_mm_mul_ps(q, r), _mm_set1_ps(EXPM1_COEFFS[c]));
+    }
+    q = _mm_add_ps(_mm_mul_ps(q, r), one);
+    __m128 p = _mm_mul_ps(q, r);
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_castps_si128(t), _mm_set1_epi32(127)), 23));
+    __m128 em1 = _mm_add_ps(_mm_mul_ps(scale, p), _mm_sub_ps(scale, one));
+    __m128 th = _mm_div_ps(em1, _mm_add_ps(em1, _mm_set1_ps(2.0f)));
+    th = _mm_or_ps(th, _mm_and_ps(v, signMask));
+    der = _mm_sub_ps(one, _mm_mul_ps(th, th));
+    return th;
+}
+
+NN_TARGET("sse2")
+static inline __m128 expFastSSE2(__m128 x){
+    __m128 magic = _mm_set1_ps(ROUND_MAGIC);
+    __m128 t = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E)), magic);
+    __m128 k = _mm_sub_ps(t, magic);
+    __m128 r = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(LN2_HI))), _mm_mul_ps(k, _mm_set1_ps(LN2_LO)));
+    __m128 q = _mm_set1_ps(FAST_EXP_COEFFS[0]);
+    for(int c = 1; c < FAST_EXP_TERMS; c++){
+        q = _mm_add_ps(_mm_mul_ps(q, r), _mm_set1_ps(FAST_EXP_COEFFS[c]));
+    }
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_castps_si128(t), _mm_set1_epi32(127)), 23));
+    return _mm_mul_ps(q, scale);
+}
+
+NN_TARGET("sse2")
+static inline __m128 tanhFastSSE2(__m128 v, __m128& der){
+    __m128 x = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-FAST_TANH_CLAMP)), _mm_set1_ps(FAST_TANH_CLAMP));
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(FAST_TANH_P[0]);
+    for(int c = 1; c < FAST_TANH_P_TERMS; c++){
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(FAST_TANH_P[c]));
+    }
+    __m128 q = _mm_set1_ps(FAST_TANH_Q[0]);
+    for(int c = 1; c < FAST_TANH_Q_TERMS; c++){
+        q = _mm_add_ps(_mm_mul_ps(q, x2), _mm_set1_ps(FAST_TANH_Q[c]));
+    }
+    __m128 th = _mm_div_ps(_mm_mul_ps(p, x), q);
+    der = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(th, th));
+    return th;
+}
+
+NN_TARGET("sse2")
+static inline __m128 sigmoidFastSSE2(__m128 v, __m128& der){
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 th = tanhFastSSE2(_mm_mul_ps(half, v), der);
+    __m128 s = _mm_add_ps(half, _mm_mul_ps(half, th));
+    der = _mm_mul_ps(s, _mm_sub_ps(_mm_set1_ps(1.0f), s));
+    return s;
+}
+
+NN_TARGET("sse2")
+static inline __m128 geluFastSSE2(__m128 v, __m128& der){
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32((int)ABS_MASK));
+    __m128 a = _mm_min_ps(_mm_and_ps(v, absMask), _mm_set1_ps(FAST_GELU_CLAMP));
+    __m128 t = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(FAST_ERF_P), _mm_mul_ps(a, _mm_set1_ps(INV_SQRT2)))));
+    __m128 poly = _mm_set1_ps(FAST_ERF_A[0]);
+    for(int c = 1; c < FAST_ERF_TERMS; c++){
+        poly = _mm_add_ps(_mm_mul_ps(poly, t), _mm_set1_ps(FAST_ERF_A[c]));
+    }
+    poly = _mm_mul_ps(poly, t);
+    __m128 e = expFastSSE2(_mm_mul_ps(_mm_mul_ps(a, a), _mm_set1_ps(-0.5f)));
+    __m128 tail = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_mul_ps(poly, e));
+    __m128 negative = _mm_cmplt_ps(v, _mm_setzero_ps());
+    __m128 cdf = _mm_or_ps(_mm_and_ps(negative, tail), _mm_andnot_ps(negative, _mm_sub_ps(one, tail)));
+    der = _mm_add_ps(cdf, _mm_mul_ps(v, _mm_mul_ps(_mm_set1_ps(INV_SQRT_2PI), e)));
+    return _mm_mul_ps(v, cdf);
+}
+
+NN_TARGET("sse2")
+static inline __m128 softplusFastSSE2(__m128 v, __m128& der){
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32((int)ABS_MASK));
+    __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)SIGN_MASK));
+    __m128 a = _mm_min_ps(_mm_and_ps(v, absMask), _mm_set1_ps(FAST_EXP_CLAMP));
+    __m128 u = expFastSSE2(_mm_xor_ps(a, signMask));
+    __m128 s = _mm_div_ps(u, _mm_add_ps(u, _mm_set1_ps(2.0f)));
+    __m128 s2 = _mm_mul_ps(s, s);
+    __m128 q = _mm_set1_ps(FAST_LOG1P_COEFFS[0]);
+    for(int c = 1; c < FAST_LOG1P_TERMS; c++){
+        q = _mm_add_ps(_mm_mul_ps(q, s2), _mm_set1_ps(FAST_LOG1P_COEFFS[c]));
+    }
+    __m128 negative = _mm_cmplt_ps(v, _mm_setzero_ps());
+    der = _mm_div_ps(_mm_or_ps(_mm_and_ps(negative, u), _mm_andnot_ps(negative, one)), _mm_add_ps(one, u));
+    return _mm_add_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_mul_ps(_mm_add_ps(s, s), q));
+}
+
+template<ActivationType T>
+NN_TARGET("sse2")
+static inline __m128 activationSSE2(__m128 v, __m128& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluSSE2(v, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhSSE2(v, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastSSE2(v, der);
+    }else if constexpr(T == ActivationType::Softmax){
+        der = _mm_set1_ps(1.0f);
+        return v;
+    }else{
+        return leakyReluSSE2(v, der);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("sse2")
+static void activationVecSSE2(const float* z, float* act, float* der, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 4 <= n; i += 4){
+            __m128 d;
+            __m128 a = activationSSE2<T>(_mm_loadu_ps(z + i), d);
+            _mm_storeu_ps(act + i, a);
+            _mm_storeu_ps(der + i, d);
+        }
+    }
+    for(; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("sse2")
+static void biasActivationSSE2(const float* bias, float* z, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 4 <= n; i += 4){
+            __m128 d;
+            _mm_storeu_ps(z + i, activationSSE2<T>(_mm_add_ps(_mm_loadu_ps(z + i), _mm_loadu_ps(bias + i)), d));
+        }
+    }
+    float der;
+    for(; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+//---------------------------------------------------------------- AVX2
+
+NN_TARGET("avx2")
+static float dotAVX2(const float* a, const float* b, size_t n){
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+        s2 = _mm256_add_ps(s2, _mm256_mul_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16)));
+        s3 = _mm256_add_ps(s3, _mm256_mul_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24)));
+    }
+    __m256 w = _mm256_add_ps(_mm256_add_ps(s0, s2), _mm256_add_ps(s1, s3));
+    __m128 t = _mm_add_ps(_mm256_castps256_ps128(w), _mm256_extractf128_ps(w, 1));
+    float sum = reduceSSE2(t);
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+NN_TARGET("avx2")
+static void axpyAVX2(float alpha, const float* x, float* y, size_t n){
+    __m256 va = _mm256_set1_ps(alpha);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8){
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(va, _mm256_loadu_ps(x + i))));
+    }
+    for(; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+NN_TARGET("avx2")
+static inline __m256 gatherAVX2(const float* x, const int32_t* columns){
+    return _mm256_i32gather_ps(x, _mm256_loadu_si256((const __m256i*)columns), 4);
+}
+
+NN_TARGET("avx2")
+static float sparseDotAVX2(const float* values, const int32_t* columns, const float* x, size_t n){
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(values + i), gatherAVX2(x, columns + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(values + i + 8), gatherAVX2(x, columns + i + 8)));
+        s2 = _mm256_add_ps(s2, _mm256_mul_ps(_mm256_loadu_ps(values + i + 16), gatherAVX2(x, columns + i + 16)));
+        s3 = _mm256_add_ps(s3, _mm256_mul_ps(_mm256_loadu_ps(values + i + 24), gatherAVX2(x, columns + i + 24)));
+    }
+    __m256 w = _mm256_add_ps(_mm256_add_ps(s0, s2), _mm256_add_ps(s1, s3));
+    __m128 t = _mm_add_ps(_mm256_castps256_ps128(w), _mm256_extractf128_ps(w, 1));
+    float sum = reduceSSE2(t);
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+NN_TARGET("avx2")
+static void multiplyAddAVX2(const float* a, const float* b, float* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        const float* as = a + start;
+        float* ys = y + start;
+        size_t m = 0;
+        for(; m + 8 <= count; m += 8){
+            _mm256_storeu_ps(ys + m, _mm256_add_ps(_mm256_loadu_ps(ys + m), _mm256_mul_ps(_mm256_loadu_ps(as + m), _mm256_loadu_ps(b + m))));
+        }
+        for(; m < count; m++){
+            ys[m] += as[m] * b[m];
+        }
+    }
+}
+
+template<OptimizerType T>
+NN_TARGET("avx2")
+static float optimizerAVX2(float* params, float* first, float* second, const float* x, float scale,
+                           const OptimizerStep& step, size_t n){
+    UpdateConstantsF c = updateConstants(step);
+    __m256 vScale = _mm256_set1_ps(scale);
+    __m256 vRate = _mm256_set1_ps(c.learningRate);
+    __m256 vBeta1 = _mm256_set1_ps(c.beta1);
+    __m256 vOneMinusBeta1 = _mm256_set1_ps(c.oneMinusBeta1);
+    __m256 vBeta2 = _mm256_set1_ps(c.beta2);
+    __m256 vOneMinusBeta2 = _mm256_set1_ps(c.oneMinusBeta2);
+    __m256 vEps = _mm256_set1_ps(c.epsilon);
+    __m256 vDecay = _mm256_set1_ps(c.weightDecay);
+    __m256 vMax = _mm256_set1_ps(c.maxRate);
+    __m256 vCorrection1 = _mm256_set1_ps(c.correction1);
+    __m256 vCorrection2 = _mm256_set1_ps(c.correction2);
+    __m256 vShrink = _mm256_set1_ps(c.shrink);
+    size_t i = 0;
+    //the last element always goes through optimizerElement, which reports its rate
+    for(; i + 8 < n; i += 8){
+        __m256 p = _mm256_loadu_ps(params + i);
+        __m256 g = _mm256_mul_ps(vScale, _mm256_loadu_ps(x + i));
+        if constexpr(T != OptimizerType::AdamW){
+            g = _mm256_add_ps(g, _mm256_mul_ps(vDecay, p));
+        }
+        if constexpr(T == OptimizerType::SGD){
+            p = _mm256_sub_ps(p, _mm256_mul_ps(vRate, g));
+        }else if constexpr(T == OptimizerType::Momentum){
+            __m256 m = _mm256_add_ps(_mm256_mul_ps(vBeta1, _mm256_loadu_ps(first + i)), g);
+            _mm256_storeu_ps(first + i, m);
+            p = _mm256_sub_ps(p, _mm256_mul_ps(vRate, m));
+        }else if constexpr(T == OptimizerType::RMSProp){
+            __m256 v = _mm256_loadu_ps(second + i);
+            __m256 rate = _mm256_min_ps(vMax, _mm256_div_ps(vRate, _mm256_add_ps(_mm256_sqrt_ps(v), vEps)));
+            p = _mm256_sub_ps(p, _mm256_mul_ps(rate, g));
+            _mm256_storeu_ps(second + i, _mm256_add_ps(_mm256_mul_ps(vBeta2, v), _mm256_mul_ps(vOneMinusBeta2, _mm256_mul_ps(g, g))));
+        }else{
+            __m256 m = _mm256_add_ps(_mm256_mul_ps(vBeta1, _mm256_loadu_ps(first + i)), _mm256_mul_ps(vOneMinusBeta1, g));
+            __m256 v = _mm256_add_ps(_mm256_mul_ps(vBeta2, _mm256_loadu_ps(second + i)), _mm256_mul_ps(vOneMinusBeta2, _mm256_mul_ps(g, g)));
+            _mm256_storeu_ps(first + i, m);
+            _mm256_storeu_ps(second + i, v);
+            __m256 rate = _mm256_min_ps(vMax, _mm256_div_ps(vRate, _mm256_add_ps(_mm256_sqrt_ps(_mm256_mul_ps(v, vCorrection2)), vEps)));
+            if constexpr(T == OptimizerType::AdamW){
+                p = _mm256_mul_ps(p, vShrink);
+            }
+            p = _mm256_sub_ps(p, _mm256_mul_ps(rate, _mm256_mul_ps(m, vCorrection1)));
+        }
+        _mm256_storeu_ps(params + i, p);
+    }
+    float rate = 0.0f;
+    for(; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+NN_TARGET("avx2")
+static inline __m256 reluAVX2(__m256 v, __m256& der){
+    __m256 negative = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ);
+    der = _mm256_andnot_ps(negative, _mm256_set1_ps(1.0f));
+    return _mm256_andnot_ps(negative, v);
+}
+
+NN_TARGET("avx2")
+static inline __m256 leakyReluAVX2(__m256 v, __m256& der){
+    __m256 slope = _mm256_set1_ps(LEAKY_SLOPE);
+    __m256 negative = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ);
+    der = _mm256_blendv_ps(_mm256_set1_ps(1.0f), slope, negative);
+    return _mm256_blendv_ps(v, _mm256_mul_ps(slope, v), negative);
+}
+
+NN_TARGET("avx2")
+static inline __m256 tanhAVX2(__m256 v, __m256& der){
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 magic = _mm256_set1_ps(ROUND_MAGIC);
+    __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)ABS_MASK));
+    __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)SIGN_MASK));
+    __m256 a = _mm256_min_ps(_mm256_and_ps(v, absMask), _mm256_set1_ps(TANH_CLAMP));
+    __m256 a2 = _mm256_add_ps(a, a);
+    __m256 t = _mm256_add_ps(_mm256_mul_ps(a2, _mm256_set1_ps(LOG2E)), magic);
+    __m256 k = _mm256_sub_ps(t, magic);
+    __m256 r = _mm256_sub_ps(_mm256_sub_ps(a2, _mm256_mul_ps(k, _mm256_set1_ps(LN2_HI))), _mm256_mul_ps(k, _mm256_set1_ps(LN2_LO)));
+    __m256 q = _mm256_set1_ps(EXPM1_COEFFS[0]);
+    for(int c = 1; c < EXPM1_TERMS - 1; c++){
+        q = _mm256_add_ps(_mm256_mul_ps(q, r), _mm256_set1_ps(EXPM1_COEFFS[c]));
+    }
+    q = _mm256_add_ps(_mm256_mul_ps(q, r), one);
+    __m256 p = _mm256_mul_ps(q, r);
+    __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_castps_si256(t), _mm256_set1_epi32(127)), 23));
+    __m256 em1 = _mm256_add_ps(_mm256_mul_ps(scale, p), _mm256_sub_ps(scale, one));
+    __m256 th = _mm256_div_ps(em1, _mm256_add_ps(em1, _mm256_set1_ps(2.0f)));
+    th = _mm256_or_ps(th, _mm256_and_ps(v, signMask));
+    der = _mm256_sub_ps(one, _mm256_mul_ps(th, th));
+    return th;
+}
+
+NN_TARGET("avx2")
+static inline __m256 expFastAVX2(__m256 x){
+    __m256 magic = _mm256_set1_ps(ROUND_MAGIC);
+    __m256 t = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)), magic);
+    __m256 k = _mm256_sub_ps(t, magic);
+    __m256 r = _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(LN2_HI))), _mm256_mul_ps(k, _mm256_set1_ps(LN2_LO)));
+    __m256 q = _mm256_set1_ps(FAST_EXP_COEFFS[0]);
+    for(int c = 1; c < FAST_EXP_TERMS; c++){
+        q = _mm256_add_ps(_mm256_mul_ps(q, r), _mm256_set1_ps(FAST_EXP_COEFFS[c]));
+    }
+    __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_castps_si256(t), _mm256_set1_epi32(127)), 23));
+    return _mm256_mul_ps(q, scale);
+}
+
+NN_TARGET("avx2")
+static inline __m256 tanhFastAVX2(__m256 v, __m256& der){
+    __m256 x = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-FAST_TANH_CLAMP)), _mm256_set1_ps(FAST_TANH_CLAMP));
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(FAST_TANH_P[0]);
+    for(int c = 1; c < FAST_TANH_P_TERMS; c++){
+        p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(FAST_TANH_P[c]));
+    }
+    __m256 q = _mm256_set1_ps(FAST_TANH_Q[0]);
+    for(int c = 1; c < FAST_TANH_Q_TERMS; c++){
+        q = _mm256_add_ps(_mm256_mul_ps(q, x2), _mm256_set1_ps(FAST_TANH_Q[c]));
+    }
+    __m256 th = _mm256_div_ps(_mm256_mul_ps(p, x), q);
+    der = _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(th, th));
+    return th;
+}
+
+NN_TARGET("avx2")
+static inline __m256 sigmoidFastAVX2(__m256 v, __m256& der){
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 th = tanhFastAVX2(_mm256_mul_ps(half, v), der);
+    __m256 s = _mm256_add_ps(half, _mm256_mul_ps(half, th));
+    der = _mm256_mul_ps(s, _mm256_sub_ps(_mm256_set1_ps(1.0f), s));
+    return s;
+}
+
+NN_TARGET("avx2")
+static inline __m256 geluFastAVX2(__m256 v, __m256& der){
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)ABS_MASK));
+    __m256 a = _mm256_min_ps(_mm256_and_ps(v, absMask), _mm256_set1_ps(FAST_GELU_CLAMP));
+    __m256 t = _mm256_div_ps(one, _mm256_add_ps(one, _mm256_mul_ps(_mm256_set1_ps(FAST_ERF_P), _mm256_mul_ps(a, _mm256_set1_ps(INV_SQRT2)))));
+    __m256 poly = _mm256_set1_ps(FAST_ERF_A[0]);
+    for(int c = 1; c < FAST_ERF_TERMS; c++){
+        poly = _mm256_add_ps(_mm256_mul_ps(poly, t), _mm256_set1_ps(FAST_ERF_A[c]));
+    }
+    poly = _mm256_mul_ps(poly, t);
+    __m256 e = expFastAVX2(_mm256_mul_ps(_mm256_mul_ps(a, a), _mm256_set1_ps(-0.5f)));
+    __m256 tail = _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(poly, e));
+    __m256 negative = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ);
+    __m256 cdf = _mm256_blendv_ps(_mm256_sub_ps(one, tail), tail, negative);
+    der = _mm256_add_ps(cdf, _mm256_mul_ps(v, _mm256_mul_ps(_mm256_set1_ps(INV_SQRT_2PI), e)));
+    return _mm256_mul_ps(v, cdf);
+}
+
+NN_TARGET("avx2")
+static inline __m256 softplusFastAVX2(__m256 v, __m256& der){
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)ABS_MASK));
+    __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)SIGN_MASK));
+    __m256 a = _mm256_min_ps(_mm256_and_ps(v, absMask), _mm256_set1_ps(FAST_EXP_CLAMP));
+    __m256 u = expFastAVX2(_mm256_xor_ps(a, signMask));
+    __m256 s = _mm256_div_ps(u, _mm256_add_ps(u, _mm256_set1_ps(2.0f)));
+    __m256 s2 = _mm256_mul_ps(s, s);
+    __m256 q = _mm256_set1_ps(FAST_LOG1P_COEFFS[0]);
+    for(int c = 1; c < FAST_LOG1P_TERMS; c++){
+        q = _mm256_add_ps(_mm256_mul_ps(q, s2), _mm256_set1_ps(FAST_LOG1P_COEFFS[c]));
+    }
+    __m256 negative = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ);
+    der = _mm256_div_ps(_mm256_blendv_ps(one, u, negative), _mm256_add_ps(one, u));
+    return _mm256_add_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_mul_ps(_mm256_add_ps(s, s), q));
+}
+
+template<ActivationType T>
+NN_TARGET("avx2")
+static inline __m256 activationAVX2(__m256 v, __m256& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluAVX2(v, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhAVX2(v, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastAVX2(v, der);
+    }else if constexpr(T == ActivationType::Softmax){
+        der = _mm256_set1_ps(1.0f);
+        return v;
+    }else{
+        return leakyReluAVX2(v, der);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx2")
+static void activationVecAVX2(const float* z, float* act, float* der, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 8 <= n; i += 8){
+            __m256 d;
+            __m256 a = activationAVX2<T>(_mm256_loadu_ps(z + i), d);
+            _mm256_storeu_ps(act + i, a);
+            _mm256_storeu_ps(der + i, d);
+        }
+    }
+    for(; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx2")
+static void biasActivationAVX2(const float* bias, float* z, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 8 <= n; i += 8){
+            __m256 d;
+            _mm256_storeu_ps(z + i, activationAVX2<T>(_mm256_add_ps(_mm256_loadu_ps(z + i), _mm256_loadu_ps(bias + i)), d));
+        }
+    }
+    float der;
+    for(; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+//---------------------------------------------------------------- AVX-512
+
+NN_TARGET("avx512f")
+static float dotAVX512(const float* a, const float* b, size_t n){
+    __m512 s0 = _mm512_setzero_ps();
+    __m512 s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        s0 = _mm512_add_ps(s0, _mm512_mul_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+        s1 = _mm512_add_ps(s1, _mm512_mul_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16)));
+    }
+    __m512 v = _mm512_add_ps(s0, s1);
+    //the upper 256 bits through a double cast, extractf32x8 needs AVX512DQ
+    __m256 w = _mm256_add_ps(_mm512_castps512_ps256(v), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)));
+    __m128 t = _mm_add_ps(_mm256_castps256_ps128(w), _mm256_extractf128_ps(w, 1));
+    float sum = reduceSSE2(t);
+    for(; i < n; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+NN_TARGET("avx512f")
+static void axpyAVX512(float alpha, const float* x, float* y, size_t n){
+    __m512 va = _mm512_set1_ps(alpha);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        _mm512_storeu_ps(y + i, _mm512_add_ps(_mm512_loadu_ps(y + i), _mm512_mul_ps(va, _mm512_loadu_ps(x + i))));
+    }
+    for(; i < n; i++){
+        y[i] += alpha * x[i];
+    }
+}
+
+NN_TARGET("avx512f")
+static float sparseDotAVX512(const float* values, const int32_t* columns, const float* x, size_t n){
+    __m512 s0 = _mm512_setzero_ps();
+    __m512 s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m512 x0 = _mm512_i32gather_ps(_mm512_loadu_si512(columns + i), x, 4);
+        __m512 x1 = _mm512_i32gather_ps(_mm512_loadu_si512(columns + i + 16), x, 4);
+        s0 = _mm512_add_ps(s0, _mm512_mul_ps(_mm512_loadu_ps(values + i), x0));
+        s1 = _mm512_add_ps(s1, _mm512_mul_ps(_mm512_loadu_ps(values + i + 16), x1));
+    }
+    __m512 v = _mm512_add_ps(s0, s1);
+    __m256 w = _mm256_add_ps(_mm512_castps512_ps256(v), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)));
+    __m128 t = _mm_add_ps(_mm256_castps256_ps128(w), _mm256_extractf128_ps(w, 1));
+    float sum = reduceSSE2(t);
+    for(; i < n; i++){
+        sum += values[i] * x[columns[i]];
+    }
+    return sum;
+}
+
+NN_TARGET("avx512f")
+static void multiplyAddAVX512(const float* a, const float* b, float* y, size_t n, size_t period){
+    for(size_t start = 0; start < n; start += period){
+        size_t count = std::min(period, n - start);
+        const float* as = a + start;
+        float* ys = y + start;
+        size_t m = 0;
+        for(; m + 16 <= count; m += 16){
+            _mm512_storeu_ps(ys + m, _mm512_add_ps(_mm512_loadu_ps(ys + m), _mm512_mul_ps(_mm512_loadu_ps(as + m), _mm512_loadu_ps(b + m))));
+        }
+        for(; m < count; m++){
+            ys[m] += as[m] * b[m];
+        }
+    }
+}
+
+//gather, add and scatter back, safe because the columns of a row are distinct
+NN_TARGET("avx512f")
+static void sparseAxpyAVX512(float alpha, const float* values, const int32_t* columns, float* y, size_t n){
+    __m512 va = _mm512_set1_ps(alpha);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m512i index = _mm512_loadu_si512(columns + i);
+        __m512 sum = _mm512_add_ps(_mm512_i32gather_ps(index, y, 4), _mm512_mul_ps(va, _mm512_loadu_ps(values + i)));
+        _mm512_i32scatter_ps(y, index, sum, 4);
+    }
+    for(; i < n; i++){
+        y[columns[i]] += alpha * values[i];
+    }
+}
+
+template<OptimizerType T>
+NN_TARGET("avx512f")
+static float optimizerAVX512(float* params, float* first, float* second, const float* x, float scale,
+                             const OptimizerStep& step, size_t n){
+    UpdateConstantsF c = updateConstants(step);
+    __m512 vScale = _mm512_set1_ps(scale);
+    __m512 vRate = _mm512_set1_ps(c.learningRate);
+    __m512 vBeta1 = _mm512_set1_ps(c.beta1);
+    __m512 vOneMinusBeta1 = _mm512_set1_ps(c.oneMinusBeta1);
+    __m512 vBeta2 = _mm512_set1_ps(c.beta2);
+    __m512 vOneMinusBeta2 = _mm512_set1_ps(c.oneMinusBeta2);
+    __m512 vEps = _mm512_set1_ps(c.epsilon);
+    __m512 vDecay = _mm512_set1_ps(c.weightDecay);
+    __m512 vMax = _mm512_set1_ps(c.maxRate);
+    __m512 vCorrection1 = _mm512_set1_ps(c.correction1);
+    __m512 vCorrection2 = _mm512_set1_ps(c.correction2);
+    __m512 vShrink = _mm512_set1_ps(c.shrink);
+    size_t i = 0;
+    //the last element always goes through optimizerElement, which reports its rate
+    for(; i + 16 < n; i += 16){
+        __m512 p = _mm512_loadu_ps(params + i);
+        __m512 g = _mm512_mul_ps(vScale, _mm512_loadu_ps(x + i));
+        if constexpr(T != OptimizerType::AdamW){
+            g = _mm512_add_ps(g, _mm512_mul_ps(vDecay, p));
+        }
+        if constexpr(T == OptimizerType::SGD){
+            p = _mm512_sub_ps(p, _mm512_mul_ps(vRate, g));
+        }else if constexpr(T == OptimizerType::Momentum){
+            __m512 m = _mm512_add_ps(_mm512_mul_ps(vBeta1, _mm512_loadu_ps(first + i)), g);
+            _mm512_storeu_ps(first + i, m);
+            p = _mm512_sub_ps(p, _mm512_mul_ps(vRate, m));
+        }else if constexpr(T == OptimizerType::RMSProp){
+            __m512 v = _mm512_loadu_ps(second + i);
+            __m512 rate = _mm512_min_ps(vMax, _mm512_div_ps(vRate, _mm512_add_ps(_mm512_sqrt_ps(v), vEps)));
+            p = _mm512_sub_ps(p, _mm512_mul_ps(rate, g));
+            _mm512_storeu_ps(second + i, _mm512_add_ps(_mm512_mul_ps(vBeta2, v), _mm512_mul_ps(vOneMinusBeta2, _mm512_mul_ps(g, g))));
+        }else{
+            __m512 m = _mm512_add_ps(_mm512_mul_ps(vBeta1, _mm512_loadu_ps(first + i)), _mm512_mul_ps(vOneMinusBeta1, g));
+            __m512 v = _mm512_add_ps(_mm512_mul_ps(vBeta2, _mm512_loadu_ps(second + i)), _mm512_mul_ps(vOneMinusBeta2, _mm512_mul_ps(g, g)));
+            _mm512_storeu_ps(first + i, m);
+            _mm512_storeu_ps(second + i, v);
+            __m512 rate = _mm512_min_ps(vMax, _mm512_div_ps(vRate, _mm512_add_ps(_mm512_sqrt_ps(_mm512_mul_ps(v, vCorrection2)), vEps)));
+            if constexpr(T == OptimizerType::AdamW){
+                p = _mm512_mul_ps(p, vShrink);
+            }
+            p = _mm512_sub_ps(p, _mm512_mul_ps(rate, _mm512_mul_ps(m, vCorrection1)));
+        }
+        _mm512_storeu_ps(params + i, p);
+    }
+    float rate = 0.0f;
+    for(; i < n; i++){
+        rate = optimizerElement<T>(params, first, second, i, scale * x[i], c);
+    }
+    return rate;
+}
+
+NN_TARGET("avx512f")
+static inline __m512 reluAVX512(__m512 v, __m512& der){
+    __m512 zero = _mm512_setzero_ps();
+    __mmask16 negative = _mm512_cmp_ps_mask(v, zero, _CMP_LT_OQ);
+    der = _mm512_mask_blend_ps(negative, _mm512_set1_ps(1.0f), zero);
+    return _mm512_mask_blend_ps(negative, v, zero);
+}
+
+NN_TARGET("avx512f")
+static inline __m512 leakyReluAVX512(__m512 v, __m512& der){
+    __m512 slope = _mm512_set1_ps(LEAKY_SLOPE);
+    __mmask16 negative = _mm512_cmp_ps_mask(v, _mm512_setzero_ps(), _CMP_LT_OQ);
+    der = _mm512_mask_blend_ps(negative, _mm512_set1_ps(1.0f), slope);
+    return _mm512_mask_blend_ps(negative, v, _mm512_mul_ps(slope, v));
+}
+
+NN_TARGET("avx512f")
+static inline __m512 tanhAVX512(__m512 v, __m512& der){
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512 magic = _mm512_set1_ps(ROUND_MAGIC);
+    __m512i vBits = _mm512_castps_si512(v);
+    __m512 a = _mm512_castsi512_ps(_mm512_and_epi32(vBits, _mm512_set1_epi32((int)ABS_MASK)));
+    a = _mm512_min_ps(a, _mm512_set1_ps(TANH_CLAMP));
+    __m512 a2 = _mm512_add_ps(a, a);
+    __m512 t = _mm512_add_ps(_mm512_mul_ps(a2, _mm512_set1_ps(LOG2E)), magic);
+    __m512 k = _mm512_sub_ps(t, magic);
+    __m512 r = _mm512_sub_ps(_mm512_sub_ps(a2, _mm512_mul_ps(k, _mm512_set1_ps(LN2_HI))), _mm512_mul_ps(k, _mm512_set1_ps(LN2_LO)));
+    __m512 q = _mm512_set1_ps(EXPM1_COEFFS[0]);
+    for(int c = 1; c < EXPM1_TERMS - 1; c++){
+        q = _mm512_add_ps(_mm512_mul_ps(q, r), _mm512_set1_ps(EXPM1_COEFFS[c]));
+    }
+    q = _mm512_add_ps(_mm512_mul_ps(q, r), one);
+    __m512 p = _mm512_mul_ps(q, r);
+    __m512 scale = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_castps_si512(t), _mm512_set1_epi32(127)), 23));
+    __m512 em1 = _mm512_add_ps(_mm512_mul_ps(scale, p), _mm512_sub_ps(scale, one));
+    __m512 th = _mm512_div_ps(em1, _mm512_add_ps(em1, _mm512_set1_ps(2.0f)));
+    __m512i sign = _mm512_and_epi32(vBits, _mm512_set1_epi32((int)SIGN_MASK));
+    th = _mm512_castsi512_ps(_mm512_or_epi32(_mm512_castps_si512(th), sign));
+    der = _mm512_sub_ps(one, _mm512_mul_ps(th, th));
+    return th;
+}
+
+NN_TARGET("avx512f")
+static inline __m512 expFastAVX512(__m512 x){
+    __m512 magic = _mm512_set1_ps(ROUND_MAGIC);
+    __m512 t = _mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(LOG2E)), magic);
+    __m512 k = _mm512_sub_ps(t, magic);
+    __m512 r = _mm512_sub_ps(_mm512_sub_ps(x, _mm512_mul_ps(k, _mm512_set1_ps(LN2_HI))), _mm512_mul_ps(k, _mm512_set1_ps(LN2_LO)));
+    __m512 q = _mm512_set1_ps(FAST_EXP_COEFFS[0]);
+    for(int c = 1; c < FAST_EXP_TERMS; c++){
+        q = _mm512_add_ps(_mm512_mul_ps(q, r), _mm512_set1_ps(FAST_EXP_COEFFS[c]));
+    }
+    __m512 scale = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_castps_si512(t), _mm512_set1_epi32(127)), 23));
+    return _mm512_mul_ps(q, scale);
+}
+
+NN_TARGET("avx512f")
+static inline __m512 tanhFastAVX512(__m512 v, __m512& der){
+    __m512 x = _mm512_min_ps(_mm512_max_ps(v, _mm512_set1_ps(-FAST_TANH_CLAMP)), _mm512_set1_ps(FAST_TANH_CLAMP));
+    __m512 x2 = _mm512_mul_ps(x, x);
+    __m512 p = _mm512_set1_ps(FAST_TANH_P[0]);
+    for(int c = 1; c < FAST_TANH_P_TERMS; c++){
+        p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(FAST_TANH_P[c]));
+    }
+    __m512 q = _mm512_set1_ps(FAST_TANH_Q[0]);
+    for(int c = 1; c < FAST_TANH_Q_TERMS; c++){
+        q = _mm512_add_ps(_mm512_mul_ps(q, x2), _mm512_set1_ps(FAST_TANH_Q[c]));
+    }
+    __m512 th = _mm512_div_ps(_mm512_mul_ps(p, x), q);
+    der = _mm512_sub_ps(_mm512_set1_ps(1.0f), _mm512_mul_ps(th, th));
+    return th;
+}
+
+NN_TARGET("avx512f")
+static inline __m512 sigmoidFastAVX512(__m512 v, __m512& der){
+    __m512 half = _mm512_set1_ps(0.5f);
+    __m512 th = tanhFastAVX512(_mm512_mul_ps(half, v), der);
+    __m512 s = _mm512_add_ps(half, _mm512_mul_ps(half, th));
+    der = _mm512_mul_ps(s, _mm512_sub_ps(_mm512_set1_ps(1.0f), s));
+    return s;
+}
+
+NN_TARGET("avx512f")
+static inline __m512 geluFastAVX512(__m512 v, __m512& der){
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512 a = _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(v), _mm512_set1_epi32((int)ABS_MASK)));
+    a = _mm512_min_ps(a, _mm512_set1_ps(FAST_GELU_CLAMP));
+    __m512 t = _mm512_div_ps(one, _mm512_add_ps(one, _mm512_mul_ps(_mm512_set1_ps(FAST_ERF_P), _mm512_mul_ps(a, _mm512_set1_ps(INV_SQRT2)))));
+    __m512 poly = _mm512_set1_ps(FAST_ERF_A[0]);
+    for(int c = 1; c < FAST_ERF_TERMS; c++){
+        poly = _mm512_add_ps(_mm512_mul_ps(poly, t), _mm512_set1_ps(FAST_ERF_A[c]));
+    }
+    poly = _mm512_mul_ps(poly, t);
+    __m512 e = expFastAVX512(_mm512_mul_ps(_mm512_mul_ps(a, a), _mm512_set1_ps(-0.5f)));
+    __m512 tail = _mm512_mul_ps(_mm512_set1_ps(0.5f), _mm512_mul_ps(poly, e));
+    __mmask16 negative = _mm512_cmp_ps_mask(v, _mm512_setzero_ps(), _CMP_LT_OQ);
+    __m512 cdf = _mm512_mask_blend_ps(negative, _mm512_sub_ps(one, tail), tail);
+    der = _mm512_add_ps(cdf, _mm512_mul_ps(v, _mm512_mul_ps(_mm512_set1_ps(INV_SQRT_2PI), e)));
+    return _mm512_mul_ps(v, cdf);
+}
+
+NN_TARGET("avx512f")
+static inline __m512 softplusFastAVX512(__m512 v, __m512& der){
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512 a = _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(v), _mm512_set1_epi32((int)ABS_MASK)));
+    a = _mm512_min_ps(a, _mm512_set1_ps(FAST_EXP_CLAMP));
+    __m512 u = expFastAVX512(_mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(a), _mm512_set1_epi32((int)SIGN_MASK))));
+    __m512 s = _mm512_div_ps(u, _mm512_add_ps(u, _mm512_set1_ps(2.0f)));
+    __m512 s2 = _mm512_mul_ps(s, s);
+    __m512 q = _mm512_set1_ps(FAST_LOG1P_COEFFS[0]);
+    for(int c = 1; c < FAST_LOG1P_TERMS; c++){
+        q = _mm512_add_ps(_mm512_mul_ps(q, s2), _mm512_set1_ps(FAST_LOG1P_COEFFS[c]));
+    }
+    __mmask16 negative = _mm512_cmp_ps_mask(v, _mm512_setzero_ps(), _CMP_LT_OQ);
+    der = _mm512_div_ps(_mm512_mask_blend_ps(negative, one, u), _mm512_add_ps(one, u));
+    return _mm512_add_ps(_mm512_max_ps(v, _mm512_setzero_ps()), _mm512_mul_ps(_mm512_add_ps(s, s), q));
+}
+
+template<ActivationType T>
+NN_TARGET("avx512f")
+static inline __m512 activationAVX512(__m512 v, __m512& der){
+    if constexpr(T == ActivationType::Relu){
+        return reluAVX512(v, der);
+    }else if constexpr(T == ActivationType::Tanh){
+        return tanhAVX512(v, der);
+    }else if constexpr(T == ActivationType::TanhFast){
+        return tanhFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::SigmoidFast){
+        return sigmoidFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::GeluFast){
+        return geluFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::SoftplusFast){
+        return softplusFastAVX512(v, der);
+    }else if constexpr(T == ActivationType::Softmax){
+        der = _mm512_set1_ps(1.0f);
+        return v;
+    }else{
+        return leakyReluAVX512(v, der);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx512f")
+static void activationVecAVX512(const float* z, float* act, float* der, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 16 <= n; i += 16){
+            __m512 d;
+            __m512 a = activationAVX512<T>(_mm512_loadu_ps(z + i), d);
+            _mm512_storeu_ps(act + i, a);
+            _mm512_storeu_ps(der + i, d);
+        }
+    }
+    for(; i < n; i++){
+        act[i] = activationScalar<T>(z[i], der[i]);
+    }
+}
+
+template<ActivationType T>
+NN_TARGET("avx512f")
+static void biasActivationAVX512(const float* bias, float* z, size_t n){
+    size_t i = 0;
+    if constexpr(!usesLibm(T)){
+        for(; i + 16 <= n; i += 16){
+            __m512 d;
+            _mm512_storeu_ps(z + i, activationAVX512<T>(_mm512_add_ps(_mm512_loadu_ps(z + i), _mm512_loadu_ps(bias + i)), d));
+        }
+    }
+    float der;
+    for(; i < n; i++){
+        z[i] = activationScalar<T>(z[i] + bias[i], der);
+    }
+}
+
+#endif // NN_X86
+
+//---------------------------------------------------------------- dispatch
+
+#define ACTIVATION_KERNELS(fn) {fn<ActivationType::LeakyRelu>, fn<ActivationType::Relu>, fn<ActivationType::Tanh>, \
+                                fn<ActivationType::Softmax>, fn<ActivationType::Sigmoid>, fn<ActivationType::Gelu>, \
+                                fn<ActivationType::Softplus>, fn<ActivationType::TanhFast>, \
+                                fn<ActivationType::SigmoidFast>, fn<ActivationType::GeluFast>, \
+                                fn<ActivationType::SoftplusFast>}
+//and one optimizer kernel per OptimizerType
+#define OPTIMIZER_KERNELS(fn) {fn<OptimizerType::SGD>, fn<OptimizerType::Momentum>, fn<OptimizerType::RMSProp>, \
+                               fn<OptimizerType::Adam>, fn<OptimizerType::AdamW>}
+
+//the caller (kernels.cpp) has already checked that the CPU supports isa
+KernelTableF makeKernelTableF(KernelISA isa){
+    KernelTableF table = {KernelISA::Scalar, "scalar", dotScalar, axpyScalar, sparseDotScalar, sparseAxpyScalar, multiplyAddScalar,
+                          OPTIMIZER_KERNELS(optimizerScalar), ACTIVATION_KERNELS(activationVecScalar),
+                          ACTIVATION_KERNELS(biasActivationScalar)};
+#ifdef NN_X86
+    if(isa == KernelISA::SSE2){
+        table = {isa, "sse2", dotSSE2, axpySSE2, sparseDotSSE2, sparseAxpyScalar, multiplyAddSSE2,
+                 OPTIMIZER_KERNELS(optimizerSSE2), ACTIVATION_KERNELS(activationVecSSE2), ACTIVATION_KERNELS(biasActivationSSE2)};
+    }else if(isa == KernelISA::AVX2){
+        table = {isa, "avx2", dotAVX2, axpyAVX2, sparseDotAVX2, sparseAxpyScalar, multiplyAddAVX2,
+                 OPTIMIZER_KERNELS(optimizerAVX2), ACTIVATION_KERNELS(activationVecAVX2), ACTIVATION_KERNELS(biasActivationAVX2)};
+    }else if(isa == KernelISA::AVX512){
+        table = {isa, "avx512", dotAVX512, axpyAVX512, sparseDotAVX512, sparseAxpyAVX512, multiplyAddAVX512,
+                 OPTIMIZER_KERNELS(optimizerAVX512), ACTIVATION_KERNELS(activationVecAVX512),
+                 ACTIVATION_KERNELS(biasActivationAVX512)};
+    }
+#endif
+    return table;
+}
@@ -0,0 +1,116 @@
+#include "kernels.h"
+#include "simd_target.h"
+
+//u8 x s8 dot products for the int8 inference path. The SSE2 and AVX2 versions
+//widen both operands to 16 bits and use madd (pairs of products summed into
+//int32), which can not saturate. VNNI does four products per int32 lane in one
+//instruction
+
+//---------------------------------------------------------------- scalar
+
+static int32_t dotU8S8Scalar(const uint8_t* a, const int8_t* b, size_t n){
+    int32_t sum = 0;
+    for(size_t i = 0; i < n; i++){
+        sum += (int32_t)a[i] * (int32_t)b[i];
+    }
+    return sum;
+}
+
+#ifdef NN_X86
+//---------------------------------------------------------------- SSE2
+
+NN_TARGET("sse2")
+static int32_t dotU8S8SSE2(const uint8_t* a, const int8_t* b, size_t n){
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        //zero extend a, sign extend b by duplicating each byte and shifting down
+        __m128i aLo = _mm_unpacklo_epi8(va, zero);
+        __m128i aHi = _mm_unpackhi_epi8(va, zero);
+        __m128i bLo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+        __m128i bHi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(aLo, bLo));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(aHi, bHi));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    int32_t sum = _mm_cvtsi128_si32(acc);
+    for(; i < n; i++){
+        sum += (int32_t)a[i] * (int32_t)b[i];
+    }
+    return sum;
+}
+
+//---------------------------------------------------------------- AVX2
+
+NN_TARGET("avx2")
+static inline int32_t horizontalSumAVX2(__m256i v){
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+NN_TARGET("avx2")
+static int32_t dotU8S8AVX2(const uint8_t* a, const int8_t* b, size_t n){
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m256i aLo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256i aHi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i + 16)));
+        __m256i bLo = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+        __m256i bHi = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + i + 16)));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(aLo, bLo));
+        acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(aHi, bHi));
+    }
+    int32_t sum = horizontalSumAVX2(_mm256_add_epi32(acc0, acc1));
+    for(; i < n; i++){
+        sum += (int32_t)a[i] * (int32_t)b[i];
+    }
+    return sum;
+}
+
+//---------------------------------------------------------------- AVX-512 VNNI
+
+NN_TARGET("avx512f,avx512vnni")
+static int32_t dotU8S8VNNI(const uint8_t* a, const int8_t* b, size_t n){
+    __m512i acc0 = _mm512_setzero_si512();
+    __m512i acc1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for(; i + 128 <= n; i += 128){
+        acc0 = _mm512_dpbusd_epi32(acc0, _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        acc1 = _mm512_dpbusd_epi32(acc1, _mm512_loadu_si512(a + i + 64), _mm512_loadu_si512(b + i + 64));
+    }
+    for(; i + 64 <= n; i += 64){
+        acc0 = _mm512_dpbusd_epi32(acc0, _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+    }
+    //fewer than 64 left, a masked byte load would need AVX512BW
+    return _mm512_reduce_add_epi32(_mm512_add_epi32(acc0, acc1)) + dotU8S8AVX2(a + i, b + i, n - i);
+}
+
+#endif // NN_X86
+
+//---------------------------------------------------------------- dispatch
+
+//the caller (kernels.cpp) has already checked that the CPU supports isa and vnni.
+//AVX-512 without VNNI uses the AVX2 kernel, widening to 16 bits needs AVX512BW
+IntegerKernelTable makeIntegerKernelTable(KernelISA isa, bool vnni){
+    IntegerKernelTable table = {"scalar", dotU8S8Scalar};
+#ifdef NN_X86
+    if(isa == KernelISA::SSE2){
+        table = {"sse2", dotU8S8SSE2};
+    }else if(isa == KernelISA::AVX2 || (isa == KernelISA::AVX512 && !vnni)){
+        table = {"avx2", dotU8S8AVX2};
+    }else if(isa == KernelISA::AVX512){
+        table = {"avx512vnni", dotU8S8VNNI};
+    }
+#else
+    (void)isa;
+    (void)vnni;
+#endif
+    return table;
+}
@@ -1,64 +1,538 @@
+#ifndef LAYER_H
+#define LAYER_H
+
 #include "neuron.h"
 #include "activation_functions.h"
+#include "logger.h"
+#include "matrix.h"
+#include "kernels.h"
+#include "optimizer.h"
 #include <vector>
-#include <functional>
 #include <random>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+//per sample state of one layer for a batch of rows, batchSize x size row-major.
+//kept apart from the Layer's parameters so several threads can run the same
+//layer at once, each with its own LayerBatch
+template<typename Scalar>
+struct LayerBatchT{
+    std::vector<Scalar> activations;
+    std::vector<Scalar> derivatives;
+    std::vector<Scalar> deltas;
+    //gradients of the layer's weights and biases, same layout as the LayerT
+    std::vector<Scalar> weightGradients;
+    std::vector<Scalar> biasGradients;
+    int batchSize = 0;
+
+    //only reallocates when the sizes change
+    void resize(int numSamples, int layerSize, int inputSize){
+        if(numSamples != batchSize || activations.size() != (size_t)numSamples * layerSize){
+            batchSize = numSamples;
+            activations.assign((size_t)batchSize * layerSize, 0.0);
+            derivatives.assign((size_t)batchSize * layerSize, 0.0);
+            deltas.assign((size_t)batchSize * layerSize, 0.0);
+        }
+        weightGradients.resize((size_t)layerSize * inputSize);
+        biasGradients.resize(layerSize);
+    }
+};
 
-struct Layer{
+//Scalar is the type of the weights and of every per sample value, double or
+//float. Hyperparameters such as the learning rate stay double
+template<typename Scalar>
+struct LayerT{
     //simple layer storage for separation of logic
     // since some activation functions work at the layer scope
-    std::vector<Neuron> layer;
-    std::function<ActivationResult(double)> activationFunc = leakyRelu;
+    //every buffer is contiguous so the whole layer runs as one matrix-vector
+    //product. weights and historicGradients are size x inputSize, row-major
+    std::vector<Scalar> weights;
+    std::vector<Scalar> historicGradients;
+    std::vector<Scalar> biases;
+    //the rest of the optimizer state (see optimizer.h), allocated when the
+    //optimizer needs it. firstMoments is laid out like weights
+    std::vector<Scalar> firstMoments;
+    std::vector<Scalar> biasFirstMoments;
+    std::vector<Scalar> biasHistoricGradients;
+    //read-only weights inside a memory-mapped model file (see model_file.h).
+    //when set, weights and historicGradients stay empty and the layer only runs inference
+    const Scalar* mappedWeights = nullptr;
+    //CSR form of a pruned layer (see prune), empty while the layer is dense.
+    //Row j keeps the columns sparseColumns[sparseRowStarts[j]..sparseRowStarts[j + 1]),
+    //in increasing order, and sparseValues holds their weights packed. The dense
+    //weights stay the parameters the optimizer trains, with the pruned entries
+    //held at zero, so the batched GEMMs and the model file see an ordinary layer
+    std::vector<int32_t> sparseRowStarts;
+    std::vector<int32_t> sparseColumns;
+    std::vector<Scalar> sparseValues;
+    //the same CSR form inside a memory-mapped model file, used instead of the
+    //vectors above when set so loading never scans the dense weights
+    const int32_t* mappedRowStarts = nullptr;
+    const int32_t* mappedColumns = nullptr;
+    const Scalar* mappedValues = nullptr;
+
+    //per sample state, one entry per neuron
+    std::vector<Scalar> activations;
+    std::vector<Scalar> derivatives;
+    std::vector<Scalar> deltas;
+    std::vector<Scalar> adjustedLearningRates;
+
+    //resolved to a specialized kernel once per layer pass
+    ActivationType activation = ActivationType::LeakyRelu;
 
     int size;
+    int inputSize = 0;
+    bool isOutput;
+
+    LayerT(int numNeurons, bool isOutput = false)
+        : biases(numNeurons, 0.1), activations(numNeurons, 0.0), derivatives(numNeurons, 0.0),
+          deltas(numNeurons, 0.0), adjustedLearningRates(numNeurons, 0.0),
+          size(numNeurons), isOutput(isOutput) {}
+
+    const Scalar* weightData() const {
+        return mappedWeights ? mappedWeights : weights.data();
+    }
+    bool isSparse() const {
+        return mappedRowStarts || !sparseRowStarts.empty();
+    }
+    //the CSR arrays, from the mapping or the vectors. Only for a sparse layer
+    const int32_t* rowStartData() const {
+        return mappedRowStarts ? mappedRowStarts : sparseRowStarts.data();
+    }
+    const int32_t* columnData() const {
+        return mappedRowStarts ? mappedColumns : sparseColumns.data();
+    }
+    const Scalar* sparseValueData() const {
+        return mappedRowStarts ? mappedValues : sparseValues.data();
+    }
+    //weights kept by a sparse layer
+    size_t nonzeroCount() const {
+        return isSparse() ? (size_t)rowStartData()[size] : 0;
+    }
+    //fraction of the weights kept, 1 for a dense layer
+    double density() const {
+        size_t weightCount = (size_t)size * inputSize;
+        return isSparse() && weightCount ? (double)nonzeroCount() / weightCount : 1.0;
+    }
+
+    //magnitude pruning: keeps the round(density * weights) largest weights by
+    //absolute value, zeroes the rest and switches the layer to its CSR form.
+    //Weights pruned earlier are zero, so they stay pruned when a later call
+    //lowers the density further. A density of 1 or more makes the layer dense again
+    bool prune(double targetDensity){
+        size_t weightCount = (size_t)size * inputSize;
+        if(mappedWeights){
+            std::cerr << "Error: a memory-mapped layer cannot be pruned.\n";
+            return false;
+        }
+        if(weightCount == 0){
+            return true;
+        }
+        if(targetDensity >= 1.0){
+            makeDense();
+            return true;
+        }
+        size_t keep = (size_t)std::llround(std::max(targetDensity, 0.0) * weightCount);
+        //the keep-th largest magnitude is the threshold, ties at it are kept in
+        //row order until keep weights are left
+        std::vector<Scalar> magnitudes(weightCount);
+        for(size_t i = 0; i < weightCount; i++){
+            magnitudes[i] = std::abs(weights[i]);
+        }
+        Scalar threshold = std::numeric_limits<Scalar>::infinity();
+        if(keep > 0){
+            std::nth_element(magnitudes.begin(), magnitudes.begin() + (weightCount - keep), magnitudes.end());
+            threshold = magnitudes[weightCount - keep];
+        }
+        size_t above = 0;
+        for(size_t i = 0; i < weightCount; i++){
+            above += std::abs(weights[i]) > threshold ? 1 : 0;
+        }
+        size_t tiesLeft = keep - above;
+        sparseRowStarts.assign(size + 1, 0);
+        sparseColumns.clear();
+        for(int j = 0; j < size; j++){
+            for(int i = 0; i < inputSize; i++){
+                Scalar& weight = weights[(size_t)j * inputSize + i];
+                Scalar magnitude = std::abs(weight);
+                bool kept = magnitude > threshold || (magnitude == threshold && tiesLeft > 0);
+                if(magnitude == threshold && kept){
+                    tiesLeft--;
+                }
+                if(kept){
+                    sparseColumns.push_back(i);
+                }else{
+                    weight = Scalar(0);
+                }
+            }
+            sparseRowStarts[j + 1] = (int32_t)sparseColumns.size();
+        }
+        sparseValues.resize(sparseColumns.size());
+        syncSparseRows(0, size);
+        return true;
+    }
+    //builds the CSR form from the weights that are exactly zero, for a pruned
+    //layer read back from a model file. Stays dense when more than maxDensity
+    //of the weights are nonzero, where the sparse kernels would be slower
+    void compressSparse(double maxDensity = 0.5){
+        size_t weightCount = (size_t)size * inputSize;
+        const Scalar* rows = weightData();
+        if(weightCount == 0 || !rows){
+            return;
+        }
+        size_t nonzero = 0;
+        for(size_t i = 0; i < weightCount; i++){
+            nonzero += rows[i] != Scalar(0) ? 1 : 0;
+        }
+        if((double)nonzero > maxDensity * weightCount){
+            makeDense();
+            return;
+        }
+        sparseRowStarts.assign(size + 1, 0);
+        sparseColumns.clear();
+        sparseValues.clear();
+        sparseColumns.reserve(nonzero);
+        sparseValues.reserve(nonzero);
+        for(int j = 0; j < size; j++){
+            for(int i = 0; i < inputSize; i++){
+                Scalar weight = rows[(size_t)j * inputSize + i];
+                if(weight != Scalar(0)){
+                    sparseColumns.push_back(i);
+                    sparseValues.push_back(weight);
+                }
+            }
+            sparseRowStarts[j + 1] = (int32_t)sparseColumns.size();
+        }
+    }
+    void makeDense(){
+        mappedRowStarts = nullptr;
+        mappedColumns = nullptr;
+        mappedValues = nullptr;
+        sparseRowStarts.clear();
+        sparseColumns.clear();
+        sparseValues.clear();
+    }
+    //replaces the weights and biases, e.g. with a copy taken earlier. A sparse
+    //layer keeps its pattern and zeroes the pruned weights of the copy
+    void setParameters(const std::vector<Scalar>& newWeights, const std::vector<Scalar>& newBiases){
+        weights.assign(newWeights.begin(), newWeights.end());
+        biases.assign(newBiases.begin(), newBiases.end());
+        syncSparseRows(0, size);
+    }
 
-    Layer(int numNeurons, bool isOutput = false){
-        size = numNeurons;
-        for(int i = 0; i < numNeurons; i++){
-            Neuron n(0.1, int(isOutput));
-            layer.push_back(n);
+    //weighted sum of the previous layer followed by the activation function
+    void activate(const LayerT& prevLayer){
+        activateRows(prevLayer, 0, size);
+        finishActivation();
+    }
+    //layer scope part of the activation, once every row is activated
+    void finishActivation(){
+        if(isLayerScope(activation)){
+            softmax(activations.data(), size);
         }
     }
-    void activate(){
-        for(int i = 0; i < size; i++){
-            layer[i].activate();
-            layer[i].delta = 0;
+    //neurons [firstRow, lastRow) only, disjoint ranges can run on different threads.
+    //Layer scope activations still need finishActivation afterwards
+    void activateRows(const LayerT& prevLayer, int firstRow, int lastRow){
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        const Scalar* inputs = prevLayer.activations.data();
+        const Scalar* rows = weightData();
+        if(isSparse()){
+            const int32_t* rowStarts = rowStartData();
+            const int32_t* columns = columnData();
+            const Scalar* values = sparseValueData();
+            for(int j = firstRow; j < lastRow; j++){
+                int32_t start = rowStarts[j];
+                activations[j] = biases[j] + k.sparseDot(values + start, columns + start, inputs,
+                                                         rowStarts[j + 1] - start);
+            }
+        }else{
+            for(int j = firstRow; j < lastRow; j++){
+                activations[j] = biases[j] + k.dot(rows + (size_t)j * inputSize, inputs, inputSize);
+            }
         }
+        k.activation[(int)activation](&activations[firstRow], &activations[firstRow], &derivatives[firstRow], lastRow - firstRow);
+        std::fill(deltas.begin() + firstRow, deltas.begin() + lastRow, 0.0);
     }
-    void setActivation(const std::string& functionName) {
-        if(functionName == "relu") {
-            activationFunc = relu;
-        } else if(functionName == "tanh") {
-            activationFunc = tanH;
-        } else {
-            activationFunc = leakyRelu;
+    //precision Fast switches tanh, sigmoid, gelu and softplus to their
+    //approximations (see ActivationPrecision), the same as a "_fast" name
+    void setActivation(const std::string& functionName, ActivationPrecision precision = ActivationPrecision::Exact) {
+        ActivationType type = activationFromName(functionName);
+        if(precision == ActivationPrecision::Fast){
+            type = withPrecision(type, precision);
         }
-        for(int i = 0; i < layer.size(); i++){
-            layer[i].activationFunc = activationFunc;
+        if(isLayerScope(type) && !isOutput){
+            std::cerr << "Error: " << functionName << " can only be the activation of the output layer.\n";
+            return;
         }
+        activation = type;
     }
-    
-    void setupReferences(std::vector<std::reference_wrapper<Neuron>> prevLayerNeuronReferences){
+
+    //allocates the weight matrix for a fully connected previous layer. seed 0
+    //draws the starting weights from std::random_device, any other seed always
+    //gives the same ones
+    void setupWeights(int prevLayerSize, uint64_t seed = 0){
         std::random_device rd;
-        std::mt19937 gen(rd());
+        std::mt19937 gen(seed ? (std::mt19937::result_type)seed : rd());
 
         // Create a uniform real distribution between with a standard deviation
-        double standardDev = std::sqrt(2.0/prevLayerNeuronReferences.size());
+        double standardDev = std::sqrt(2.0/prevLayerSize);
         std::normal_distribution<double> dis(0.0, standardDev);
-        for(int i = 0; i < size; i++){
-            
-            for(int j = 0; j < prevLayerNeuronReferences.size(); j++){
-                layer[i].weights.push_back(dis(gen));
-                layer[i].historicGradients.push_back(1.0);
+
+        inputSize = prevLayerSize;
+        weights.resize((size_t)size * inputSize);
+        historicGradients.assign((size_t)size * inputSize, 1.0);
+        for(size_t i = 0; i < weights.size(); i++){
+            weights[i] = (Scalar)dis(gen);
+        }
+    }
+
+    //output layer starts the backprop from the targets, hidden layers already
+    //have the accumulated deltas from the layer after them
+    void computeDeltas(const std::vector<Scalar>& expectedValues){
+        computeDeltas(expectedValues.data(), nullptr);
+    }
+    //label is the class of a one-hot target, used instead of expectedValues when set.
+    //Softmax outputs are trained with cross-entropy, whose gradient through the
+    //softmax is p - y, so their derivative is never applied
+    void computeDeltas(const Scalar* expectedValues, const int* label){
+        if(isOutput){
+            outputDeltas(activations.data(), derivatives.data(), deltas.data(), expectedValues, label);
+        }else{
+            for(int j = 0; j < size; j++){
+                deltas[j] *= derivatives[j];
             }
-            layer[i].input_neurons = prevLayerNeuronReferences;
         }
+    }
 
+    //passes this layer's deltas back through the weights (W^T * delta).
+    //row-major rows are scaled and added so every access is contiguous
+    void propagateDeltas(LayerT& prevLayer){
+        propagateDeltaColumns(prevLayer, 0, inputSize);
+    }
+    //gather form for previous layer neurons [firstColumn, lastColumn) only. Each
+    //range owns its slice of prevLayer.deltas so ranges can run on different threads
+    void propagateDeltaColumns(LayerT& prevLayer, int firstColumn, int lastColumn){
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        Scalar* prevDeltas = &prevLayer.deltas[firstColumn];
+        const Scalar* rows = weightData();
+        std::fill(prevDeltas, prevDeltas + (lastColumn - firstColumn), 0.0);
+        if(isSparse()){
+            //the kept columns of every row that fall in the range, found by
+            //binary search unless the range is the whole row
+            bool wholeRow = firstColumn == 0 && lastColumn == inputSize;
+            for(int j = 0; j < size; j++){
+                const int32_t* first = sparseColumns.data() + sparseRowStarts[j];
+                const int32_t* last = sparseColumns.data() + sparseRowStarts[j + 1];
+                if(!wholeRow){
+                    first = std::lower_bound(first, last, firstColumn);
+                    last = std::lower_bound(first, last, lastColumn);
+                }
+                k.sparseAxpy(deltas[j], &sparseValues[first - sparseColumns.data()], first, prevLayer.deltas.data(), last - first);
+            }
+            return;
+        }
+        for(int j = 0; j < size; j++){
+            k.axpy(deltas[j], rows + (size_t)j * inputSize + firstColumn, prevDeltas, lastColumn - firstColumn);
+        }
     }
-    Neuron& getConnection(int neuronIndex){
-        return layer[neuronIndex];
+
+    //allocates the optimizer state that optimizer needs and the layer does not
+    //have yet. reset puts all of it back to the optimizer's starting values
+    void prepareOptimizer(const Optimizer& optimizer, bool reset = false){
+        size_t weightCount = (size_t)size * inputSize;
+        if(mappedWeights || weightCount == 0){
+            return;
+        }
+        OptimizerType biasType = optimizer.biasType();
+        Scalar initialSecond = (Scalar)optimizer.initialSecondMoment();
+        if(optimizer.usesFirstMoments(optimizer.type) && (reset || firstMoments.size() != weightCount)){
+            firstMoments.assign(weightCount, 0.0);
+        }
+        if(reset || historicGradients.size() != weightCount){
+            historicGradients.assign(weightCount, initialSecond);
+        }
+        if(optimizer.usesFirstMoments(biasType) && (reset || biasFirstMoments.size() != (size_t)size)){
+            biasFirstMoments.assign(size, 0.0);
+        }
+        if(optimizer.usesSecondMoments(biasType) && (reset || biasHistoricGradients.size() != (size_t)size)){
+            biasHistoricGradients.assign(size, initialSecond);
+        }
+    }
+
+    //one optimizer step from the current sample, expects computeDeltas to have been called
+    void backPropagate(LayerT& prevLayer, const Optimizer& optimizer, const OptimizerStep& step, bool propagate = true){
+        if(propagate){
+            propagateDeltas(prevLayer);
+        }
+        updateRows(prevLayer, optimizer, step, 0, size);
+    }
+    //update of neurons [firstRow, lastRow), deltas must already be propagated.
+    //The gradient of row j is deltas[j] * the previous activations, so it is
+    //formed inside the kernel instead of being stored
+    void updateRows(const LayerT& prevLayer, const Optimizer& optimizer, const OptimizerStep& step, int firstRow, int lastRow){
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        OptimizerKernelT<Scalar> update = k.optimizer[(int)optimizer.type];
+        const Scalar* inputs = prevLayer.activations.data();
+        for(int j = firstRow; j < lastRow; j++){
+            size_t offset = (size_t)j * inputSize;
+            if(NN_LOG_ENABLED(LogLevel::Trace, LOG_OPTIMIZER)){
+                logUpdate(j, inputs, optimizer, step);
+            }
+            adjustedLearningRates[j] = update(&weights[offset], stateAt(firstMoments, offset), stateAt(historicGradients, offset),
+                                              inputs, deltas[j], step, inputSize);
+        }
+        syncSparseRows(firstRow, lastRow);
+        //the bias gradients are the deltas themselves
+        updateBiases(&deltas[firstRow], optimizer, step, firstRow, lastRow);
+    }
+
+    //Z = X * W^T as one blocked GEMM, then bias and activation per element
+    void activateBatch(const LayerBatchT<Scalar>& prevState, LayerBatchT<Scalar>& state) const {
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        ActivationKernelT<Scalar> activationKernel = k.activation[(int)activation];
+        matMulNT(state.batchSize, size, inputSize, Scalar(1), prevState.activations.data(), weightData(), state.activations.data());
+        for(int n = 0; n < state.batchSize; n++){
+            Scalar* z = &state.activations[(size_t)n * size];
+            k.axpy(Scalar(1), biases.data(), z, size);
+            activationKernel(z, z, &state.derivatives[(size_t)n * size], size);
+            if(isLayerScope(activation)){
+                softmax(z, size);
+            }
+        }
+    }
+
+    //same as computeDeltas for every sample in the batch. expectedValues is
+    //batchSize x size, or labels has one class per sample, and only the output
+    //layer reads them
+    void computeBatchDeltas(LayerBatchT<Scalar>& state, const Scalar* expectedValues, const int* labels = nullptr) const {
+        size_t count = (size_t)state.batchSize * size;
+        if(isOutput){
+            for(int n = 0; n < state.batchSize; n++){
+                size_t offset = (size_t)n * size;
+                outputDeltas(&state.activations[offset], &state.derivatives[offset], &state.deltas[offset],
+                             labels ? nullptr : expectedValues + offset, labels ? labels + n : nullptr);
+            }
+        }else{
+            for(size_t k = 0; k < count; k++){
+                state.deltas[k] *= state.derivatives[k];
+            }
+        }
+    }
+
+    //prevDeltas = Delta * W
+    void propagateBatchDeltas(const LayerBatchT<Scalar>& state, LayerBatchT<Scalar>& prevState) const {
+        matMulNN(state.batchSize, inputSize, size, Scalar(1), state.deltas.data(), weightData(), prevState.deltas.data());
+    }
+
+    //weightGradients = scale * Delta^T * X, biasGradients = scale * column sums of Delta.
+    //scale is 1 / the full batch size so slices of one batch can be summed afterwards
+    void accumulateGradients(LayerBatchT<Scalar>& state, const LayerBatchT<Scalar>& prevState, Scalar scale) const {
+        std::fill(state.biasGradients.begin(), state.biasGradients.end(), 0.0);
+        matMulTN(size, inputSize, state.batchSize, scale, state.deltas.data(), prevState.activations.data(), state.weightGradients.data());
+        for(int n = 0; n < state.batchSize; n++){
+            const Scalar* delta = &state.deltas[(size_t)n * size];
+            for(int j = 0; j < size; j++){
+                state.biasGradients[j] += delta[j] * scale;
+            }
+        }
+    }
+
+    //optimizer update of rows [firstRow, lastRow) from the gradients in state,
+    //disjoint row ranges can be updated from different threads
+    void applyGradients(const LayerBatchT<Scalar>& state, const Optimizer& optimizer, const OptimizerStep& step,
+                        int firstRow = 0, int lastRow = -1){
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        OptimizerKernelT<Scalar> update = k.optimizer[(int)optimizer.type];
+        if(lastRow < 0){
+            lastRow = size;
+        }
+        for(int j = firstRow; j < lastRow; j++){
+            size_t offset = (size_t)j * inputSize;
+            adjustedLearningRates[j] = update(&weights[offset], stateAt(firstMoments, offset), stateAt(historicGradients, offset),
+                                              &state.weightGradients[offset], 1.0, step, inputSize);
+        }
+        syncSparseRows(firstRow, lastRow);
+        updateBiases(&state.biasGradients[firstRow], optimizer, step, firstRow, lastRow);
+    }
+
+    //view of a single neuron for debugging and printing. For a mapped layer the
+    //weights must not be written through the view and historicGradients is null
+    NeuronT<Scalar> getConnection(int neuronIndex){
+        size_t offset = (size_t)neuronIndex * inputSize;
+        Scalar* historic = historicGradients.empty() ? nullptr : historicGradients.data() + offset;
+        return NeuronT<Scalar>(const_cast<Scalar*>(weightData()) + offset, historic, inputSize,
+                      biases[neuronIndex], activations[neuronIndex], adjustedLearningRates[neuronIndex],
+                      derivatives[neuronIndex], deltas[neuronIndex], int(isOutput));
+    }
+
+private:
+    //(a - y) * derivative of one sample, y one-hot at *label when it is set
+    void outputDeltas(const Scalar* act, const Scalar* der, Scalar* delta, const Scalar* expectedValues, const int* label) const {
+        bool crossEntropy = activation == ActivationType::Softmax;
+        if(label){
+            for(int j = 0; j < size; j++){
+                delta[j] = crossEntropy ? act[j] : act[j] * der[j];
+            }
+            delta[*label] = crossEntropy ? act[*label] - Scalar(1) : (act[*label] - Scalar(1)) * der[*label];
+            return;
+        }
+        for(int j = 0; j < size; j++){
+            delta[j] = crossEntropy ? act[j] - expectedValues[j] : (act[j] - expectedValues[j]) * der[j];
+        }
+    }
+    //after a dense update of rows [firstRow, lastRow) of a sparse layer: puts
+    //the pruned weights back to zero and repacks the kept ones into sparseValues
+    void syncSparseRows(int firstRow, int lastRow){
+        if(!isSparse()){
+            return;
+        }
+        for(int j = firstRow; j < lastRow; j++){
+            Scalar* row = &weights[(size_t)j * inputSize];
+            int next = 0;
+            for(int32_t p = sparseRowStarts[j]; p < sparseRowStarts[j + 1]; p++){
+                int column = sparseColumns[p];
+                std::fill(row + next, row + column, Scalar(0));
+                sparseValues[p] = row[column];
+                next = column + 1;
+            }
+            std::fill(row + next, row + inputSize, Scalar(0));
+        }
+    }
+    static Scalar* stateAt(std::vector<Scalar>& state, size_t offset){
+        return state.empty() ? nullptr : state.data() + offset;
+    }
+    void updateBiases(const Scalar* gradients, const Optimizer& optimizer, const OptimizerStep& step, int firstRow, int lastRow){
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        k.optimizer[(int)optimizer.biasType()](&biases[firstRow], stateAt(biasFirstMoments, firstRow),
+                                               stateAt(biasHistoricGradients, firstRow), gradients, 1.0, step, lastRow - firstRow);
+    }
+    //the rate is the one RMSProp and Adam derive from the squared gradients,
+    //the plain learning rate for the other rules
+    void logUpdate(int neuronIndex, const Scalar* inputs, const Optimizer& optimizer, const OptimizerStep& step){
+        const Scalar* row = &weights[(size_t)neuronIndex * inputSize];
+        const Scalar* historic = &historicGradients[(size_t)neuronIndex * inputSize];
+        double delta = deltas[neuronIndex];
+        for(int i = 0; i < inputSize; i++){
+            double currentGradient = delta * inputs[i];
+            double adjustedLearningRate = step.learningRate;
+            if(optimizer.usesSecondMoments(optimizer.type)){
+                double second = historic[i] * step.correction2;
+                adjustedLearningRate = std::min(step.learningRate / (std::sqrt(second) + step.epsilon), step.maxRate);
+            }
+            Logger::write(LogLevel::Trace, LOG_OPTIMIZER,
+                          "Neuron: {} Prev Layer Neuron: {} Delta: {} Weight: {} Historic Gradient: {} Current Gradient: {} Adjusted Learning Rate: {} Weight Adjustment: {}",
+                          neuronIndex, i, delta, row[i], historic[i], currentGradient, adjustedLearningRate, adjustedLearningRate * currentGradient);
+        }
     }
+};
 
-    
+typedef LayerBatchT<double> LayerBatch;
+typedef LayerBatchT<float> LayerBatchF;
+typedef LayerT<double> Layer;
+typedef LayerT<float> LayerF;
 
-};
\ No newline at end of file
+#endif // LAYER_H
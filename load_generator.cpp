@@ -0,0 +1,41 @@
+#include "server.h"
+#include <cstdlib>
+
+//drives an nn_server with concurrent clients and reports throughput and latency.
+//  nn_loadgen [--unix path | --port n] [--connections n] [--rows n] [--seconds s] [--seed n]
+//every connection sends --rows random rows per request, the next request as
+//soon as the last response is in
+
+int main(int argc, char** argv){
+    LoadOptions options;
+    bool hasTarget = false;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--unix" && hasValue){
+            options.socketPath = argv[++i];
+            hasTarget = true;
+        }else if(arg == "--port" && hasValue){
+            options.port = std::atoi(argv[++i]);
+            hasTarget = true;
+        }else if(arg == "--connections" && hasValue){
+            options.connections = std::atoi(argv[++i]);
+        }else if(arg == "--rows" && hasValue){
+            options.rowsPerRequest = std::atoi(argv[++i]);
+        }else if(arg == "--seconds" && hasValue){
+            options.seconds = std::atof(argv[++i]);
+        }else if(arg == "--seed" && hasValue){
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        }else{
+            hasTarget = false;
+            break;
+        }
+    }
+    if(!hasTarget){
+        std::cerr << "Usage: nn_loadgen [--unix path | --port n] [--connections n] [--rows n] [--seconds s] [--seed n]\n";
+        return 1;
+    }
+    LoadResult result = generateLoad(options);
+    printLoadResult(result, std::cout);
+    return result.ok ? 0 : 1;
+}
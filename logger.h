@@ -5,40 +5,350 @@
 #include <string>
 #include <mutex>
 #include <stdexcept>
-bool isLogging = true;
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <type_traits>
+
+enum class LogLevel : uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+//categories are bit flags so a filter can enable any combination
+enum LogCategory : uint32_t {
+    LOG_GENERAL = 1u << 0,
+    LOG_FORWARD = 1u << 1,
+    LOG_BACKPROP = 1u << 2,
+    LOG_OPTIMIZER = 1u << 3,
+    LOG_DATA = 1u << 4,
+    LOG_TRAINING = 1u << 5,
+    LOG_ALL = 0xffffffffu
+};
+
+//levels below NN_LOG_MIN_LEVEL are removed at compile time. Release builds drop
+//everything unless the build defines NN_LOG_MIN_LEVEL itself (0 keeps trace)
+#ifndef NN_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define NN_LOG_MIN_LEVEL 5
+#else
+#define NN_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+//one load and one branch when the level/category is filtered out, the
+//arguments are only evaluated when the record is actually written
+#define NN_LOG_ENABLED(level, category) \
+    ((int)(level) >= NN_LOG_MIN_LEVEL && Logger::enabled(level, category))
+#define NN_LOG(level, category, ...) \
+    do { if(NN_LOG_ENABLED(level, category)) Logger::write(level, category, __VA_ARGS__); } while(0)
+
+//single formatting argument stored by value in a record
+struct LogArg {
+    enum Type : uint8_t { Int, Double, StaticString, Text };
+    Type type;
+    union {
+        long long intValue;
+        double doubleValue;
+        const char* stringValue;
+        uint32_t textOffset;
+    };
+};
+
+//fixed size binary record. The format string must be a string literal, "{}"
+//marks where each argument goes. std::string arguments are copied into text
+const int LOG_MAX_ARGS = 8;
+const int LOG_TEXT_SIZE = 96;
+struct LogRecord {
+    long long timestamp;
+    const char* format;
+    uint32_t category;
+    LogLevel level;
+    uint8_t argCount;
+    uint16_t textUsed;
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+};
+
+//producers write records into a bounded lock-free ring buffer, a background
+//thread formats them and writes the log file. A full ring drops the record
+//instead of blocking training and the drop count is reported in the file
 class Logger {
 public:
+    static bool enabled(LogLevel level, uint32_t category) {
+        return (levelMasks[(int)level].load(std::memory_order_relaxed) & category) != 0;
+    }
+
+    //minimum level that is written, LogLevel::Off disables everything
+    static void setLevel(LogLevel level) {
+        minLevel = level;
+        updateMasks();
+    }
+    //bitwise or of LogCategory values that are written
+    static void setCategories(uint32_t categories) {
+        categoryMask = categories;
+        updateMasks();
+    }
+
+    template<typename... Args>
+    static void write(LogLevel level, uint32_t category, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+        instance().push(level, category, format, args...);
+    }
+
     // Log a message to the default log file.
-    
+    // kept for older call sites, the message is copied into the record and truncated if needed
     static void log(const std::string &message) {
-        if(!isLogging){
-            return;
-        }
-        std::lock_guard<std::mutex> lock(mtx);
-        // Open the file if it isn't already open.
-        if (!logFile.is_open()) {
-            logFile.open(filePath, std::ios::out | std::ios::trunc);
-            if (!logFile) {
-                throw std::runtime_error("Failed to open log file: " + filePath);
-            }
-        }
-        logFile << message << std::endl;
+        NN_LOG(LogLevel::Info, LOG_GENERAL, "{}", message);
     }
-    
+
     // Optionally, change the default file path at runtime.
     static void setFilePath(const std::string &newFilePath) {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (logFile.is_open()) {
-            logFile.close();
-        }
+        std::lock_guard<std::mutex> lock(pathMtx);
         filePath = newFilePath;
+        pathChanged = true;
     }
 
+    //blocks until every record pushed so far is in the file
+    static void flush() {
+        instance().waitForDrain();
+    }
+
+    static unsigned long long droppedRecords() {
+        return instance().dropped.load();
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
 private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    static const size_t RING_SIZE = 8192;
+
     // Default log file path.
     inline static std::string filePath = "./log/default_log.txt";
-    inline static std::ofstream logFile;
-    inline static std::mutex mtx;
+    inline static bool pathChanged = false;
+    inline static std::mutex pathMtx;
+    inline static LogLevel minLevel = LogLevel::Trace;
+    inline static uint32_t categoryMask = LOG_ALL;
+    //levelMasks[level] is categoryMask if level is written, 0 otherwise
+    inline static std::atomic<uint32_t> levelMasks[(int)LogLevel::Off + 1] = {
+        {LOG_ALL}, {LOG_ALL}, {LOG_ALL}, {LOG_ALL}, {LOG_ALL}, {0}
+    };
+
+    std::vector<Cell> cells;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;
+    std::atomic<unsigned long long> dropped{0};
+    std::atomic<size_t> written{0};
+    std::atomic<bool> stopping{false};
+    std::ofstream logFile;
+    bool openFailed = false;
+    std::thread drainThread;
+
+    Logger() : cells(RING_SIZE) {
+        for(size_t i = 0; i < RING_SIZE; i++){
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        drainThread = std::thread([this](){ drainLoop(); });
+    }
+    ~Logger() {
+        stopping.store(true);
+        drainThread.join();
+    }
+
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    static void updateMasks() {
+        for(int level = 0; level < (int)LogLevel::Off; level++){
+            levelMasks[level].store(level >= (int)minLevel ? categoryMask : 0u, std::memory_order_relaxed);
+        }
+    }
+
+    static void setArg(LogRecord&, LogArg& arg, long long value) {
+        arg.type = LogArg::Int;
+        arg.intValue = value;
+    }
+    static void setArg(LogRecord&, LogArg& arg, double value) {
+        arg.type = LogArg::Double;
+        arg.doubleValue = value;
+    }
+    static void setArg(LogRecord&, LogArg& arg, const char* value) {
+        arg.type = LogArg::StaticString;
+        arg.stringValue = value;
+    }
+    static void setArg(LogRecord& record, LogArg& arg, const std::string& value) {
+        if(record.textUsed >= LOG_TEXT_SIZE){
+            setArg(record, arg, "");
+            return;
+        }
+        size_t room = LOG_TEXT_SIZE - record.textUsed - 1;
+        size_t length = value.size() < room ? value.size() : room;
+        std::memcpy(record.text + record.textUsed, value.data(), length);
+        record.text[record.textUsed + length] = '\0';
+        arg.type = LogArg::Text;
+        arg.textOffset = record.textUsed;
+        record.textUsed += (uint16_t)(length + 1);
+    }
+    template<typename T>
+    static void setArg(LogRecord& record, LogArg& arg, const T& value) {
+        static_assert(std::is_arithmetic<T>::value || std::is_convertible<const T&, const char*>::value,
+                      "log arguments must be numbers, string literals or std::string");
+        if constexpr(std::is_convertible<const T&, const char*>::value){
+            setArg(record, arg, (const char*)value);
+        }else if constexpr(std::is_floating_point<T>::value){
+            setArg(record, arg, (double)value);
+        }else{
+            setArg(record, arg, (long long)value);
+        }
+    }
+
+    template<typename... Args>
+    void push(LogLevel level, uint32_t category, const char* format, const Args&... args) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while(true){
+            cell = &cells[pos & (RING_SIZE - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            long long diff = (long long)sequence - (long long)pos;
+            if(diff == 0){
+                if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    break;
+                }
+            }else if(diff < 0){
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }else{
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        LogRecord& record = cell->record;
+        record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        record.format = format;
+        record.category = category;
+        record.level = level;
+        record.argCount = 0;
+        record.textUsed = 0;
+        ((setArg(record, record.args[record.argCount], args), record.argCount++), ...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    bool pop(std::string& line) {
+        Cell& cell = cells[dequeuePos & (RING_SIZE - 1)];
+        if(cell.sequence.load(std::memory_order_acquire) != dequeuePos + 1){
+            return false;
+        }
+        format(cell.record, line);
+        cell.sequence.store(dequeuePos + RING_SIZE, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+
+    static void format(const LogRecord& record, std::string& line) {
+        static const char* levelNames[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+        char number[32];
+        line.clear();
+        line += '[';
+        line += levelNames[(int)record.level];
+        line += "] ";
+        int argIndex = 0;
+        for(const char* c = record.format; *c; c++){
+            if(c[0] == '{' && c[1] == '}' && argIndex < record.argCount){
+                const LogArg& arg = record.args[argIndex++];
+                switch(arg.type){
+                    case LogArg::Int:
+                        std::snprintf(number, sizeof(number), "%lld", arg.intValue);
+                        line += number;
+                        break;
+                    case LogArg::Double:
+                        std::snprintf(number, sizeof(number), "%.6f", arg.doubleValue);
+                        line += number;
+                        break;
+                    case LogArg::StaticString:
+                        line += arg.stringValue;
+                        break;
+                    case LogArg::Text:
+                        line += record.text + arg.textOffset;
+                        break;
+                }
+                c++;
+            }else{
+                line += *c;
+            }
+        }
+        line += '\n';
+    }
+
+    void openFile() {
+        std::lock_guard<std::mutex> lock(pathMtx);
+        //a path that failed is not retried until it changes
+        if((logFile.is_open() || openFailed) && !pathChanged){
+            return;
+        }
+        if(logFile.is_open()){
+            logFile.close();
+        }
+        pathChanged = false;
+        logFile.open(filePath, std::ios::out | std::ios::trunc);
+        openFailed = !logFile;
+        if (openFailed) {
+            std::fprintf(stderr, "Failed to open log file: %s\n", filePath.c_str());
+        }
+    }
+
+    void drainLoop() {
+        std::string line;
+        unsigned long long reportedDrops = 0;
+        while(true){
+            bool any = false;
+            while(pop(line)){
+                if(!any){
+                    openFile();
+                    any = true;
+                }
+                logFile << line;
+                written.fetch_add(1, std::memory_order_release);
+            }
+            unsigned long long drops = dropped.load(std::memory_order_relaxed);
+            if(drops != reportedDrops && logFile.is_open()){
+                logFile << "[WARN] " << (drops - reportedDrops) << " log records dropped, ring buffer full\n";
+                reportedDrops = drops;
+            }
+            if(any){
+                //newline instead of std::endl, the file is flushed once per drained burst
+                logFile.flush();
+                continue;
+            }
+            if(stopping.load()){
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void waitForDrain() {
+        //dropped records never claimed a slot so they are not part of the target
+        size_t target = enqueuePos.load();
+        while(written.load(std::memory_order_acquire) < target){
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
 };
 
 #endif // LOGGER_H
@@ -0,0 +1,83 @@
+#include "network.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//every heap allocation of the program is counted for --check-allocations
+static std::atomic<unsigned long long> heapAllocations{0};
+
+void* operator new(std::size_t size){
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* memory = std::malloc(size ? size : 1)){
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+static unsigned long long allocationCount(){
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+int main(int argc, char** argv){
+    Logger::setLevel(LogLevel::Off);
+    //--check-precision compares the float and double networks instead of running the demo
+    if(argc > 1 && std::string(argv[1]) == "--check-precision"){
+        return precisionTest() ? 0 : 1;
+    }
+    //--check-quantization checks the int8 network's error against the double one
+    if(argc > 1 && std::string(argv[1]) == "--check-quantization"){
+        return quantizationTest() ? 0 : 1;
+    }
+    //--check-allocations fails if a training or inference step touches the heap
+    if(argc > 1 && std::string(argv[1]) == "--check-allocations"){
+        return allocationTest(allocationCount) ? 0 : 1;
+    }
+    //--check-checkpoint fails if resuming from a checkpoint does not continue training exactly
+    if(argc > 1 && std::string(argv[1]) == "--check-checkpoint"){
+        return checkpointTest() ? 0 : 1;
+    }
+    //--check-softmax compares label and one-hot training and the iris accuracy with and without softmax
+    if(argc > 1 && std::string(argv[1]) == "--check-softmax"){
+        return softmaxTest() ? 0 : 1;
+    }
+    //--check-sparse prunes to 10% density and compares the sparse kernels with the dense ones
+    if(argc > 1 && std::string(argv[1]) == "--check-sparse"){
+        return pruneTest() ? 0 : 1;
+    }
+    //--sweep [threads] trains a population of iris networks concurrently with successive halving
+    if(argc > 1 && std::string(argv[1]) == "--sweep"){
+        return populationTest(argc > 2 ? std::atoi(argv[2]) : 0) ? 0 : 1;
+    }
+    //--check-ensemble compares a lockstep ensemble with separately trained networks
+    if(argc > 1 && std::string(argv[1]) == "--check-ensemble"){
+        return ensembleTest() ? 0 : 1;
+    }
+    //--check-activations measures the fast activations' errors and speed against the exact ones
+    if(argc > 1 && std::string(argv[1]) == "--check-activations"){
+        return activationTest() ? 0 : 1;
+    }
+    //--check-server runs the inference server against its own clients and load generator
+    if(argc > 1 && std::string(argv[1]) == "--check-server"){
+        return serverTest() ? 0 : 1;
+    }
+    //--check-schedule compares learning rate schedules with early stopping by time to a target accuracy
+    if(argc > 1 && std::string(argv[1]) == "--check-schedule"){
+        return scheduleTest() ? 0 : 1;
+    }
+    //--profile [trace.json] prints per layer timings of a short training run and writes a Chrome trace
+    if(argc > 1 && std::string(argv[1]) == "--profile"){
+        profileTest(argc > 2 ? argv[2] : "profile_trace.json");
+        return 0;
+    }
+    //simpleTest(); //for testing basic functionality with fixed data
+    hardTest(); //for testing more complicated functionality with variable data
+
+    //hold();
+    return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cstddef>
+#include <algorithm>
+#include "kernels.h"
+
+//cache blocked matrix kernels for the batched passes. All matrices are
+//row-major and every kernel overwrites its output (C = alpha * op(A) * op(B)).
+//block sizes keep one panel of each operand resident in L1/L2 while it is reused.
+//Scalar is double or float and picks the matching kernel table
+constexpr int GEMM_BLOCK_M = 64;
+constexpr int GEMM_BLOCK_N = 256;
+constexpr int GEMM_BLOCK_K = 128;
+
+//C (M x N) = alpha * A (M x K) * B (K x N)
+template<typename Scalar>
+inline void matMulNN(int M, int N, int K, Scalar alpha, const Scalar* A, const Scalar* B, Scalar* C){
+    const KernelTableT<Scalar>& kernel = kernelsFor<Scalar>();
+    std::fill(C, C + (size_t)M * N, Scalar(0));
+    for(int i0 = 0; i0 < M; i0 += GEMM_BLOCK_M){
+        int i1 = std::min(i0 + GEMM_BLOCK_M, M);
+        for(int k0 = 0; k0 < K; k0 += GEMM_BLOCK_K){
+            int k1 = std::min(k0 + GEMM_BLOCK_K, K);
+            for(int j0 = 0; j0 < N; j0 += GEMM_BLOCK_N){
+                int j1 = std::min(j0 + GEMM_BLOCK_N, N);
+                for(int i = i0; i < i1; i++){
+                    Scalar* c = C + (size_t)i * N;
+                    for(int k = k0; k < k1; k++){
+                        Scalar a = alpha * A[(size_t)i * K + k];
+                        kernel.axpy(a, B + (size_t)k * N + j0, c + j0, j1 - j0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+//C (M x N) = alpha * A (M x K) * B^T, B is stored as N x K
+template<typename Scalar>
+inline void matMulNT(int M, int N, int K, Scalar alpha, const Scalar* A, const Scalar* B, Scalar* C){
+    const KernelTableT<Scalar>& kernel = kernelsFor<Scalar>();
+    std::fill(C, C + (size_t)M * N, Scalar(0));
+    for(int k0 = 0; k0 < K; k0 += GEMM_BLOCK_K){
+        int k1 = std::min(k0 + GEMM_BLOCK_K, K);
+        for(int i0 = 0; i0 < M; i0 += GEMM_BLOCK_M){
+            int i1 = std::min(i0 + GEMM_BLOCK_M, M);
+            for(int j0 = 0; j0 < N; j0 += GEMM_BLOCK_N){
+                int j1 = std::min(j0 + GEMM_BLOCK_N, N);
+                for(int i = i0; i < i1; i++){
+                    const Scalar* a = A + (size_t)i * K;
+                    Scalar* c = C + (size_t)i * N;
+                    for(int j = j0; j < j1; j++){
+                        c[j] += alpha * kernel.dot(a + k0, B + (size_t)j * K + k0, k1 - k0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+//C (M x N) = alpha * A^T * B (K x N), A is stored as K x M
+template<typename Scalar>
+inline void matMulTN(int M, int N, int K, Scalar alpha, const Scalar* A, const Scalar* B, Scalar* C){
+    const KernelTableT<Scalar>& kernel = kernelsFor<Scalar>();
+    std::fill(C, C + (size_t)M * N, Scalar(0));
+    for(int i0 = 0; i0 < M; i0 += GEMM_BLOCK_M){
+        int i1 = std::min(i0 + GEMM_BLOCK_M, M);
+        for(int j0 = 0; j0 < N; j0 += GEMM_BLOCK_N){
+            int j1 = std::min(j0 + GEMM_BLOCK_N, N);
+            for(int k0 = 0; k0 < K; k0 += GEMM_BLOCK_K){
+                int k1 = std::min(k0 + GEMM_BLOCK_K, K);
+                for(int k = k0; k < k1; k++){
+                    const Scalar* b = B + (size_t)k * N + j0;
+                    for(int i = i0; i < i1; i++){
+                        Scalar a = alpha * A[(size_t)k * M + i];
+                        kernel.axpy(a, b, C + (size_t)i * N + j0, j1 - j0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif // MATRIX_H
@@ -0,0 +1,720 @@
+#include "model_file.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static uint64_t alignUp(uint64_t offset, uint64_t alignment){
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path){
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(handle == INVALID_HANDLE_VALUE){
+        std::cerr << "Error: could not open model file " << path << "\n";
+        return nullptr;
+    }
+    file->fileHandle = handle;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0){
+        std::cerr << "Error: model file " << path << " is empty\n";
+        return nullptr;
+    }
+    file->mappingHandle = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(file->mappingHandle == nullptr){
+        std::cerr << "Error: could not map model file " << path << "\n";
+        return nullptr;
+    }
+    file->bytes = (const unsigned char*)MapViewOfFile(file->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if(file->bytes == nullptr){
+        std::cerr << "Error: could not map model file " << path << "\n";
+        return nullptr;
+    }
+    file->length = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        std::cerr << "Error: could not open model file " << path << "\n";
+        return nullptr;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0){
+        std::cerr << "Error: model file " << path << " is empty\n";
+        ::close(fd);
+        return nullptr;
+    }
+    //the mapping keeps its own reference to the file, the descriptor is not needed after this
+    void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(address == MAP_FAILED){
+        std::cerr << "Error: could not map model file " << path << "\n";
+        return nullptr;
+    }
+    file->bytes = (const unsigned char*)address;
+    file->length = (size_t)info.st_size;
+#endif
+    return file;
+}
+
+MappedFile::~MappedFile(){
+#ifdef _WIN32
+    if(bytes){
+        UnmapViewOfFile(bytes);
+    }
+    if(mappingHandle){
+        CloseHandle(mappingHandle);
+    }
+    if(fileHandle){
+        CloseHandle(fileHandle);
+    }
+#else
+    if(bytes){
+        munmap((void*)bytes, length);
+    }
+#endif
+}
+
+//pads the stream with zeros up to offset
+static void seekForward(std::ofstream& out, uint64_t& position, uint64_t offset){
+    static const char zeros[MODEL_PAGE_ALIGNMENT] = {};
+    while(position < offset){
+        uint64_t count = std::min<uint64_t>(offset - position, sizeof(zeros));
+        out.write(zeros, (std::streamsize)count);
+        position += count;
+    }
+}
+
+template<typename Value>
+static void writeSection(std::ofstream& out, uint64_t& position, uint64_t offset, const Value* values, size_t count){
+    seekForward(out, position, offset);
+    out.write((const char*)values, (std::streamsize)(count * sizeof(Value)));
+    position += count * sizeof(Value);
+}
+template<typename Value>
+static void writeSection(std::ofstream& out, uint64_t& position, uint64_t offset, const std::vector<Value>& values){
+    writeSection(out, position, offset, values.data(), values.size());
+}
+
+//flushes a written file to disk. Directories are synced the same way so a
+//rename inside them is durable too
+static bool syncPath(const std::string& path, bool directory){
+#ifdef _WIN32
+    //NTFS journals the rename itself, only files need flushing
+    if(directory){
+        return true;
+    }
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(handle == INVALID_HANDLE_VALUE){
+        return false;
+    }
+    bool flushed = FlushFileBuffers(handle) != 0;
+    CloseHandle(handle);
+    return flushed;
+#else
+    int fd = ::open(path.c_str(), directory ? O_RDONLY | O_DIRECTORY : O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+    bool flushed = fsync(fd) == 0;
+    ::close(fd);
+    return flushed;
+#endif
+}
+
+static std::string parentDirectory(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    if(slash == std::string::npos){
+        return ".";
+    }
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+template<typename Scalar>
+bool writeModelFile(const std::string& path, const std::vector<LayerT<Scalar>>& layers, int step,
+                    double learningRate, bool includeHistoric, const Optimizer* optimizer, bool sync,
+                    const LearningRateSchedule* schedule, const ValidationProgressT<Scalar>* validation){
+    if(layers.empty()){
+        std::cerr << "Error: No layers in the network.\n";
+        return false;
+    }
+    for(const LayerT<Scalar>& layer: layers){
+        if(layer.mappedWeights != nullptr){
+            includeHistoric = false;
+        }
+    }
+
+    bool includeOptimizer = includeHistoric && optimizer != nullptr;
+    bool includeSchedule = includeOptimizer && schedule != nullptr;
+    //the best weights are only kept once validation has evaluated
+    bool includeBest = includeSchedule && validation != nullptr && validation->bestStep >= 0
+                       && validation->bestWeights.size() == layers.size()
+                       && validation->bestBiases.size() == layers.size();
+    for(size_t i = 1; includeBest && i < layers.size(); i++){
+        includeBest = validation->bestWeights[i].size() == (size_t)layers[i].size * layers[i].inputSize
+                      && validation->bestBiases[i].size() == (size_t)layers[i].size;
+    }
+    bool includeSparse = false;
+    for(size_t i = 1; i < layers.size(); i++){
+        includeSparse = includeSparse || layers[i].isSparse();
+    }
+
+    ModelHeader header = {};
+    std::memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version = MODEL_VERSION;
+    header.byteOrder = MODEL_BYTE_ORDER;
+    header.flags = includeHistoric ? (uint32_t)MODEL_HAS_HISTORIC : 0u;
+    if(std::is_same<Scalar, float>::value){
+        header.flags |= MODEL_FLOAT32;
+    }
+    if(includeOptimizer){
+        header.flags |= MODEL_HAS_OPTIMIZER;
+    }
+    if(includeSchedule){
+        header.flags |= MODEL_HAS_SCHEDULE;
+    }
+    if(includeSparse){
+        header.flags |= MODEL_HAS_SPARSE;
+    }
+    header.numLayers = (uint32_t)layers.size();
+    header.step = step;
+    header.learningRate = learningRate;
+
+    //lay out every section before writing anything
+    std::vector<ModelLayerRecord> records(layers.size());
+    ModelOptimizerRecord optimizerRecord = {};
+    std::vector<ModelOptimizerLayerRecord> optimizerRecords(includeOptimizer ? layers.size() : 0);
+    if(includeOptimizer){
+        optimizerRecord.type = (uint32_t)optimizer->type;
+        optimizerRecord.beta1 = optimizer->beta1;
+        optimizerRecord.beta2 = optimizer->beta2;
+        optimizerRecord.epsilon = optimizer->epsilon;
+        optimizerRecord.weightDecay = optimizer->weightDecay;
+        optimizerRecord.maxRate = optimizer->maxRate;
+        optimizerRecord.updates = optimizer->updates;
+    }
+    ModelScheduleRecord scheduleRecord = {};
+    std::vector<ModelValidationLayerRecord> validationRecords(includeSchedule ? layers.size() : 0);
+    if(includeSchedule){
+        scheduleRecord.type = (uint32_t)schedule->type;
+        scheduleRecord.warmupSteps = schedule->warmupSteps;
+        scheduleRecord.stepSize = schedule->stepSize;
+        scheduleRecord.totalSteps = schedule->totalSteps;
+        scheduleRecord.patience = schedule->patience;
+        scheduleRecord.sinceBest = schedule->sinceBest;
+        scheduleRecord.baseRate = schedule->baseRate;
+        scheduleRecord.factor = schedule->factor;
+        scheduleRecord.minRate = schedule->minRate;
+        scheduleRecord.threshold = schedule->threshold;
+        scheduleRecord.plateauScale = schedule->plateauScale;
+        scheduleRecord.bestScore = schedule->bestScore;
+        ValidationProgressT<Scalar> none;
+        const ValidationProgressT<Scalar>& progress = validation ? *validation : none;
+        scheduleRecord.validationBestStep = includeBest ? progress.bestStep : -1;
+        scheduleRecord.validationSinceBest = progress.sinceBest;
+        scheduleRecord.validationStopped = progress.stopped ? 1 : 0;
+        scheduleRecord.validationBestScore = progress.bestScore;
+    }
+    uint64_t recordBytes = sizeof(ModelHeader) + records.size() * sizeof(ModelLayerRecord);
+    if(includeOptimizer){
+        recordBytes += sizeof(ModelOptimizerRecord) + optimizerRecords.size() * sizeof(ModelOptimizerLayerRecord);
+    }
+    if(includeSchedule){
+        recordBytes += sizeof(ModelScheduleRecord) + validationRecords.size() * sizeof(ModelValidationLayerRecord);
+    }
+    std::vector<ModelSparseLayerRecord> sparseRecords(includeSparse ? layers.size() : 0);
+    recordBytes += sparseRecords.size() * sizeof(ModelSparseLayerRecord);
+    uint64_t offset = recordBytes;
+    for(size_t i = 0; i < layers.size(); i++){
+        const LayerT<Scalar>& layer = layers[i];
+        ModelLayerRecord& record = records[i];
+        uint64_t weightBytes = (uint64_t)layer.size * layer.inputSize * sizeof(Scalar);
+        record.size = (uint32_t)layer.size;
+        record.inputSize = (uint32_t)layer.inputSize;
+        record.activation = (uint32_t)layer.activation;
+        record.isOutput = layer.isOutput ? 1 : 0;
+        offset = alignUp(offset, MODEL_PAGE_ALIGNMENT);
+        record.weightsOffset = offset;
+        offset += weightBytes;
+        offset = alignUp(offset, MODEL_SECTION_ALIGNMENT);
+        record.biasesOffset = offset;
+        offset += (uint64_t)layer.size * sizeof(Scalar);
+        record.historicOffset = 0;
+        if(includeHistoric){
+            offset = alignUp(offset, MODEL_PAGE_ALIGNMENT);
+            record.historicOffset = offset;
+            offset += weightBytes;
+        }
+        if(!includeOptimizer){
+            continue;
+        }
+        //layers only have the arrays their optimizer uses
+        ModelOptimizerLayerRecord& state = optimizerRecords[i];
+        state = {};
+        size_t weightCount = (size_t)layer.size * layer.inputSize;
+        if(weightCount > 0 && layer.firstMoments.size() == weightCount){
+            offset = alignUp(offset, MODEL_PAGE_ALIGNMENT);
+            state.firstMomentsOffset = offset;
+            offset += weightBytes;
+        }
+        if(weightCount > 0 && layer.biasFirstMoments.size() == (size_t)layer.size){
+            offset = alignUp(offset, MODEL_SECTION_ALIGNMENT);
+            state.biasFirstMomentsOffset = offset;
+            offset += (uint64_t)layer.size * sizeof(Scalar);
+        }
+        if(weightCount > 0 && layer.biasHistoricGradients.size() == (size_t)layer.size){
+            offset = alignUp(offset, MODEL_SECTION_ALIGNMENT);
+            state.biasHistoricOffset = offset;
+            offset += (uint64_t)layer.size * sizeof(Scalar);
+        }
+        if(includeSchedule && includeBest && weightCount > 0){
+            ModelValidationLayerRecord& best = validationRecords[i];
+            offset = alignUp(offset, MODEL_PAGE_ALIGNMENT);
+            best.bestWeightsOffset = offset;
+            offset += weightBytes;
+            offset = alignUp(offset, MODEL_SECTION_ALIGNMENT);
+            best.bestBiasesOffset = offset;
+            offset += (uint64_t)layer.size * sizeof(Scalar);
+        }
+    }
+    //after the optimizer state, which the loop above skips for a file without it
+    for(size_t i = 1; includeSparse && i < layers.size(); i++){
+        const LayerT<Scalar>& layer = layers[i];
+        if(!layer.isSparse()){
+            continue;
+        }
+        ModelSparseLayerRecord& sparse = sparseRecords[i];
+        sparse.nonzeros = layer.nonzeroCount();
+        offset = alignUp(offset, MODEL_PAGE_ALIGNMENT);
+        sparse.rowStartsOffset = offset;
+        offset += ((uint64_t)layer.size + 1) * sizeof(int32_t);
+        offset = alignUp(offset, MODEL_SECTION_ALIGNMENT);
+        sparse.columnsOffset = offset;
+        offset += sparse.nonzeros * sizeof(int32_t);
+        offset = alignUp(offset, MODEL_SECTION_ALIGNMENT);
+        sparse.valuesOffset = offset;
+        offset += sparse.nonzeros * sizeof(Scalar);
+    }
+    header.fileSize = offset;
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if(!out){
+        std::cerr << "Error: could not open " << tempPath << " for writing\n";
+        return false;
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)records.data(), (std::streamsize)(records.size() * sizeof(ModelLayerRecord)));
+    if(includeOptimizer){
+        out.write((const char*)&optimizerRecord, sizeof(optimizerRecord));
+        out.write((const char*)optimizerRecords.data(),
+                  (std::streamsize)(optimizerRecords.size() * sizeof(ModelOptimizerLayerRecord)));
+    }
+    if(includeSchedule){
+        out.write((const char*)&scheduleRecord, sizeof(scheduleRecord));
+        out.write((const char*)validationRecords.data(),
+                  (std::streamsize)(validationRecords.size() * sizeof(ModelValidationLayerRecord)));
+    }
+    out.write((const char*)sparseRecords.data(), (std::streamsize)(sparseRecords.size() * sizeof(ModelSparseLayerRecord)));
+    uint64_t position = recordBytes;
+    for(size_t i = 0; i < layers.size(); i++){
+        const LayerT<Scalar>& layer = layers[i];
+        const ModelLayerRecord& record = records[i];
+        size_t weightCount = (size_t)layer.size * layer.inputSize;
+        seekForward(out, position, record.weightsOffset);
+        out.write((const char*)layer.weightData(), (std::streamsize)(weightCount * sizeof(Scalar)));
+        position += weightCount * sizeof(Scalar);
+        writeSection(out, position, record.biasesOffset, layer.biases);
+        if(includeHistoric){
+            writeSection(out, position, record.historicOffset, layer.historicGradients);
+        }
+        if(!includeOptimizer){
+            continue;
+        }
+        const ModelOptimizerLayerRecord& state = optimizerRecords[i];
+        if(state.firstMomentsOffset){
+            writeSection(out, position, state.firstMomentsOffset, layer.firstMoments);
+        }
+        if(state.biasFirstMomentsOffset){
+            writeSection(out, position, state.biasFirstMomentsOffset, layer.biasFirstMoments);
+        }
+        if(state.biasHistoricOffset){
+            writeSection(out, position, state.biasHistoricOffset, layer.biasHistoricGradients);
+        }
+        if(includeSchedule && validationRecords[i].bestWeightsOffset){
+            writeSection(out, position, validationRecords[i].bestWeightsOffset, validation->bestWeights[i]);
+            writeSection(out, position, validationRecords[i].bestBiasesOffset, validation->bestBiases[i]);
+        }
+    }
+    for(size_t i = 1; includeSparse && i < layers.size(); i++){
+        const LayerT<Scalar>& layer = layers[i];
+        const ModelSparseLayerRecord& sparse = sparseRecords[i];
+        if(sparse.rowStartsOffset){
+            writeSection(out, position, sparse.rowStartsOffset, layer.rowStartData(), (size_t)layer.size + 1);
+            writeSection(out, position, sparse.columnsOffset, layer.columnData(), (size_t)sparse.nonzeros);
+            writeSection(out, position, sparse.valuesOffset, layer.sparseValueData(), (size_t)sparse.nonzeros);
+        }
+    }
+    out.close();
+    if(!out){
+        std::cerr << "Error: failed writing model file " << tempPath << "\n";
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    if(sync && !syncPath(tempPath, false)){
+        std::cerr << "Error: could not flush " << tempPath << " to disk\n";
+        std::remove(tempPath.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    //rename does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if(std::rename(tempPath.c_str(), path.c_str()) != 0){
+        std::cerr << "Error: could not move " << tempPath << " to " << path << "\n";
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    if(sync && !syncPath(parentDirectory(path), true)){
+        std::cerr << "Error: could not flush the directory of " << path << " to disk\n";
+        return false;
+    }
+    return true;
+}
+
+//true if [offset, offset + bytes) is inside the file
+static bool inFile(uint64_t offset, uint64_t bytes, uint64_t fileSize){
+    return offset <= fileSize && bytes <= fileSize - offset;
+}
+
+//true if the CSR arrays of a size x inputSize layer are in the file and
+//consistent: rows start at 0 and never go back, end at nonzeros, and every
+//row's columns increase and stay below inputSize. Reads only the index
+//arrays, which are small next to the dense weights of a pruned layer
+template<typename Scalar>
+static bool validSparse(const unsigned char* bytes, uint64_t fileSize, const ModelSparseLayerRecord& sparse,
+                        uint64_t size, uint64_t inputSize){
+    if(sparse.rowStartsOffset == 0){
+        return sparse.columnsOffset == 0 && sparse.valuesOffset == 0 && sparse.nonzeros == 0;
+    }
+    if(sparse.rowStartsOffset % sizeof(int32_t) != 0 || sparse.columnsOffset % sizeof(int32_t) != 0
+       || sparse.valuesOffset % sizeof(Scalar) != 0 || sparse.nonzeros > size * inputSize
+       || !inFile(sparse.rowStartsOffset, (size + 1) * sizeof(int32_t), fileSize)
+       || !inFile(sparse.columnsOffset, sparse.nonzeros * sizeof(int32_t), fileSize)
+       || !inFile(sparse.valuesOffset, sparse.nonzeros * sizeof(Scalar), fileSize)){
+        return false;
+    }
+    const int32_t* rowStarts = (const int32_t*)(bytes + sparse.rowStartsOffset);
+    const int32_t* columns = (const int32_t*)(bytes + sparse.columnsOffset);
+    if(rowStarts[0] != 0 || (uint64_t)rowStarts[size] != sparse.nonzeros){
+        return false;
+    }
+    for(uint64_t j = 0; j < size; j++){
+        if(rowStarts[j + 1] < rowStarts[j]){
+            return false;
+        }
+        for(int32_t p = rowStarts[j]; p < rowStarts[j + 1]; p++){
+            if(columns[p] < 0 || (uint64_t)columns[p] >= inputSize || (p > rowStarts[j] && columns[p] <= columns[p - 1])){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//copies the header out of the file and checks it can be read on this host
+static bool parseHeader(const std::string& path, const unsigned char* bytes, uint64_t fileSize, ModelHeader& header){
+    if(fileSize < sizeof(header)){
+        std::cerr << "Error: " << path << " is too small to be a model file\n";
+        return false;
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    if(std::memcmp(header.magic, MODEL_MAGIC, sizeof(header.magic)) != 0){
+        std::cerr << "Error: " << path << " is not a model file\n";
+        return false;
+    }
+    if(header.byteOrder != MODEL_BYTE_ORDER){
+        std::cerr << "Error: " << path << " was written on a host with a different byte order\n";
+        return false;
+    }
+    if(header.version == 0 || header.version > MODEL_VERSION){
+        std::cerr << "Error: model file version " << header.version << " is not supported (expected "
+        << MODEL_VERSION << ")\n";
+        return false;
+    }
+    if((header.flags & ~MODEL_KNOWN_FLAGS) != 0){
+        std::cerr << "Error: " << path << " has sections this build does not know (flags 0x" << std::hex
+        << (header.flags & ~MODEL_KNOWN_FLAGS) << std::dec << "), load it with a newer build\n";
+        return false;
+    }
+    return true;
+}
+
+bool readModelHeader(const std::string& path, ModelHeader& header){
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    return file && parseHeader(path, file->data(), file->size(), header);
+}
+
+template<typename Scalar>
+bool readModelFile(const std::string& path, std::vector<LayerT<Scalar>>& layers, int& step, double& learningRate,
+                   bool mapWeights, std::shared_ptr<MappedFile>& mapping, Optimizer* optimizer,
+                   LearningRateSchedule* schedule, ValidationProgressT<Scalar>* validation){
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if(!file){
+        return false;
+    }
+    const unsigned char* bytes = file->data();
+    uint64_t fileSize = file->size();
+
+    //validate everything before touching layers so a bad file leaves the network as it was
+    ModelHeader header;
+    if(!parseHeader(path, bytes, fileSize, header)){
+        return false;
+    }
+    if(header.fileSize != fileSize || header.numLayers == 0
+       || !inFile(sizeof(header), (uint64_t)header.numLayers * sizeof(ModelLayerRecord), fileSize)){
+        std::cerr << "Error: model file " << path << " is truncated or corrupt\n";
+        return false;
+    }
+    //a mapping can only be used as it is, so the scalar type has to match
+    bool isFloat = (header.flags & MODEL_FLOAT32) != 0;
+    if(isFloat != std::is_same<Scalar, float>::value){
+        std::cerr << "Error: " << path << " stores " << (isFloat ? "float" : "double")
+        << " weights, load it into a network of the same scalar type\n";
+        return false;
+    }
+    bool hasHistoric = (header.flags & MODEL_HAS_HISTORIC) != 0;
+    bool hasOptimizer = (header.flags & MODEL_HAS_OPTIMIZER) != 0;
+    bool hasSchedule = (header.flags & MODEL_HAS_SCHEDULE) != 0;
+    bool hasSparse = (header.flags & MODEL_HAS_SPARSE) != 0;
+    std::vector<ModelLayerRecord> records(header.numLayers);
+    std::memcpy(records.data(), bytes + sizeof(header), records.size() * sizeof(ModelLayerRecord));
+    //the optional records follow each other, start is where the next one begins
+    uint64_t start = sizeof(header) + records.size() * sizeof(ModelLayerRecord);
+    ModelOptimizerRecord optimizerRecord = {};
+    std::vector<ModelOptimizerLayerRecord> optimizerRecords(hasOptimizer ? header.numLayers : 0);
+    if(hasOptimizer){
+        if(header.version < 2 || !hasHistoric
+           || !inFile(start, sizeof(optimizerRecord) + optimizerRecords.size() * sizeof(ModelOptimizerLayerRecord), fileSize)){
+            std::cerr << "Error: model file " << path << " is truncated or corrupt\n";
+            return false;
+        }
+        std::memcpy(&optimizerRecord, bytes + start, sizeof(optimizerRecord));
+        std::memcpy(optimizerRecords.data(), bytes + start + sizeof(optimizerRecord),
+                    optimizerRecords.size() * sizeof(ModelOptimizerLayerRecord));
+        start += sizeof(optimizerRecord) + optimizerRecords.size() * sizeof(ModelOptimizerLayerRecord);
+        if(optimizerRecord.type >= (uint32_t)OPTIMIZER_TYPE_COUNT || optimizerRecord.updates < 0){
+            std::cerr << "Error: the optimizer state of model file " << path << " is corrupt\n";
+            return false;
+        }
+    }
+    ModelScheduleRecord scheduleRecord = {};
+    std::vector<ModelValidationLayerRecord> validationRecords(hasSchedule ? header.numLayers : 0);
+    if(hasSchedule){
+        if(header.version < 3 || !hasOptimizer
+           || !inFile(start, sizeof(scheduleRecord) + validationRecords.size() * sizeof(ModelValidationLayerRecord), fileSize)){
+            std::cerr << "Error: model file " << path << " is truncated or corrupt\n";
+            return false;
+        }
+        std::memcpy(&scheduleRecord, bytes + start, sizeof(scheduleRecord));
+        std::memcpy(validationRecords.data(), bytes + start + sizeof(scheduleRecord),
+                    validationRecords.size() * sizeof(ModelValidationLayerRecord));
+        start += sizeof(scheduleRecord) + validationRecords.size() * sizeof(ModelValidationLayerRecord);
+        if(scheduleRecord.type > (uint32_t)ScheduleType::ReduceOnPlateau || scheduleRecord.stepSize < 1
+           || scheduleRecord.patience < 1 || scheduleRecord.validationBestStep < -1){
+            std::cerr << "Error: the schedule state of model file " << path << " is corrupt\n";
+            return false;
+        }
+    }
+    std::vector<ModelSparseLayerRecord> sparseRecords(hasSparse ? header.numLayers : 0);
+    if(hasSparse){
+        if(header.version < 3 || !inFile(start, sparseRecords.size() * sizeof(ModelSparseLayerRecord), fileSize)){
+            std::cerr << "Error: model file " << path << " is truncated or corrupt\n";
+            return false;
+        }
+        std::memcpy(sparseRecords.data(), bytes + start, sparseRecords.size() * sizeof(ModelSparseLayerRecord));
+    }
+    for(size_t i = 0; i < records.size(); i++){
+        const ModelLayerRecord& record = records[i];
+        uint64_t expectedInputs = i == 0 ? 0 : records[i - 1].size;
+        uint64_t weightBytes = (uint64_t)record.size * record.inputSize * sizeof(Scalar);
+        bool valid = record.size > 0 && record.inputSize == expectedInputs
+                     && record.activation < (uint32_t)ACTIVATION_TYPE_COUNT
+                     && (!isLayerScope((ActivationType)record.activation) || record.isOutput)
+                     && record.isOutput == (i == records.size() - 1 && i > 0 ? 1u : 0u)
+                     && record.weightsOffset % MODEL_PAGE_ALIGNMENT == 0
+                     && record.biasesOffset % sizeof(Scalar) == 0
+                     && inFile(record.weightsOffset, weightBytes, fileSize)
+                     && inFile(record.biasesOffset, (uint64_t)record.size * sizeof(Scalar), fileSize)
+                     && (!hasHistoric || (record.historicOffset % sizeof(Scalar) == 0
+                                          && inFile(record.historicOffset, weightBytes, fileSize)));
+        if(valid && hasOptimizer){
+            const ModelOptimizerLayerRecord& state = optimizerRecords[i];
+            uint64_t biasBytes = (uint64_t)record.size * sizeof(Scalar);
+            auto section = [&](uint64_t offset, uint64_t sectionBytes){
+                return offset == 0 || (offset % sizeof(Scalar) == 0 && inFile(offset, sectionBytes, fileSize));
+            };
+            valid = section(state.firstMomentsOffset, weightBytes) && section(state.biasFirstMomentsOffset, biasBytes)
+                    && section(state.biasHistoricOffset, biasBytes);
+        }
+        if(valid && hasSchedule){
+            //every layer with weights has its best weights once validation has evaluated, none before
+            const ModelValidationLayerRecord& best = validationRecords[i];
+            bool expected = scheduleRecord.validationBestStep >= 0 && weightBytes > 0;
+            uint64_t biasBytes = (uint64_t)record.size * sizeof(Scalar);
+            valid = expected ? (best.bestWeightsOffset % sizeof(Scalar) == 0 && best.bestBiasesOffset % sizeof(Scalar) == 0
+                                && best.bestWeightsOffset != 0 && best.bestBiasesOffset != 0
+                                && inFile(best.bestWeightsOffset, weightBytes, fileSize)
+                                && inFile(best.bestBiasesOffset, biasBytes, fileSize))
+                             : best.bestWeightsOffset == 0 && best.bestBiasesOffset == 0;
+        }
+        if(valid && hasSparse){
+            valid = validSparse<Scalar>(bytes, fileSize, sparseRecords[i], record.size, record.inputSize)
+                    && (i > 0 || sparseRecords[i].rowStartsOffset == 0);
+        }
+        if(!valid){
+            std::cerr << "Error: layer " << i << " of model file " << path << " is corrupt\n";
+            return false;
+        }
+    }
+
+    std::vector<LayerT<Scalar>> loaded;
+    loaded.reserve(records.size());
+    for(size_t i = 0; i < records.size(); i++){
+        const ModelLayerRecord& record = records[i];
+        loaded.emplace_back((int)record.size, record.isOutput != 0);
+        LayerT<Scalar>& layer = loaded.back();
+        size_t weightCount = (size_t)record.size * record.inputSize;
+        layer.inputSize = (int)record.inputSize;
+        layer.activation = (ActivationType)record.activation;
+        const Scalar* weights = (const Scalar*)(bytes + record.weightsOffset);
+        const Scalar* biases = (const Scalar*)(bytes + record.biasesOffset);
+        layer.biases.assign(biases, biases + record.size);
+        if(mapWeights){
+            layer.mappedWeights = weights;
+            continue;
+        }
+        layer.weights.assign(weights, weights + weightCount);
+        if(hasHistoric){
+            const Scalar* historic = (const Scalar*)(bytes + record.historicOffset);
+            layer.historicGradients.assign(historic, historic + weightCount);
+        }else{
+            //same starting point as setupWeights
+            layer.historicGradients.assign(weightCount, 1.0);
+        }
+        if(!hasOptimizer){
+            continue;
+        }
+        const ModelOptimizerLayerRecord& state = optimizerRecords[i];
+        if(state.firstMomentsOffset){
+            const Scalar* moments = (const Scalar*)(bytes + state.firstMomentsOffset);
+            layer.firstMoments.assign(moments, moments + weightCount);
+        }
+        if(state.biasFirstMomentsOffset){
+            const Scalar* moments = (const Scalar*)(bytes + state.biasFirstMomentsOffset);
+            layer.biasFirstMoments.assign(moments, moments + record.size);
+        }
+        if(state.biasHistoricOffset){
+            const Scalar* historic = (const Scalar*)(bytes + state.biasHistoricOffset);
+            layer.biasHistoricGradients.assign(historic, historic + record.size);
+        }
+    }
+    for(size_t i = 1; hasSparse && i < records.size(); i++){
+        const ModelSparseLayerRecord& sparse = sparseRecords[i];
+        if(!sparse.rowStartsOffset){
+            continue;
+        }
+        LayerT<Scalar>& layer = loaded[i];
+        const int32_t* rowStarts = (const int32_t*)(bytes + sparse.rowStartsOffset);
+        const int32_t* columns = (const int32_t*)(bytes + sparse.columnsOffset);
+        const Scalar* values = (const Scalar*)(bytes + sparse.valuesOffset);
+        if(mapWeights){
+            layer.mappedRowStarts = rowStarts;
+            layer.mappedColumns = columns;
+            layer.mappedValues = values;
+            continue;
+        }
+        layer.sparseRowStarts.assign(rowStarts, rowStarts + records[i].size + 1);
+        layer.sparseColumns.assign(columns, columns + sparse.nonzeros);
+        layer.sparseValues.assign(values, values + sparse.nonzeros);
+    }
+
+    layers = std::move(loaded);
+    step = (int)header.step;
+    learningRate = header.learningRate;
+    if(optimizer && hasOptimizer && !mapWeights){
+        optimizer->type = (OptimizerType)optimizerRecord.type;
+        optimizer->beta1 = optimizerRecord.beta1;
+        optimizer->beta2 = optimizerRecord.beta2;
+        optimizer->epsilon = optimizerRecord.epsilon;
+        optimizer->weightDecay = optimizerRecord.weightDecay;
+        optimizer->maxRate = optimizerRecord.maxRate;
+        optimizer->updates = optimizerRecord.updates;
+    }
+    if(schedule && hasSchedule && !mapWeights){
+        schedule->type = (ScheduleType)scheduleRecord.type;
+        schedule->warmupSteps = scheduleRecord.warmupSteps;
+        schedule->stepSize = scheduleRecord.stepSize;
+        schedule->totalSteps = scheduleRecord.totalSteps;
+        schedule->patience = scheduleRecord.patience;
+        schedule->sinceBest = scheduleRecord.sinceBest;
+        schedule->baseRate = scheduleRecord.baseRate;
+        schedule->factor = scheduleRecord.factor;
+        schedule->minRate = scheduleRecord.minRate;
+        schedule->threshold = scheduleRecord.threshold;
+        schedule->plateauScale = scheduleRecord.plateauScale;
+        schedule->bestScore = scheduleRecord.bestScore;
+    }
+    if(validation && !mapWeights){
+        *validation = ValidationProgressT<Scalar>();
+        if(hasSchedule){
+            validation->bestScore = scheduleRecord.validationBestScore;
+            validation->bestStep = scheduleRecord.validationBestStep;
+            validation->sinceBest = scheduleRecord.validationSinceBest;
+            validation->stopped = scheduleRecord.validationStopped != 0;
+        }
+        if(hasSchedule && scheduleRecord.validationBestStep >= 0){
+            validation->bestWeights.resize(records.size());
+            validation->bestBiases.resize(records.size());
+            for(size_t i = 1; i < records.size(); i++){
+                const ModelValidationLayerRecord& best = validationRecords[i];
+                size_t weightCount = (size_t)records[i].size * records[i].inputSize;
+                const Scalar* weights = (const Scalar*)(bytes + best.bestWeightsOffset);
+                const Scalar* biases = (const Scalar*)(bytes + best.bestBiasesOffset);
+                validation->bestWeights[i].assign(weights, weights + weightCount);
+                validation->bestBiases[i].assign(biases, biases + records[i].size);
+            }
+        }
+    }
+    mapping = mapWeights ? file : nullptr;
+    return true;
+}
+
+template bool writeModelFile<double>(const std::string&, const std::vector<Layer>&, int, double, bool,
+                                     const Optimizer*, bool, const LearningRateSchedule*,
+                                     const ValidationProgressT<double>*);
+template bool writeModelFile<float>(const std::string&, const std::vector<LayerF>&, int, double, bool,
+                                    const Optimizer*, bool, const LearningRateSchedule*,
+                                    const ValidationProgressT<float>*);
+template bool readModelFile<double>(const std::string&, std::vector<Layer>&, int&, double&, bool,
+                                    std::shared_ptr<MappedFile>&, Optimizer*, LearningRateSchedule*,
+                                    ValidationProgressT<double>*);
+template bool readModelFile<float>(const std::string&, std::vector<LayerF>&, int&, double&, bool,
+                                   std::shared_ptr<MappedFile>&, Optimizer*, LearningRateSchedule*,
+                                   ValidationProgressT<float>*);
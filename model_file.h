@@ -0,0 +1,195 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include "layer.h"
+#include "optimizer.h"
+#include "schedule.h"
+
+//binary model layout, all values in host byte order:
+//  ModelHeader
+//  ModelLayerRecord x numLayers (the input layer has no weights)
+//  ModelOptimizerRecord, ModelOptimizerLayerRecord x numLayers (optional, version 2)
+//  ModelScheduleRecord, ModelValidationLayerRecord x numLayers (optional, version 3)
+//  ModelSparseLayerRecord x numLayers (optional, version 3)
+//  per layer: weights (page aligned), biases, historicGradients (page aligned, optional)
+//             then firstMoments, biasFirstMoments and biasHistoricGradients when present
+//             then the best validated weights and biases when present
+//             then the CSR row starts (page aligned), columns and values of a pruned layer
+//every offset is from the start of the file. Weight sections start on a page
+//boundary so a read-only mapping can hand them to the kernels directly.
+//Version 1 files have no optimizer records and version 2 files no schedule or
+//sparse records, both still load. A record added later raises the version
+//and gets a flag, and files with flags a reader does not know are refused, so
+//an older reader never drops state it can not see
+const char MODEL_MAGIC[8] = {'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0'};
+const uint32_t MODEL_VERSION = 3;
+//reads back differently on a host with the other byte order
+const uint32_t MODEL_BYTE_ORDER = 0x01020304;
+const uint64_t MODEL_PAGE_ALIGNMENT = 4096;
+const uint64_t MODEL_SECTION_ALIGNMENT = 64;
+
+enum ModelFlags : uint32_t {
+    MODEL_HAS_HISTORIC = 1u << 0,
+    //weights, biases and historicGradients are float instead of double
+    MODEL_FLOAT32 = 1u << 1,
+    //the optimizer records follow the layer records, so training resumes exactly
+    MODEL_HAS_OPTIMIZER = 1u << 2,
+    //the schedule records follow the optimizer records, only with MODEL_HAS_OPTIMIZER
+    MODEL_HAS_SCHEDULE = 1u << 3,
+    //the sparse records follow, pruned layers keep their CSR form next to the
+    //dense weights so a mapped load can use it without scanning them
+    MODEL_HAS_SPARSE = 1u << 4
+};
+const uint32_t MODEL_KNOWN_FLAGS = MODEL_HAS_HISTORIC | MODEL_FLOAT32 | MODEL_HAS_OPTIMIZER | MODEL_HAS_SCHEDULE
+                                   | MODEL_HAS_SPARSE;
+
+struct ModelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t flags;
+    uint32_t numLayers;
+    int64_t step;
+    double learningRate;
+    uint64_t fileSize;
+};
+
+struct ModelLayerRecord {
+    uint32_t size;
+    uint32_t inputSize;
+    //ActivationType value
+    uint32_t activation;
+    uint32_t isOutput;
+    uint64_t weightsOffset;
+    uint64_t biasesOffset;
+    //0 when the file has no historicGradients
+    uint64_t historicOffset;
+};
+
+//the Optimizer the state was made with
+struct ModelOptimizerRecord {
+    //OptimizerType value
+    uint32_t type;
+    uint32_t reserved;
+    double beta1;
+    double beta2;
+    double epsilon;
+    double weightDecay;
+    double maxRate;
+    int64_t updates;
+};
+
+//the rest of a layer's optimizer state, 0 for the arrays it does not have
+struct ModelOptimizerLayerRecord {
+    uint64_t firstMomentsOffset;
+    uint64_t biasFirstMomentsOffset;
+    uint64_t biasHistoricOffset;
+};
+
+//the LearningRateSchedule with its plateau state, and what validation had found
+struct ModelScheduleRecord {
+    //ScheduleType value
+    uint32_t type;
+    int32_t warmupSteps;
+    int32_t stepSize;
+    int32_t totalSteps;
+    int32_t patience;
+    int32_t sinceBest;
+    double baseRate;
+    double factor;
+    double minRate;
+    double threshold;
+    double plateauScale;
+    double bestScore;
+    //-1 before the first evaluation, the best weights are only there after it
+    int32_t validationBestStep;
+    int32_t validationSinceBest;
+    uint32_t validationStopped;
+    uint32_t reserved;
+    double validationBestScore;
+};
+
+//where a layer's best validated weights and biases are, 0 without them
+struct ModelValidationLayerRecord {
+    uint64_t bestWeightsOffset;
+    uint64_t bestBiasesOffset;
+};
+
+//the CSR form of a pruned layer (see LayerT::prune), all 0 for a dense layer.
+//Row starts and columns are int32
+struct ModelSparseLayerRecord {
+    uint64_t rowStartsOffset;
+    uint64_t columnsOffset;
+    uint64_t valuesOffset;
+    uint64_t nonzeros;
+};
+
+static_assert(sizeof(ModelHeader) == 48, "model header layout changed");
+static_assert(sizeof(ModelLayerRecord) == 40, "model layer record layout changed");
+static_assert(sizeof(ModelOptimizerRecord) == 56, "model optimizer record layout changed");
+static_assert(sizeof(ModelOptimizerLayerRecord) == 24, "model optimizer layer record layout changed");
+static_assert(sizeof(ModelScheduleRecord) == 96, "model schedule record layout changed");
+static_assert(sizeof(ModelValidationLayerRecord) == 16, "model validation layer record layout changed");
+static_assert(sizeof(ModelSparseLayerRecord) == 32, "model sparse layer record layout changed");
+
+//read-only view of a whole file. The pages belong to the OS page cache, so every
+//process that maps the same file shares one physical copy
+class MappedFile {
+public:
+    //prints the error and returns nullptr on failure
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const {
+        return bytes;
+    }
+    size_t size() const {
+        return length;
+    }
+
+private:
+    MappedFile() = default;
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+//writes the layers to path. The file is written next to it and renamed into
+//place, so processes that still map the old model keep a consistent copy.
+//With includeHistoric and an optimizer the whole optimizer state is saved
+//along with it, and the schedule and validation progress with that when they
+//are given (null validation saves none). sync flushes the file and its
+//directory to disk before returning, so a crash right after still finds the
+//complete file
+template<typename Scalar>
+bool writeModelFile(const std::string& path, const std::vector<LayerT<Scalar>>& layers, int step,
+                    double learningRate, bool includeHistoric, const Optimizer* optimizer = nullptr,
+                    bool sync = false, const LearningRateSchedule* schedule = nullptr,
+                    const ValidationProgressT<Scalar>* validation = nullptr);
+
+//rebuilds layers from a model file. With mapWeights the layers read their
+//weights, and the CSR form of pruned layers, straight from the mapping, which
+//is returned in mapping and has to outlive them. Without it everything is copied and mapping is reset. The file
+//has to have been written from layers of the same scalar type. optimizer and
+//schedule are only set when the file has their state and the weights are
+//copied. validation is set to the saved progress then, and to none otherwise
+template<typename Scalar>
+bool readModelFile(const std::string& path, std::vector<LayerT<Scalar>>& layers, int& step, double& learningRate,
+                   bool mapWeights, std::shared_ptr<MappedFile>& mapping, Optimizer* optimizer = nullptr,
+                   LearningRateSchedule* schedule = nullptr, ValidationProgressT<Scalar>* validation = nullptr);
+
+//reads only the header, to find out e.g. whether the file holds float or
+//double weights before choosing the network to load it into
+bool readModelHeader(const std::string& path, ModelHeader& header);
+
+#endif // MODEL_FILE_H
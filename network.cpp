@@ -1,199 +1,14 @@
 #include "network.h"
-struct network{
-    std::vector<Layer> layers;
-    double learningRate = 1.0;
-    int step = 0;
-    void setupNetwork(std::vector<int> structure){
-        //creates input layer
-        Layer inputLayer = Layer(structure[0]);
-        //inputLayer.setActivation()
-        
-        layers.push_back(inputLayer);
-        //creates all hidden layers
-        for(int i = 1; i < structure.size() ; i++){
-            std::vector<std::reference_wrapper<Neuron>> prevLayerNeuronReferences;
-            //creates fist layer
-            Layer thisLayer = Layer(structure[i], i == structure.size() - 1 ? true: false);
-            //building the references for the next layer
-            for(int j = 0; j < structure[i-1]; j++){
-                Neuron& refNeuron = layers[i-1].getConnection(j);
-                prevLayerNeuronReferences.push_back(refNeuron);
-            }
-            thisLayer.setupReferences(prevLayerNeuronReferences);
-
-            layers.push_back(thisLayer);
-        }
-    }
-    
-    void updateLearningRate(){
-        //learningRate = 1/std::exp(0.01 * step);
-    }
-
-    //set activationValue for the input layer. Iterate all subsequent layers as a standard pass
-    void forwardPass(std::vector<double>& inputValues){
-        Logger::log("forwardPass:\n");
-        Logger::log("Learning Rate: ");
-        Logger::log(std::to_string(learningRate));
-        //catch cases for errors
-        if(layers.empty()){
-            std::cerr << "Error: No layers in the network.\n";
-            return;
-        }
-        if(inputValues.size() != layers[0].size){
-            std::cerr << "Error: input size (" << layers[0].size
-            << ") does not match network imports size (" << inputValues.size() << ").\n";
-            return;
-        }
-        //set all the input layer activation values to the inputs
-        for (int i = 0; i < layers[0].size; i++){
-            Neuron& n = layers[0].layer[i];
-            n.activationValue = inputValues[i];
-            
-            //logging activation
-            std::ostringstream oss;
-            oss << "Neuron: (0, " << i << ") Effective learning rate: " << n.adjustedLearningRate << "Activation:" << inputValues[i];
-            Logger::log(oss.str());
-        }
-        //iterate each non input layer, activate all neurons in the layers
-        int size = layers.size();
-        for(int i = 1; i < size; i++){
-            //get the current layer reference
-            Layer& thisLayer = layers[i];
-
-            int layerSize = layers[i].size;
-            for(int j = 0; j < layerSize; j++){
-                //get current neuron reference
-                thisLayer.layer[j].activate();
-                Neuron& n = thisLayer.layer[j];
-
-                //logging activation
-                std::ostringstream oss;
-                oss << "Neuron: (" << i << ", " << j << ") Activation:" << n.activationValue;
-                Logger::log(oss.str());
-            }
-        }
-    }
-    void backPropagate(std::vector<double> expectedValues){
-        //catch case for empty network
-        Logger::log("BackProp:");
-        std::string expectedValuesString;
-        Logger::log("Expected");
-        for(int i = 0; i < expectedValues.size(); i++){
-            expectedValuesString += " " + std::to_string(expectedValues[i]);
-        }
-        Logger::log(expectedValuesString + "\n");
+#include "population.h"
+#include "ensemble.h"
+#include "server.h"
+#include <filesystem>
+#include <fstream>
+#include <chrono>
 
-        if(layers.empty()){
-            std::cerr << "Error: No layers in the network.\n";
-            return;
-        }
-        Layer &outputLayer = layers[layers.size() - 1];
-        //catch case for size mismatch
-        if(expectedValues.size() != outputLayer.size){
-            std::cerr << "Error: expectedValues size (" << outputLayer.size
-            << ") does not match network output size (" << expectedValues.size() << ").\n";
-            return;
-        }
-
-        //back prop call for output layer
-        for(int i = 0; i < outputLayer.size; i++){
-            Neuron &n = outputLayer.layer[i];
-            double err = n.backPropagateRMS(learningRate, 0.9, expectedValues[i]);
-
-            //logging backprop
-            std::ostringstream oss;
-            oss << "Neuron: (" << layers.size() - 1  << ", " << i << "), NeuronType: " << n.neuronType << " Error: " << err;
-            Logger::log(oss.str());
-        }
-        //skip output layer
-        for(int i = layers.size() - 2; i >= 0; i--){
-            Layer &curLayer = layers[i];
-            for(int j = 0; j < curLayer.size; j++){
-                Neuron &n = layers[i].layer[j];
-                double err = n.backPropagateRMS(learningRate);
-
-                //logging with string builder
-                std::ostringstream oss;
-                oss << "Neuron: (" << i  << ", " << j << ") backProp Error:" << err;
-                Logger::log(oss.str());
-            }
-
-        }
-        step++;
-        updateLearningRate();
-
-    }
-
-    //for debugging
-    void hold() {
-        std::cout << "Press Enter to continue...";
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    }
-    void backPropagateRMS(std::vector<double> expectedValues){
-        //catch case for empty network
-        Logger::log("BackProp:");
-        std::string expectedValuesString;
-        Logger::log("Expected");
-        for(int i = 0; i < expectedValues.size(); i++){
-            expectedValuesString += " " + std::to_string(expectedValues[i]);
-        }
-        Logger::log(expectedValuesString + "\n");
-
-        if(layers.empty()){
-            std::cerr << "Error: No layers in the network.\n";
-            return;
-        }
-        Layer &outputLayer = layers[layers.size() - 1];
-        //catch case for size mismatch
-        if(expectedValues.size() != outputLayer.size){
-            std::cerr << "Error: expectedValues size (" << outputLayer.size
-            << ") does not match network output size (" << expectedValues.size() << ").\n";
-            return;
-        }
-        //iterate backwards from the last layer to the first hidden layer
-        for(int i = layers.size() - 1; i > 0; i--){
-            for(int j = 0; j < layers[i].layer.size(); j++){
-                Logger::log("Neuron (" + std::to_string(i) + ", " + std::to_string(j) + ")\n");
-                layers[i].layer[j].backPropagateRMS(learningRate, 0.9, expectedValues[j]);
-            }
-        }
-        step++;
-    }
-
-    void printNetworkDetailed() {
-        std::cout << "Neural Network Visualization:\n";
-        std::cout << "Base Learning Rate: " << learningRate << "\n";
-        int numLayers = layers.size();
-        for (int l = 0; l < numLayers; l++){
-            std::cout << "Layer " << l << " (" << layers[l].size << " neurons):\n";
-
-            for (int n = 0; n < layers[l].size; n++){
-                Neuron& neuron = layers[l].layer[n];
-                // Format the numbers with fixed precision
-                std::cout << "  Neuron " << std::setw(2) << n << " Neuron type: " << neuron.neuronType 
-                        << " | Effective learning rate: " << std::fixed << std::setprecision(4) << neuron.adjustedLearningRate 
-                        << " | Activation: " << std::fixed << std::setprecision(4) << neuron.activationValue 
-                        << " | Error: " << std::fixed << std::setprecision(4) << neuron.delta
-                        << "\n";
-            }
-            std::cout << std::endl;
-        }
-    }
-
-    void printExpectedOutputs(const std::vector<double>& expected) {
-        std::cout << "Expected Outputs:\n";
-        for (size_t i = 0; i < expected.size(); i++){
-            std::cout << "  Output " << std::setw(2) << i 
-                      << " | Value: " << std::fixed << std::setprecision(4) << expected[i] 
-                      << "\n";
-        }
-        std::cout << std::endl;
-    }
-    void printNetwork(){
-        printNetworkDetailed();
-    }
-
-};
+//both scalar types are compiled in full so neither can silently stop building
+template struct NetworkT<double>;
+template struct NetworkT<float>;
 
 std::vector<int> stringToStructure(std::string layerStructure){
     std::vector<int> structure;
@@ -225,213 +40,164 @@ std::vector<int> stringToStructure(std::string layerStructure){
     return structure;
 }
 
-std::vector<double> getLine(std::vector<std::vector<double>> &lines){
-    std::vector<double> randomLine;
-    if(!lines.empty()){
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dist(0, lines.size() - 2);
-
-        
-        // Get a random index.
-        int randomIndex = dist(gen);
-        std::string randomLineString = "Random Line" + std::to_string(randomIndex) + "\n" + "Num Lines Left: " + std::to_string(lines.size());
-        Logger::log(randomLineString);
-        
-        
-        // Get the random line.
-        randomLine = lines[randomIndex];
-        
-        // Remove the random line from the vector.
-        lines.erase(lines.begin() + randomIndex);
-
-        
-    }
-    return randomLine;
-}
-double converToDouble(const std::string& s) {
-    try {
-        double value = std::stod(s);
-        return value;
-    } catch (const std::invalid_argument& e) {
-       
-    } catch (const std::out_of_range& e) {
-        std::cerr << "Out of range: " << e.what() << std::endl;
+//column layout of ./data/iris.data. The labels are listed so they keep the
+//ids 0, 1 and 2 whatever order the file is in
+DataSchema irisSchema(bool labelIds){
+    DataSchema schema;
+    for(const char* name: {"sepal length", "sepal width", "petal length", "petal width"}){
+        ColumnSchema column;
+        column.name = name;
+        schema.columns.push_back(column);
     }
-    return std::numeric_limits<double>::lowest();
-}
-std::vector<std::string> splitStringByComma(const std::string& input) {
-    std::vector<std::string> tokens;
-    std::istringstream stream(input);
-    std::string token;
-    
-    while (std::getline(stream, token, ',')) {
-        tokens.push_back(token);
+    ColumnSchema label;
+    label.name = "class";
+    label.type = ColumnType::Categorical;
+    label.categories = {"Iris-setosa", "Iris-versicolor", "Iris-virginica"};
+    if(labelIds){
+        label.normalization = Normalization::None;
     }
-    
-    return tokens;
+    schema.columns.push_back(label);
+    return schema;
 }
 
+//parses a single line of iris data, the label is replaced by its id
 std::vector<double> processDataPoint(const std::string& input){
-    //for converting the string data to ints
-    std::unordered_map<std::string, int> dict ={
-        {"Iris-setosa", 0.0},
-        {"Iris-versicolor", 1.0},
-        {"Iris-virginica", 2.0}
-    };
-
+    //built once and only read afterwards
+    static const CategoryDictionary labels = [](){
+        CategoryDictionary dictionary;
+        DataSchema schema = irisSchema();
+        for(const std::string& category: schema.columns.back().categories){
+            dictionary.intern(category);
+        }
+        return dictionary;
+    }();
 
     std::vector<double> tokens;
-    std::istringstream stream(input);
-    std::string token;
-    
-    while (std::getline(stream, token, ',')) {
-        //converts the current token to double, if it cant be converted there is either
-        //an overflow error or a conversion error
-        double tokenDouble = converToDouble(token);
-        
-        //if it doesnt convert, the function returns the lowest value for a double
-        //and if it doesnt convert it is a string. Only strings in the data are in the
-        //unordered map.
-        if(tokenDouble == std::numeric_limits<double>::lowest()){
-            tokenDouble = dict[token];
+    std::string_view rest(input);
+    while(!rest.empty()){
+        size_t comma = rest.find(',');
+        std::string_view token = rest.substr(0, comma);
+        double tokenDouble;
+        std::from_chars_result result = std::from_chars(token.data(), token.data() + token.size(), tokenDouble);
+        //anything that is not a number is a label, unknown labels count as the first class
+        if(result.ec != std::errc() || result.ptr != token.data() + token.size()){
+            tokenDouble = std::max(labels.find(token), 0);
         }
         tokens.push_back(tokenDouble);
+        if(comma == std::string_view::npos){
+            break;
+        }
+        rest.remove_prefix(comma + 1);
     }
-    
     return tokens;
 }
-double max(double val1, double val2){
-    if(val1 > val2){
-        return val1;
-    }
-    return val2;
-}
-double min(double val1, double val2){
-    if(val1 < val2){
-        return val1;
-    }
-    return val2;
-}
-std::vector<std::vector<double>> processData(std::string filepath){
-    //declared prior to catch case so there can still be a return value
-    std::vector<std::vector<double>> processedLines;
-    std::vector<double> processedLine;
 
-    std::ifstream inFile(filepath);  // Adjust the file name as needed
-    if (!inFile) {
-        std::cerr << "Error: Could not open file.\n";
-        return processedLines;
-    }
-
-    //final output storage
-    std::vector<std::vector<double>> normalizedData;
-    std::vector<double> maxes;
-    std::vector<double> mins;
-
-    //storage for iterating through file
-    std::string line;
-
-    //stores all data as doubles
-    while(std::getline(inFile, line)){
-        processedLine = processDataPoint(line);
-        
-        //for normalization
-        for(int i = 0; i < processedLine.size();i++){
-
-            if(i >= maxes.size()){
-                maxes.push_back(processedLine[i]);
-                mins.push_back(processedLine[i]);
-            }
-            maxes[i] = max(maxes[i], processedLine[i]);
-            mins[i] = min(mins[i], processedLine[i]);
-            
-            std::cout << processedLine[i] << std::endl;
-        }
-        processedLines.push_back(processedLine);
-    }
-    //normalizes stored data
-    for(int i = 0; i < processedLines.size(); i++){
-        //each line is [bunch of values, expectedOutputIndex]
-        std::vector<double> normalizedLine;
-        for(int j = 0; j < processedLines[i].size(); j++){
-            //each value in line
-            double denom = (maxes[j] - mins[j]);
-            double normalizedValue;
-
-            //normalized = (value - minimum)/maximum - minimum
-            //if denominator is 0, there is no variance in the datapoints so the value is constantly 0
-            if(denom != 0.0){
-                normalizedValue = (processedLines[i][j] - mins[j]) / (maxes[j] - mins[j]);
-            }else{
-                normalizedValue = 0;
-            }
-            normalizedLine.push_back(normalizedValue);
-        }
-        normalizedData.push_back(normalizedLine);
-    }
-    
-    inFile.close();
-    return normalizedData;
+//loads the iris data as min-max normalized rows, see loadCsv
+DataSet processData(const std::string& filepath, bool labelIds){
+    return loadCsv(filepath, irisSchema(labelIds));
 }
 
 void hold() {
     std::cout << "Press Enter to continue...";
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
-void hardTest(){
+
+//held out accuracy of a network trained on the iris rows in train. Softmax
+//networks predict the largest output, the regression network the class whose
+//normalized id (0, 0.5 or 1) is nearest to its single output
+static double irisAccuracy(network& net, const DataSet& data, const std::vector<size_t>& rows){
+    size_t correct = 0;
+    std::vector<double> input;
+    for(size_t r: rows){
+        const double* row = data.row(r);
+        input.assign(row, row + 4);
+        net.forwardPass(input);
+        const std::vector<double>& output = net.layers.back().activations;
+        int predicted;
+        int actual;
+        if(output.size() == 1){
+            predicted = (int)std::lround(std::min(std::max(output[0], 0.0), 1.0) * 2.0);
+            actual = (int)std::lround(row[4] * 2.0);
+        }else{
+            predicted = (int)(std::max_element(output.begin(), output.end()) - output.begin());
+            actual = (int)row[4];
+        }
+        correct += predicted == actual ? 1 : 0;
+    }
+    return rows.empty() ? 0.0 : (double)correct / rows.size();
+}
+
+//trains on 3/4 of the iris data for up to the given number of epochs, then
+//steps through half of the held out rows printing the network for each one.
+//The held out accuracy is checked once an epoch, training stops with the best
+//weights once it has not improved for 10 epochs or every row is right
+void hardTest(int batchSize, int numThreads, int epochs, uint64_t seed){
     std::string dataPath = "./data/iris.data";
-    std::vector<std::vector<double>> normalizedData = processData(dataPath);
+    DataSet data = processData(dataPath);
+    std::vector<size_t> trainRows;
+    std::vector<size_t> validationRows;
+    splitRows(data.numRows, 0.25, seed, trainRows, validationRows);
+    EpochSampler trainSampler(data, trainRows, seed + 1);
+    EpochSampler validationSampler(data, validationRows, seed + 2);
 
-    int startSize = normalizedData.size();
     network neuralNet;
     //data points are 5 points, 4 of them are inputs 1 is expected
     //there are 3 types of expected values
     std::vector<int> structure = {4, 5, 5, 8, 1};
+    int numInputs = structure[0];
 
     neuralNet.setupNetwork(structure);
     neuralNet.learningRate = 0.005;
+    neuralNet.setThreads(numThreads);
+    neuralNet.reserveTraining(batchSize);
+    //halves the rate after 3 epochs without progress
+    neuralNet.setSchedule(LearningRateSchedule::reduceOnPlateau(neuralNet.learningRate, 0.5, 3));
+    ValidationOptions validation;
+    validation.everySteps = (int)((trainRows.size() + batchSize - 1) / batchSize);
+    validation.patience = 10;
+    validation.targetScore = 1.0;
+    neuralNet.enableValidation(validation, [&](network& net){
+        return irisAccuracy(net, data, validationRows);
+    });
 
     //training
-    Logger::log("Training");
-    while(normalizedData.size() > startSize/4){
-        std::vector<double> randomLine = getLine(normalizedData);
-
-        std::vector<double> expectedOutput;
-        std::vector<double> trainingData;
-
-        for(int i = 0; i < randomLine.size() - 1; i++){
-            trainingData.push_back(randomLine[i]);
+    NN_LOG(LogLevel::Info, LOG_TRAINING, "Training");
+    std::vector<RowView> batch;
+    std::vector<double> trainingData;
+    std::vector<double> expectedOutput;
+    RowView row;
+    for(int epoch = 0; epoch < epochs && !neuralNet.stopped(); epoch++){
+        if(epoch > 0){
+            trainSampler.startEpoch();
         }
-        expectedOutput.push_back(randomLine[randomLine.size() - 1]);
-        neuralNet.forwardPass(trainingData);
-
-        neuralNet.backPropagate(expectedOutput);
-
-        //hold for text input every 20 steps **DEBUGGING TOOL**
-        /*if(neuralNet.step % 20 == 0){
-            std::string tmp;
-
-            std::cout << normalizedData.size();
-            std:: cin >> tmp;
-        }*/
+        if(batchSize > 1){
+            //batchSize x inputs matrices, the last batch of an epoch may be smaller
+            while(int samples = trainSampler.nextBatch(batchSize, batch)){
+                gatherBatch(batch, numInputs, trainingData, expectedOutput);
+                neuralNet.trainBatch(trainingData, expectedOutput, samples);
+            }
+            continue;
+        }
+        while(trainSampler.next(row)){
+            trainingData.assign(row.values, row.values + numInputs);
+            expectedOutput.assign(row.values + numInputs, row.values + row.size);
+            neuralNet.forwardPass(trainingData);
+            neuralNet.backPropagate(expectedOutput);
+        }
+        NN_LOG(LogLevel::Info, LOG_TRAINING, "Epoch {} done, step {}", epoch, neuralNet.step);
     }
+    std::cout << "held out accuracy " << neuralNet.validation->bestScore << " after "
+              << neuralNet.validation->bestStep << " steps" << (neuralNet.stopped() ? ", stopped early" : "") << "\n";
+    neuralNet.disableValidation();
+    hold();
 
     //Visualization after training(since we want to display error the training continues)
-    for(int i = 0; i < normalizedData.size()/2; i++){
+    size_t shown = validationSampler.size() / 2;
+    for(size_t i = 0; i < shown && validationSampler.next(row); i++){
         system("clear");
-        std::vector<double> randomLine = getLine(normalizedData);
-
-        std::vector<double> expectedOutput;
-        std::vector<double> trainingData;
-        //for logging std::string lineData;
-
         //splits expected from training data
-        for(int i = 0; i < randomLine.size() - 1; i++){
-            trainingData.push_back(randomLine[i]);
-            //for logging lineData+= std::to_string(randomLine[i]);
-        }
-        expectedOutput.push_back(randomLine[randomLine.size() - 1]);
+        trainingData.assign(row.values, row.values + numInputs);
+        expectedOutput.assign(row.values + numInputs, row.values + row.size);
 
         //updates net with data
         neuralNet.forwardPass(trainingData);
@@ -443,7 +209,7 @@ void hardTest(){
         //waits for user interaction
         hold();
     }
-    Logger::log(std::to_string(normalizedData.size()));
+    NN_LOG(LogLevel::Info, LOG_DATA, "Rows left: {}", validationSampler.remaining());
 
     hold();
 }
@@ -473,7 +239,7 @@ void simpleTest(){
             std::cout << "Layer" << l << std::endl;
             for(int n = 0; n < layer.size; n++){
                 std::cout << "Neuron" << n << " ";
-                layer.layer[n].printWeights();
+                layer.getConnection(n).printWeights();
             }
             std::cout << std::endl;
 
@@ -503,12 +269,21 @@ void useCaseExample(){
     network neuralNetwork;
     neuralNetwork.setupNetwork(structure);
 
-    for(Layer layer: neuralNetwork.layers){
+    for(Layer& layer: neuralNetwork.layers){
         //options
         layer.setActivation("relu");
         layer.setActivation("leakyrelu");
         layer.setActivation("tanh");
+        layer.setActivation("sigmoid");
+        layer.setActivation("gelu");
+        layer.setActivation("softplus");
+        //the vectorized approximations of the last four, or "tanh_fast"
+        layer.setActivation("tanh", ActivationPrecision::Fast);
     }
+    //options for the learning rate, set after every step
+    neuralNetwork.setSchedule(LearningRateSchedule::stepDecay(0.01, 1000));
+    neuralNetwork.setSchedule(LearningRateSchedule::cosine(0.01, 10000, 0.0, 500));
+    neuralNetwork.setSchedule(LearningRateSchedule::reduceOnPlateau(0.01));
 
     neuralNetwork.forwardPass(inputs);
     neuralNetwork.backPropagateRMS(expected);
@@ -516,11 +291,1354 @@ void useCaseExample(){
     neuralNetwork.backPropagate(expected);
 
 }
-int main(){
-    isLogging = false;
-    //simpleTest(); //for testing basic functionality with fixed data
-    hardTest(); //for testing more complicated functionality with variable data
 
-    //hold();
-    return 0;
-}
\ No newline at end of file
+bool precisionTest(int epochs, double tolerance, uint64_t seed){
+    DataSet data = processData("./data/iris.data");
+    if(data.numRows == 0){
+        return false;
+    }
+    std::vector<int> structure = {4, 5, 5, 8, 1};
+    int numInputs = structure[0];
+
+    network doubleNet;
+    doubleNet.setupNetwork(structure, seed);
+    doubleNet.learningRate = 0.005;
+    networkF floatNet;
+
+    //RMSProp amplifies rounding differences over many steps, so the float
+    //network restarts from the double weights every step and only the error
+    //of a single forward pass and update is compared. Differences are relative
+    //to the double value once it is above 1
+    auto difference = [](double exact, float value){
+        return std::abs(exact - (double)value) / std::max(1.0, std::abs(exact));
+    };
+    EpochSampler sampler(data, seed);
+    std::vector<double> inputs, expected;
+    std::vector<float> inputsF, expectedF;
+    RowView row;
+    double maxOutputDifference = 0.0;
+    double maxWeightDifference = 0.0;
+    for(int epoch = 0; epoch < epochs; epoch++){
+        if(epoch > 0){
+            sampler.startEpoch();
+        }
+        while(sampler.next(row)){
+            inputs.assign(row.values, row.values + numInputs);
+            expected.assign(row.values + numInputs, row.values + row.size);
+            inputsF.assign(inputs.begin(), inputs.end());
+            expectedF.assign(expected.begin(), expected.end());
+            floatNet.copyFrom(doubleNet);
+            doubleNet.forwardPass(inputs);
+            floatNet.forwardPass(inputsF);
+            const Layer& output = doubleNet.layers.back();
+            for(int j = 0; j < output.size; j++){
+                maxOutputDifference = std::max(maxOutputDifference,
+                                               difference(output.activations[j], floatNet.layers.back().activations[j]));
+            }
+            doubleNet.backPropagate(expected);
+            floatNet.backPropagate(expectedF);
+            for(size_t l = 1; l < doubleNet.layers.size(); l++){
+                const std::vector<double>& weights = doubleNet.layers[l].weights;
+                for(size_t w = 0; w < weights.size(); w++){
+                    maxWeightDifference = std::max(maxWeightDifference,
+                                                   difference(weights[w], floatNet.layers[l].weights[w]));
+                }
+            }
+        }
+    }
+
+    //the trained weights through both frozen plans, every row in one batch
+    floatNet.copyFrom(doubleNet);
+    std::vector<double> allInputs;
+    for(size_t i = 0; i < data.numRows; i++){
+        allInputs.insert(allInputs.end(), data.row(i), data.row(i) + numInputs);
+    }
+    std::vector<float> allInputsF(allInputs.begin(), allInputs.end());
+    std::vector<double> predictions(data.numRows * structure.back());
+    std::vector<float> predictionsF(predictions.size());
+    doubleNet.freeze().predictBatch(allInputs.data(), predictions.data(), (int)data.numRows);
+    floatNet.freeze().predictBatch(allInputsF.data(), predictionsF.data(), (int)data.numRows);
+    double maxPredictionDifference = 0.0;
+    for(size_t i = 0; i < predictions.size(); i++){
+        maxPredictionDifference = std::max(maxPredictionDifference, difference(predictions[i], predictionsF[i]));
+    }
+
+    double worst = std::max({maxOutputDifference, maxWeightDifference, maxPredictionDifference});
+    bool passed = worst <= tolerance;
+    std::cout << "float vs double on " << data.numRows << " rows, " << epochs << " epochs (tolerance " << tolerance << ")\n"
+              << "  forwardPass outputs  " << maxOutputDifference << "\n"
+              << "  updated weights      " << maxWeightDifference << "\n"
+              << "  predictBatch outputs " << maxPredictionDifference << "\n"
+              << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+bool quantizationTest(int epochs, double maxError, double minSameLabel, uint64_t seed){
+    DataSet data = processData("./data/iris.data");
+    if(data.numRows == 0){
+        return false;
+    }
+    std::vector<int> structure = {4, 5, 5, 8, 1};
+    int numInputs = structure[0];
+    network neuralNet;
+    neuralNet.setupNetwork(structure, seed);
+    neuralNet.learningRate = 0.005;
+
+    EpochSampler sampler(data, seed);
+    std::vector<RowView> batch;
+    std::vector<double> inputs, expected;
+    for(int epoch = 0; epoch < epochs; epoch++){
+        if(epoch > 0){
+            sampler.startEpoch();
+        }
+        while(int samples = sampler.nextBatch(10, batch)){
+            gatherBatch(batch, numInputs, inputs, expected);
+            neuralNet.trainBatch(inputs, expected, samples);
+        }
+    }
+
+    //the labels are 0, 0.5 and 1 after normalization, a prediction counts as the
+    //nearest of them
+    auto label = [](double value){
+        return (int)std::lround(std::min(std::max(value, 0.0), 1.0) * 2.0);
+    };
+    InferenceNetwork reference = neuralNet.freeze();
+    std::cout << "int8 quantization on " << data.numRows << " iris rows after " << epochs << " epochs ("
+              << integerKernels().name << " kernels)\n";
+    bool passed = true;
+    for(WeightScaling scaling: {WeightScaling::PerLayer, WeightScaling::PerRow}){
+        QuantizedNetwork quantized = neuralNet.quantize(data, scaling);
+        QuantizationReport report = compareQuantized(reference, quantized, data);
+        size_t sameLabel = 0;
+        for(size_t r = 0; r < data.numRows; r++){
+            double exact, approximate;
+            reference.predict(data.row(r), &exact);
+            quantized.predict(data.row(r), &approximate);
+            sameLabel += label(exact) == label(approximate) ? 1 : 0;
+        }
+        std::cout << (scaling == WeightScaling::PerRow ? "  per row scales:   " : "  per layer scales: ")
+                  << "max error " << report.maxAbsError << ", mean error " << report.meanAbsError
+                  << ", rms error " << report.rmsError << ", same label " << sameLabel << "/" << data.numRows
+                  << ", " << report.referenceBytes << " -> " << report.quantizedBytes << " bytes\n";
+        bool within = report.maxAbsError <= maxError && sameLabel >= minSameLabel * data.numRows;
+        if(!within){
+            std::cout << "  OUT OF BOUNDS: max error above " << maxError << " or same label below " << minSameLabel << "\n";
+        }
+        passed = passed && within;
+    }
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+//heap allocations of steps repetitions of each pass, on a network that was
+//set up and sized with reserveTraining beforehand. Frozen networks size their
+//workspace on their first call, so that one call is made before counting
+template<typename Scalar>
+static bool countStepAllocations(unsigned long long (*allocationCount)(), const Optimizer& optimizer, int steps){
+    const int batchSize = 32;
+    std::vector<int> structure = {16, 96, 96, 4};
+    NetworkT<Scalar> net;
+    net.setupNetwork(structure);
+    net.setOptimizer(optimizer);
+    net.learningRate = 1e-3;
+    net.setThreads(4);
+    net.parallelLayerThreshold = 1024;
+    net.reserveTraining(batchSize);
+
+    std::mt19937_64 generator(7);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<Scalar> inputs((size_t)batchSize * structure.front());
+    std::vector<Scalar> expected((size_t)batchSize * structure.back());
+    for(Scalar& value: inputs){
+        value = (Scalar)dist(generator);
+    }
+    for(Scalar& value: expected){
+        value = (Scalar)dist(generator);
+    }
+    std::vector<Scalar> input(inputs.begin(), inputs.begin() + structure.front());
+    std::vector<Scalar> target(expected.begin(), expected.begin() + structure.back());
+    std::vector<Scalar> outputs(expected.size());
+    const int smallBatch = batchSize - 7;
+    std::vector<Scalar> smallInputs(inputs.begin(), inputs.begin() + (size_t)smallBatch * structure.front());
+    std::vector<Scalar> smallExpected(expected.begin(), expected.begin() + (size_t)smallBatch * structure.back());
+
+    bool passed = true;
+    auto count = [&](const char* name, auto&& pass){
+        unsigned long long before = allocationCount();
+        for(int i = 0; i < steps; i++){
+            pass(i);
+        }
+        unsigned long long allocations = allocationCount() - before;
+        passed = passed && allocations == 0;
+        std::cout << " " << name << " " << allocations;
+    };
+    std::cout << "  " << (sizeof(Scalar) == sizeof(float) ? "float " : "double") << " "
+              << std::setw(8) << std::left << optimizerName(optimizer.type) << std::right;
+    count("backPropagate", [&](int){
+        net.forwardPass(input);
+        net.backPropagate(target);
+    });
+    //every other batch is smaller, like the last batch of an epoch
+    count("backwardBatch", [&](int i){
+        bool small = i % 2 == 1;
+        net.forwardBatch(small ? smallInputs : inputs, small ? smallBatch : batchSize);
+        net.backwardBatch(small ? smallExpected : expected, small ? smallBatch : batchSize);
+    });
+    count("trainBatch", [&](int i){
+        bool small = i % 2 == 1;
+        net.trainBatch(small ? smallInputs : inputs, small ? smallExpected : expected, small ? smallBatch : batchSize);
+    });
+    net.intraLayerParallel = true;
+    count("split", [&](int){
+        net.forwardPass(input);
+        net.backPropagate(target);
+    });
+    InferenceNetworkT<Scalar> frozen = net.freeze();
+    frozen.predictBatch(inputs.data(), outputs.data(), batchSize);
+    count("predict", [&](int){
+        frozen.predict(input.data(), outputs.data());
+        frozen.predictBatch(inputs.data(), outputs.data(), batchSize);
+    });
+    std::cout << "\n";
+    return passed;
+}
+
+bool allocationTest(unsigned long long (*allocationCount)(), int steps){
+    std::cout << "heap allocations over " << steps << " steps of each pass\n";
+    bool passed = true;
+    for(const Optimizer& optimizer: {Optimizer::rmsProp(), Optimizer::adamW()}){
+        passed = countStepAllocations<double>(allocationCount, optimizer, steps) && passed;
+        passed = countStepAllocations<float>(allocationCount, optimizer, steps) && passed;
+    }
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+void profileTest(const std::string& tracePath, int epochs, int numThreads, uint64_t seed){
+    DataSet data = processData("./data/iris.data");
+    if(data.numRows == 0){
+        return;
+    }
+    std::vector<int> structure = {4, 64, 64, 1};
+    int numInputs = structure[0];
+    network neuralNet;
+    neuralNet.setupNetwork(structure);
+    neuralNet.learningRate = 0.005;
+    neuralNet.setThreads(numThreads);
+    ProfilerOptions options;
+    options.hardwareCounters = true;
+    neuralNet.enableProfiling(options);
+
+    //batched epochs on the pool, then one epoch of single sample passes so
+    //both kinds of sections show up in the trace
+    EpochSampler sampler(data, seed);
+    std::vector<RowView> batch;
+    std::vector<double> inputs, expected;
+    for(int epoch = 0; epoch < epochs; epoch++){
+        if(epoch > 0){
+            sampler.startEpoch();
+        }
+        while(int samples = sampler.nextBatch(10, batch)){
+            gatherBatch(batch, numInputs, inputs, expected);
+            neuralNet.trainBatch(inputs, expected, samples);
+        }
+    }
+    sampler.startEpoch();
+    while(sampler.nextBatch(1, batch)){
+        gatherBatch(batch, numInputs, inputs, expected);
+        neuralNet.forwardPass(inputs);
+        neuralNet.backPropagate(expected);
+    }
+
+    neuralNet.profiler->printSummary(std::cout);
+    if(neuralNet.profiler->writeChromeTrace(tracePath)){
+        std::cout << "trace written to " << tracePath << " (chrome://tracing or ui.perfetto.dev)\n";
+    }
+}
+
+template<typename Scalar>
+static bool sameState(const NetworkT<Scalar>& a, const NetworkT<Scalar>& b){
+    if(a.step != b.step || a.learningRate != b.learningRate || a.optimizer.type != b.optimizer.type
+       || a.optimizer.updates != b.optimizer.updates || a.layers.size() != b.layers.size()){
+        return false;
+    }
+    if(a.schedule.type != b.schedule.type || a.schedule.baseRate != b.schedule.baseRate
+       || a.schedule.plateauScale != b.schedule.plateauScale || a.schedule.bestScore != b.schedule.bestScore
+       || a.schedule.sinceBest != b.schedule.sinceBest || (a.validation == nullptr) != (b.validation == nullptr)){
+        return false;
+    }
+    if(a.validation){
+        const ValidationT<Scalar>& x = *a.validation;
+        const ValidationT<Scalar>& y = *b.validation;
+        if(x.bestScore != y.bestScore || x.bestStep != y.bestStep || x.sinceBest != y.sinceBest
+           || x.stopped != y.stopped || x.bestWeights != y.bestWeights || x.bestBiases != y.bestBiases){
+            return false;
+        }
+    }
+    for(size_t i = 0; i < a.layers.size(); i++){
+        const LayerT<Scalar>& x = a.layers[i];
+        const LayerT<Scalar>& y = b.layers[i];
+        if(x.weights != y.weights || x.biases != y.biases || x.historicGradients != y.historicGradients
+           || x.firstMoments != y.firstMoments || x.biasFirstMoments != y.biasFirstMoments
+           || x.biasHistoricGradients != y.biasHistoricGradients){
+            return false;
+        }
+    }
+    return true;
+}
+
+//trains one network with background checkpoints, then resumes a second one
+//from the checkpoint and trains both on the same remaining steps. plateau adds
+//a ReduceOnPlateau schedule driven by validation, whose state has to resume too
+template<typename Scalar>
+static bool checkResume(const std::string& path, const Optimizer& optimizer, int stepsBefore, int stepsAfter,
+                        bool plateau = false){
+    const int batchSize = 8;
+    std::vector<int> structure = {16, 48, 48, 4};
+    int total = stepsBefore + stepsAfter;
+    std::mt19937_64 generator(11);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<Scalar> inputs((size_t)total * batchSize * structure.front());
+    std::vector<Scalar> expected((size_t)total * batchSize * structure.back());
+    for(Scalar& value: inputs){
+        value = (Scalar)dist(generator);
+    }
+    for(Scalar& value: expected){
+        value = (Scalar)dist(generator);
+    }
+    std::vector<Scalar> batchInputs, batchExpected;
+    //odd steps train one sample at a time so both kinds of pass are resumed
+    auto trainStep = [&](NetworkT<Scalar>& net, int s){
+        size_t inputSize = (size_t)batchSize * structure.front();
+        size_t outputSize = (size_t)batchSize * structure.back();
+        batchInputs.assign(inputs.begin() + s * inputSize, inputs.begin() + (s + 1) * inputSize);
+        batchExpected.assign(expected.begin() + s * outputSize, expected.begin() + (s + 1) * outputSize);
+        if(s % 2 == 0){
+            net.trainBatch(batchInputs, batchExpected, batchSize);
+            return;
+        }
+        batchInputs.resize(structure.front());
+        batchExpected.resize(structure.back());
+        net.forwardPass(batchInputs);
+        net.backPropagate(batchExpected);
+    };
+    //negated squared error on the first rows, which shrinks too slowly to clear
+    //the threshold so the plateau lowers the rate over and over
+    std::vector<Scalar> scoreInputs;
+    auto score = [&](NetworkT<Scalar>& net){
+        double error = 0.0;
+        for(int r = 0; r < batchSize; r++){
+            scoreInputs.assign(inputs.begin() + r * structure.front(), inputs.begin() + (r + 1) * structure.front());
+            net.forwardPass(scoreInputs);
+            const std::vector<Scalar>& output = net.layers.back().activations;
+            for(int j = 0; j < structure.back(); j++){
+                double diff = (double)output[j] - expected[(size_t)r * structure.back() + j];
+                error += diff * diff;
+            }
+        }
+        return -error;
+    };
+    ValidationOptions validationOptions;
+    validationOptions.everySteps = 3;
+    validationOptions.patience = 0;
+    validationOptions.restoreBest = false;
+
+    NetworkT<Scalar> original;
+    original.setupNetwork(structure);
+    original.setOptimizer(optimizer);
+    original.learningRate = 1e-3;
+    if(plateau){
+        LearningRateSchedule schedule = LearningRateSchedule::reduceOnPlateau(1e-3, 0.5, 1);
+        schedule.threshold = 1e-2;
+        original.setSchedule(schedule);
+        original.enableValidation(validationOptions, score);
+    }
+    CheckpointOptions options;
+    options.path = path;
+    options.everySteps = stepsBefore;
+    original.enableCheckpoints(options);
+    for(int s = 0; s < total; s++){
+        trainStep(original, s);
+    }
+    original.checkpoints->flush();
+    int savedStep = original.checkpoints->savedStep();
+    double pause = original.checkpoints->longestPauseSeconds();
+    original.disableCheckpoints();
+
+    NetworkT<Scalar> resumed;
+    bool loaded = resumed.loadModel(path);
+    if(plateau){
+        resumed.enableValidation(validationOptions, score);
+    }
+    for(int s = stepsBefore; loaded && s < total; s++){
+        trainStep(resumed, s);
+    }
+    bool passed = loaded && savedStep == stepsBefore && sameState(original, resumed);
+    std::cout << "  " << std::left << std::setw(6) << (std::is_same<Scalar, float>::value ? "float" : "double")
+              << " " << std::setw(8) << optimizerName(optimizer.type) << " " << std::setw(8)
+              << scheduleName(original.schedule.type) << std::right
+              << " checkpoint at step " << savedStep << ", longest pause " << std::fixed << std::setprecision(1)
+              << pause * 1e6 << " us, resumed " << (passed ? "identical" : "DIFFERENT") << "\n";
+    std::cout.unsetf(std::ios::fixed);
+    return passed;
+}
+
+bool checkpointTest(int stepsBefore, int stepsAfter){
+    std::string path = (std::filesystem::temp_directory_path() / "nn_checkpoint_check.nnm").string();
+    std::cout << "resuming from a checkpoint after " << stepsBefore << " of " << stepsBefore + stepsAfter << " steps\n";
+    bool passed = true;
+    for(const Optimizer& optimizer: {Optimizer::rmsProp(), Optimizer::momentum(), Optimizer::adamW()}){
+        passed = checkResume<double>(path, optimizer, stepsBefore, stepsAfter) && passed;
+        passed = checkResume<float>(path, optimizer, stepsBefore, stepsAfter) && passed;
+    }
+    passed = checkResume<double>(path, Optimizer::adamW(), stepsBefore, stepsAfter, true) && passed;
+    passed = checkResume<float>(path, Optimizer::adamW(), stepsBefore, stepsAfter, true) && passed;
+
+    //a checkpoint with a section this build does not know must not load, it
+    //would resume without that part of the state
+    ModelHeader header;
+    bool refused = readModelHeader(path, header);
+    if(refused){
+        header.flags |= 1u << 31;
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.write((const char*)&header, sizeof(header));
+        file.close();
+        //the last checkpoint was the float run's
+        networkF unknown;
+        refused = !unknown.loadModel(path);
+    }
+    std::cout << "  checkpoint with an unknown section " << (refused ? "refused" : "LOADED") << "\n";
+    passed = passed && refused;
+    std::filesystem::remove(path);
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+bool softmaxTest(int epochs, uint64_t seed){
+    DataSet regressionData = processData("./data/iris.data");
+    DataSet labelData = processData("./data/iris.data", true);
+    if(regressionData.numRows == 0 || labelData.numRows == 0){
+        return false;
+    }
+    std::vector<size_t> trainRows, validationRows;
+    splitRows(labelData.numRows, 0.25, seed, trainRows, validationRows);
+    const int batchSize = 10;
+    bool passed = true;
+
+    //labels and the dense one-hot rows they stand for have to train the same
+    network dense;
+    dense.setupNetwork({4, 8, 3});
+    dense.layers.back().setActivation("softmax");
+    network labelled;
+    labelled.copyFrom(dense);
+    //on the pool, so the sliced batches get their labels too
+    dense.setThreads(3);
+    labelled.setThreads(3);
+    EpochSampler sampler(labelData, trainRows, seed + 1);
+    std::vector<RowView> batch;
+    std::vector<double> inputs, oneHot;
+    std::vector<int> labels;
+    while(int samples = sampler.nextBatch(batchSize, batch)){
+        gatherLabels(batch, 4, inputs, labels);
+        oneHot.assign((size_t)samples * 3, 0.0);
+        for(int n = 0; n < samples; n++){
+            oneHot[(size_t)n * 3 + labels[n]] = 1.0;
+        }
+        dense.trainBatch(inputs, oneHot, samples);
+        labelled.trainBatchLabels(inputs, labels, samples);
+        //and one sample at a time
+        inputs.resize(4);
+        oneHot.resize(3);
+        dense.forwardPass(inputs);
+        dense.backPropagate(oneHot);
+        labelled.forwardPass(inputs);
+        labelled.backPropagateLabel(labels[0]);
+    }
+    bool same = true;
+    for(size_t i = 1; i < dense.layers.size(); i++){
+        same = same && dense.layers[i].weights == labelled.layers[i].weights && dense.layers[i].biases == labelled.layers[i].biases;
+    }
+    InferenceNetwork frozen = labelled.freeze();
+    double frozenOutputs[3];
+    frozen.predict(inputs.data(), frozenOutputs);
+    labelled.forwardPass(inputs);
+    const std::vector<double>& probabilities = labelled.layers.back().activations;
+    double sum = probabilities[0] + probabilities[1] + probabilities[2];
+    bool frozenSame = std::equal(probabilities.begin(), probabilities.end(), frozenOutputs);
+    std::cout << "softmax: labels train " << (same ? "the same as" : "DIFFERENTLY from") << " one-hot rows, outputs sum to "
+              << sum << ", frozen plan " << (frozenSame ? "matches" : "DIFFERS") << "\n";
+    passed = same && frozenSame && std::abs(sum - 1.0) < 1e-12;
+
+    //the class id regressed onto one output with mean squared error as hardTest
+    //does, against three softmax outputs with cross-entropy, same optimizer and rows
+    network regression;
+    regression.setupNetwork({4, 5, 5, 8, 1});
+    regression.setOptimizer(Optimizer::adam());
+    regression.learningRate = 0.01;
+    network classifier;
+    classifier.setupNetwork({4, 5, 5, 8, 3});
+    classifier.layers.back().setActivation("softmax");
+    classifier.setOptimizer(Optimizer::adam());
+    classifier.learningRate = 0.01;
+    EpochSampler regressionSampler(regressionData, trainRows, seed + 2);
+    EpochSampler classifierSampler(labelData, trainRows, seed + 2);
+    std::vector<double> expected;
+    std::cout << "held out iris accuracy  epoch  mse regression  softmax cross-entropy\n";
+    for(int epoch = 1; epoch <= epochs; epoch++){
+        regressionSampler.startEpoch();
+        classifierSampler.startEpoch();
+        while(int samples = regressionSampler.nextBatch(batchSize, batch)){
+            gatherBatch(batch, 4, inputs, expected);
+            regression.trainBatch(inputs, expected, samples);
+        }
+        while(int samples = classifierSampler.nextBatch(batchSize, batch)){
+            gatherLabels(batch, 4, inputs, labels);
+            classifier.trainBatchLabels(inputs, labels, samples);
+        }
+        if(epoch % std::max(1, epochs / 5) == 0 || epoch == epochs){
+            std::cout << "                        " << std::setw(5) << epoch << std::fixed << std::setprecision(3)
+                      << std::setw(16) << irisAccuracy(regression, regressionData, validationRows)
+                      << std::setw(23) << irisAccuracy(classifier, labelData, validationRows) << "\n";
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+//largest difference between two networks' outputs for the same input
+static double outputDifference(network& a, network& b, const std::vector<double>& input){
+    a.forwardPass(input);
+    b.forwardPass(input);
+    double largest = 0.0;
+    for(size_t j = 0; j < a.layers.back().activations.size(); j++){
+        largest = std::max(largest, std::abs(a.layers.back().activations[j] - b.layers.back().activations[j]));
+    }
+    return largest;
+}
+
+//seconds per predict call of plan, best of a few rounds
+static double predictSeconds(const InferenceNetwork& plan, const std::vector<double>& inputs, int samples){
+    std::vector<double> output(plan.outputSize());
+    double best = std::numeric_limits<double>::infinity();
+    for(int round = 0; round < 5; round++){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int n = 0; n < samples; n++){
+            plan.predict(&inputs[(size_t)n * plan.inputSize()], output.data());
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / samples);
+    }
+    return best;
+}
+
+bool pruneTest(double density, uint64_t seed){
+    bool passed = true;
+    std::mt19937_64 generator(seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+    //gradual pruning with fine-tuning on the iris data, the pruned weights have
+    //to stay zero while the network keeps training
+    DataSet data = processData("./data/iris.data");
+    if(data.numRows == 0){
+        return false;
+    }
+    network neuralNet;
+    neuralNet.setupNetwork({4, 64, 64, 1});
+    neuralNet.setOptimizer(Optimizer::adam());
+    neuralNet.learningRate = 0.005;
+    EpochSampler sampler(data, seed);
+    std::vector<RowView> batch;
+    std::vector<double> inputs, expected, single(4), target(1);
+    auto meanSquaredError = [&](){
+        double sum = 0.0;
+        for(size_t r = 0; r < data.numRows; r++){
+            single.assign(data.row(r), data.row(r) + 4);
+            neuralNet.forwardPass(single);
+            double error = neuralNet.layers.back().activations[0] - data.row(r)[4];
+            sum += error * error;
+        }
+        return sum / data.numRows;
+    };
+    //batches and single samples, so both the GEMM and the sparse passes train
+    auto train = [&](int epochs){
+        for(int epoch = 0; epoch < epochs; epoch++){
+            sampler.startEpoch();
+            while(int samples = sampler.nextBatch(10, batch)){
+                gatherBatch(batch, 4, inputs, expected);
+                neuralNet.trainBatch(inputs, expected, samples);
+                single.assign(inputs.begin(), inputs.begin() + 4);
+                target[0] = expected[0];
+                neuralNet.forwardPass(single);
+                neuralNet.backPropagate(target);
+            }
+        }
+    };
+    train(30);
+    std::cout << "magnitude pruning of a 4-64-64-1 network on iris\n";
+    std::cout << "  density 1.00  mse " << meanSquaredError() << "\n";
+    for(double step: {0.5, 0.25, density}){
+        neuralNet.prune(step);
+        double pruned = meanSquaredError();
+        train(10);
+        std::cout << "  density " << std::fixed << std::setprecision(2) << neuralNet.density();
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6) << "  mse " << pruned << " pruned, " << meanSquaredError() << " after fine-tuning\n";
+    }
+    for(size_t i = 1; i < neuralNet.layers.size(); i++){
+        const Layer& layer = neuralNet.layers[i];
+        size_t weightCount = (size_t)layer.size * layer.inputSize;
+        size_t nonzero = weightCount - std::count(layer.weights.begin(), layer.weights.end(), 0.0);
+        passed = passed && layer.sparseColumns.size() == (size_t)std::llround(density * weightCount)
+                 && nonzero <= layer.sparseColumns.size();
+    }
+    std::cout << "  pruned weights stayed zero: " << (passed ? "yes" : "NO") << "\n";
+
+    //the sparse passes against the same weights run dense
+    network dense;
+    dense.copyFrom(neuralNet);
+    for(Layer& layer: dense.layers){
+        layer.makeDense();
+    }
+    double largest = 0.0;
+    for(size_t r = 0; r < data.numRows; r++){
+        single.assign(data.row(r), data.row(r) + 4);
+        largest = std::max(largest, outputDifference(neuralNet, dense, single));
+    }
+    //and after a save, which keeps the CSR form, the model comes back sparse,
+    //mapped too where the layers run on the CSR arrays inside the mapping
+    std::string path = (std::filesystem::temp_directory_path() / "nn_prune_check.nnm").string();
+    network loaded, mapped;
+    bool reloaded = neuralNet.saveModel(path) && loaded.loadModel(path) && mapped.loadModel(path, true);
+    reloaded = reloaded && loaded.density() == neuralNet.density() && outputDifference(neuralNet, loaded, single) == 0.0
+               && mapped.density() == neuralNet.density() && outputDifference(neuralNet, mapped, single) == 0.0;
+    std::filesystem::remove(path);
+    std::cout << "  sparse vs dense outputs differ by " << largest << ", reloaded model "
+              << (reloaded ? "is the same" : "DIFFERS") << "\n";
+    passed = passed && largest < 1e-12 && reloaded;
+
+    //a wider random network for memory and speed, the sparse plan against the
+    //dense plan of the same network before pruning
+    std::vector<int> structure = {512, 1024, 1024, 16};
+    const int samples = 64;
+    network wide;
+    wide.setupNetwork(structure);
+    InferenceNetwork densePlan = wide.freeze();
+    wide.prune(density);
+    InferenceNetwork sparsePlan = wide.freeze();
+    std::vector<double> wideInputs((size_t)samples * structure.front());
+    for(double& value: wideInputs){
+        value = dist(generator);
+    }
+    double denseTime = predictSeconds(densePlan, wideInputs, samples);
+    double sparseTime = predictSeconds(sparsePlan, wideInputs, samples);
+    std::cout << "512-1024-1024-16 at density " << density << ": " << densePlan.parameterBytes() << " -> "
+              << sparsePlan.parameterBytes() << " bytes (" << std::fixed << std::setprecision(1)
+              << (double)densePlan.parameterBytes() / sparsePlan.parameterBytes() << "x smaller), predict "
+              << denseTime * 1e6 << " -> " << sparseTime * 1e6 << " us (" << denseTime / sparseTime << "x faster)\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+
+    //every ISA has to give the scalar kernels' results bit for bit, forward
+    //through the plan and one training step through the sparse passes
+    std::vector<double> reference(structure.back()), output(structure.back()), referenceActivations;
+    std::vector<double> wideInput(wideInputs.begin(), wideInputs.begin() + structure.front());
+    std::vector<double> wideTarget(structure.back(), 0.5);
+    network referenceNet;
+    bool sameEverywhere = true;
+    for(KernelISA isa: {KernelISA::Scalar, KernelISA::SSE2, KernelISA::AVX2, KernelISA::AVX512}){
+        if(!setKernelISA(isa)){
+            continue;
+        }
+        network trained;
+        trained.copyFrom(wide);
+        trained.forwardPass(wideInput);
+        trained.backPropagate(wideTarget);
+        trained.forwardPass(wideInput);
+        if(isa == KernelISA::Scalar){
+            sparsePlan.predict(wideInput.data(), reference.data());
+            referenceNet.copyFrom(trained);
+            referenceActivations = trained.layers.back().activations;
+            //wide layers split by rows and columns across threads take the
+            //same step, the column ranges cut every sparse row
+            network split;
+            split.copyFrom(wide);
+            split.setThreads(3);
+            split.intraLayerParallel = true;
+            split.forwardPass(wideInput);
+            split.backPropagate(wideTarget);
+            bool sameSplit = true;
+            for(size_t i = 1; i < split.layers.size(); i++){
+                sameSplit = sameSplit && split.layers[i].weights == trained.layers[i].weights;
+            }
+            std::cout << "  threaded sparse passes " << (sameSplit ? "match" : "DIFFER from") << " one thread\n";
+            sameEverywhere = sameEverywhere && sameSplit;
+            continue;
+        }
+        sparsePlan.predict(wideInput.data(), output.data());
+        bool same = output == reference && trained.layers.back().activations == referenceActivations;
+        for(size_t i = 1; i < trained.layers.size(); i++){
+            same = same && trained.layers[i].weights == referenceNet.layers[i].weights;
+        }
+        std::cout << "  " << kernels().name << " sparse kernels " << (same ? "match" : "DIFFER from") << " scalar\n";
+        sameEverywhere = sameEverywhere && same;
+    }
+    setKernelISA(detectKernelISA());
+    passed = passed && sameEverywhere;
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+bool populationTest(int numThreads, uint64_t seed){
+    //loaded once, every network of the sweep reads the same rows
+    DataSet data = processData("./data/iris.data");
+    if(data.numRows == 0){
+        return false;
+    }
+    std::vector<std::vector<int>> structures = {{4, 5, 5, 8, 1}, {4, 8, 1}, {4, 32, 1}, {4, 16, 16, 1}, {4, 8, 8, 8, 1}, {4, 16, 8, 1}};
+    std::vector<double> learningRates = {0.0005, 0.001, 0.002, 0.005, 0.01, 0.02};
+    std::vector<Optimizer> optimizers = {Optimizer::rmsProp(), Optimizer::adam(), Optimizer::momentum(), Optimizer::sgd()};
+    PopulationOptions options;
+    options.seed = seed;
+    std::vector<PopulationResult> results[2];
+    double wallSeconds[2];
+    int threadCounts[2] = {numThreads, 1};
+    for(int run = 0; run < 2; run++){
+        options.numThreads = threadCounts[run];
+        PopulationTrainer trainer(data, 4, options);
+        uint64_t configSeed = seed;
+        for(const std::vector<int>& structure: structures){
+            for(double learningRate: learningRates){
+                for(const Optimizer& optimizer: optimizers){
+                    for(int batchSize: {1, 10}){
+                        trainer.add({structure, learningRate, optimizer, batchSize, ++configSeed});
+                    }
+                }
+            }
+        }
+        results[run] = trainer.run();
+        wallSeconds[run] = trainer.seconds();
+    }
+
+    int epochs = 0;
+    double trainingSeconds = 0.0;
+    for(const PopulationResult& result: results[0]){
+        epochs += result.epochs;
+        trainingSeconds += result.seconds;
+    }
+    std::cout << "sweep of " << results[0].size() << " iris networks with successive halving (eta " << options.eta
+              << ", " << options.minEpochs << " to " << options.maxEpochs << " epochs)\n";
+    printPopulationResults(results[0], std::cout, 10);
+    std::cout << "  " << epochs << " epochs trained instead of " << results[0].size() * options.maxEpochs
+              << " without halving, " << trainingSeconds << " s of training in total\n";
+    std::cout << "  wall time " << wallSeconds[0] << " s on " << (numThreads > 0 ? numThreads : (int)std::thread::hardware_concurrency())
+              << " threads, " << wallSeconds[1] << " s on 1 (" << wallSeconds[1] / wallSeconds[0] << "x)\n";
+    //the thread count must not change any result
+    bool same = results[0].size() == results[1].size();
+    for(size_t i = 0; same && i < results[0].size(); i++){
+        same = results[0][i].config.seed == results[1][i].config.seed && results[0][i].epochs == results[1][i].epochs
+               && results[0][i].validationError == results[1][i].validationError;
+    }
+    std::cout << "  results " << (same ? "identical" : "DIFFER") << " on 1 thread\n";
+    std::cout << (same ? "ok" : "FAILED") << "\n";
+    return same;
+}
+
+//== that also counts two NaNs as equal, a member that diverged has to diverge the same way
+template<typename Scalar>
+static bool sameValues(const std::vector<Scalar>& a, const std::vector<Scalar>& b){
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](Scalar x, Scalar y){
+        return x == y || (std::isnan(x) && std::isnan(y));
+    });
+}
+
+//trains members networks one at a time and as one lockstep ensemble on the
+//same bootstrap samples and checks every member ends up bit for bit the same
+template<typename Scalar>
+static bool checkLockstep(const DataSet& data, const std::vector<size_t>& rows, const std::vector<int>& structure,
+                          const Optimizer& optimizer, int members, int steps, uint64_t seed){
+    std::vector<NetworkT<Scalar>> networks(members);
+    for(int m = 0; m < members; m++){
+        networks[m].setupNetwork(structure, seed + m);
+        networks[m].setOptimizer(optimizer);
+        //the ensemble has to follow the members' schedule step for step
+        networks[m].setSchedule(LearningRateSchedule::cosine(0.005, steps));
+    }
+    EnsembleT<Scalar> ensemble(networks);
+    std::mt19937_64 generator(seed);
+    std::vector<Scalar> inputs((size_t)members * 4), expected(members), input(4), target(1);
+    for(int s = 0; s < steps; s++){
+        for(int m = 0; m < members; m++){
+            const double* row = data.row(rows[randomBelow(generator, rows.size())]);
+            std::copy(row, row + 4, &inputs[(size_t)m * 4]);
+            expected[m] = (Scalar)row[4];
+            input.assign(row, row + 4);
+            target[0] = (Scalar)row[4];
+            networks[m].forwardPass(input);
+            networks[m].backPropagate(target);
+        }
+        ensemble.train(inputs.data(), expected.data());
+    }
+    bool same = true;
+    for(int m = 0; m < members; m++){
+        NetworkT<Scalar> member = ensemble.member(m);
+        for(size_t i = 1; i < member.layers.size(); i++){
+            same = same && sameValues(member.layers[i].weights, networks[m].layers[i].weights)
+                   && sameValues(member.layers[i].biases, networks[m].layers[i].biases)
+                   && sameValues(member.layers[i].historicGradients, networks[m].layers[i].historicGradients);
+        }
+    }
+    std::ostringstream shape;
+    for(size_t l = 0; l < structure.size(); l++){
+        shape << (l ? "-" : "") << structure[l];
+    }
+    std::cout << "  " << std::left << std::setw(6) << (std::is_same<Scalar, float>::value ? "float" : "double")
+              << " " << std::setw(8) << optimizerName(optimizer.type) << " " << std::setw(10) << shape.str() << std::right
+              << " members " << (same ? "identical to" : "DIFFERENT from") << " separate networks\n";
+    return same;
+}
+
+//samples per second of members networks trained one after another against
+//the same samples through an ensemble
+template<typename Scalar>
+static void lockstepThroughput(const std::vector<int>& structure, int members, int steps){
+    std::vector<NetworkT<Scalar>> networks(members);
+    for(int m = 0; m < members; m++){
+        networks[m].setupNetwork(structure, m + 1);
+        networks[m].learningRate = 0.001;
+    }
+    EnsembleT<Scalar> ensemble(networks);
+    std::vector<Scalar> inputs((size_t)members * structure.front(), Scalar(0.5));
+    std::vector<Scalar> expected((size_t)members * structure.back(), Scalar(0.25));
+    std::vector<Scalar> input(structure.front(), Scalar(0.5)), target(structure.back(), Scalar(0.25));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int s = 0; s < steps; s++){
+        for(NetworkT<Scalar>& net: networks){
+            net.forwardPass(input);
+            net.backPropagate(target);
+        }
+    }
+    double separate = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for(int s = 0; s < steps; s++){
+        ensemble.train(inputs.data(), expected.data());
+    }
+    double lockstep = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double samples = (double)steps * members;
+    std::cout << "  " << std::left << std::setw(6) << (std::is_same<Scalar, float>::value ? "float" : "double") << std::right
+              << " " << members << " members: " << std::fixed << std::setprecision(0) << samples / separate
+              << " samples/sec separately, " << samples / lockstep << " in lockstep (" << std::setprecision(1)
+              << separate / lockstep << "x)\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
+
+bool ensembleTest(int members, int epochs, uint64_t seed){
+    DataSet data = processData("./data/iris.data");
+    if(data.numRows == 0){
+        return false;
+    }
+    std::vector<size_t> trainRows, validationRows;
+    splitRows(data.numRows, 0.25, seed, trainRows, validationRows);
+    bool passed = true;
+    std::cout << "lockstep ensembles of " << members << " iris networks (" << kernels().name << " kernels)\n";
+    //the wide layer has full blocks of dot's partial sums for both scalar types
+    for(const std::vector<int>& structure: {std::vector<int>{4, 5, 5, 8, 1}, std::vector<int>{4, 40, 8, 1}}){
+        for(const Optimizer& optimizer: {Optimizer::rmsProp(), Optimizer::adamW()}){
+            passed = checkLockstep<double>(data, trainRows, structure, optimizer, members, 200, seed) && passed;
+            passed = checkLockstep<float>(data, trainRows, structure, optimizer, members, 200, seed) && passed;
+        }
+    }
+    lockstepThroughput<double>({4, 5, 5, 8, 1}, members, 20000);
+    lockstepThroughput<float>({4, 5, 5, 8, 1}, members * 2, 20000);
+
+    //bagging: every member trains on its own bootstrap sample of the rows and
+    //the ensemble predicts their average
+    Ensemble bagged({4, 5, 5, 8, 1}, members, seed);
+    bagged.learningRate = 0.005;
+    std::mt19937_64 generator(seed + 1);
+    std::vector<double> inputs((size_t)members * 4), expected(members);
+    for(size_t s = 0; s < (size_t)epochs * trainRows.size(); s++){
+        for(int m = 0; m < members; m++){
+            const double* row = data.row(trainRows[randomBelow(generator, trainRows.size())]);
+            std::copy(row, row + 4, &inputs[(size_t)m * 4]);
+            expected[m] = row[4];
+        }
+        bagged.train(inputs.data(), expected.data());
+    }
+    double averaged = 0.0;
+    std::vector<double> memberErrors(members, 0.0);
+    for(size_t r: validationRows){
+        const double* row = data.row(r);
+        double prediction;
+        bagged.predict(row, &prediction);
+        averaged += (prediction - row[4]) * (prediction - row[4]);
+        for(int m = 0; m < members; m++){
+            double error = bagged.output(m, 0) - row[4];
+            memberErrors[m] += error * error;
+        }
+    }
+    double meanMember = 0.0;
+    for(double error: memberErrors){
+        meanMember += error / validationRows.size() / members;
+    }
+    std::cout << "  bagged held out mse after " << epochs << " epochs: " << averaged / validationRows.size()
+              << " averaged, " << meanMember << " per member on average\n";
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+//kernels of every type with an exact reference to compare or time against
+static const ActivationType SWEPT_ACTIVATIONS[] = {
+    ActivationType::Tanh, ActivationType::Sigmoid, ActivationType::Gelu, ActivationType::Softplus,
+    ActivationType::TanhFast, ActivationType::SigmoidFast, ActivationType::GeluFast, ActivationType::SoftplusFast
+};
+
+//documented largest absolute errors of the fast types (activation_functions.h)
+//for the value and the derivative, 0 for the exact ones
+static void activationBounds(ActivationType type, double& valueBound, double& derivativeBound){
+    switch(type){
+        case ActivationType::TanhFast:
+            valueBound = 2.7e-7;
+            derivativeBound = 5.3e-7;
+            break;
+        case ActivationType::SigmoidFast:
+            valueBound = 1.3e-7;
+            derivativeBound = 1.3e-7;
+            break;
+        case ActivationType::GeluFast:
+            valueBound = 2.2e-7;
+            derivativeBound = 8e-8;
+            break;
+        case ActivationType::SoftplusFast:
+            valueBound = 1.1e-7;
+            derivativeBound = 4e-8;
+            break;
+        default:
+            valueBound = 0.0;
+            derivativeBound = 0.0;
+    }
+}
+
+//runs the selected kernel of type over inputs and compares every value and
+//derivative with the long double reference. Each may be off by its bound plus
+//a few units of rounding of the result in Scalar. Returns the largest absolute
+//errors and whether every element was within that
+template<typename Scalar>
+static bool sweepActivation(ActivationType type, const std::vector<Scalar>& inputs,
+                            double& valueError, double& derivativeError){
+    std::vector<Scalar> values(inputs.size()), derivatives(inputs.size());
+    kernelsFor<Scalar>().activation[(int)type](inputs.data(), values.data(), derivatives.data(), inputs.size());
+    double valueBound, derivativeBound;
+    activationBounds(type, valueBound, derivativeBound);
+    const long double rounding = 4.0L * std::numeric_limits<Scalar>::epsilon();
+    valueError = 0.0;
+    derivativeError = 0.0;
+    bool within = true;
+    for(size_t i = 0; i < inputs.size(); i++){
+        ActivationResultT<long double> exact = applyActivation(type, (long double)inputs[i]);
+        long double valueDifference = std::abs(values[i] - exact.activatedValue);
+        long double derivativeDifference = std::abs(derivatives[i] - exact.derivative);
+        within = within && valueDifference <= valueBound + rounding * std::max(1.0L, std::abs(exact.activatedValue))
+                 && derivativeDifference <= derivativeBound + rounding * std::max(1.0L, std::abs(exact.derivative));
+        valueError = std::max(valueError, (double)valueDifference);
+        derivativeError = std::max(derivativeError, (double)derivativeDifference);
+    }
+    return within;
+}
+
+//every ISA's activation and bias + activation kernels against the scalar ones, bit for bit
+template<typename Scalar>
+static bool sameActivationKernels(const std::vector<Scalar>& inputs){
+    std::vector<Scalar> bias(inputs.size());
+    for(size_t i = 0; i < bias.size(); i++){
+        bias[i] = Scalar(0.25) * inputs[bias.size() - 1 - i];
+    }
+    std::vector<std::vector<Scalar>> reference;
+    bool same = true;
+    for(KernelISA isa: {KernelISA::Scalar, KernelISA::SSE2, KernelISA::AVX2, KernelISA::AVX512}){
+        if(!setKernelISA(isa)){
+            continue;
+        }
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        for(size_t t = 0; t < std::size(SWEPT_ACTIVATIONS); t++){
+            int type = (int)SWEPT_ACTIVATIONS[t];
+            std::vector<Scalar> values(inputs.size()), derivatives(inputs.size());
+            std::vector<Scalar> fused = inputs;
+            k.activation[type](inputs.data(), values.data(), derivatives.data(), inputs.size());
+            k.biasActivation[type](bias.data(), fused.data(), fused.size());
+            values.insert(values.end(), derivatives.begin(), derivatives.end());
+            values.insert(values.end(), fused.begin(), fused.end());
+            if(isa == KernelISA::Scalar){
+                reference.push_back(values);
+            }else{
+                same = same && values == reference[t];
+            }
+        }
+    }
+    setKernelISA(detectKernelISA());
+    return same;
+}
+
+//nanoseconds per element of one activation kernel over a block that stays in cache
+template<typename Scalar>
+static double activationNanoseconds(ActivationType type, int repeats){
+    std::vector<Scalar> inputs(4096), values(4096), derivatives(4096);
+    for(size_t i = 0; i < inputs.size(); i++){
+        inputs[i] = Scalar(-8.0 + 16.0 * i / inputs.size());
+    }
+    ActivationKernelT<Scalar> kernel = kernelsFor<Scalar>().activation[(int)type];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeats; r++){
+        kernel(inputs.data(), values.data(), derivatives.data(), inputs.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / ((double)repeats * inputs.size());
+}
+
+bool activationTest(int epochs, uint64_t seed){
+    DataSet data = processData("./data/iris.data", true);
+    if(data.numRows == 0){
+        return false;
+    }
+    bool passed = true;
+
+    //every 1e-4 on [-20, 20] and the odd count leaves a tail for the scalar loops
+    std::vector<double> inputs;
+    for(int i = -200000; i <= 200000; i++){
+        inputs.push_back(i * 1e-4);
+    }
+    std::vector<float> inputsF(inputs.begin(), inputs.end());
+    std::cout << "largest absolute error on [-20, 20] (" << kernels().name << " kernels)\n"
+              << "activation       double value  derivative   float value  derivative\n";
+    for(ActivationType type: SWEPT_ACTIVATIONS){
+        double valueError, derivativeError, valueErrorF, derivativeErrorF;
+        bool within = sweepActivation(type, inputs, valueError, derivativeError);
+        within = sweepActivation(type, inputsF, valueErrorF, derivativeErrorF) && within;
+        std::cout << std::left << std::setw(15) << activationName(type) << std::right << std::scientific << std::setprecision(2)
+                  << std::setw(14) << valueError << std::setw(12) << derivativeError
+                  << std::setw(14) << valueErrorF << std::setw(12) << derivativeErrorF
+                  << (within ? "" : "  OUT OF BOUNDS") << "\n";
+        std::cout.unsetf(std::ios::scientific);
+        passed = passed && within;
+    }
+    std::cout << std::setprecision(6);
+    bool sameEverywhere = sameActivationKernels(inputs) && sameActivationKernels(inputsF);
+    std::cout << "every ISA's activation kernels " << (sameEverywhere ? "match" : "DIFFER from") << " the scalar ones\n";
+    passed = passed && sameEverywhere;
+
+    //libm's tanh per element, what the tanh layers used to cost. The inputs
+    //move a little every repeat and the sum is checked afterwards, so no call
+    //can be skipped
+    const int repeats = 2000;
+    double sum = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeats; r++){
+        for(int i = 0; i < 4096; i++){
+            ActivationResult result = tanH(-8.0 + 16.0 * i / 4096 + r * 1e-9);
+            sum += result.activatedValue + result.derivative;
+        }
+    }
+    double libmTanh = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e9
+                      / ((double)repeats * 4096);
+    passed = passed && std::isfinite(sum);
+    std::cout << "ns per element     exact   fast  speedup   float exact   fast  speedup   (libm tanh "
+              << std::fixed << std::setprecision(2) << libmTanh << ")\n";
+    for(size_t t = 0; t < std::size(SWEPT_ACTIVATIONS) / 2; t++){
+        ActivationType exact = SWEPT_ACTIVATIONS[t];
+        ActivationType fast = withPrecision(exact, ActivationPrecision::Fast);
+        double exactTime = activationNanoseconds<double>(exact, repeats);
+        double fastTime = activationNanoseconds<double>(fast, repeats);
+        double exactTimeF = activationNanoseconds<float>(exact, repeats);
+        double fastTimeF = activationNanoseconds<float>(fast, repeats);
+        std::cout << std::left << std::setw(15) << activationName(exact) << std::right
+                  << std::setw(9) << exactTime << std::setw(7) << fastTime << std::setw(8) << exactTime / fastTime << "x"
+                  << std::setw(14) << exactTimeF << std::setw(7) << fastTimeF << std::setw(8) << exactTimeF / fastTimeF << "x\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+
+    //the same iris classifier from the same weights on the same rows with
+    //each exact hidden activation and its approximation
+    std::vector<size_t> trainRows, validationRows;
+    splitRows(data.numRows, 0.25, seed, trainRows, validationRows);
+    std::cout << "held out iris accuracy after " << epochs << " epochs   exact   fast\n";
+    std::vector<RowView> batch;
+    std::vector<double> batchInputs;
+    std::vector<int> labels;
+    for(size_t t = 0; t < std::size(SWEPT_ACTIVATIONS) / 2; t++){
+        double accuracy[2];
+        for(int precision = 0; precision < 2; precision++){
+            network net;
+            net.setupNetwork({4, 8, 8, 3}, seed);
+            for(size_t i = 1; i + 1 < net.layers.size(); i++){
+                net.layers[i].setActivation(activationName(SWEPT_ACTIVATIONS[t]), (ActivationPrecision)precision);
+            }
+            net.layers.back().setActivation("softmax");
+            net.setOptimizer(Optimizer::adam());
+            net.learningRate = 0.01;
+            EpochSampler sampler(data, trainRows, seed + 1);
+            for(int epoch = 0; epoch < epochs; epoch++){
+                sampler.startEpoch();
+                while(int samples = sampler.nextBatch(10, batch)){
+                    gatherLabels(batch, 4, batchInputs, labels);
+                    net.trainBatchLabels(batchInputs, labels, samples);
+                }
+            }
+            accuracy[precision] = irisAccuracy(net, data, validationRows);
+        }
+        bool unchanged = std::abs(accuracy[1] - accuracy[0]) <= 1.0 / validationRows.size() + 1e-12;
+        std::cout << "  " << std::left << std::setw(37) << activationName(SWEPT_ACTIVATIONS[t]) << std::right
+                  << std::fixed << std::setprecision(3) << accuracy[0] << std::setw(7) << accuracy[1]
+                  << (unchanged ? "" : "  CHANGED") << "\n";
+        std::cout.unsetf(std::ios::fixed);
+        passed = passed && unchanged;
+    }
+    std::cout << std::setprecision(6) << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+//clients send requests of 1 to 4 random rows through the server at the same
+//time and every response has to match the frozen network's own predictions
+template<typename Scalar>
+static bool serverMatches(const InferenceNetworkT<Scalar>& frozen, const ServerOptions& options, int port, uint64_t seed){
+    const int clients = 6;
+    const int requests = 300;
+    std::atomic<bool> matched{true};
+    std::vector<std::thread> threads;
+    for(int c = 0; c < clients; c++){
+        threads.emplace_back([&, c](){
+            InferenceClientT<Scalar> client;
+            if(!client.connect(options.socketPath, port)){
+                matched = false;
+                return;
+            }
+            std::mt19937_64 generator(seed + c);
+            std::uniform_real_distribution<double> dist(0.0, 1.0);
+            std::vector<Scalar> inputs, outputs, expected;
+            for(int r = 0; r < requests; r++){
+                int rows = 1 + (int)(generator() % 4);
+                inputs.resize((size_t)rows * frozen.inputSize());
+                outputs.resize((size_t)rows * frozen.outputSize());
+                expected.resize(outputs.size());
+                for(Scalar& value: inputs){
+                    value = (Scalar)dist(generator);
+                }
+                if(!client.predict(inputs.data(), outputs.data(), rows)){
+                    matched = false;
+                    return;
+                }
+                frozen.predictBatch(inputs.data(), expected.data(), rows);
+                if(outputs != expected){
+                    matched = false;
+                }
+            }
+        });
+    }
+    for(std::thread& thread: threads){
+        thread.join();
+    }
+    return matched;
+}
+
+bool serverTest(double seconds, uint64_t seed){
+    bool passed = true;
+    network net;
+    net.setupNetwork({32, 1024, 1024, 10}, seed);
+    InferenceNetwork frozen = net.freeze();
+    networkF netF;
+    netF.copyFrom(net);
+    InferenceNetworkF frozenF = netF.freeze();
+    //the float model is served from a mapped load, like nn_server does, so
+    //its plan refers to the weights in the mapping instead of copying them
+    std::string modelPath = (std::filesystem::temp_directory_path() / "nn_server_check.nnm").string();
+    networkF mappedNet;
+    bool mappedLoad = netF.saveModel(modelPath, false) && mappedNet.loadModel(modelPath, true);
+    InferenceNetworkF mappedF = mappedNet.freeze();
+    //the mapping stays valid once the name is gone
+    std::filesystem::remove(modelPath);
+    bool shared = mappedLoad && mappedF.parameterBytes() < frozenF.parameterBytes() / 100;
+    std::cout << "float plan of a mapped load holds " << mappedF.parameterBytes() << " of " << frozenF.parameterBytes()
+              << " bytes, " << (shared ? "the weights stay in the mapping" : "the weights were COPIED") << "\n";
+    passed = passed && shared;
+
+    //double over loopback TCP, float over a Unix domain socket
+    ServerOptions options;
+    {
+        InferenceServer server(frozen, options);
+        bool matched = server.start() && serverMatches(frozen, options, server.port(), seed);
+        std::cout << "double model over TCP: responses " << (matched ? "match" : "DIFFER from") << " predict\n";
+        passed = passed && matched;
+    }
+#ifndef _WIN32
+    ServerOptions unixOptions;
+    unixOptions.socketPath = (std::filesystem::temp_directory_path() / "nn_server_check.sock").string();
+    {
+        InferenceServerF server(mappedF, unixOptions);
+        bool matched = server.start() && serverMatches(frozenF, unixOptions, 0, seed);
+        std::cout << "float model over " << unixOptions.socketPath << ": responses "
+                  << (matched ? "match" : "DIFFER from") << " predict\n";
+        passed = passed && matched;
+    }
+#endif
+
+    //8 clients sending one row each, served one request per predict and in micro-batches
+    std::cout << "8 connections x 1 row for " << seconds << " s\n";
+    for(int maxBatch: {1, 64}){
+        ServerOptions loadOptions;
+        loadOptions.maxBatch = maxBatch;
+        InferenceServer server(frozen, loadOptions);
+        if(!server.start()){
+            passed = false;
+            continue;
+        }
+        LoadOptions load;
+        load.port = server.port();
+        load.seconds = seconds;
+        load.seed = seed;
+        LoadResult result = generateLoad(load);
+        ServerStats stats = server.stats();
+        std::cout << "  max batch " << std::setw(2) << maxBatch << ": ";
+        printLoadResult(result, std::cout);
+        std::cout << "  server: ";
+        printServerStats(stats, std::cout);
+        passed = passed && result.ok && result.requests > 0;
+    }
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
+
+static bool sameRate(double rate, double expected){
+    return std::abs(rate - expected) <= 1e-12 * std::max(1.0, std::abs(expected));
+}
+
+//every schedule at the steps where its closed form is easy to write down
+static bool scheduleCurves(){
+    LearningRateSchedule cosine = LearningRateSchedule::cosine(0.1, 1100, 0.001, 100);
+    bool same = sameRate(cosine.rateAt(0), 0.001) && sameRate(cosine.rateAt(49), 0.05) && sameRate(cosine.rateAt(100), 0.1)
+                && sameRate(cosine.rateAt(600), 0.0505) && sameRate(cosine.rateAt(1100), 0.001)
+                && sameRate(cosine.rateAt(5000), 0.001);
+    LearningRateSchedule decay = LearningRateSchedule::stepDecay(0.1, 100, 0.5);
+    same = same && sameRate(decay.rateAt(99), 0.1) && sameRate(decay.rateAt(100), 0.05) && sameRate(decay.rateAt(250), 0.025);
+    //patience 2: the third score in a row without progress halves the rate, down to 0.03
+    LearningRateSchedule plateau = LearningRateSchedule::reduceOnPlateau(0.1, 0.5, 2, 0.03);
+    bool reduced[8];
+    double scores[8] = {0.5, 0.5, 0.5, 0.6, 0.6, 0.6, 0.6, 0.6};
+    for(int i = 0; i < 8; i++){
+        reduced[i] = plateau.observe(scores[i]);
+    }
+    same = same && !reduced[0] && !reduced[1] && reduced[2] && !reduced[3] && !reduced[4] && reduced[5]
+           && !reduced[6] && !reduced[7] && sameRate(plateau.rateAt(0), 0.03);
+    std::cout << "schedule curves " << (same ? "match" : "DIFFER from") << " their closed forms\n";
+    return same;
+}
+
+struct TargetRun {
+    int steps = 0;
+    double seconds = 0.0;
+    //-1 when the target was never reached
+    int stepsToTarget = -1;
+    double secondsToTarget = 0.0;
+    double bestAccuracy = 0.0;
+    //the weights left in the network score the best accuracy
+    bool restored = false;
+    //(step, accuracy) of every epoch
+    std::vector<std::pair<int, double>> history;
+};
+
+//trains the iris classifier for up to epochs with schedule, validating after
+//every epoch. earlyStop stops at target or after 10 epochs without progress,
+//otherwise every epoch runs
+static TargetRun trainToTarget(const DataSet& data, const std::vector<size_t>& trainRows,
+                               const std::vector<size_t>& validationRows, const LearningRateSchedule& schedule,
+                               bool earlyStop, int epochs, double target, uint64_t seed){
+    const int batchSize = 10;
+    network net;
+    net.setupNetwork({4, 8, 8, 3}, seed);
+    net.layers.back().setActivation("softmax");
+    net.setOptimizer(Optimizer::adam());
+    net.setSchedule(schedule);
+    TargetRun run;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ValidationOptions options;
+    options.everySteps = (int)((trainRows.size() + batchSize - 1) / batchSize);
+    options.patience = earlyStop ? 10 : 0;
+    options.targetScore = earlyStop ? target : std::numeric_limits<double>::infinity();
+    net.enableValidation(options, [&](network& scored){
+        double accuracy = irisAccuracy(scored, data, validationRows);
+        if(accuracy >= target && run.stepsToTarget < 0){
+            run.stepsToTarget = scored.step;
+            run.secondsToTarget = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return accuracy;
+    });
+    EpochSampler sampler(data, trainRows, seed + 1);
+    std::vector<RowView> batch;
+    std::vector<double> inputs;
+    std::vector<int> labels;
+    for(int epoch = 0; epoch < epochs && !net.stopped(); epoch++){
+        sampler.startEpoch();
+        while(int samples = sampler.nextBatch(batchSize, batch)){
+            gatherLabels(batch, 4, inputs, labels);
+            net.trainBatchLabels(inputs, labels, samples);
+        }
+    }
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    run.steps = net.step;
+    run.bestAccuracy = net.validation->bestScore;
+    run.history = net.validation->history;
+    if(!net.stopped()){
+        net.restoreBest();
+    }
+    run.restored = irisAccuracy(net, data, validationRows) == run.bestAccuracy;
+    return run;
+}
+
+bool scheduleTest(int epochs, double target, uint64_t seed){
+    DataSet data = processData("./data/iris.data", true);
+    if(data.numRows == 0){
+        return false;
+    }
+    bool passed = scheduleCurves();
+    std::vector<size_t> trainRows, validationRows;
+    splitRows(data.numRows, 0.25, seed, trainRows, validationRows);
+    int stepsPerEpoch = (int)((trainRows.size() + 9) / 10);
+    int totalSteps = epochs * stepsPerEpoch;
+
+    struct Candidate {
+        const char* name;
+        LearningRateSchedule schedule;
+        bool earlyStop;
+    };
+    Candidate candidates[] = {
+        {"constant 0.01, every epoch", LearningRateSchedule::constant(0.01), false},
+        {"constant 0.01, early stop", LearningRateSchedule::constant(0.01), true},
+        {"step 0.03, x0.5 / 20 epochs", LearningRateSchedule::stepDecay(0.03, 20 * stepsPerEpoch, 0.5), true},
+        {"cosine 0.03, 5 epoch warmup", LearningRateSchedule::cosine(0.03, totalSteps, 0.0, 5 * stepsPerEpoch), true},
+        {"plateau 0.03, x0.5", LearningRateSchedule::reduceOnPlateau(0.03, 0.5, 3), true},
+    };
+    std::cout << "iris {4, 8, 8, 3}, adam, batch 10, up to " << epochs << " epochs, target held out accuracy " << target << "\n"
+              << "schedule                        steps  seconds  to target  seconds   best accuracy\n";
+    TargetRun runs[std::size(candidates)];
+    for(size_t c = 0; c < std::size(candidates); c++){
+        TargetRun& run = runs[c];
+        run = trainToTarget(data, trainRows, validationRows, candidates[c].schedule, candidates[c].earlyStop, epochs, target, seed);
+        std::cout << "  " << std::left << std::setw(28) << candidates[c].name << std::right << std::setw(7) << run.steps
+                  << std::fixed << std::setprecision(4) << std::setw(9) << run.seconds;
+        if(run.stepsToTarget >= 0){
+            std::cout << std::setw(11) << run.stepsToTarget << std::setw(9) << run.secondsToTarget;
+        }else{
+            std::cout << std::setw(11) << "never" << std::setw(9) << "-";
+        }
+        std::cout << std::setprecision(3) << std::setw(16) << run.bestAccuracy << (run.restored ? "" : "  NOT RESTORED") << "\n";
+        std::cout.unsetf(std::ios::fixed);
+        passed = passed && run.restored;
+    }
+    std::cout << std::setprecision(6);
+    //stopping early must not change the run up to the stop
+    bool sameTrajectory = runs[1].history.size() <= runs[0].history.size()
+                          && std::equal(runs[1].history.begin(), runs[1].history.end(), runs[0].history.begin());
+    std::cout << "early stopping " << (sameTrajectory ? "follows" : "DEPARTS from") << " the full run up to its stop\n";
+    passed = passed && sameTrajectory;
+    std::cout << (passed ? "ok" : "FAILED") << "\n";
+    return passed;
+}
@@ -11,11 +11,956 @@
 #include <limits>
 #include <unordered_map>
 #include <iomanip>
+#include <memory>
+#include <charconv>
+#include <string_view>
 
 #include "neuron.h"
 #include "layer.h"
 #include "logger.h"
+#include "thread_pool.h"
+#include "model_file.h"
+#include "data_loader.h"
+#include "sampler.h"
+#include "inference.h"
+#include "quantized.h"
+#include "profiler.h"
+#include "checkpoint.h"
+#include "schedule.h"
 
+//the whole stack is templated on the scalar type of the weights and
+//activations, network trains in double and networkF in float. The float
+//version halves the memory traffic of every pass and doubles the SIMD width
+template<typename Scalar>
+struct NetworkT{
+    std::vector<LayerT<Scalar>> layers;
+    double learningRate = 1.0;
+    int step = 0;
+    //update rule of every training pass, RMSProp unless setOptimizer is called
+    Optimizer optimizer;
 
+    //per sample state for the batched passes, one entry per layer
+    std::vector<LayerBatchT<Scalar>> batchState;
+    //data-parallel training, one state per batch slice
+    std::shared_ptr<ThreadPool> pool;
+    std::vector<std::vector<LayerBatchT<Scalar>>> workerState;
+    //(layer, first row) of every reduce and update task, kept so steps do not allocate
+    std::vector<std::pair<int, int>> updateTasks;
+    //single sample passes can split wide layers across the pool. Layers with
+    //fewer weights than the threshold stay on the calling thread
+    bool intraLayerParallel = false;
+    size_t parallelLayerThreshold = 1 << 16;
+    //set while the weights live in a read-only mapped model file
+    std::shared_ptr<MappedFile> mappedModel;
+    //per layer timers of the training passes, null unless enableProfiling was
+    //called so the passes only pay a pointer check per layer when it is off
+    std::shared_ptr<Profiler> profiler;
+    //background checkpoints of the training state, null unless enableCheckpoints was called
+    std::shared_ptr<CheckpointWriterT<Scalar>> checkpoints;
+    //sets learningRate after every step, a constant one leaves it alone
+    LearningRateSchedule schedule;
+    //held out evaluations and early stopping, null unless enableValidation was called
+    std::shared_ptr<ValidationT<Scalar>> validation;
 
-#endif
\ No newline at end of file
+    //seed 0 starts every layer from random weights, any other seed makes the
+    //starting weights reproducible
+    void setupNetwork(std::vector<int> structure, uint64_t seed = 0){
+        //every layer owns its own contiguous buffers so layers are built in place
+        layers.clear();
+        mappedModel.reset();
+        layers.reserve(structure.size());
+        //creates input layer
+        layers.emplace_back(structure[0]);
+        //creates all hidden layers
+        for(int i = 1; i < structure.size() ; i++){
+            layers.emplace_back(structure[i], i == structure.size() - 1 ? true: false);
+            layers[i].setupWeights(structure[i-1], seed ? seed + i : 0);
+            layers[i].prepareOptimizer(optimizer, true);
+        }
+        optimizer.updates = 0;
+    }
+
+    //switches the update rule, the optimizer state of every layer starts over.
+    //Optimizer::adam(), Optimizer::sgd() etc. or optimizerFromName("adam")
+    void setOptimizer(const Optimizer& newOptimizer){
+        optimizer = newOptimizer;
+        optimizer.updates = 0;
+        for(int i = 1; i < layers.size(); i++){
+            layers[i].prepareOptimizer(optimizer, true);
+        }
+    }
+    
+    //starts recording every forward, backward and update section, see profiler.h.
+    //Call it after the layers and threads are set up, sections of layers or
+    //slices added later are not recorded
+    void enableProfiling(const ProfilerOptions& options = ProfilerOptions()){
+        int tracks = 1 + (pool ? pool->size() : 0);
+        profiler = std::make_shared<Profiler>((int)layers.size(), tracks, options);
+    }
+    void disableProfiling(){
+        profiler.reset();
+    }
+
+    //saves the whole training state (weights, biases, optimizer state, step,
+    //learning rate, optimizer, schedule and validation progress) to options.path
+    //on a schedule, see checkpoint.h. Training only pauses to copy the state, the
+    //file is written and synced on a background thread. loadModel(options.path)
+    //resumes exactly where the checkpoint was taken
+    void enableCheckpoints(const CheckpointOptions& options){
+        checkpoints = std::make_shared<CheckpointWriterT<Scalar>>(options);
+    }
+    //waits for the checkpoint being written, then stops the writer
+    void disableCheckpoints(){
+        checkpoints.reset();
+    }
+    //captures a checkpoint now, whatever the schedule says
+    bool checkpoint(){
+        if(!checkpoints){
+            std::cerr << "Error: checkpoints are not enabled, call enableCheckpoints first.\n";
+            return false;
+        }
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, there is no training state to save.\n";
+            return false;
+        }
+        checkpoints->capture(layers, step, learningRate, optimizer, schedule, validation.get());
+        return true;
+    }
+
+    //installs a learning rate schedule, see schedule.h. A baseRate of 0 takes
+    //the current learningRate. The rate is set for the next step right away
+    void setSchedule(const LearningRateSchedule& newSchedule){
+        schedule = newSchedule;
+        if(schedule.baseRate <= 0.0){
+            schedule.baseRate = learningRate;
+        }
+        if(schedule.adjusts()){
+            learningRate = schedule.rateAt(step);
+        }
+    }
+    void updateLearningRate(){
+        if(schedule.adjusts()){
+            learningRate = schedule.rateAt(step);
+        }
+    }
+
+    //scores the network every options.everySteps steps with score (higher is
+    //better), feeds the score to a ReduceOnPlateau schedule and keeps the
+    //weights of the best one. Once the patience runs out or the target is
+    //reached stopped() turns true and, with restoreBest, the best weights are
+    //put back. Training loops check stopped() between steps. The score function
+    //is not saved with the model, call this again after loadModel of a
+    //checkpoint; the progress the checkpoint holds is kept
+    void enableValidation(const ValidationOptions& options, std::function<double(NetworkT&)> score){
+        if(validation && !validation->score){
+            validation->options = options;
+            validation->score = std::move(score);
+            return;
+        }
+        validation = std::make_shared<ValidationT<Scalar>>(options, std::move(score));
+    }
+    void disableValidation(){
+        validation.reset();
+    }
+    bool stopped() const {
+        return validation && validation->stopped;
+    }
+    //evaluates now, whatever the schedule says, and returns the score
+    double validate(){
+        if(!validation || !validation->score){
+            std::cerr << "Error: validation is not enabled, call enableValidation first.\n";
+            return 0.0;
+        }
+        double value = validation->score(*this);
+        if(validation->record(step, value)){
+            validation->bestWeights.resize(layers.size());
+            validation->bestBiases.resize(layers.size());
+            for(int i = 1; i < layers.size(); i++){
+                validation->bestWeights[i].assign(layers[i].weights.begin(), layers[i].weights.end());
+                validation->bestBiases[i].assign(layers[i].biases.begin(), layers[i].biases.end());
+            }
+        }
+        if(schedule.observe(value)){
+            learningRate = schedule.rateAt(step);
+        }
+        if(validation->stopped && validation->options.restoreBest){
+            restoreBest();
+        }
+        NN_LOG(LogLevel::Info, LOG_TRAINING, "step {}: validation score {}, best {} at step {}", step, value,
+               validation->bestScore, validation->bestStep);
+        return value;
+    }
+    //puts back the weights and biases of the best evaluation, the optimizer
+    //state and the step stay where they are
+    bool restoreBest(){
+        if(!validation || validation->bestWeights.size() != layers.size()){
+            std::cerr << "Error: there is no validated state to restore.\n";
+            return false;
+        }
+        for(int i = 1; i < layers.size(); i++){
+            layers[i].setParameters(validation->bestWeights[i], validation->bestBiases[i]);
+        }
+        return true;
+    }
+
+    //set activationValue for the input layer. Iterate all subsequent layers as a standard pass
+    void forwardPass(const std::vector<Scalar>& inputValues){
+        NN_LOG(LogLevel::Debug, LOG_FORWARD, "forwardPass: Learning Rate: {}", learningRate);
+        //catch cases for errors
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        if(inputValues.size() != layers[0].size){
+            std::cerr << "Error: input size (" << layers[0].size
+            << ") does not match network imports size (" << inputValues.size() << ").\n";
+            return;
+        }
+        //set all the input layer activation values to the inputs
+        std::copy(inputValues.begin(), inputValues.end(), layers[0].activations.begin());
+        if(NN_LOG_ENABLED(LogLevel::Trace, LOG_FORWARD)){
+            for (int i = 0; i < layers[0].size; i++){
+                Logger::write(LogLevel::Trace, LOG_FORWARD, "Neuron: (0, {}) Effective learning rate: {} Activation: {}",
+                              i, layers[0].adjustedLearningRates[i], inputValues[i]);
+            }
+        }
+        //iterate each non input layer, each layer is a single matrix-vector product
+        int size = layers.size();
+        for(int i = 1; i < size; i++){
+            LayerT<Scalar>& thisLayer = layers[i];
+            profiled(i, ProfilePhase::Forward, 1, false, [&](){
+                activateLayer(i);
+            });
+
+            if(NN_LOG_ENABLED(LogLevel::Trace, LOG_FORWARD)){
+                for(int j = 0; j < thisLayer.size; j++){
+                    Logger::write(LogLevel::Trace, LOG_FORWARD, "Neuron: ({}, {}) Activation: {}", i, j, thisLayer.activations[j]);
+                }
+            }
+        }
+    }
+    void backPropagate(const std::vector<Scalar>& expectedValues){
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, load the model without mapping to train.\n";
+            return;
+        }
+        NN_LOG(LogLevel::Debug, LOG_BACKPROP, "BackProp:");
+        if(NN_LOG_ENABLED(LogLevel::Trace, LOG_BACKPROP)){
+            for(int i = 0; i < expectedValues.size(); i++){
+                Logger::write(LogLevel::Trace, LOG_BACKPROP, "Expected ({}) {}", i, expectedValues[i]);
+            }
+        }
+        //catch case for empty network
+
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        LayerT<Scalar>& outputLayer = layers[layers.size() - 1];
+        //catch case for size mismatch
+        if(expectedValues.size() != outputLayer.size){
+            std::cerr << "Error: expectedValues size (" << outputLayer.size
+            << ") does not match network output size (" << expectedValues.size() << ").\n";
+            return;
+        }
+
+        runBackPropagate(expectedValues.data(), nullptr);
+    }
+    //backPropagate with a one-hot target, label is the index of the output that
+    //should be 1. Meant for softmax outputs, no dense target vector is built
+    void backPropagateLabel(int label){
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, load the model without mapping to train.\n";
+            return;
+        }
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        if(label < 0 || label >= layers.back().size){
+            std::cerr << "Error: label " << label << " is not one of the network's " << layers.back().size << " outputs.\n";
+            return;
+        }
+        runBackPropagate(nullptr, &label);
+    }
+
+    //inputValues is batchSize x inputs row-major. Every layer runs one blocked
+    //GEMM for the whole batch so each weight is loaded once per batch
+    void forwardBatch(const std::vector<Scalar>& inputValues, int batchSize){
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        if(batchSize <= 0 || inputValues.size() != (size_t)batchSize * layers[0].size){
+            std::cerr << "Error: batch input size (" << inputValues.size()
+            << ") does not match batch size " << batchSize << " x network inputs (" << layers[0].size << ").\n";
+            return;
+        }
+        runForwardBatch(batchState, inputValues.data(), batchSize);
+    }
+
+    //expectedValues is batchSize x outputs row-major. Gradients are averaged
+    //over the batch and applied as a single optimizer update
+    void backwardBatch(const std::vector<Scalar>& expectedValues, int batchSize){
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, load the model without mapping to train.\n";
+            return;
+        }
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        LayerT<Scalar>& outputLayer = layers[layers.size() - 1];
+        if(batchState.size() != layers.size() || batchSize != batchState.back().batchSize
+           || expectedValues.size() != (size_t)batchSize * outputLayer.size){
+            std::cerr << "Error: batch expectedValues size (" << expectedValues.size()
+            << ") does not match batch size " << batchSize << " x network outputs (" << outputLayer.size << ").\n";
+            return;
+        }
+        runBackwardAndUpdate(expectedValues.data(), nullptr, batchSize);
+    }
+    //backwardBatch with one-hot targets, labels has the class of every sample
+    void backwardBatchLabels(const std::vector<int>& labels, int batchSize){
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, load the model without mapping to train.\n";
+            return;
+        }
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        if(batchState.size() != layers.size() || batchSize != batchState.back().batchSize
+           || labels.size() != (size_t)batchSize || !validLabels(labels)){
+            std::cerr << "Error: batch labels (" << labels.size() << ") do not match batch size " << batchSize
+            << " or are not all below the network outputs (" << layers.back().size << ").\n";
+            return;
+        }
+        runBackwardAndUpdate(nullptr, labels.data(), batchSize);
+    }
+
+    //data-parallel training. Each pool task runs forward and backward on a fixed
+    //slice of the batch with its own LayerBatch buffers, then the slice gradients
+    //are summed in slice order so a given thread count always gives the same result
+    void setThreads(int numThreads){
+        if(numThreads <= 1){
+            pool.reset();
+        }else if(!pool || pool->size() != numThreads){
+            pool = std::make_shared<ThreadPool>(numThreads);
+        }
+    }
+    void trainBatch(const std::vector<Scalar>& inputValues, const std::vector<Scalar>& expectedValues, int batchSize){
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, load the model without mapping to train.\n";
+            return;
+        }
+        if(!pool || batchSize < 2){
+            forwardBatch(inputValues, batchSize);
+            backwardBatch(expectedValues, batchSize);
+            return;
+        }
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        int outputSize = layers.back().size;
+        if(inputValues.size() != (size_t)batchSize * layers[0].size || expectedValues.size() != (size_t)batchSize * outputSize){
+            std::cerr << "Error: batch sizes (" << inputValues.size() << ", " << expectedValues.size()
+            << ") do not match batch size " << batchSize << " x network inputs/outputs.\n";
+            return;
+        }
+        runTrainBatch(inputValues.data(), expectedValues.data(), nullptr, batchSize);
+    }
+    //trainBatch with one-hot targets, labels has the class of every sample
+    void trainBatchLabels(const std::vector<Scalar>& inputValues, const std::vector<int>& labels, int batchSize){
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, load the model without mapping to train.\n";
+            return;
+        }
+        if(!pool || batchSize < 2){
+            forwardBatch(inputValues, batchSize);
+            backwardBatchLabels(labels, batchSize);
+            return;
+        }
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        if(inputValues.size() != (size_t)batchSize * layers[0].size || labels.size() != (size_t)batchSize || !validLabels(labels)){
+            std::cerr << "Error: batch sizes (" << inputValues.size() << ", " << labels.size()
+            << ") do not match batch size " << batchSize << " x network inputs, or a label is not below the network outputs ("
+            << layers.back().size << ").\n";
+            return;
+        }
+        runTrainBatch(inputValues.data(), nullptr, labels.data(), batchSize);
+    }
+    //sizes every buffer the training passes use for batches of up to batchSize,
+    //along with the optimizer state. Steps reuse their buffers and only allocate
+    //while they grow, so after this even the first step does not allocate
+    void reserveTraining(int batchSize){
+        if(layers.empty() || batchSize <= 0){
+            return;
+        }
+        for(int i = 1; i < layers.size(); i++){
+            layers[i].prepareOptimizer(optimizer);
+        }
+        batchState.resize(layers.size());
+        for(int i = 0; i < layers.size(); i++){
+            batchState[i].resize(batchSize, layers[i].size, layers[i].inputSize);
+        }
+        if(!pool || batchSize < 2){
+            return;
+        }
+        int slices = std::min(pool->size(), batchSize);
+        int sliceSize = (batchSize + slices - 1) / slices;
+        workerState.resize(slices);
+        size_t tasks = 0;
+        for(std::vector<LayerBatchT<Scalar>>& state: workerState){
+            state.resize(layers.size());
+            for(int i = 0; i < layers.size(); i++){
+                state[i].resize(sliceSize, layers[i].size, layers[i].inputSize);
+            }
+        }
+        for(int i = 1; i < layers.size(); i++){
+            tasks += (layers[i].size + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        }
+        updateTasks.reserve(tasks);
+    }
+
+    //for debugging
+    void hold() {
+        std::cout << "Press Enter to continue...";
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    //same pass as backPropagate. It predates the pluggable optimizers, with the
+    //default optimizer it is still RMSProp
+    void backPropagateRMS(const std::vector<Scalar>& expectedValues){
+        if(isReadOnly()){
+            std::cerr << "Error: the network weights are memory-mapped read-only, load the model without mapping to train.\n";
+            return;
+        }
+        NN_LOG(LogLevel::Debug, LOG_BACKPROP, "BackProp:");
+        if(NN_LOG_ENABLED(LogLevel::Trace, LOG_BACKPROP)){
+            for(int i = 0; i < expectedValues.size(); i++){
+                Logger::write(LogLevel::Trace, LOG_BACKPROP, "Expected ({}) {}", i, expectedValues[i]);
+            }
+        }
+        //catch case for empty network
+
+        if(layers.empty()){
+            std::cerr << "Error: No layers in the network.\n";
+            return;
+        }
+        LayerT<Scalar>& outputLayer = layers[layers.size() - 1];
+        //catch case for size mismatch
+        if(expectedValues.size() != outputLayer.size){
+            std::cerr << "Error: expectedValues size (" << outputLayer.size
+            << ") does not match network output size (" << expectedValues.size() << ").\n";
+            return;
+        }
+        //iterate backwards from the last layer to the first hidden layer
+        OptimizerStep update = nextOptimizerStep();
+        for(int i = layers.size() - 1; i > 0; i--){
+            NN_LOG(LogLevel::Trace, LOG_BACKPROP, "Layer ({})", i);
+            profiled(i, ProfilePhase::Backward, 1, false, [&](){
+                layers[i].computeDeltas(expectedValues);
+                if(i > 1){
+                    propagateLayer(i);
+                }
+            });
+            profiled(i, ProfilePhase::Update, 1, false, [&](){
+                updateLayer(i, update);
+            });
+        }
+        finishStep(1);
+    }
+
+    //writes the structure, activations, weights, biases and optionally the
+    //optimizer with all of its state to a versioned binary file (layout in model_file.h)
+    bool saveModel(const std::string& path, bool includeHistoric = true) const {
+        return writeModelFile(path, layers, step, learningRate, includeHistoric, &optimizer, false, &schedule,
+                              validation.get());
+    }
+    //replaces the network with a saved model, and the optimizer, schedule and
+    //validation progress too when the file has their state. mapWeights leaves
+    //the weights in a read-only mapping of the file that every process loading
+    //it shares, load time no longer depends on the model size but the network
+    //can not train
+    bool loadModel(const std::string& path, bool mapWeights = false){
+        ValidationProgressT<Scalar> progress;
+        if(!readModelFile(path, layers, step, learningRate, mapWeights, mappedModel, &optimizer, &schedule, &progress)){
+            return false;
+        }
+        //saved progress waits for enableValidation to bring the score function back
+        if(!validation && progress.bestStep >= 0 && !mapWeights){
+            validation = std::make_shared<ValidationT<Scalar>>(ValidationOptions(), nullptr);
+        }
+        if(validation){
+            static_cast<ValidationProgressT<Scalar>&>(*validation) = std::move(progress);
+        }
+        //pruned layers come back in the CSR form the file keeps for them. Older
+        //files only have the dense weights with zeros, those are scanned for it
+        //unless they are mapped, where reading every page would undo the mapping
+        for(size_t i = 1; i < layers.size() && !mapWeights; i++){
+            if(!layers[i].isSparse()){
+                layers[i].compressSparse();
+            }
+        }
+        batchState.clear();
+        workerState.clear();
+        return true;
+    }
+    bool isReadOnly() const {
+        return mappedModel != nullptr;
+    }
+
+    //replaces this network with a copy of other converted to this scalar type,
+    //for example to serve a network trained in double from a networkF
+    template<typename Other>
+    void copyFrom(const NetworkT<Other>& other){
+        layers.clear();
+        mappedModel.reset();
+        batchState.clear();
+        workerState.clear();
+        layers.reserve(other.layers.size());
+        for(const LayerT<Other>& source: other.layers){
+            layers.emplace_back(source.size, source.isOutput);
+            LayerT<Scalar>& layer = layers.back();
+            size_t weightCount = (size_t)source.size * source.inputSize;
+            layer.inputSize = source.inputSize;
+            layer.activation = source.activation;
+            layer.weights.assign(source.weightData(), source.weightData() + weightCount);
+            layer.biases.assign(source.biases.begin(), source.biases.end());
+            if(source.historicGradients.empty()){
+                layer.historicGradients.assign(weightCount, Scalar(1));
+            }else{
+                layer.historicGradients.assign(source.historicGradients.begin(), source.historicGradients.end());
+            }
+            layer.firstMoments.assign(source.firstMoments.begin(), source.firstMoments.end());
+            layer.biasFirstMoments.assign(source.biasFirstMoments.begin(), source.biasFirstMoments.end());
+            layer.biasHistoricGradients.assign(source.biasHistoricGradients.begin(), source.biasHistoricGradients.end());
+            if(source.isSparse()){
+                layer.sparseRowStarts.assign(source.rowStartData(), source.rowStartData() + source.size + 1);
+                layer.sparseColumns.assign(source.columnData(), source.columnData() + source.nonzeroCount());
+                layer.sparseValues.assign(source.sparseValueData(), source.sparseValueData() + source.nonzeroCount());
+            }
+        }
+        learningRate = other.learningRate;
+        schedule = other.schedule;
+        step = other.step;
+        optimizer = other.optimizer;
+    }
+
+    //magnitude pruning of every layer down to density (0.1 keeps 10% of the
+    //weights), see Layer::prune. Pruned layers run the single sample passes and
+    //inference on sparse kernels and keep their zeros while they train, so
+    //calling it again with a lower density after some training prunes
+    //gradually with fine-tuning in between
+    bool prune(double density){
+        if(isReadOnly()){
+            std::cerr << "Error: a memory-mapped network cannot be pruned.\n";
+            return false;
+        }
+        for(size_t i = 1; i < layers.size(); i++){
+            layers[i].prune(density);
+        }
+        return true;
+    }
+    //kept weights over all weights, 1 for a dense network
+    double density() const {
+        double kept = 0.0;
+        double total = 0.0;
+        for(size_t i = 1; i < layers.size(); i++){
+            double count = (double)layers[i].size * layers[i].inputSize;
+            kept += layers[i].density() * count;
+            total += count;
+        }
+        return total > 0.0 ? kept / total : 1.0;
+    }
+
+    //compiles the current weights into a read-only inference plan. The plan is
+    //a copy, training the network afterwards does not change it. Weights a
+    //mapped loadModel left in the file stay there, the plan shares the mapping
+    InferenceNetworkT<Scalar> freeze() const {
+        return InferenceNetworkT<Scalar>(layers, mappedModel);
+    }
+
+    //int8 copy of the current weights for serving, see quantized.h. The input
+    //ranges are calibrated on up to calibrationRows rows of calibration
+    QuantizedNetwork quantize(const DataSet& calibration, WeightScaling scaling = WeightScaling::PerRow,
+                              size_t calibrationRows = 1024) const {
+        return QuantizedNetwork(layers, calibration, scaling, calibrationRows);
+    }
+
+    void printNetworkDetailed() {
+        std::cout << "Neural Network Visualization:\n";
+        std::cout << "Base Learning Rate: " << learningRate << "\n";
+        int numLayers = layers.size();
+        for (int l = 0; l < numLayers; l++){
+            std::cout << "Layer " << l << " (" << layers[l].size << " neurons):\n";
+
+            for (int n = 0; n < layers[l].size; n++){
+                NeuronT<Scalar> neuron = layers[l].getConnection(n);
+                // Format the numbers with fixed precision
+                std::cout << "  Neuron " << std::setw(2) << n << " Neuron type: " << neuron.neuronType 
+                        << " | Effective learning rate: " << std::fixed << std::setprecision(4) << neuron.adjustedLearningRate 
+                        << " | Activation: " << std::fixed << std::setprecision(4) << neuron.activationValue 
+                        << " | Error: " << std::fixed << std::setprecision(4) << neuron.delta
+                        << "\n";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    void printExpectedOutputs(const std::vector<Scalar>& expected) {
+        std::cout << "Expected Outputs:\n";
+        for (size_t i = 0; i < expected.size(); i++){
+            std::cout << "  Output " << std::setw(2) << i 
+                      << " | Value: " << std::fixed << std::setprecision(4) << expected[i] 
+                      << "\n";
+        }
+        std::cout << std::endl;
+    }
+    void printNetwork(){
+        printNetworkDetailed();
+    }
+
+private:
+    //rows per reduce and update task of trainBatch
+    static constexpr int ROWS_PER_TASK = 64;
+
+    bool splitLayer(const LayerT<Scalar>& layer){
+        return pool && intraLayerParallel && (size_t)layer.size * layer.inputSize >= parallelLayerThreshold;
+    }
+    //splits [0, count) into chunks on cache line boundaries (64 bytes) so no two
+    //tasks write to the same line, with a few chunks per thread for stealing
+    template<typename Body>
+    void parallelRanges(int count, const Body& body){
+        const int align = 64 / sizeof(Scalar);
+        int blocks = (count + align - 1) / align;
+        int chunks = std::min(pool->size() * 4, blocks);
+        pool->run(chunks, [&](int chunk){
+            int first = (int)((long long)blocks * chunk / chunks) * align;
+            int last = std::min((int)((long long)blocks * (chunk + 1) / chunks) * align, count);
+            body(first, last);
+        });
+    }
+    void activateLayer(int i){
+        LayerT<Scalar>& layer = layers[i];
+        const LayerT<Scalar>& prevLayer = layers[i - 1];
+        if(!splitLayer(layer)){
+            layer.activate(prevLayer);
+            return;
+        }
+        parallelRanges(layer.size, [&](int first, int last){
+            layer.activateRows(prevLayer, first, last);
+        });
+        layer.finishActivation();
+    }
+    //deltas are propagated with every thread owning a slice of the previous
+    //layer's deltas, the rows are only updated once all of them are done
+    void propagateLayer(int i){
+        LayerT<Scalar>& layer = layers[i];
+        LayerT<Scalar>& prevLayer = layers[i - 1];
+        if(!splitLayer(layer)){
+            layer.propagateDeltas(prevLayer);
+            return;
+        }
+        parallelRanges(layer.inputSize, [&](int first, int last){
+            layer.propagateDeltaColumns(prevLayer, first, last);
+        });
+    }
+    void updateLayer(int i, const OptimizerStep& update){
+        LayerT<Scalar>& layer = layers[i];
+        const LayerT<Scalar>& prevLayer = layers[i - 1];
+        if(!splitLayer(layer)){
+            layer.updateRows(prevLayer, optimizer, update, 0, layer.size);
+            return;
+        }
+        parallelRanges(layer.size, [&](int first, int last){
+            layer.updateRows(prevLayer, optimizer, update, first, last);
+        });
+    }
+    //runs work as a profiler section when profiling is on. The FLOPs and bytes
+    //are counted like the benchmark does (see benchmark.cpp), batched sections
+    //also form the weight gradients of their samples
+    template<typename Work>
+    void profiled(int layer, ProfilePhase phase, int samples, bool batched, const Work& work, int track = 0){
+        if(!profiler){
+            work();
+            return;
+        }
+        Profiler::Mark mark = profiler->start(track);
+        work();
+        double flops = 0.0;
+        double bytes = 0.0;
+        //layer 0 stands for every layer at once
+        int first = layer == 0 ? 1 : layer;
+        int last = layer == 0 ? (int)layers.size() - 1 : layer;
+        for(int i = first; i <= last; i++){
+            sectionCost(i, phase, samples, batched, flops, bytes);
+        }
+        profiler->stop(mark, layer, phase, flops, bytes, track);
+    }
+    void sectionCost(int i, ProfilePhase phase, int samples, bool batched, double& flops, double& bytes) const {
+        const LayerT<Scalar>& layer = layers[i];
+        double weights = (double)layer.size * layer.inputSize;
+        //a pruned layer only multiplies its kept weights outside the batched GEMMs
+        double multiplied = batched ? weights : weights * layer.density();
+        double width = sizeof(Scalar);
+        switch(phase){
+            case ProfilePhase::Forward:
+                flops += 2.0 * multiplied * samples;
+                bytes += (multiplied + (double)samples * (layer.inputSize + layer.size)) * width;
+                break;
+            case ProfilePhase::Backward:
+                //the input layer has no weights so nothing is propagated to it
+                if(i > 1){
+                    flops += 2.0 * multiplied * samples;
+                    bytes += (multiplied + (double)samples * layer.inputSize) * width;
+                }
+                if(batched){
+                    flops += 2.0 * weights * samples;
+                    bytes += (weights + (double)samples * layer.inputSize) * width;
+                }
+                bytes += 2.0 * samples * layer.size * width;
+                break;
+            default:
+                //weights read and written, the optimizer state with them, and the
+                //gradients or the inputs they are formed from
+                flops += optimizer.flopsPerWeight() * weights;
+                bytes += (2.0 + 2.0 * optimizer.stateArrays() + 1.0) * weights * width;
+                break;
+        }
+    }
+    //bookkeeping after every training step
+    void finishStep(int samples){
+        step++;
+        if(profiler){
+            profiler->endStep(samples, step);
+        }
+        updateLearningRate();
+        if(validation && validation->due(step)){
+            validate();
+        }
+        if(checkpoints && checkpoints->due(step)){
+            checkpoints->capture(layers, step, learningRate, optimizer, schedule, validation.get());
+        }
+    }
+    //checked backPropagate and backPropagateLabel, one of expectedValues and label is set.
+    //Deltas are passed to the previous layer before the weights are updated
+    void runBackPropagate(const Scalar* expectedValues, const int* label){
+        //iterate backwards from the output layer to the first hidden layer
+        OptimizerStep update = nextOptimizerStep();
+        for(int i = layers.size() - 1; i > 0; i--){
+            LayerT<Scalar>& curLayer = layers[i];
+            profiled(i, ProfilePhase::Backward, 1, false, [&](){
+                curLayer.computeDeltas(expectedValues, label);
+                //the input layer has no weights so there is nothing to propagate to it
+                if(i > 1){
+                    propagateLayer(i);
+                }
+            });
+            profiled(i, ProfilePhase::Update, 1, false, [&](){
+                updateLayer(i, update);
+            });
+
+            if(NN_LOG_ENABLED(LogLevel::Trace, LOG_BACKPROP)){
+                for(int j = 0; j < curLayer.size; j++){
+                    Logger::write(LogLevel::Trace, LOG_BACKPROP, "Neuron: ({}, {}), NeuronType: {} backProp Error: {}",
+                                  i, j, int(curLayer.isOutput), curLayer.deltas[j]);
+                }
+            }
+        }
+        finishStep(1);
+    }
+    //checked backwardBatch and backwardBatchLabels on batchState
+    void runBackwardAndUpdate(const Scalar* expectedValues, const int* labels, int batchSize){
+        runBackwardBatch(batchState, expectedValues, labels, 1.0 / batchSize);
+        OptimizerStep update = nextOptimizerStep();
+        for(int i = layers.size() - 1; i > 0; i--){
+            profiled(i, ProfilePhase::Update, batchSize, true, [&](){
+                layers[i].applyGradients(batchState[i], optimizer, update);
+            });
+        }
+        finishStep(batchSize);
+    }
+    //checked trainBatch and trainBatchLabels on the pool
+    void runTrainBatch(const Scalar* inputValues, const Scalar* expectedValues, const int* labels, int batchSize){
+        int slices = std::min(pool->size(), batchSize);
+        workerState.resize(slices);
+        pool->run(slices, [&](int slice){
+            int begin = (int)((long long)batchSize * slice / slices);
+            int end = (int)((long long)batchSize * (slice + 1) / slices);
+            std::vector<LayerBatchT<Scalar>>& state = workerState[slice];
+            runForwardBatch(state, inputValues + (size_t)begin * layers[0].size, end - begin, slice + 1);
+            runBackwardBatch(state, expectedValues ? expectedValues + (size_t)begin * layers.back().size : nullptr,
+                             labels ? labels + begin : nullptr, 1.0 / batchSize, slice + 1);
+        });
+
+        //reduction and update are split by rows, each row is summed over the
+        //slices in slice order and updated by exactly one task
+        updateTasks.clear();
+        batchState.resize(layers.size());
+        for(int i = 1; i < layers.size(); i++){
+            batchState[i].resize(batchSize, layers[i].size, layers[i].inputSize);
+            for(int row = 0; row < layers[i].size; row += ROWS_PER_TASK){
+                updateTasks.push_back({i, row});
+            }
+        }
+        OptimizerStep update = nextOptimizerStep();
+        //every layer is reduced and updated at once, recorded as layer 0
+        profiled(0, ProfilePhase::Update, batchSize, true, [&](){
+            pool->run(updateTasks.size(), [&](int task){
+                int i = updateTasks[task].first;
+                int firstRow = updateTasks[task].second;
+                int lastRow = std::min(firstRow + ROWS_PER_TASK, layers[i].size);
+                reduceGradients(i, slices, firstRow, lastRow);
+                layers[i].applyGradients(batchState[i], optimizer, update, firstRow, lastRow);
+            });
+        });
+        finishStep(batchSize);
+    }
+    bool validLabels(const std::vector<int>& labels) const {
+        for(int label: labels){
+            if(label < 0 || label >= layers.back().size){
+                return false;
+            }
+        }
+        return true;
+    }
+    //makes sure every layer has the state the optimizer needs (a loaded model
+    //only brings historicGradients) and counts the update
+    OptimizerStep nextOptimizerStep(){
+        for(int i = 1; i < layers.size(); i++){
+            layers[i].prepareOptimizer(optimizer);
+        }
+        return optimizer.nextStep(learningRate);
+    }
+    //track is the profiler track of the calling thread, see profiler.h
+    void runForwardBatch(std::vector<LayerBatchT<Scalar>>& state, const Scalar* inputValues, int batchSize, int track = 0){
+        state.resize(layers.size());
+        for(int i = 0; i < layers.size(); i++){
+            state[i].resize(batchSize, layers[i].size, layers[i].inputSize);
+        }
+        std::copy(inputValues, inputValues + (size_t)batchSize * layers[0].size, state[0].activations.begin());
+        for(int i = 1; i < layers.size(); i++){
+            profiled(i, ProfilePhase::Forward, batchSize, true, [&](){
+                layers[i].activateBatch(state[i - 1], state[i]);
+            }, track);
+        }
+    }
+    void runBackwardBatch(std::vector<LayerBatchT<Scalar>>& state, const Scalar* expectedValues, const int* labels,
+                          double scale, int track = 0){
+        int batchSize = state.back().batchSize;
+        for(int i = layers.size() - 1; i > 0; i--){
+            profiled(i, ProfilePhase::Backward, batchSize, true, [&](){
+                layers[i].computeBatchDeltas(state[i], expectedValues, labels);
+                //the input layer has no weights so there is nothing to propagate to it
+                if(i > 1){
+                    layers[i].propagateBatchDeltas(state[i], state[i - 1]);
+                }
+                layers[i].accumulateGradients(state[i], state[i - 1], scale);
+            }, track);
+        }
+    }
+    void reduceGradients(int layerIndex, int slices, int firstRow, int lastRow){
+        const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+        int inputSize = layers[layerIndex].inputSize;
+        size_t begin = (size_t)firstRow * inputSize;
+        size_t count = (size_t)(lastRow - firstRow) * inputSize;
+        LayerBatchT<Scalar>& total = batchState[layerIndex];
+        const LayerBatchT<Scalar>& first = workerState[0][layerIndex];
+        std::copy(first.weightGradients.begin() + begin, first.weightGradients.begin() + begin + count, total.weightGradients.begin() + begin);
+        std::copy(first.biasGradients.begin() + firstRow, first.biasGradients.begin() + lastRow, total.biasGradients.begin() + firstRow);
+        for(int slice = 1; slice < slices; slice++){
+            const LayerBatchT<Scalar>& part = workerState[slice][layerIndex];
+            k.axpy(Scalar(1), &part.weightGradients[begin], &total.weightGradients[begin], count);
+            k.axpy(Scalar(1), &part.biasGradients[firstRow], &total.biasGradients[firstRow], lastRow - firstRow);
+        }
+    }
+
+};
+
+typedef NetworkT<double> network;
+typedef NetworkT<float> networkF;
+
+//"3, 5, 2" to {3, 5, 2}
+std::vector<int> stringToStructure(std::string layerStructure);
+
+//column layout of ./data/iris.data. labelIds keeps the class column as the
+//ids 0, 1 and 2 for softmax outputs instead of normalizing it
+DataSchema irisSchema(bool labelIds = false);
+//parses a single line of iris data, the label is replaced by its id. The id
+//is the class for backPropagateLabel: (int)point.back()
+std::vector<double> processDataPoint(const std::string& input);
+//loads the iris data as min-max normalized rows, see loadCsv
+DataSet processData(const std::string& filepath, bool labelIds = false);
+
+//interactive demos, they block on hold() for user input
+void hold();
+void hardTest(int batchSize = 1, int numThreads = 1, int epochs = 200, uint64_t seed = std::random_device()());
+void simpleTest();
+void useCaseExample();
+//trains a network and a networkF from the same starting weights on the iris
+//data in the same order, then compares their predictions on every row. Prints
+//the largest difference and returns whether it is within tolerance
+bool precisionTest(int epochs = 5, double tolerance = 1e-4, uint64_t seed = 1);
+//trains on the iris data, quantizes the network to int8 with per layer and per
+//row weight scales and prints how far each is from the double forwardPass.
+//Fails when either one's largest output error is above maxError or fewer than
+//minSameLabel of the rows get the same label as the double network
+bool quantizationTest(int epochs = 20, double maxError = 0.05, double minSameLabel = 0.95, uint64_t seed = 1);
+//runs every training and inference pass steps times, for both scalar types and
+//for RMSProp and AdamW, and checks that none of them allocates once the network
+//is set up. allocationCount returns the number of heap allocations so far, the
+//program counts them itself (main.cpp replaces operator new)
+bool allocationTest(unsigned long long (*allocationCount)(), int steps = 50);
+//trains on the iris data with profiling on, batched on numThreads threads
+//and then one sample at a time, prints the per layer summary and writes the
+//Chrome trace to tracePath
+void profileTest(const std::string& tracePath, int epochs = 20, int numThreads = 2, uint64_t seed = 1);
+//trains with background checkpoints for stepsBefore + stepsAfter steps, then
+//resumes a second network from the checkpoint taken at stepsBefore and checks
+//that after the same steps both are identical, for several optimizers and
+//both scalar types, and once more with a plateau schedule and validation.
+//Then checks that a checkpoint with an unknown section is refused
+bool checkpointTest(int stepsBefore = 40, int stepsAfter = 25);
+//checks that class labels train a softmax output exactly like one-hot rows
+//and that its outputs sum to 1, then trains the iris classes as one regressed
+//output and as three softmax outputs and prints both held out accuracies
+bool softmaxTest(int epochs = 50, uint64_t seed = 1);
+//prunes a network trained on iris down to density in steps with fine-tuning
+//between them and checks that the pruned weights stay zero, that the sparse
+//passes match the dense ones and that a saved model comes back sparse. Then
+//prints the memory and predict time of a wider pruned network against the
+//dense one and checks that every ISA's sparse kernels match the scalar ones
+bool pruneTest(double density = 0.1, uint64_t seed = 1);
+//sweeps 288 iris networks (structures, learning rates, optimizers and batch
+//sizes) with successive halving on numThreads threads (0 for every core), prints
+//the best of them and the wall time, then checks the sweep gives the same
+//results on one thread
+bool populationTest(int numThreads = 0, uint64_t seed = 1);
+//trains members iris networks separately and as a lockstep ensemble on the
+//same samples and checks they stay identical, for both scalar types, then
+//prints the training throughput of both and the held out error of a bagged
+//ensemble's averaged predictions against its members'
+bool ensembleTest(int members = 8, int epochs = 30, uint64_t seed = 1);
+//sweeps the exact and fast activation kernels of both scalar types over
+//[-20, 20] against a long double reference and checks the documented error
+//bounds and that every ISA matches the scalar kernels, prints the cost per
+//element of each against libm tanh, then trains iris classifiers with every
+//exact hidden activation and its approximation and compares their accuracy
+bool activationTest(int epochs = 60, uint64_t seed = 1);
+//serves a random {32, 1024, 1024, 10} network over loopback TCP (double) and a
+//Unix socket (float, frozen from a mapped load that has to leave the weights in
+//the mapping), checks that concurrent clients get exactly what predict returns, then prints the load generator's throughput and latency with one
+//request per batch against micro-batching
+bool serverTest(double seconds = 1.0, uint64_t seed = 1);
+//checks the learning rate schedules against their closed forms, then trains
+//the same iris classifier with a constant rate for every epoch and with each
+//schedule and early stopping, and prints the steps and seconds each takes to
+//reach the target held out accuracy. Checks that early stopping leaves the best
+//weights in the network and does not change the run before the stop
+bool scheduleTest(int epochs = 200, double target = 0.97, uint64_t seed = 1);
+
+#endif // NETWORK_H
@@ -0,0 +1,91 @@
+#include "optimizer.h"
+#include <cmath>
+
+Optimizer Optimizer::rmsProp(double decay, double epsilon, double maxRate){
+    Optimizer optimizer;
+    optimizer.type = OptimizerType::RMSProp;
+    optimizer.beta2 = decay;
+    optimizer.epsilon = epsilon;
+    optimizer.maxRate = maxRate;
+    return optimizer;
+}
+Optimizer Optimizer::sgd(double weightDecay){
+    Optimizer optimizer;
+    optimizer.type = OptimizerType::SGD;
+    optimizer.weightDecay = weightDecay;
+    return optimizer;
+}
+Optimizer Optimizer::momentum(double momentum, double weightDecay){
+    Optimizer optimizer;
+    optimizer.type = OptimizerType::Momentum;
+    optimizer.beta1 = momentum;
+    optimizer.weightDecay = weightDecay;
+    return optimizer;
+}
+Optimizer Optimizer::adam(double beta1, double beta2, double epsilon, double weightDecay){
+    Optimizer optimizer;
+    optimizer.type = OptimizerType::Adam;
+    optimizer.beta1 = beta1;
+    optimizer.beta2 = beta2;
+    optimizer.epsilon = epsilon;
+    optimizer.weightDecay = weightDecay;
+    optimizer.maxRate = std::numeric_limits<double>::infinity();
+    return optimizer;
+}
+Optimizer Optimizer::adamW(double weightDecay, double beta1, double beta2, double epsilon){
+    Optimizer optimizer = adam(beta1, beta2, epsilon, weightDecay);
+    optimizer.type = OptimizerType::AdamW;
+    return optimizer;
+}
+
+OptimizerStep Optimizer::nextStep(double learningRate){
+    updates++;
+    OptimizerStep step = {learningRate, beta1, beta2, epsilon, weightDecay, maxRate, 1.0, 1.0};
+    if(type == OptimizerType::Adam || type == OptimizerType::AdamW){
+        step.correction1 = 1.0 / (1.0 - std::pow(beta1, (double)updates));
+        step.correction2 = 1.0 / (1.0 - std::pow(beta2, (double)updates));
+    }
+    return step;
+}
+
+double Optimizer::flopsPerWeight() const {
+    switch(type){
+        //gradient, decay, step
+        case OptimizerType::SGD: return 5.0;
+        //plus the velocity
+        case OptimizerType::Momentum: return 7.0;
+        //decayed average, sqrt, rate and clip instead of the velocity
+        case OptimizerType::RMSProp: return 13.0;
+        //both moments, corrected rate and corrected step
+        case OptimizerType::Adam: return 18.0;
+        //the decay shrinks the weight instead of joining the gradient
+        default: return 17.0;
+    }
+}
+
+Optimizer optimizerFromName(const std::string& name){
+    if(name == "sgd"){
+        return Optimizer::sgd();
+    }else if(name == "momentum"){
+        return Optimizer::momentum();
+    }else if(name == "adam"){
+        return Optimizer::adam();
+    }else if(name == "adamw"){
+        return Optimizer::adamW();
+    }
+    return Optimizer::rmsProp();
+}
+const char* optimizerName(OptimizerType type){
+    switch(type){
+        case OptimizerType::SGD:
+            return "sgd";
+        case OptimizerType::Momentum:
+            return "momentum";
+        case OptimizerType::Adam:
+            return "adam";
+        case OptimizerType::AdamW:
+            return "adamw";
+        default:
+            return "rmsprop";
+    }
+}
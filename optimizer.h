@@ -0,0 +1,93 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <string>
+#include <limits>
+
+//update rules the network can train with. Each one is a fused kernel in the
+//kernel tables (kernels.h) indexed by this enum, new types go before the count
+enum class OptimizerType {
+    SGD,
+    Momentum,
+    RMSProp,
+    Adam,
+    AdamW
+};
+const int OPTIMIZER_TYPE_COUNT = 5;
+
+//hyperparameters of one update as the kernels read them, made by Optimizer::nextStep
+struct OptimizerStep {
+    double learningRate;
+    double beta1;
+    double beta2;
+    double epsilon;
+    double weightDecay;
+    //upper bound of the per element rate of RMSProp and Adam
+    double maxRate;
+    //Adam's bias corrections 1 / (1 - beta^t), 1 for the other rules
+    double correction1;
+    double correction2;
+};
+
+//an optimizer is the rule plus its hyperparameters. The state it needs lives
+//next to the parameters in every layer, as flat arrays with the same layout:
+//  firstMoments     momentum velocity or Adam's m
+//  historicGradients RMSProp's decayed squared gradients or Adam's v
+//every gradient g also gets weightDecay * weight added (L2), except AdamW
+//which shrinks the weight by learningRate * weightDecay instead.
+//The learning rate is not part of it, it stays on the network so schedules
+//can change it between steps
+struct Optimizer {
+    OptimizerType type = OptimizerType::RMSProp;
+    //momentum, or Adam's first moment decay
+    double beta1 = 0.9;
+    //RMSProp decay, or Adam's second moment decay
+    double beta2 = 0.9;
+    double epsilon = 1e-8;
+    double weightDecay = 0.0;
+    double maxRate = 5.0;
+    //updates made so far, Adam's t
+    long long updates = 0;
+
+    //the default is the RMSProp the network has always used: decay 0.9 and the
+    //per element rate clipped at 5 to prevent network explosion as a result of
+    //an unused neuron getting activated as a result of new data
+    static Optimizer rmsProp(double decay = 0.9, double epsilon = 1e-8, double maxRate = 5.0);
+    static Optimizer sgd(double weightDecay = 0.0);
+    static Optimizer momentum(double momentum = 0.9, double weightDecay = 0.0);
+    static Optimizer adam(double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8, double weightDecay = 0.0);
+    static Optimizer adamW(double weightDecay = 0.01, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8);
+
+    //counts the update and returns its hyperparameters
+    OptimizerStep nextStep(double learningRate);
+
+    //the rule the biases are updated with. RMSProp keeps the plain gradient
+    //step the biases have always taken, the others adapt them like the weights
+    OptimizerType biasType() const {
+        return type == OptimizerType::RMSProp ? OptimizerType::SGD : type;
+    }
+    bool usesFirstMoments(OptimizerType rule) const {
+        return rule == OptimizerType::Momentum || rule == OptimizerType::Adam || rule == OptimizerType::AdamW;
+    }
+    bool usesSecondMoments(OptimizerType rule) const {
+        return rule == OptimizerType::RMSProp || rule == OptimizerType::Adam || rule == OptimizerType::AdamW;
+    }
+    //arrays of state read and written next to the weights by one update
+    int stateArrays() const {
+        return (usesFirstMoments(type) ? 1 : 0) + (usesSecondMoments(type) ? 1 : 0);
+    }
+    //FLOPs per weight of one update, forming the gradient and its weight decay included
+    double flopsPerWeight() const;
+    //RMSProp starts its history at 1 so the first steps are not huge, Adam
+    //starts at 0 and corrects for it
+    double initialSecondMoment() const {
+        return type == OptimizerType::RMSProp ? 1.0 : 0.0;
+    }
+};
+
+//"sgd", "momentum", "rmsprop", "adam" or "adamw" with its default
+//hyperparameters, anything else gives RMSProp
+Optimizer optimizerFromName(const std::string& name);
+const char* optimizerName(OptimizerType type);
+
+#endif // OPTIMIZER_H
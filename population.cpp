@@ -0,0 +1,178 @@
+#include "population.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+//a network with its own sampler and buffers, so members share nothing but the data
+struct PopulationTrainer::Member {
+    PopulationResult result;
+    network net;
+    EpochSampler sampler;
+    std::vector<RowView> batch;
+    std::vector<double> inputs;
+    std::vector<double> expected;
+
+    Member(const PopulationConfig& config, const DataSet& data, const std::vector<size_t>& rows, uint64_t seed)
+        : sampler(data, rows, seed){
+        result.config = config;
+        net.setOptimizer(config.optimizer);
+        net.setupNetwork(config.structure, config.seed);
+        net.learningRate = config.learningRate;
+    }
+
+    //rough cost of one epoch for scheduling, the weights times the rows
+    double epochCost() const {
+        double weights = 0.0;
+        for(size_t i = 1; i < net.layers.size(); i++){
+            weights += (double)net.layers[i].size * net.layers[i].inputSize;
+        }
+        return weights * sampler.size();
+    }
+};
+
+PopulationTrainer::PopulationTrainer(const DataSet& data, int numInputs, const PopulationOptions& options)
+    : data(data), numInputs(numInputs), options(options){
+    splitRows(data.numRows, options.validationFraction, options.seed, trainRows, validationRows);
+}
+
+PopulationTrainer::~PopulationTrainer() = default;
+
+void PopulationTrainer::add(const PopulationConfig& config){
+    if(config.structure.size() < 2 || config.structure.front() != numInputs
+       || config.structure.back() != data.numColumns - numInputs){
+        std::cerr << "Error: a population network needs " << numInputs << " inputs and "
+                  << data.numColumns - numInputs << " outputs.\n";
+        return;
+    }
+    members.push_back(std::make_unique<Member>(config, data, trainRows, options.seed + 1));
+}
+
+size_t PopulationTrainer::size() const {
+    return members.size();
+}
+
+double PopulationTrainer::meanSquaredError(Member& member, const std::vector<size_t>& rows) const {
+    if(rows.empty()){
+        return 0.0;
+    }
+    double sum = 0.0;
+    for(size_t r: rows){
+        const double* row = data.row(r);
+        member.inputs.assign(row, row + numInputs);
+        member.net.forwardPass(member.inputs);
+        const std::vector<double>& output = member.net.layers.back().activations;
+        for(size_t j = 0; j < output.size(); j++){
+            double error = output[j] - row[numInputs + j];
+            sum += error * error;
+        }
+    }
+    return sum / ((double)rows.size() * (data.numColumns - numInputs));
+}
+
+//same loop as hardTest, then both errors for ranking
+void PopulationTrainer::trainMember(Member& member, int untilEpoch) const {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PopulationResult& result = member.result;
+    int batchSize = std::max(1, result.config.batchSize);
+    RowView row;
+    for(; result.epochs < untilEpoch; result.epochs++){
+        if(result.epochs > 0){
+            member.sampler.startEpoch();
+        }
+        if(batchSize > 1){
+            while(int samples = member.sampler.nextBatch(batchSize, member.batch)){
+                gatherBatch(member.batch, numInputs, member.inputs, member.expected);
+                member.net.trainBatch(member.inputs, member.expected, samples);
+            }
+            continue;
+        }
+        while(member.sampler.next(row)){
+            member.inputs.assign(row.values, row.values + numInputs);
+            member.expected.assign(row.values + numInputs, row.values + row.size);
+            member.net.forwardPass(member.inputs);
+            member.net.backPropagate(member.expected);
+        }
+    }
+    result.trainError = meanSquaredError(member, trainRows);
+    result.validationError = meanSquaredError(member, validationRows);
+    //diverged networks rank last
+    if(!std::isfinite(result.validationError)){
+        result.validationError = std::numeric_limits<double>::infinity();
+    }
+    result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<PopulationResult> PopulationTrainer::run(){
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int numThreads = options.numThreads > 0 ? options.numThreads : (int)std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(numThreads);
+    int maxEpochs = std::max(1, options.maxEpochs);
+    int eta = std::max(1, options.eta);
+
+    std::vector<Member*> alive;
+    for(std::unique_ptr<Member>& member: members){
+        alive.push_back(member.get());
+    }
+    int target = eta == 1 ? maxEpochs : std::min(std::max(1, options.minEpochs), maxEpochs);
+    while(!alive.empty()){
+        //largest remaining work first
+        std::stable_sort(alive.begin(), alive.end(), [&](const Member* a, const Member* b){
+            return a->epochCost() * (target - a->result.epochs) > b->epochCost() * (target - b->result.epochs);
+        });
+        pool.run((int)alive.size(), [&](int i){
+            trainMember(*alive[i], target);
+        });
+        if(target >= maxEpochs){
+            for(Member* member: alive){
+                member->result.finished = true;
+            }
+            break;
+        }
+        //the best 1 / eta go on to the next rung
+        std::stable_sort(alive.begin(), alive.end(), [](const Member* a, const Member* b){
+            return a->result.validationError < b->result.validationError;
+        });
+        alive.resize(std::max<size_t>(1, alive.size() / eta));
+        target = std::min(target * eta, maxEpochs);
+    }
+    wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    //the networks that got furthest first, each rung by validation error
+    std::vector<PopulationResult> results;
+    for(const std::unique_ptr<Member>& member: members){
+        results.push_back(member->result);
+    }
+    std::stable_sort(results.begin(), results.end(), [](const PopulationResult& a, const PopulationResult& b){
+        if(a.epochs != b.epochs){
+            return a.epochs > b.epochs;
+        }
+        return a.validationError < b.validationError;
+    });
+    return results;
+}
+
+void printPopulationResults(const std::vector<PopulationResult>& results, std::ostream& out, size_t limit){
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "  rank  structure            optimizer  learning rate  batch  epochs   train mse  validation mse  seconds\n";
+    size_t shown = limit == 0 ? results.size() : std::min(limit, results.size());
+    for(size_t i = 0; i < shown; i++){
+        const PopulationResult& result = results[i];
+        std::ostringstream structure;
+        for(size_t l = 0; l < result.config.structure.size(); l++){
+            structure << (l ? "-" : "") << result.config.structure[l];
+        }
+        out << std::setw(6) << i + 1 << "  " << std::left << std::setw(20) << structure.str() << " "
+            << std::setw(9) << optimizerName(result.config.optimizer.type) << std::right
+            << std::setw(15) << std::setprecision(4) << result.config.learningRate
+            << std::setw(7) << result.config.batchSize << std::setw(8) << result.epochs
+            << std::fixed << std::setprecision(5) << std::setw(12) << result.trainError
+            << std::setw(16) << result.validationError << std::setprecision(3) << std::setw(9) << result.seconds << "\n";
+        out.unsetf(std::ios::fixed);
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,94 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <iostream>
+#include "network.h"
+
+//one network of a sweep: its shape and how it trains
+struct PopulationConfig {
+    std::vector<int> structure;
+    double learningRate = 0.005;
+    Optimizer optimizer;
+    //1 trains one sample at a time with forwardPass and backPropagate
+    int batchSize = 10;
+    //starting weights, 0 for random ones
+    uint64_t seed = 0;
+};
+
+struct PopulationOptions {
+    //threads training networks at once, 0 for every core
+    int numThreads = 0;
+    //fraction of the rows held out to rank the networks by
+    double validationFraction = 0.25;
+    //split of the rows and the order every network samples them in
+    uint64_t seed = 1;
+    //successive halving: every network trains minEpochs epochs, then only the
+    //best 1 / eta of them by validation error keep going, for eta times as many
+    //epochs in total, and so on until maxEpochs. eta 1 trains all of them for
+    //maxEpochs
+    int minEpochs = 2;
+    int maxEpochs = 50;
+    int eta = 3;
+};
+
+//where one network ended up. Networks dropped by the halving keep the errors of
+//the rung they were dropped at
+struct PopulationResult {
+    PopulationConfig config;
+    int epochs = 0;
+    double trainError = 0.0;
+    double validationError = 0.0;
+    //time spent training and evaluating this network, on whichever thread ran it
+    double seconds = 0.0;
+    bool finished = false;
+};
+
+//trains many small networks concurrently over one shared in-memory DataSet.
+//The data is loaded once and only read, every network has its own sampler
+//over the shared rows and trains on a single thread, and the pool runs one
+//network per task. Within a rung the networks are handed out largest first so
+//the long ones do not end up last, and idle threads steal what is left. A
+//network's result depends only on its config and the options, never on the
+//thread count or on which thread ran it
+class PopulationTrainer {
+public:
+    //the first numInputs columns of data are inputs, the rest are targets.
+    //data has to outlive the trainer
+    PopulationTrainer(const DataSet& data, int numInputs, const PopulationOptions& options = PopulationOptions());
+    ~PopulationTrainer();
+
+    void add(const PopulationConfig& config);
+    size_t size() const;
+
+    //trains every network with successive halving and returns the results best
+    //validation error first
+    std::vector<PopulationResult> run();
+    //wall time of the last run
+    double seconds() const {
+        return wallSeconds;
+    }
+
+private:
+    struct Member;
+
+    const DataSet& data;
+    int numInputs;
+    PopulationOptions options;
+    std::vector<size_t> trainRows;
+    std::vector<size_t> validationRows;
+    std::vector<std::unique_ptr<Member>> members;
+    double wallSeconds = 0.0;
+
+    void trainMember(Member& member, int untilEpoch) const;
+    double meanSquaredError(Member& member, const std::vector<size_t>& rows) const;
+};
+
+//one line per result: rank, structure, optimizer, learning rate, batch size,
+//epochs, errors and seconds. limit 0 prints every result
+void printPopulationResults(const std::vector<PopulationResult>& results, std::ostream& out, size_t limit = 0);
+
+#endif // POPULATION_H
@@ -0,0 +1,272 @@
+#include "profiler.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* profilePhaseName(ProfilePhase phase){
+    switch(phase){
+        case ProfilePhase::Backward:
+            return "backward";
+        case ProfilePhase::Update:
+            return "update";
+        default:
+            return "forward";
+    }
+}
+
+Profiler::Profiler(int numLayers, int numTracks, const ProfilerOptions& options)
+    : numLayers(numLayers), options(options), tracks(numTracks < 1 ? 1 : numTracks),
+      origin(std::chrono::steady_clock::now()){
+    size_t eventsPerTrack = options.trace ? options.maxTraceEvents / tracks.size() : 0;
+    for(Track& track: tracks){
+        track.counters.resize((size_t)numLayers * PROFILE_PHASE_COUNT);
+        track.events.reserve(eventsPerTrack);
+    }
+    if(options.hardwareCounters){
+        openHardwareCounters();
+    }
+}
+
+Profiler::~Profiler(){
+    closeHardwareCounters();
+}
+
+Profiler::Mark Profiler::start(int track){
+    Mark mark = {};
+    if(track == 0 && counterGroup >= 0){
+        readHardwareCounters(mark.hardware);
+    }
+    mark.start = std::chrono::steady_clock::now();
+    return mark;
+}
+
+void Profiler::stop(const Mark& mark, int layer, ProfilePhase phase, double flops, double bytes, int track){
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    //layers or slices added after profiling started are not recorded
+    if(layer < 0 || layer >= numLayers || track < 0 || track >= (int)tracks.size()){
+        return;
+    }
+    Track& owner = tracks[track];
+    ProfileCounters& total = owner.counters[(size_t)layer * PROFILE_PHASE_COUNT + (int)phase];
+    total.calls++;
+    total.seconds += std::chrono::duration<double>(end - mark.start).count();
+    total.flops += flops;
+    total.bytes += bytes;
+    if(track == 0 && counterGroup >= 0){
+        uint64_t now[3];
+        readHardwareCounters(now);
+        total.instructions += now[0] - mark.hardware[0];
+        total.cycles += now[1] - mark.hardware[1];
+        total.cacheMisses += now[2] - mark.hardware[2];
+    }
+    if(!options.trace){
+        return;
+    }
+    if(owner.events.size() == owner.events.capacity()){
+        owner.dropped++;
+        return;
+    }
+    owner.events.push_back({std::chrono::duration_cast<std::chrono::nanoseconds>(mark.start - origin).count(),
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(end - mark.start).count(),
+                            layer, phase, flops, bytes});
+}
+
+void Profiler::endStep(int samples, int step){
+    sampleCount += samples;
+    if(options.summaryEvery > 0 && step % options.summaryEvery == 0){
+        std::ostream& out = options.summaryStream ? *options.summaryStream : std::cout;
+        out << "step " << step << "\n";
+        printSummary(out);
+    }
+}
+
+ProfileCounters Profiler::counters(int layer, ProfilePhase phase) const {
+    ProfileCounters sum;
+    if(layer < 0 || layer >= numLayers){
+        return sum;
+    }
+    for(const Track& track: tracks){
+        const ProfileCounters& part = track.counters[(size_t)layer * PROFILE_PHASE_COUNT + (int)phase];
+        sum.calls += part.calls;
+        sum.seconds += part.seconds;
+        sum.flops += part.flops;
+        sum.bytes += part.bytes;
+        sum.instructions += part.instructions;
+        sum.cycles += part.cycles;
+        sum.cacheMisses += part.cacheMisses;
+    }
+    return sum;
+}
+
+double Profiler::samplesPerSecond() const {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+    return seconds > 0.0 ? sampleCount / seconds : 0.0;
+}
+
+size_t Profiler::droppedTraceEvents() const {
+    size_t dropped = 0;
+    for(const Track& track: tracks){
+        dropped += track.dropped;
+    }
+    return dropped;
+}
+
+//seconds summed over the tracks, so slices that ran at the same time add up
+//to more than the wall time they took
+void Profiler::printSummary(std::ostream& out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    bool hardware = counterGroup >= 0;
+    out << std::fixed << std::setprecision(3);
+    out << "profile: " << sampleCount << " samples, " << samplesPerSecond() << " samples/sec\n";
+    out << "  layer phase        calls    total ms     us/call    GFLOP/s       GB/s";
+    if(hardware){
+        out << "    IPC  cache misses";
+    }
+    out << "\n";
+    for(int layer = 0; layer < numLayers; layer++){
+        for(int phase = 0; phase < PROFILE_PHASE_COUNT; phase++){
+            ProfileCounters total = counters(layer, (ProfilePhase)phase);
+            if(total.calls == 0){
+                continue;
+            }
+            double seconds = total.seconds > 0.0 ? total.seconds : 1e-12;
+            out << "  " << std::setw(5) << layer << " " << std::left << std::setw(8) << profilePhaseName((ProfilePhase)phase)
+                << std::right << std::setw(10) << total.calls
+                << std::setw(12) << total.seconds * 1e3
+                << std::setw(12) << total.seconds * 1e6 / total.calls
+                << std::setw(11) << total.flops / seconds * 1e-9
+                << std::setw(11) << total.bytes / seconds * 1e-9;
+            if(hardware){
+                out << std::setw(7) << (total.cycles ? (double)total.instructions / total.cycles : 0.0)
+                    << std::setw(14) << total.cacheMisses;
+            }
+            out << "\n";
+        }
+    }
+    if(!hardwareMessage.empty()){
+        out << "  hardware counters off: " << hardwareMessage << "\n";
+    }
+    if(size_t dropped = droppedTraceEvents()){
+        out << "  " << dropped << " trace events dropped, the buffers are full\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if(!out){
+        std::cerr << "Error: could not open " << path << " for writing\n";
+        return false;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for(size_t t = 0; t < tracks.size(); t++){
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t
+            << ", \"args\": {\"name\": \"" << (t == 0 ? std::string("network") : "slice " + std::to_string(t - 1)) << "\"}}";
+        first = false;
+        for(const TraceEvent& event: tracks[t].events){
+            out << ",\n{\"name\": \"" << profilePhaseName(event.phase) << " " << event.layer
+                << "\", \"cat\": \"" << profilePhaseName(event.phase)
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t
+                << ", \"ts\": " << event.startNanoseconds * 1e-3
+                << ", \"dur\": " << event.durationNanoseconds * 1e-3
+                << ", \"args\": {\"layer\": " << event.layer << ", \"flops\": " << event.flops
+                << ", \"bytes\": " << event.bytes << "}}";
+        }
+    }
+    out << "\n]}\n";
+    if(!out){
+        std::cerr << "Error: failed writing " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+void Profiler::reset(){
+    for(Track& track: tracks){
+        std::fill(track.counters.begin(), track.counters.end(), ProfileCounters());
+        track.events.clear();
+        track.dropped = 0;
+    }
+    sampleCount = 0;
+    origin = std::chrono::steady_clock::now();
+}
+
+#ifdef __linux__
+static int openCounter(uint64_t config, int group){
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group < 0 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    //this thread on any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+//one group so a single read returns all three counters
+void Profiler::openHardwareCounters(){
+    counterGroup = openCounter(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if(counterGroup >= 0){
+        counterMembers[0] = openCounter(PERF_COUNT_HW_CPU_CYCLES, counterGroup);
+        counterMembers[1] = openCounter(PERF_COUNT_HW_CACHE_MISSES, counterGroup);
+    }
+    if(counterGroup < 0 || counterMembers[0] < 0 || counterMembers[1] < 0){
+        hardwareMessage = std::string("perf_event_open failed (") + std::strerror(errno)
+                          + "), see /proc/sys/kernel/perf_event_paranoid";
+        closeHardwareCounters();
+        return;
+    }
+    ioctl(counterGroup, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counterGroup, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void Profiler::closeHardwareCounters(){
+    for(int& member: counterMembers){
+        if(member >= 0){
+            close(member);
+            member = -1;
+        }
+    }
+    if(counterGroup >= 0){
+        close(counterGroup);
+        counterGroup = -1;
+    }
+}
+
+void Profiler::readHardwareCounters(uint64_t values[3]) const {
+    //PERF_FORMAT_GROUP: the number of counters, then their values in open order
+    uint64_t buffer[4] = {0, 0, 0, 0};
+    if(read(counterGroup, buffer, sizeof(buffer)) != (ssize_t)sizeof(buffer)){
+        buffer[1] = buffer[2] = buffer[3] = 0;
+    }
+    values[0] = buffer[1];
+    values[1] = buffer[2];
+    values[2] = buffer[3];
+}
+#else
+void Profiler::openHardwareCounters(){
+    hardwareMessage = "perf_event_open is only available on Linux";
+}
+void Profiler::closeHardwareCounters(){
+}
+void Profiler::readHardwareCounters(uint64_t values[3]) const {
+    values[0] = values[1] = values[2] = 0;
+}
+#endif
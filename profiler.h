@@ -0,0 +1,133 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+//what a recorded section of a training step did
+enum class ProfilePhase {
+    //activations of one layer
+    Forward,
+    //deltas and, for the batch passes, the weight gradients
+    Backward,
+    //optimizer step
+    Update
+};
+const int PROFILE_PHASE_COUNT = 3;
+
+const char* profilePhaseName(ProfilePhase phase);
+
+struct ProfilerOptions {
+    //keep every section as a Chrome trace event, see writeChromeTrace
+    bool trace = true;
+    //trace events kept in memory, later sections are only counted. The buffers
+    //are allocated up front so profiling does not add heap allocations to a step
+    size_t maxTraceEvents = 1 << 18;
+    //instructions, cycles and cache misses from perf_event_open (Linux only).
+    //They count the thread that enabled profiling, so sections that run on the
+    //thread pool's slices leave them out
+    bool hardwareCounters = false;
+    //prints printSummary every this many training steps, 0 never
+    int summaryEvery = 0;
+    std::ostream* summaryStream = nullptr;
+};
+
+//totals of one (layer, phase) pair
+struct ProfileCounters {
+    unsigned long long calls = 0;
+    double seconds = 0.0;
+    //FLOPs counted like the benchmark, bytes estimated from the buffers read
+    //and written. Neither is measured
+    double flops = 0.0;
+    double bytes = 0.0;
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+    uint64_t cacheMisses = 0;
+};
+
+//opt-in instrumentation of the training passes (network::enableProfiling).
+//Sections are recorded per layer and phase on a track: track 0 is the thread
+//that calls the network and track 1 + s is slice s of trainBatch, so every
+//track is only written by one thread at a time and recording needs no locks.
+//Sections that cover every layer at once, such as the threaded update of
+//trainBatch, are recorded on layer 0, the input layer, which has no work of its own
+class Profiler {
+public:
+    //a started section
+    struct Mark {
+        std::chrono::steady_clock::time_point start;
+        uint64_t hardware[3];
+    };
+
+    Profiler(int numLayers, int numTracks, const ProfilerOptions& options = ProfilerOptions());
+    ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    //hardware counters are only read on track 0
+    Mark start(int track = 0);
+    void stop(const Mark& mark, int layer, ProfilePhase phase, double flops, double bytes, int track = 0);
+    //call once per training step with the samples it trained on, prints the
+    //periodic summary when one is due
+    void endStep(int samples, int step);
+
+    //totals of a layer and phase summed over the tracks
+    ProfileCounters counters(int layer, ProfilePhase phase) const;
+    unsigned long long samples() const {
+        return sampleCount;
+    }
+    //samples per second of wall time since the profiler started or was reset
+    double samplesPerSecond() const;
+    bool hardwareCountersActive() const {
+        return counterGroup >= 0;
+    }
+    //why hardwareCounters is off, empty when it was not asked for or works
+    const std::string& hardwareStatus() const {
+        return hardwareMessage;
+    }
+    size_t droppedTraceEvents() const;
+
+    //one line per layer and phase: calls, time, GFLOP/s, GB/s and, when
+    //available, instructions per cycle and cache misses
+    void printSummary(std::ostream& out) const;
+    //Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev), one
+    //complete event per recorded section with its FLOPs and bytes as args
+    bool writeChromeTrace(const std::string& path) const;
+    //clears the counters and trace events, keeps the options
+    void reset();
+
+private:
+    struct TraceEvent {
+        int64_t startNanoseconds;
+        int64_t durationNanoseconds;
+        int layer;
+        ProfilePhase phase;
+        double flops;
+        double bytes;
+    };
+    struct Track {
+        //numLayers x PROFILE_PHASE_COUNT
+        std::vector<ProfileCounters> counters;
+        std::vector<TraceEvent> events;
+        size_t dropped = 0;
+    };
+
+    int numLayers;
+    ProfilerOptions options;
+    std::vector<Track> tracks;
+    std::chrono::steady_clock::time_point origin;
+    unsigned long long sampleCount = 0;
+    //perf_event_open group leader and members, -1 when closed
+    int counterGroup = -1;
+    int counterMembers[2] = {-1, -1};
+    std::string hardwareMessage;
+
+    void openHardwareCounters();
+    void closeHardwareCounters();
+    void readHardwareCounters(uint64_t values[3]) const;
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,211 @@
+#include "quantized.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static const int WEIGHT_LEVELS = 127;
+static const int INPUT_LEVELS = 255;
+
+//widest input range of every layer over the calibration rows, one entry per
+//layer with weights. 0 is always in the range so it quantizes exactly
+template<typename Scalar>
+static void calibrateRanges(const std::vector<LayerT<Scalar>>& layers, const DataSet& data, size_t calibrationRows,
+                            std::vector<double>& low, std::vector<double>& high){
+    const KernelTableT<Scalar>& k = kernelsFor<Scalar>();
+    int maxWidth = 0;
+    for(const LayerT<Scalar>& layer: layers){
+        maxWidth = std::max(maxWidth, layer.size);
+    }
+    std::vector<Scalar> in(maxWidth), out(maxWidth);
+    low.assign(layers.size() - 1, 0.0);
+    high.assign(layers.size() - 1, 0.0);
+    size_t rows = std::max<size_t>(1, std::min(calibrationRows, data.numRows));
+    for(size_t r = 0; r < rows; r++){
+        const double* row = data.row(r * data.numRows / rows);
+        std::copy(row, row + layers.front().size, in.begin());
+        for(size_t i = 1; i < layers.size(); i++){
+            const LayerT<Scalar>& layer = layers[i];
+            for(int c = 0; c < layer.inputSize; c++){
+                low[i - 1] = std::min(low[i - 1], (double)in[c]);
+                high[i - 1] = std::max(high[i - 1], (double)in[c]);
+            }
+            const Scalar* rowsData = layer.weightData();
+            for(int j = 0; j < layer.size; j++){
+                out[j] = k.dot(rowsData + (size_t)j * layer.inputSize, in.data(), layer.inputSize);
+            }
+            k.biasActivation[(int)layer.activation](layer.biases.data(), out.data(), layer.size);
+            if(isLayerScope(layer.activation)){
+                softmax(out.data(), layer.size);
+            }
+            std::swap(in, out);
+        }
+    }
+}
+
+template<typename Scalar>
+QuantizedNetwork::QuantizedNetwork(const std::vector<LayerT<Scalar>>& layers, const DataSet& calibration,
+                                   WeightScaling scaling, size_t calibrationRows){
+    if(layers.size() < 2){
+        return;
+    }
+    if(calibration.numRows == 0 || calibration.numColumns < layers.front().size){
+        std::cerr << "Error: calibration data (" << calibration.numRows << " rows, " << calibration.numColumns
+        << " columns) does not cover the network inputs (" << layers.front().size << ").\n";
+        return;
+    }
+    std::vector<double> low, high;
+    calibrateRanges(layers, calibration, calibrationRows, low, high);
+
+    size_t totalWeights = 0;
+    size_t totalRows = 0;
+    for(size_t i = 1; i < layers.size(); i++){
+        totalWeights += (size_t)layers[i].size * layers[i].inputSize;
+        totalRows += layers[i].size;
+    }
+    weights.reserve(totalWeights);
+    rowScales.reserve(totalRows);
+    rowOffsets.reserve(totalRows);
+    biases.reserve(totalRows);
+
+    maxWidth = layers.front().size;
+    for(size_t i = 1; i < layers.size(); i++){
+        const LayerT<Scalar>& layer = layers[i];
+        double inputScale = high[i - 1] > low[i - 1] ? (high[i - 1] - low[i - 1]) / INPUT_LEVELS : 1.0;
+        int32_t zeroPoint = (int32_t)std::lround(-low[i - 1] / inputScale);
+        zeroPoint = std::min(std::max(zeroPoint, 0), INPUT_LEVELS);
+        LayerPlan step = {layer.size, layer.inputSize, layer.activation, weights.size(), biases.size(),
+                          1.0 / inputScale, zeroPoint};
+
+        const Scalar* source = layer.weightData();
+        size_t weightCount = (size_t)layer.size * layer.inputSize;
+        double layerMax = 0.0;
+        for(size_t w = 0; w < weightCount; w++){
+            layerMax = std::max(layerMax, std::abs((double)source[w]));
+        }
+        for(int j = 0; j < layer.size; j++){
+            const Scalar* row = source + (size_t)j * layer.inputSize;
+            double rowMax = layerMax;
+            if(scaling == WeightScaling::PerRow){
+                rowMax = 0.0;
+                for(int c = 0; c < layer.inputSize; c++){
+                    rowMax = std::max(rowMax, std::abs((double)row[c]));
+                }
+            }
+            double weightScale = rowMax > 0.0 ? rowMax / WEIGHT_LEVELS : 1.0;
+            int32_t rowSum = 0;
+            for(int c = 0; c < layer.inputSize; c++){
+                long q = std::lround(row[c] / weightScale);
+                q = std::min(std::max(q, (long)-WEIGHT_LEVELS), (long)WEIGHT_LEVELS);
+                weights.push_back((int8_t)q);
+                rowSum += (int32_t)q;
+            }
+            rowScales.push_back(weightScale * inputScale);
+            rowOffsets.push_back(zeroPoint * rowSum);
+            biases.push_back((double)layer.biases[j]);
+        }
+        plan.push_back(step);
+        maxWidth = std::max(maxWidth, layer.size);
+    }
+    numInputs = layers.front().size;
+    numOutputs = layers.back().size;
+}
+
+QuantizedNetwork::Workspace& QuantizedNetwork::threadWorkspace(){
+    thread_local Workspace workspace;
+    return workspace;
+}
+
+void QuantizedNetwork::predict(const double* input, double* output) const {
+    predict(input, output, threadWorkspace());
+}
+
+void QuantizedNetwork::predict(const double* input, double* output, Workspace& workspace) const {
+    if(plan.empty()){
+        return;
+    }
+    if(workspace.front.size() < (size_t)maxWidth){
+        workspace.front.resize(maxWidth);
+        workspace.back.resize(maxWidth);
+        workspace.quantized.resize(maxWidth);
+    }
+    const KernelTable& k = kernels();
+    const IntegerKernelTable& integer = integerKernels();
+    uint8_t* quantized = workspace.quantized.data();
+    const double* in = input;
+    for(size_t i = 0; i < plan.size(); i++){
+        const LayerPlan& step = plan[i];
+        //values outside the calibrated range saturate. The value is clamped before
+        //rounding, so it is never negative and + 0.5 with truncation rounds it
+        double zeroPoint = step.inputZeroPoint;
+        for(int c = 0; c < step.inputSize; c++){
+            double q = in[c] * step.inverseInputScale + zeroPoint;
+            q = std::min(std::max(q, 0.0), (double)INPUT_LEVELS);
+            quantized[c] = (uint8_t)(int)(q + 0.5);
+        }
+        double* out = i + 1 == plan.size() ? output : (i % 2 == 0 ? workspace.front.data() : workspace.back.data());
+        const int8_t* rows = &weights[step.weightsOffset];
+        const double* scales = &rowScales[step.rowOffset];
+        const int32_t* offsets = &rowOffsets[step.rowOffset];
+        for(int j = 0; j < step.size; j++){
+            int32_t sum = integer.dotU8S8(quantized, rows + (size_t)j * step.inputSize, step.inputSize);
+            out[j] = (double)(sum - offsets[j]) * scales[j];
+        }
+        k.biasActivation[(int)step.activation](&biases[step.rowOffset], out, step.size);
+        if(isLayerScope(step.activation)){
+            softmax(out, step.size);
+        }
+        in = out;
+    }
+}
+
+void QuantizedNetwork::predictBatch(const double* inputs, double* outputs, int batchSize) const {
+    predictBatch(inputs, outputs, batchSize, threadWorkspace());
+}
+
+//rows one at a time, every weight row is already as small as it gets and the
+//input has to be quantized per row anyway
+void QuantizedNetwork::predictBatch(const double* inputs, double* outputs, int batchSize, Workspace& workspace) const {
+    for(int r = 0; r < batchSize; r++){
+        predict(inputs + (size_t)r * numInputs, outputs + (size_t)r * numOutputs, workspace);
+    }
+}
+
+QuantizationReport compareQuantized(const InferenceNetwork& reference, const QuantizedNetwork& quantized,
+                                    const DataSet& data){
+    QuantizationReport report;
+    int outputs = reference.outputSize();
+    if(reference.empty() || quantized.empty() || reference.inputSize() != quantized.inputSize()
+       || outputs != quantized.outputSize() || data.numColumns < reference.inputSize()){
+        std::cerr << "Error: the networks and the data do not have matching sizes.\n";
+        return report;
+    }
+    std::vector<double> exact(outputs), approximate(outputs);
+    double sumAbs = 0.0;
+    double sumSquares = 0.0;
+    size_t agreements = 0;
+    for(size_t r = 0; r < data.numRows; r++){
+        reference.predict(data.row(r), exact.data());
+        quantized.predict(data.row(r), approximate.data());
+        for(int j = 0; j < outputs; j++){
+            double error = std::abs(exact[j] - approximate[j]);
+            report.maxAbsError = std::max(report.maxAbsError, error);
+            sumAbs += error;
+            sumSquares += error * error;
+        }
+        if(std::max_element(exact.begin(), exact.end()) - exact.begin()
+           == std::max_element(approximate.begin(), approximate.end()) - approximate.begin()){
+            agreements++;
+        }
+    }
+    size_t count = data.numRows * outputs;
+    report.rows = data.numRows;
+    report.meanAbsError = count > 0 ? sumAbs / count : 0.0;
+    report.rmsError = count > 0 ? std::sqrt(sumSquares / count) : 0.0;
+    report.argmaxAgreement = data.numRows > 0 ? (double)agreements / data.numRows : 1.0;
+    report.referenceBytes = (quantized.weightCount() + quantized.neuronCount()) * sizeof(double);
+    report.quantizedBytes = quantized.parameterBytes();
+    return report;
+}
+
+template QuantizedNetwork::QuantizedNetwork(const std::vector<Layer>&, const DataSet&, WeightScaling, size_t);
+template QuantizedNetwork::QuantizedNetwork(const std::vector<LayerF>&, const DataSet&, WeightScaling, size_t);
@@ -0,0 +1,115 @@
+#ifndef QUANTIZED_H
+#define QUANTIZED_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "layer.h"
+#include "data_loader.h"
+#include "inference.h"
+
+//how the int8 weight scales are shared. PerRow gives every neuron its own
+//scale, which keeps small rows accurate next to large ones for one float per row
+enum class WeightScaling {
+    PerLayer,
+    PerRow
+};
+
+//int8 post-training quantization of a trained network for CPU serving.
+//Weights are symmetric int8 (w ~ scale * q, q in [-127, 127]). The input of
+//every layer is asymmetric uint8 (x ~ inputScale * (q - zeroPoint)) with the
+//range measured on calibration rows, so each neuron is
+//  scale * inputScale * (sum(qw * qx) - zeroPoint * sum(qw)) + bias
+//with the sum in int32 and sum(qw) precomputed. The bias and activation run in
+//double on the integer result. Like InferenceNetwork the plan is read-only
+//after construction and predict can be called from any number of threads
+class QuantizedNetwork {
+public:
+    //double activations of one call and the uint8 copy of the current layer input
+    struct Workspace {
+        std::vector<double> front;
+        std::vector<double> back;
+        std::vector<uint8_t> quantized;
+    };
+
+    QuantizedNetwork() = default;
+    //calibrationRows rows spread evenly over calibration are run through the
+    //layers in full precision to find the range of every layer input. The first
+    //columns of calibration are the network inputs, any others are ignored
+    template<typename Scalar>
+    QuantizedNetwork(const std::vector<LayerT<Scalar>>& layers, const DataSet& calibration,
+                     WeightScaling scaling = WeightScaling::PerRow, size_t calibrationRows = 1024);
+
+    int inputSize() const {
+        return numInputs;
+    }
+    int outputSize() const {
+        return numOutputs;
+    }
+    bool empty() const {
+        return plan.empty();
+    }
+    size_t weightCount() const {
+        return weights.size();
+    }
+    size_t neuronCount() const {
+        return biases.size();
+    }
+    //int8 weights plus the per row scales, offsets and biases
+    size_t parameterBytes() const {
+        return weights.size() + rowScales.size() * sizeof(double) + rowOffsets.size() * sizeof(int32_t)
+               + biases.size() * sizeof(double);
+    }
+
+    //same interface as InferenceNetwork
+    void predict(const double* input, double* output) const;
+    void predict(const double* input, double* output, Workspace& workspace) const;
+    void predictBatch(const double* inputs, double* outputs, int batchSize) const;
+    void predictBatch(const double* inputs, double* outputs, int batchSize, Workspace& workspace) const;
+
+private:
+    struct LayerPlan {
+        int size;
+        int inputSize;
+        ActivationType activation;
+        //into weights
+        size_t weightsOffset;
+        //into rowScales, rowOffsets and biases
+        size_t rowOffset;
+        double inverseInputScale;
+        int32_t inputZeroPoint;
+    };
+
+    std::vector<LayerPlan> plan;
+    std::vector<int8_t> weights;
+    //weight scale * input scale per row
+    std::vector<double> rowScales;
+    //zeroPoint * sum(qw) per row
+    std::vector<int32_t> rowOffsets;
+    std::vector<double> biases;
+    int numInputs = 0;
+    int numOutputs = 0;
+    int maxWidth = 0;
+
+    static Workspace& threadWorkspace();
+};
+
+//how far a quantized network is from the full precision one. The reference is
+//the frozen double network, whose outputs match forwardPass exactly
+struct QuantizationReport {
+    size_t rows = 0;
+    double maxAbsError = 0.0;
+    double meanAbsError = 0.0;
+    double rmsError = 0.0;
+    //rows where the largest output is the same neuron in both, 1 with a single output
+    double argmaxAgreement = 1.0;
+    //bytes of the double weights and of the quantized parameters
+    size_t referenceBytes = 0;
+    size_t quantizedBytes = 0;
+};
+
+//runs every row of data through both networks
+QuantizationReport compareQuantized(const InferenceNetwork& reference, const QuantizedNetwork& quantized,
+                                    const DataSet& data);
+
+#endif // QUANTIZED_H
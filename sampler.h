@@ -0,0 +1,146 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include "data_loader.h"
+
+//one row of a DataSet, points into the DataSet's buffer
+struct RowView {
+    const double* values;
+    int size;
+
+    double operator[](int index) const {
+        return values[index];
+    }
+};
+
+//uniform integer in [0, bound). std::uniform_int_distribution differs between
+//standard libraries, this gives the same sequence for a seed everywhere
+inline uint64_t randomBelow(std::mt19937_64& generator, uint64_t bound){
+    //rejects the top values that would make the modulo uneven
+    uint64_t threshold = (0 - bound) % bound;
+    uint64_t value;
+    do {
+        value = generator();
+    } while(value < threshold);
+    return value % bound;
+}
+
+//Fisher-Yates shuffle of indices
+inline void shuffleIndices(std::vector<size_t>& indices, std::mt19937_64& generator){
+    for(size_t i = indices.size(); i > 1; i--){
+        size_t j = (size_t)randomBelow(generator, i);
+        std::swap(indices[i - 1], indices[j]);
+    }
+}
+
+//shuffles the row indices of a DataSet once and cuts off the last
+//validationFraction of them as the validation rows
+inline void splitRows(size_t numRows, double validationFraction, uint64_t seed,
+                      std::vector<size_t>& trainRows, std::vector<size_t>& validationRows){
+    std::vector<size_t> indices(numRows);
+    for(size_t i = 0; i < numRows; i++){
+        indices[i] = i;
+    }
+    std::mt19937_64 generator(seed);
+    shuffleIndices(indices, generator);
+    size_t numValidation = (size_t)(numRows * validationFraction);
+    trainRows.assign(indices.begin(), indices.end() - numValidation);
+    validationRows.assign(indices.end() - numValidation, indices.end());
+}
+
+//hands out the rows of a DataSet in a new random order every epoch. The
+//DataSet is never modified or copied and has to outlive the sampler. Every
+//row is visited exactly once per epoch and a seed always gives the same order
+class EpochSampler {
+public:
+    //samples every row of data
+    EpochSampler(const DataSet& data, uint64_t seed) : data(&data), generator(seed) {
+        rows.resize(data.numRows);
+        for(size_t i = 0; i < rows.size(); i++){
+            rows[i] = i;
+        }
+        shuffleIndices(rows, generator);
+    }
+    //samples only the given rows, for example one side of splitRows
+    EpochSampler(const DataSet& data, std::vector<size_t> rowIndices, uint64_t seed)
+        : data(&data), rows(std::move(rowIndices)), generator(seed) {
+        shuffleIndices(rows, generator);
+    }
+
+    //next row of the current epoch, false once every row has been handed out
+    bool next(RowView& row){
+        if(position >= rows.size()){
+            return false;
+        }
+        row = RowView{data->row(rows[position++]), data->numColumns};
+        return true;
+    }
+    //up to batchSize rows of the current epoch, returns how many (0 at the end)
+    int nextBatch(int batchSize, std::vector<RowView>& batch){
+        batch.clear();
+        RowView row;
+        while((int)batch.size() < batchSize && next(row)){
+            batch.push_back(row);
+        }
+        return (int)batch.size();
+    }
+    //starts the next epoch with a fresh permutation
+    void startEpoch(){
+        shuffleIndices(rows, generator);
+        position = 0;
+        currentEpoch++;
+    }
+
+    int epoch() const {
+        return currentEpoch;
+    }
+    size_t size() const {
+        return rows.size();
+    }
+    size_t remaining() const {
+        return rows.size() - position;
+    }
+
+private:
+    const DataSet* data;
+    std::vector<size_t> rows;
+    std::mt19937_64 generator;
+    size_t position = 0;
+    int currentEpoch = 0;
+};
+
+//packs rows into the row-major inputs/expected matrices the batched passes
+//take. The first numInputs columns are inputs and the rest are expected values.
+//The buffers are reused, so after the first batch this does not allocate.
+//Float buffers get the values rounded, for training a networkF
+template<typename Scalar>
+inline void gatherBatch(const std::vector<RowView>& batch, int numInputs,
+                        std::vector<Scalar>& inputs, std::vector<Scalar>& expected){
+    inputs.clear();
+    expected.clear();
+    for(const RowView& row: batch){
+        inputs.insert(inputs.end(), row.values, row.values + numInputs);
+        expected.insert(expected.end(), row.values + numInputs, row.values + row.size);
+    }
+}
+
+//gatherBatch for classification. The column after the inputs holds a class id,
+//as a categorical column loaded with Normalization::None does, and becomes one
+//label per row for trainBatchLabels instead of a one-hot expected row
+template<typename Scalar>
+inline void gatherLabels(const std::vector<RowView>& batch, int numInputs,
+                         std::vector<Scalar>& inputs, std::vector<int>& labels){
+    inputs.clear();
+    labels.clear();
+    for(const RowView& row: batch){
+        inputs.insert(inputs.end(), row.values, row.values + numInputs);
+        labels.push_back((int)row.values[numInputs]);
+    }
+}
+
+#endif // SAMPLER_H
@@ -0,0 +1,85 @@
+#include "schedule.h"
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+LearningRateSchedule LearningRateSchedule::constant(double baseRate, int warmupSteps){
+    LearningRateSchedule schedule;
+    schedule.baseRate = baseRate;
+    schedule.warmupSteps = warmupSteps;
+    return schedule;
+}
+LearningRateSchedule LearningRateSchedule::stepDecay(double baseRate, int stepSize, double factor, int warmupSteps){
+    LearningRateSchedule schedule = constant(baseRate, warmupSteps);
+    schedule.type = ScheduleType::StepDecay;
+    schedule.stepSize = std::max(1, stepSize);
+    schedule.factor = factor;
+    return schedule;
+}
+LearningRateSchedule LearningRateSchedule::cosine(double baseRate, int totalSteps, double minRate, int warmupSteps){
+    LearningRateSchedule schedule = constant(baseRate, warmupSteps);
+    schedule.type = ScheduleType::Cosine;
+    schedule.totalSteps = totalSteps;
+    schedule.minRate = minRate;
+    return schedule;
+}
+LearningRateSchedule LearningRateSchedule::reduceOnPlateau(double baseRate, double factor, int patience, double minRate,
+                                                           int warmupSteps){
+    LearningRateSchedule schedule = constant(baseRate, warmupSteps);
+    schedule.type = ScheduleType::ReduceOnPlateau;
+    schedule.factor = factor;
+    schedule.patience = std::max(1, patience);
+    schedule.minRate = minRate;
+    return schedule;
+}
+
+double LearningRateSchedule::rateAt(int step) const {
+    if(step < warmupSteps){
+        return baseRate * (step + 1) / warmupSteps;
+    }
+    int decayed = step - warmupSteps;
+    switch(type){
+        case ScheduleType::StepDecay:
+            return baseRate * std::pow(factor, decayed / stepSize);
+        case ScheduleType::Cosine: {
+            int span = totalSteps - warmupSteps;
+            double progress = span > 0 ? std::min(1.0, (double)decayed / span) : 1.0;
+            return minRate + (baseRate - minRate) * 0.5 * (1.0 + std::cos(PI * progress));
+        }
+        case ScheduleType::ReduceOnPlateau:
+            return std::max(minRate, baseRate * plateauScale);
+        default:
+            return baseRate;
+    }
+}
+
+bool LearningRateSchedule::observe(double score){
+    if(type != ScheduleType::ReduceOnPlateau){
+        return false;
+    }
+    if(score > bestScore + threshold){
+        bestScore = score;
+        sinceBest = 0;
+        return false;
+    }
+    if(++sinceBest < patience || baseRate * plateauScale <= minRate){
+        return false;
+    }
+    plateauScale *= factor;
+    sinceBest = 0;
+    return true;
+}
+
+const char* scheduleName(ScheduleType type){
+    switch(type){
+        case ScheduleType::StepDecay:
+            return "step";
+        case ScheduleType::Cosine:
+            return "cosine";
+        case ScheduleType::ReduceOnPlateau:
+            return "plateau";
+        default:
+            return "constant";
+    }
+}
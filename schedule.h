@@ -0,0 +1,133 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <vector>
+#include <functional>
+#include <utility>
+#include <limits>
+
+//how the learning rate moves with the training step. NetworkT::setSchedule
+//installs one and every step sets learningRate = rateAt(step). Model files
+//saved with the optimizer state keep the schedule, plateau state included,
+//so loadModel of a checkpoint continues on the same curve
+enum class ScheduleType {
+    //baseRate throughout, what the network did before schedules
+    Constant,
+    //baseRate * factor^(steps / stepSize)
+    StepDecay,
+    //half a cosine from baseRate down to minRate over totalSteps
+    Cosine,
+    //baseRate, multiplied by factor whenever the validation score has not
+    //improved for patience evaluations, down to minRate
+    ReduceOnPlateau
+};
+
+//every schedule can start with warmupSteps steps that raise the rate linearly
+//to baseRate. Steps are the network's step counter, so the curve starts at
+//step 0 and the decay starts after the warmup
+struct LearningRateSchedule {
+    ScheduleType type = ScheduleType::Constant;
+    //0 takes the network's learningRate when the schedule is set
+    double baseRate = 0.0;
+    int warmupSteps = 0;
+    //StepDecay and ReduceOnPlateau
+    int stepSize = 1000;
+    double factor = 0.1;
+    //Cosine
+    int totalSteps = 0;
+    //Cosine and ReduceOnPlateau never go below it
+    double minRate = 0.0;
+    //ReduceOnPlateau: evaluations without an improvement of more than threshold
+    int patience = 3;
+    double threshold = 1e-4;
+
+    //ReduceOnPlateau state, kept by observe
+    double plateauScale = 1.0;
+    double bestScore = -std::numeric_limits<double>::infinity();
+    int sinceBest = 0;
+
+    static LearningRateSchedule constant(double baseRate = 0.0, int warmupSteps = 0);
+    static LearningRateSchedule stepDecay(double baseRate, int stepSize, double factor = 0.1, int warmupSteps = 0);
+    static LearningRateSchedule cosine(double baseRate, int totalSteps, double minRate = 0.0, int warmupSteps = 0);
+    static LearningRateSchedule reduceOnPlateau(double baseRate, double factor = 0.5, int patience = 3,
+                                                double minRate = 0.0, int warmupSteps = 0);
+
+    //false for a plain constant rate, which then leaves learningRate alone
+    bool adjusts() const {
+        return type != ScheduleType::Constant || warmupSteps > 0;
+    }
+    //the rate of the step after step
+    double rateAt(int step) const;
+    //takes a validation score, higher is better. Returns true when a plateau
+    //lowered the rate
+    bool observe(double score);
+};
+const char* scheduleName(ScheduleType type);
+
+//when NetworkT::enableValidation evaluates and when it stops training
+struct ValidationOptions {
+    //evaluate every this many training steps
+    int everySteps = 100;
+    //stop after this many evaluations in a row without an improvement of more
+    //than minImprovement, 0 never stops on a plateau
+    int patience = 5;
+    double minImprovement = 0.0;
+    //stop as soon as a score reaches it
+    double targetScore = std::numeric_limits<double>::infinity();
+    //put the weights of the best evaluation back when training stops
+    bool restoreBest = true;
+};
+
+template<typename Scalar>
+struct NetworkT;
+
+//what validation has found so far. It is saved with the training state, so a
+//run resumed from a checkpoint keeps its best weights and its patience
+template<typename Scalar>
+struct ValidationProgressT {
+    double bestScore = -std::numeric_limits<double>::infinity();
+    //-1 before the first evaluation
+    int bestStep = -1;
+    int sinceBest = 0;
+    //set once the patience ran out or the target was reached
+    bool stopped = false;
+    //per layer, empty until the first evaluation
+    std::vector<std::vector<Scalar>> bestWeights;
+    std::vector<std::vector<Scalar>> bestBiases;
+};
+
+//validation state of a network: the score function, the scores so far and
+//the weights and biases of the best one
+template<typename Scalar>
+struct ValidationT : ValidationProgressT<Scalar> {
+    ValidationOptions options;
+    //score of the network on a held out set, higher is better (use the
+    //negated loss for a loss). Empty for progress loadModel restored before
+    //enableValidation was called
+    std::function<double(NetworkT<Scalar>&)> score;
+    //(step, score) of every evaluation since enableValidation, not saved
+    std::vector<std::pair<int, double>> history;
+
+    ValidationT(const ValidationOptions& options, std::function<double(NetworkT<Scalar>&)> score)
+        : options(options), score(std::move(score)){}
+
+    bool due(int step) const {
+        return !this->stopped && score && options.everySteps > 0 && step % options.everySteps == 0;
+    }
+    //records the score of step, returns true when it is the new best
+    bool record(int step, double value){
+        history.push_back({step, value});
+        bool improved = this->bestStep < 0 || value > this->bestScore + options.minImprovement;
+        if(improved){
+            this->bestScore = value;
+            this->bestStep = step;
+            this->sinceBest = 0;
+        }else{
+            this->sinceBest++;
+        }
+        this->stopped = value >= options.targetScore || (options.patience > 0 && this->sinceBest >= options.patience);
+        return improved;
+    }
+};
+
+#endif // SCHEDULE_H
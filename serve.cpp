@@ -0,0 +1,110 @@
+#include "network.h"
+#include "server.h"
+#include <cstdlib>
+#include <csignal>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+//serves a saved model to local processes, see InferenceServer for the protocol.
+//  nn_server model.nn [--unix path | --port n] [--max-batch n] [--max-delay-us us]
+//            [--workers n] [--report seconds]
+//without --unix it listens on loopback TCP, port 0 picks a free port. Statistics
+//are printed every --report seconds (0 for never) and on SIGINT/SIGTERM, which
+//stop the server
+
+template<typename Scalar>
+static int serve(const std::string& modelPath, const ServerOptions& options, double reportSeconds){
+    //mapped, and the frozen plan keeps referring to the mapping, so every
+    //server on this host shares one physical copy of the weights
+    NetworkT<Scalar> net;
+    if(!net.loadModel(modelPath, true)){
+        return 1;
+    }
+#ifndef _WIN32
+    //SIGINT and SIGTERM are taken by a thread waiting for them, so nothing has
+    //to be async-signal-safe. They are blocked before the server starts its
+    //threads, which inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+    InferenceServerT<Scalar> server(net.freeze(), options);
+    if(!server.start()){
+        return 1;
+    }
+    if(options.socketPath.empty()){
+        std::cout << "serving " << modelPath << " on 127.0.0.1:" << server.port() << std::endl;
+    }else{
+        std::cout << "serving " << modelPath << " on " << options.socketPath << std::endl;
+    }
+
+#ifndef _WIN32
+    std::atomic<bool> stopRequested{false};
+    std::thread waiter([&](){
+        int received = 0;
+        sigwait(&signals, &received);
+        stopRequested = true;
+    });
+    std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+    while(!stopRequested){
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if(reportSeconds > 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - lastReport).count() >= reportSeconds){
+            printServerStats(server.stats(true), std::cout);
+            lastReport = std::chrono::steady_clock::now();
+        }
+    }
+    waiter.join();
+#else
+    std::cout << "press enter to stop" << std::endl;
+    std::cin.get();
+#endif
+    printServerStats(server.stats(), std::cout);
+    server.stop();
+    return 0;
+}
+
+int main(int argc, char** argv){
+    Logger::setLevel(LogLevel::Off);
+    std::string modelPath;
+    ServerOptions options;
+    double reportSeconds = 10.0;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--unix" && hasValue){
+            options.socketPath = argv[++i];
+        }else if(arg == "--port" && hasValue){
+            options.port = std::atoi(argv[++i]);
+        }else if(arg == "--max-batch" && hasValue){
+            options.maxBatch = std::atoi(argv[++i]);
+        }else if(arg == "--max-delay-us" && hasValue){
+            options.maxDelayMicroseconds = std::atof(argv[++i]);
+        }else if(arg == "--workers" && hasValue){
+            options.workers = std::atoi(argv[++i]);
+        }else if(arg == "--report" && hasValue){
+            reportSeconds = std::atof(argv[++i]);
+        }else if(modelPath.empty() && !arg.empty() && arg[0] != '-'){
+            modelPath = arg;
+        }else{
+            modelPath.clear();
+            break;
+        }
+    }
+    if(modelPath.empty()){
+        std::cerr << "Usage: nn_server model.nn [--unix path | --port n] [--max-batch n] [--max-delay-us us]"
+                  << " [--workers n] [--report seconds]\n";
+        return 1;
+    }
+    ModelHeader header;
+    if(!readModelHeader(modelPath, header)){
+        return 1;
+    }
+    if(header.flags & MODEL_FLOAT32){
+        return serve<float>(modelPath, options, reportSeconds);
+    }
+    return serve<double>(modelPath, options, reportSeconds);
+}
@@ -0,0 +1,663 @@
+#include "server.h"
+#include <algorithm>
+#include <random>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+//---------------------------------------------------------------- sockets
+
+//the only platform specific part. Windows has no Unix domain socket
+//streams that behave the same, so there every helper fails
+#ifndef _WIN32
+#ifdef MSG_NOSIGNAL
+//a client that disconnects must not kill the server with SIGPIPE
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+static void closeSocket(int socket){
+    ::close(socket);
+}
+
+static bool readFully(int socket, void* data, size_t bytes){
+    char* at = static_cast<char*>(data);
+    while(bytes > 0){
+        ssize_t received = ::recv(socket, at, bytes, 0);
+        if(received < 0 && errno == EINTR){
+            continue;
+        }
+        if(received <= 0){
+            return false;
+        }
+        at += received;
+        bytes -= (size_t)received;
+    }
+    return true;
+}
+
+//a header and its payload in one system call where possible
+static bool writeFully(int socket, const void* header, size_t headerBytes, const void* payload, size_t payloadBytes){
+    iovec parts[2] = {{const_cast<void*>(header), headerBytes}, {const_cast<void*>(payload), payloadBytes}};
+    int first = 0;
+    while(first < 2){
+        msghdr message = {};
+        message.msg_iov = parts + first;
+        message.msg_iovlen = 2 - first;
+        ssize_t sent = ::sendmsg(socket, &message, SEND_FLAGS);
+        if(sent < 0 && errno == EINTR){
+            continue;
+        }
+        if(sent <= 0){
+            return false;
+        }
+        size_t left = (size_t)sent;
+        while(first < 2 && left >= parts[first].iov_len){
+            left -= parts[first].iov_len;
+            first++;
+        }
+        if(first < 2){
+            parts[first].iov_base = static_cast<char*>(parts[first].iov_base) + left;
+            parts[first].iov_len -= left;
+        }
+    }
+    return true;
+}
+
+//small requests and responses go out at once instead of waiting for Nagle
+static void setNoDelay(int socket){
+    int on = 1;
+    ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static bool fillUnixAddress(const std::string& path, sockaddr_un& address){
+    address = {};
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)){
+        std::cerr << "Error: socket path " << path << " is longer than " << sizeof(address.sun_path) - 1 << " bytes\n";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+//listening socket on socketPath, or on loopback port. port is set to the
+//bound port, -1 and an error printed on failure
+static int openListener(const std::string& socketPath, int& port){
+    int listener = -1;
+    if(!socketPath.empty()){
+        sockaddr_un address;
+        if(!fillUnixAddress(socketPath, address)){
+            return -1;
+        }
+        //a socket left behind by a server that did not stop cleanly, never a regular file
+        struct stat existing;
+        if(::lstat(socketPath.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)){
+            ::unlink(socketPath.c_str());
+        }
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if(listener < 0 || ::bind(listener, (const sockaddr*)&address, sizeof(address)) != 0){
+            std::cerr << "Error: could not bind " << socketPath << ": " << std::strerror(errno) << "\n";
+            if(listener >= 0){
+                closeSocket(listener);
+            }
+            return -1;
+        }
+        port = 0;
+    }else{
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((uint16_t)port);
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        if(listener >= 0){
+            ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        }
+        if(listener < 0 || ::bind(listener, (const sockaddr*)&address, sizeof(address)) != 0){
+            std::cerr << "Error: could not bind 127.0.0.1:" << port << ": " << std::strerror(errno) << "\n";
+            if(listener >= 0){
+                closeSocket(listener);
+            }
+            return -1;
+        }
+        socklen_t length = sizeof(address);
+        ::getsockname(listener, (sockaddr*)&address, &length);
+        port = ntohs(address.sin_port);
+    }
+    if(::listen(listener, 128) != 0){
+        std::cerr << "Error: could not listen: " << std::strerror(errno) << "\n";
+        closeSocket(listener);
+        return -1;
+    }
+    return listener;
+}
+
+//waits up to timeoutMilliseconds for a connection, -1 when none came
+static int acceptConnection(int listener, bool tcp, int timeoutMilliseconds){
+    pollfd waiting = {listener, POLLIN, 0};
+    if(::poll(&waiting, 1, timeoutMilliseconds) <= 0){
+        return -1;
+    }
+    int client = ::accept(listener, nullptr, nullptr);
+    if(client >= 0 && tcp){
+        setNoDelay(client);
+    }
+    return client;
+}
+
+static void shutdownSocket(int socket){
+    ::shutdown(socket, SHUT_RDWR);
+}
+
+static int connectSocket(const std::string& socketPath, int port){
+    int client = -1;
+    if(!socketPath.empty()){
+        sockaddr_un address;
+        if(!fillUnixAddress(socketPath, address)){
+            return -1;
+        }
+        client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if(client >= 0 && ::connect(client, (const sockaddr*)&address, sizeof(address)) == 0){
+            return client;
+        }
+        std::cerr << "Error: could not connect to " << socketPath << ": " << std::strerror(errno) << "\n";
+    }else{
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((uint16_t)port);
+        client = ::socket(AF_INET, SOCK_STREAM, 0);
+        if(client >= 0 && ::connect(client, (const sockaddr*)&address, sizeof(address)) == 0){
+            setNoDelay(client);
+            return client;
+        }
+        std::cerr << "Error: could not connect to 127.0.0.1:" << port << ": " << std::strerror(errno) << "\n";
+    }
+    if(client >= 0){
+        closeSocket(client);
+    }
+    return -1;
+}
+
+static void removeSocketFile(const std::string& socketPath){
+    if(!socketPath.empty()){
+        ::unlink(socketPath.c_str());
+    }
+}
+#else
+static void closeSocket(int){}
+static bool readFully(int, void*, size_t){
+    return false;
+}
+static bool writeFully(int, const void*, size_t, const void*, size_t){
+    return false;
+}
+static int openListener(const std::string&, int&){
+    std::cerr << "Error: the inference server needs POSIX sockets\n";
+    return -1;
+}
+static int acceptConnection(int, bool, int){
+    return -1;
+}
+static void shutdownSocket(int){}
+static int connectSocket(const std::string&, int){
+    std::cerr << "Error: the inference client needs POSIX sockets\n";
+    return -1;
+}
+static void removeSocketFile(const std::string&){}
+#endif
+
+//---------------------------------------------------------------- statistics
+
+LatencySummary summarizeLatencies(std::vector<float>& microseconds){
+    LatencySummary summary;
+    if(microseconds.empty()){
+        return summary;
+    }
+    size_t n = microseconds.size();
+    std::nth_element(microseconds.begin(), microseconds.begin() + n / 2, microseconds.end());
+    summary.p50Microseconds = microseconds[n / 2];
+    size_t p99 = std::min(n - 1, n * 99 / 100);
+    std::nth_element(microseconds.begin(), microseconds.begin() + p99, microseconds.end());
+    summary.p99Microseconds = microseconds[p99];
+    summary.maxMicroseconds = *std::max_element(microseconds.begin(), microseconds.end());
+    return summary;
+}
+
+static void printLatency(const LatencySummary& latency, std::ostream& out){
+    out << "latency p50 " << latency.p50Microseconds << " us, p99 " << latency.p99Microseconds
+        << " us, max " << latency.maxMicroseconds << " us";
+}
+
+void printServerStats(const ServerStats& stats, std::ostream& out){
+    double seconds = std::max(stats.seconds, 1e-9);
+    out << std::fixed << std::setprecision(1) << stats.requests << " requests (" << stats.requests / seconds << "/s), "
+        << stats.rows << " rows (" << stats.rows / seconds << "/s), " << stats.batches << " batches of "
+        << (stats.batches ? (double)stats.rows / stats.batches : 0.0) << " rows, ";
+    printLatency(stats.latency, out);
+    out << "\n";
+    out.unsetf(std::ios::fixed);
+    out << std::setprecision(6);
+}
+
+void printLoadResult(const LoadResult& result, std::ostream& out){
+    double seconds = std::max(result.seconds, 1e-9);
+    out << std::fixed << std::setprecision(1) << result.requests << " requests (" << result.requests / seconds << "/s), "
+        << result.rows << " rows (" << result.rows / seconds << "/s) in " << result.seconds << " s, ";
+    printLatency(result.latency, out);
+    out << (result.ok ? "" : ", FAILED") << "\n";
+    out.unsetf(std::ios::fixed);
+    out << std::setprecision(6);
+}
+
+static double microsecondsSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+//---------------------------------------------------------------- server
+
+template<typename Scalar>
+InferenceServerT<Scalar>::InferenceServerT(const InferenceNetworkT<Scalar>& model, const ServerOptions& options)
+    : model(model), options(options){
+    this->options.maxBatch = std::max(1, options.maxBatch);
+    this->options.workers = std::max(1, options.workers);
+    this->options.maxRows = std::max(1, options.maxRows);
+}
+
+template<typename Scalar>
+InferenceServerT<Scalar>::~InferenceServerT(){
+    stop();
+}
+
+template<typename Scalar>
+bool InferenceServerT<Scalar>::start(){
+    if(running()){
+        return true;
+    }
+    if(model.empty()){
+        std::cerr << "Error: the inference server has no model\n";
+        return false;
+    }
+    boundPort = options.port;
+    listenSocket = openListener(options.socketPath, boundPort);
+    if(listenSocket < 0){
+        return false;
+    }
+    stopping = false;
+    stats(true);
+    acceptor = std::thread([this](){ acceptLoop(); });
+    for(int i = 0; i < options.workers; i++){
+        workers.emplace_back([this](){ workerLoop(); });
+    }
+    return true;
+}
+
+template<typename Scalar>
+void InferenceServerT<Scalar>::stop(){
+    if(!running()){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    queued.notify_all();
+    acceptor.join();
+    //workers finish the batch they have, so no request they took is left half written
+    for(std::thread& worker: workers){
+        worker.join();
+    }
+    workers.clear();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        //nobody will run these, their connection threads can let go of them
+        for(Request* request: queue){
+            request->abandoned = true;
+            request->finished.notify_one();
+        }
+        queue.clear();
+        queuedRows = 0;
+        for(std::unique_ptr<Connection>& connection: connections){
+            shutdownSocket(connection->socket);
+        }
+    }
+    for(std::unique_ptr<Connection>& connection: connections){
+        connection->thread.join();
+        closeSocket(connection->socket);
+    }
+    connections.clear();
+    closeSocket(listenSocket);
+    removeSocketFile(options.socketPath);
+    listenSocket = -1;
+}
+
+template<typename Scalar>
+ServerStats InferenceServerT<Scalar>::stats(bool reset){
+    std::vector<float> copy;
+    ServerStats result;
+    {
+        std::lock_guard<std::mutex> lock(statsMtx);
+        result = totals;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - statsStart).count();
+        if(reset){
+            copy.swap(latencies);
+            totals = ServerStats();
+            statsStart = std::chrono::steady_clock::now();
+        }else{
+            copy = latencies;
+        }
+    }
+    result.latency = summarizeLatencies(copy);
+    return result;
+}
+
+template<typename Scalar>
+void InferenceServerT<Scalar>::reapConnections(){
+    for(size_t i = 0; i < connections.size();){
+        if(connections[i]->closed){
+            connections[i]->thread.join();
+            closeSocket(connections[i]->socket);
+            connections.erase(connections.begin() + i);
+        }else{
+            i++;
+        }
+    }
+}
+
+template<typename Scalar>
+void InferenceServerT<Scalar>::acceptLoop(){
+    bool tcp = options.socketPath.empty();
+    while(true){
+        //wakes up every 100 ms to see whether the server is stopping
+        int client = acceptConnection(listenSocket, tcp, 100);
+        std::lock_guard<std::mutex> lock(mtx);
+        if(stopping){
+            if(client >= 0){
+                closeSocket(client);
+            }
+            return;
+        }
+        reapConnections();
+        if(client < 0){
+            continue;
+        }
+        connections.push_back(std::make_unique<Connection>());
+        Connection& connection = *connections.back();
+        connection.socket = client;
+        openConnections++;
+        connection.thread = std::thread([this, &connection](){ serveConnection(connection); });
+    }
+}
+
+template<typename Scalar>
+void InferenceServerT<Scalar>::serveConnection(Connection& connection){
+    int inputSize = model.inputSize();
+    int outputSize = model.outputSize();
+    ServerHello hello = {SERVER_MAGIC, SERVER_VERSION, (uint32_t)inputSize, (uint32_t)outputSize,
+                         (uint32_t)sizeof(Scalar), (uint32_t)options.maxRows};
+    std::vector<Scalar> inputs, outputs;
+    Request request;
+    bool open = writeFully(connection.socket, &hello, sizeof(hello), nullptr, 0);
+    while(open){
+        uint32_t rows = 0;
+        if(!readFully(connection.socket, &rows, sizeof(rows)) || rows == 0 || rows > (uint32_t)options.maxRows){
+            break;
+        }
+        inputs.resize((size_t)rows * inputSize);
+        outputs.resize((size_t)rows * outputSize);
+        if(!readFully(connection.socket, inputs.data(), inputs.size() * sizeof(Scalar))){
+            break;
+        }
+        std::chrono::steady_clock::time_point arrived = std::chrono::steady_clock::now();
+        request.inputs = inputs.data();
+        request.outputs = outputs.data();
+        request.rows = (int)rows;
+        request.done = false;
+        request.abandoned = false;
+        request.arrived = arrived;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if(stopping){
+                break;
+            }
+            queue.push_back(&request);
+            queuedRows += (int)rows;
+            queued.notify_all();
+            //stopping alone is not enough, a worker may still be writing the outputs
+            request.finished.wait(lock, [&](){ return request.done || request.abandoned; });
+            if(!request.done){
+                break;
+            }
+        }
+        open = writeFully(connection.socket, &rows, sizeof(rows), outputs.data(), outputs.size() * sizeof(Scalar));
+        float latency = (float)microsecondsSince(arrived);
+        std::lock_guard<std::mutex> lock(statsMtx);
+        totals.requests++;
+        totals.rows += rows;
+        latencies.push_back(latency);
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    openConnections--;
+    connection.closed = true;
+    //a batch waiting for this connection can leave now
+    queued.notify_all();
+}
+
+template<typename Scalar>
+void InferenceServerT<Scalar>::workerLoop(){
+    typename InferenceNetworkT<Scalar>::Workspace workspace;
+    std::vector<Scalar> batchInputs, batchOutputs;
+    std::vector<Request*> batch;
+    int inputSize = model.inputSize();
+    int outputSize = model.outputSize();
+    std::chrono::duration<double, std::micro> maxDelay(options.maxDelayMicroseconds);
+    std::unique_lock<std::mutex> lock(mtx);
+    while(true){
+        queued.wait(lock, [this](){ return stopping || !queue.empty(); });
+        if(stopping){
+            return;
+        }
+        //more requests can only come from connections that are not already waiting
+        std::chrono::steady_clock::time_point deadline = queue.front()->arrived
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(maxDelay);
+        queued.wait_until(lock, deadline, [this](){
+            return stopping || queue.empty() || queuedRows >= options.maxBatch || (int)queue.size() >= openConnections;
+        });
+        if(stopping){
+            return;
+        }
+        if(queue.empty()){
+            continue;
+        }
+        batch.clear();
+        int rows = 0;
+        while(!queue.empty() && (batch.empty() || rows + queue.front()->rows <= options.maxBatch)){
+            batch.push_back(queue.front());
+            rows += queue.front()->rows;
+            queue.pop_front();
+        }
+        queuedRows -= rows;
+        lock.unlock();
+
+        if(batch.size() == 1){
+            model.predictBatch(batch[0]->inputs, batch[0]->outputs, rows, workspace);
+        }else{
+            batchInputs.resize((size_t)rows * inputSize);
+            batchOutputs.resize((size_t)rows * outputSize);
+            size_t offset = 0;
+            for(Request* request: batch){
+                std::copy(request->inputs, request->inputs + (size_t)request->rows * inputSize, &batchInputs[offset * inputSize]);
+                offset += request->rows;
+            }
+            model.predictBatch(batchInputs.data(), batchOutputs.data(), rows, workspace);
+            offset = 0;
+            for(Request* request: batch){
+                const Scalar* from = &batchOutputs[offset * outputSize];
+                std::copy(from, from + (size_t)request->rows * outputSize, request->outputs);
+                offset += request->rows;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> statsLock(statsMtx);
+            totals.batches++;
+        }
+
+        lock.lock();
+        for(Request* request: batch){
+            request->done = true;
+            request->finished.notify_one();
+        }
+    }
+}
+
+//---------------------------------------------------------------- client
+
+template<typename Scalar>
+InferenceClientT<Scalar>::~InferenceClientT(){
+    close();
+}
+
+template<typename Scalar>
+bool InferenceClientT<Scalar>::connect(const std::string& socketPath, int port){
+    close();
+    socket = connectSocket(socketPath, port);
+    if(socket < 0){
+        return false;
+    }
+    if(!readFully(socket, &serverHello, sizeof(serverHello)) || serverHello.magic != SERVER_MAGIC
+       || serverHello.version != SERVER_VERSION){
+        std::cerr << "Error: the server did not answer with a valid hello\n";
+        close();
+        return false;
+    }
+    if(serverHello.scalarBytes != sizeof(Scalar)){
+        std::cerr << "Error: the server's model is " << (serverHello.scalarBytes == sizeof(float) ? "float" : "double")
+                  << ", this client sends " << (sizeof(Scalar) == sizeof(float) ? "float" : "double") << "\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+template<typename Scalar>
+void InferenceClientT<Scalar>::close(){
+    if(socket >= 0){
+        closeSocket(socket);
+        socket = -1;
+    }
+}
+
+template<typename Scalar>
+bool InferenceClientT<Scalar>::predict(const Scalar* inputs, Scalar* outputs, int rows){
+    if(socket < 0 || rows < 1 || (uint32_t)rows > serverHello.maxRows){
+        return false;
+    }
+    uint32_t count = (uint32_t)rows;
+    if(!writeFully(socket, &count, sizeof(count), inputs, (size_t)rows * serverHello.inputSize * sizeof(Scalar))){
+        return false;
+    }
+    uint32_t answered = 0;
+    return readFully(socket, &answered, sizeof(answered)) && answered == count
+           && readFully(socket, outputs, (size_t)rows * serverHello.outputSize * sizeof(Scalar));
+}
+
+template<typename Scalar>
+bool InferenceClientT<Scalar>::probe(const std::string& socketPath, int port, ServerHello& hello){
+    int client = connectSocket(socketPath, port);
+    if(client < 0){
+        return false;
+    }
+    bool ok = readFully(client, &hello, sizeof(hello)) && hello.magic == SERVER_MAGIC && hello.version == SERVER_VERSION;
+    closeSocket(client);
+    if(!ok){
+        std::cerr << "Error: the server did not answer with a valid hello\n";
+    }
+    return ok;
+}
+
+//---------------------------------------------------------------- load generator
+
+template<typename Scalar>
+static LoadResult runLoad(const LoadOptions& options, const ServerHello& hello){
+    LoadResult result;
+    int connections = std::max(1, options.connections);
+    int rows = std::min(std::max(1, options.rowsPerRequest), (int)hello.maxRows);
+    //every client connects before the clock starts
+    std::vector<std::unique_ptr<InferenceClientT<Scalar>>> clients;
+    for(int c = 0; c < connections; c++){
+        clients.push_back(std::make_unique<InferenceClientT<Scalar>>());
+        if(!clients.back()->connect(options.socketPath, options.port)){
+            return result;
+        }
+    }
+    std::vector<std::vector<float>> latencies(connections);
+    std::vector<uint64_t> requests(connections, 0);
+    std::atomic<bool> failed{false};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end = start
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.seconds));
+    std::vector<std::thread> threads;
+    for(int c = 0; c < connections; c++){
+        threads.emplace_back([&, c](){
+            std::mt19937_64 generator(options.seed + c);
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            std::vector<Scalar> inputs((size_t)rows * hello.inputSize), outputs((size_t)rows * hello.outputSize);
+            for(Scalar& value: inputs){
+                value = (Scalar)uniform(generator);
+            }
+            while(std::chrono::steady_clock::now() < end){
+                std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+                if(!clients[c]->predict(inputs.data(), outputs.data(), rows)){
+                    failed = true;
+                    return;
+                }
+                latencies[c].push_back((float)microsecondsSince(sent));
+                requests[c]++;
+                inputs[requests[c] % inputs.size()] = (Scalar)uniform(generator);
+            }
+        });
+    }
+    for(std::thread& thread: threads){
+        thread.join();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<float> all;
+    for(int c = 0; c < connections; c++){
+        result.requests += requests[c];
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    }
+    result.rows = result.requests * rows;
+    result.latency = summarizeLatencies(all);
+    result.ok = !failed;
+    return result;
+}
+
+LoadResult generateLoad(const LoadOptions& options){
+    ServerHello hello;
+    if(!InferenceClient::probe(options.socketPath, options.port, hello)){
+        return LoadResult();
+    }
+    if(hello.scalarBytes == sizeof(float)){
+        return runLoad<float>(options, hello);
+    }
+    return runLoad<double>(options, hello);
+}
+
+template class InferenceServerT<double>;
+template class InferenceServerT<float>;
+template class InferenceClientT<double>;
+template class InferenceClientT<float>;
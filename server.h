@@ -0,0 +1,207 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include "inference.h"
+
+//wire protocol of InferenceServer, host byte order since both ends are on the
+//same machine:
+//  on connect the server sends a ServerHello
+//  request:  uint32 rows, then rows x inputSize values
+//  response: uint32 rows, then rows x outputSize values
+//values are float or double, whichever the model is (ServerHello::scalarBytes).
+//A connection sends its next request once it has read the last response.
+//Rows 0 or closing the socket ends the connection, so does a request of more
+//than maxRows rows
+const uint32_t SERVER_MAGIC = 0x56534e4e;
+const uint32_t SERVER_VERSION = 1;
+
+struct ServerHello {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t inputSize;
+    uint32_t outputSize;
+    uint32_t scalarBytes;
+    uint32_t maxRows;
+};
+static_assert(sizeof(ServerHello) == 24, "server hello layout changed");
+
+struct ServerOptions {
+    //listens on this Unix domain socket when set, otherwise on loopback TCP
+    std::string socketPath;
+    //loopback TCP port, 0 picks a free one (see InferenceServer::port)
+    int port = 0;
+    //rows run through one predictBatch at most
+    int maxBatch = 64;
+    //how long the oldest waiting request may wait for others to join its batch.
+    //A batch leaves early once it is full or every connection is waiting in it
+    double maxDelayMicroseconds = 200.0;
+    //threads running batches, each with its own workspace
+    int workers = 1;
+    //largest request accepted
+    int maxRows = 4096;
+};
+
+//percentiles of a set of latencies, 0 when there are none
+struct LatencySummary {
+    double p50Microseconds = 0.0;
+    double p99Microseconds = 0.0;
+    double maxMicroseconds = 0.0;
+};
+//reorders microseconds
+LatencySummary summarizeLatencies(std::vector<float>& microseconds);
+
+//what a server did since it started or since the last stats(true). The
+//latency of a request runs from reading its last byte to writing its response
+struct ServerStats {
+    uint64_t requests = 0;
+    uint64_t rows = 0;
+    uint64_t batches = 0;
+    double seconds = 0.0;
+    LatencySummary latency;
+};
+void printServerStats(const ServerStats& stats, std::ostream& out);
+
+//serves predictions of a frozen network to local processes. Every connection
+//has a thread that reads its requests and queues them. Worker threads take
+//the queued requests as one micro-batch, up to maxBatch rows, copy them into
+//one matrix and run a single predictBatch over it, so many clients sending
+//one row each share the GEMMs. The first request of a batch waits at most
+//maxDelayMicroseconds for company, which bounds the latency batching adds.
+//Results are identical to calling predict on each request alone
+template<typename Scalar>
+class InferenceServerT {
+public:
+    InferenceServerT(const InferenceNetworkT<Scalar>& model, const ServerOptions& options = ServerOptions());
+    //stops the server
+    ~InferenceServerT();
+    InferenceServerT(const InferenceServerT&) = delete;
+    InferenceServerT& operator=(const InferenceServerT&) = delete;
+
+    //binds the socket and starts the threads, prints the error and returns
+    //false when the socket can not be set up
+    bool start();
+    //closes every connection and joins the threads, requests in flight are dropped
+    void stop();
+    bool running() const {
+        return listenSocket >= 0;
+    }
+    //the TCP port, resolved once start() has bound a port 0
+    int port() const {
+        return boundPort;
+    }
+    ServerStats stats(bool reset = false);
+
+private:
+    //one queued request, owned by the connection thread waiting for it. The
+    //thread only leaves once done (a worker ran it) or abandoned (stop() took
+    //it off the queue), after that nothing else refers to it
+    struct Request {
+        const Scalar* inputs;
+        Scalar* outputs;
+        int rows;
+        bool done;
+        bool abandoned;
+        std::chrono::steady_clock::time_point arrived;
+        std::condition_variable finished;
+    };
+    struct Connection {
+        int socket;
+        std::thread thread;
+        std::atomic<bool> closed{false};
+    };
+
+    InferenceNetworkT<Scalar> model;
+    ServerOptions options;
+    int listenSocket = -1;
+    int boundPort = 0;
+    std::thread acceptor;
+    std::vector<std::thread> workers;
+
+    std::mutex mtx;
+    std::condition_variable queued;
+    std::deque<Request*> queue;
+    int queuedRows = 0;
+    int openConnections = 0;
+    bool stopping = false;
+    std::vector<std::unique_ptr<Connection>> connections;
+
+    std::mutex statsMtx;
+    ServerStats totals;
+    std::vector<float> latencies;
+    std::chrono::steady_clock::time_point statsStart;
+
+    void acceptLoop();
+    void serveConnection(Connection& connection);
+    void workerLoop();
+    //removes connections whose thread has finished, with mtx held
+    void reapConnections();
+};
+
+typedef InferenceServerT<double> InferenceServer;
+typedef InferenceServerT<float> InferenceServerF;
+
+//blocking client for one connection to an InferenceServer
+template<typename Scalar>
+class InferenceClientT {
+public:
+    InferenceClientT() = default;
+    ~InferenceClientT();
+    InferenceClientT(const InferenceClientT&) = delete;
+    InferenceClientT& operator=(const InferenceClientT&) = delete;
+
+    //the Unix domain socket at socketPath, or loopback TCP port when it is
+    //empty. Fails when the server's model is not in Scalar
+    bool connect(const std::string& socketPath, int port);
+    void close();
+    const ServerHello& hello() const {
+        return serverHello;
+    }
+    //inputs is rows x inputSize and outputs rows x outputSize, row-major
+    bool predict(const Scalar* inputs, Scalar* outputs, int rows);
+
+    //connects, reads the hello and disconnects, to find out what a server serves
+    static bool probe(const std::string& socketPath, int port, ServerHello& hello);
+
+private:
+    int socket = -1;
+    ServerHello serverHello = {};
+};
+
+typedef InferenceClientT<double> InferenceClient;
+typedef InferenceClientT<float> InferenceClientF;
+
+//load generator: connections clients each send requests of rowsPerRequest
+//random rows back to back for the given time
+struct LoadOptions {
+    std::string socketPath;
+    int port = 0;
+    int connections = 8;
+    int rowsPerRequest = 1;
+    double seconds = 2.0;
+    uint64_t seed = 1;
+};
+
+//what the clients saw. The latency of a request runs from sending it to
+//reading the whole response
+struct LoadResult {
+    bool ok = false;
+    uint64_t requests = 0;
+    uint64_t rows = 0;
+    double seconds = 0.0;
+    LatencySummary latency;
+};
+LoadResult generateLoad(const LoadOptions& options);
+void printLoadResult(const LoadResult& result, std::ostream& out);
+
+#endif // SERVER_H
@@ -0,0 +1,30 @@
+#ifndef SIMD_TARGET_H
+#define SIMD_TARGET_H
+
+//shared setup of the kernel translation units, only include it from those.
+//every ISA is compiled into the same binary with per-function target
+//attributes and picked at runtime (see kernels.h)
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define NN_TARGET(isa)
+#else
+#define NN_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+//no kernel may fuse a multiply and an add, otherwise the AVX-512 path (which
+//implies FMA) would round differently from the others
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+#endif // SIMD_TARGET_H
@@ -0,0 +1,178 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+//fixed set of worker threads that run batches of indexed tasks.
+//run() blocks until every task is done and the calling thread helps out, so a
+//pool of n threads keeps n - 1 workers. Tasks are dealt out as one contiguous
+//range per thread and idle threads steal the back half of a busy thread's range,
+//so neighbouring tasks tend to stay on one core while the load still balances.
+//Which thread runs a task is not fixed, callers that need reproducible results
+//key their buffers by task index
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads){
+        threadCount = numThreads < 1 ? 1 : numThreads;
+        for(int i = 0; i < threadCount; i++){
+            queues.push_back(std::make_unique<TaskRange>());
+        }
+        for(int i = 1; i < threadCount; i++){
+            workers.emplace_back([this, i](){ workerLoop(i); });
+        }
+    }
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread& worker: workers){
+            worker.join();
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const {
+        return threadCount;
+    }
+
+    //calls task(i) for every i in [0, numTasks). The task is called through a
+    //pointer and never copied, so running a lambda does not allocate
+    template<typename Task>
+    void run(int numTasks, const Task& task){
+        if(numTasks <= 0){
+            return;
+        }
+        if(threadCount == 1 || numTasks == 1){
+            for(int i = 0; i < numTasks; i++){
+                task(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            currentTask = &task;
+            invokeTask = [](const void* function, int index){
+                (*static_cast<const Task*>(function))(index);
+            };
+            for(int i = 0; i < threadCount; i++){
+                TaskRange& range = *queues[i];
+                std::lock_guard<std::mutex> rangeLock(range.mtx);
+                range.next = (int)((long long)numTasks * i / threadCount);
+                range.end = (int)((long long)numTasks * (i + 1) / threadCount);
+            }
+            remaining.store(numTasks);
+            generation++;
+        }
+        wake.notify_all();
+        drainTasks(0);
+
+        //workers that joined this run have to be out of drainTasks before the
+        //task state can be reused by the next run
+        std::unique_lock<std::mutex> lock(mtx);
+        finished.wait(lock, [this](){ return remaining.load() == 0 && busy == 0; });
+        currentTask = nullptr;
+    }
+
+private:
+    struct TaskRange {
+        std::mutex mtx;
+        int next = 0;
+        int end = 0;
+    };
+
+    int threadCount;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<TaskRange>> queues;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const void* currentTask = nullptr;
+    void (*invokeTask)(const void*, int) = nullptr;
+    int busy = 0;
+    std::atomic<int> remaining{0};
+    unsigned long long generation = 0;
+    bool stopping = false;
+
+    //takes the next task from the front of this thread's own range
+    bool popOwn(int self, int& index){
+        TaskRange& range = *queues[self];
+        std::lock_guard<std::mutex> lock(range.mtx);
+        if(range.next >= range.end){
+            return false;
+        }
+        index = range.next++;
+        return true;
+    }
+
+    //moves the back half of another thread's range into this thread's range
+    bool steal(int self){
+        for(int offset = 1; offset < threadCount; offset++){
+            TaskRange& victim = *queues[(self + offset) % threadCount];
+            int begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.mtx);
+                int left = victim.end - victim.next;
+                if(left <= 0){
+                    continue;
+                }
+                int taken = (left + 1) / 2;
+                end = victim.end;
+                begin = end - taken;
+                victim.end = begin;
+            }
+            TaskRange& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            own.next = begin;
+            own.end = end;
+            return true;
+        }
+        return false;
+    }
+
+    void drainTasks(int self){
+        int index;
+        while(remaining.load() > 0){
+            if(popOwn(self, index)){
+                invokeTask(currentTask, index);
+                remaining.fetch_sub(1);
+            }else if(!steal(self)){
+                return;
+            }
+        }
+    }
+
+    void workerLoop(int self){
+        unsigned long long seen = 0;
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [&](){ return stopping || generation != seen; });
+                if(stopping){
+                    return;
+                }
+                seen = generation;
+                //woke up after the run already finished
+                if(currentTask == nullptr){
+                    continue;
+                }
+                busy++;
+            }
+            drainTasks(self);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                busy--;
+            }
+            finished.notify_all();
+        }
+    }
+};
+
+#endif // THREAD_POOL_H